@@ -4,8 +4,12 @@
 	Copyright: See COPYING file that comes with this distribution
 
 */
+#include <QDir>
 #include <QSettings>
+#include <QTextStream>
+#include "../src/analytics.h"
 #include "../src/common.h"
+#include "../src/logdaemon.h"
 #include "../src/mainimpl.h"
 
 #if defined(_MSC_VER) && defined(NDEBUG)
@@ -15,8 +19,47 @@
 
 using namespace QGit;
 
+static int runDaemon(int argc, char* argv[]) {
+// headless, no display is needed
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setOrganizationName(ORG_KEY);
+	QCoreApplication::setApplicationName(APP_KEY);
+	GIT_DIR = QSettings().value(GIT_DIR_KEY).toString();
+
+	LogDaemon daemon;
+	if (!daemon.listen())
+		return 1;
+
+	return app.exec();
+}
+
+static int runReport(int argc, char* argv[]) {
+// qgit --report [directory [depth]], churn of current repository
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setOrganizationName(ORG_KEY);
+	QCoreApplication::setApplicationName(APP_KEY);
+	GIT_DIR = QSettings().value(GIT_DIR_KEY).toString();
+
+	ChurnQuery q;
+	if (argc > 2)
+		q.prefix = QString::fromLocal8Bit(argv[2]);
+	if (argc > 3)
+		q.depth = QString(argv[3]).toInt();
+
+	QTextStream out(stdout);
+	return Analytics::report(QDir::currentPath(), q, out) ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) {
 
+	if (argc > 1 && QString(argv[1]) == "--daemon")
+		return runDaemon(argc, argv);
+
+	if (argc > 1 && QString(argv[1]) == "--report")
+		return runReport(argc, argv);
+
 	QApplication app(argc, argv);
 	QCoreApplication::setOrganizationName(ORG_KEY);
 	QCoreApplication::setApplicationName(APP_KEY);
@@ -1,7 +1,23 @@
 TEMPLATE=subdirs
 SUBDIRS= \
     app \
-    test
+    test \
+    test/odb \
+    test/reachability \
+    test/rowblocks \
+    test/revtext \
+    test/dateindex \
+    test/queries \
+    test/snapshot \
+    test/logformat \
+    test/spawner \
+    test/diffview \
+    test/annotate \
+    test/analytics \
+    test/patchids \
+    test/historyorder \
+    test/tasks \
+    test/logdaemon
 CONFIG += debug_and_release c++11
 
 QMAKE_CXXFLAGS += -std=c++11
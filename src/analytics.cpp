@@ -0,0 +1,305 @@
+#include "analytics.h"
+
+#include <algorithm>
+
+#include <QDateTime>
+#include <QDir>
+#include <QHash>
+#include <QTextStream>
+#include <QtConcurrentMap>
+
+#include "cache.h"
+#include "snapshot.h"
+#include "task.h"
+
+using namespace QGit;
+
+static const int ROWS_CHUNK = 16384; // rows counted by a single map call
+static const int CANCEL_ROWS = 4096; // rows between two cancel checks
+static const uint DAY_SECS = 86400;
+
+struct ChurnCounts {
+    ChurnCounts() : commits(0), changes(0) {}
+    ChurnCounts(int groups, int authors)
+        : pathCommits(groups), pathChanges(groups),
+          authorCommits(authors), authorChanges(authors), commits(0), changes(0) {}
+
+    QVector<int> pathCommits, pathChanges;
+    QVector<int> authorCommits, authorChanges;
+    QHash<int, QPair<int, int> > periods; // commits and changes by period
+    int commits, changes;
+};
+
+struct ChurnMap {
+    typedef ChurnCounts result_type;
+
+    ChurnMap(const ChurnData& d, const ChurnQuery& q, const QVector<int>& g,
+             int gc, const CancelToken& t) : data(d), query(q), dirGroup(g), groupsCnt(gc), tok(t) {}
+
+    ChurnCounts operator()(int first) const {
+
+        ChurnCounts c(groupsCnt, data.authors.count());
+        QVector<int> counted(groupsCnt, -1); // last row counted, once per commit
+        const uint periodSecs = qMax(query.periodDays, 1) * DAY_SECS;
+        const int last = qMin(first + ROWS_CHUNK, data.files.count());
+
+        for (int row = first; row < last; row++) {
+
+            if ((row - first) % CANCEL_ROWS == 0 && tok.isCanceled())
+                break;
+
+            const uint t = data.authorTimes.at(row);
+            const RevFile* rf = data.files.at(row);
+            if (!rf || t < query.since || t > query.until)
+                continue;
+
+            int changed = 0;
+            for (int i = 0; i < rf->count(); i++) {
+                int g = dirGroup.at(rf->dirAt(i));
+                if (g == -1)
+                    continue;
+
+                changed++;
+                c.pathChanges[g]++;
+                if (counted.at(g) != row) {
+                    counted[g] = row;
+                    c.pathCommits[g]++;
+                }
+            }
+            if (changed == 0)
+                continue;
+
+            c.commits++;
+            c.changes += changed;
+            int a = data.authorIds.at(row);
+            if (a != -1) {
+                c.authorCommits[a]++;
+                c.authorChanges[a] += changed;
+            }
+            QPair<int, int>& p = c.periods[t / periodSecs];
+            p.first++;
+            p.second += changed;
+        }
+        return c;
+    }
+
+    const ChurnData& data;
+    const ChurnQuery& query;
+    const QVector<int>& dirGroup;
+    int groupsCnt;
+    CancelToken tok;
+};
+
+static void addVector(QVector<int>& a, const QVector<int>& b) {
+
+    for (int i = 0; i < b.count(); i++)
+        a[i] += b.at(i);
+}
+
+static void reduceCounts(ChurnCounts& res, const ChurnCounts& c) {
+
+    if (res.pathCommits.isEmpty() && res.authorCommits.isEmpty()) {
+        res = c; // first one
+        return;
+    }
+    addVector(res.pathCommits, c.pathCommits);
+    addVector(res.pathChanges, c.pathChanges);
+    addVector(res.authorCommits, c.authorCommits);
+    addVector(res.authorChanges, c.authorChanges);
+    QHashIterator<int, QPair<int, int> > it(c.periods);
+    while (it.hasNext()) {
+        it.next();
+        QPair<int, int>& p = res.periods[it.key()];
+        p.first += it.value().first;
+        p.second += it.value().second;
+    }
+    res.commits += c.commits;
+    res.changes += c.changes;
+}
+
+static bool moreChanges(const ChurnEntry& a, const ChurnEntry& b) {
+
+    return (a.changes != b.changes ? a.changes > b.changes : a.key < b.key);
+}
+
+static const QVector<ChurnEntry> toEntries(const QVector<int>& commits,
+                                           const QVector<int>& changes, const QStringList& keys) {
+    QVector<ChurnEntry> v;
+    for (int i = 0; i < changes.count(); i++)
+        if (changes.at(i) > 0) {
+            ChurnEntry e;
+            e.key = keys.at(i);
+            e.commits = commits.at(i);
+            e.changes = changes.at(i);
+            v.append(e);
+        }
+    std::sort(v.begin(), v.end(), moreChanges);
+    return v;
+}
+
+const QVector<int> Analytics::groupDirs(const StrVect& dirNames, const ChurnQuery& q,
+                                        QStringList* groups) {
+// group of each directory, -1 if outside prefix. Directories are
+// much less than commits, here strings can be used
+
+    QString prefix(q.prefix);
+    if (!prefix.isEmpty() && !prefix.endsWith('/'))
+        prefix.append('/');
+
+    QHash<QString, int> ids;
+    QVector<int> dirGroup(dirNames.count(), -1);
+    for (int i = 0; i < dirNames.count(); i++) {
+
+        const QString& dn = dirNames.at(i); // with a trailing '/', empty for root
+        if (!dn.startsWith(prefix))
+            continue;
+
+        const QString rest(dn.mid(prefix.length()));
+        QString key(prefix);
+        if (!rest.isEmpty() && q.depth > 0)
+            key.append(rest.section('/', 0, q.depth - 1, QString::SectionSkipEmpty) + '/');
+
+        if (key.isEmpty())
+            key = "./";
+
+        if (!ids.contains(key)) {
+            ids.insert(key, groups->count());
+            groups->append(key);
+        }
+        dirGroup[i] = ids.value(key);
+    }
+    return dirGroup;
+}
+
+const ChurnReport Analytics::compute(const ChurnData& d, const ChurnQuery& q,
+                                     const CancelToken& tok) {
+    QStringList groups;
+    const QVector<int> dirGroup(groupDirs(d.dirNames, q, &groups));
+
+    QVector<int> chunks;
+    for (int i = 0; i < d.files.count(); i += ROWS_CHUNK)
+        chunks.append(i);
+
+    ChurnReport r;
+    if (chunks.isEmpty() || groups.isEmpty())
+        return r;
+
+    const ChurnCounts c(QtConcurrent::blockingMappedReduced<ChurnCounts>(chunks,
+                        ChurnMap(d, q, dirGroup, groups.count(), tok), reduceCounts));
+    if (tok.isCanceled())
+        return r;
+
+    r.commits = c.commits;
+    r.changes = c.changes;
+    r.byPath = toEntries(c.pathCommits, c.pathChanges, groups);
+    r.byAuthor = toEntries(c.authorCommits, c.authorChanges, QStringList(d.authors.toList()));
+
+    QList<int> periods(c.periods.keys());
+    std::sort(periods.begin(), periods.end());
+    const uint periodSecs = qMax(q.periodDays, 1) * DAY_SECS;
+    FOREACH (QList<int>, it, periods) {
+        ChurnEntry e;
+        e.key = QDateTime::fromTime_t(*it * periodSecs).date().toString(Qt::ISODate);
+        e.commits = c.periods.value(*it).first;
+        e.changes = c.periods.value(*it).second;
+        r.byPeriod.append(e);
+    }
+    return r;
+}
+
+ChurnDataPtr Analytics::fromSnapshot(const QSharedPointer<const RepoSnapshot>& s) {
+// one hash lookup per row, done once and not for each query
+
+    QSharedPointer<ChurnData> d(new ChurnData);
+    d->snapshot = s;
+    d->dirNames = s->dirs();
+    d->authors = s->authorList();
+    const int cnt = s->count();
+    d->files.reserve(cnt);
+    d->authorIds.reserve(cnt);
+    d->authorTimes.reserve(cnt);
+    for (int i = 0; i < cnt; i++) {
+        d->files.append(s->files(i));
+        d->authorIds.append(s->authorId(i));
+        d->authorTimes.append(s->authorTime(i));
+    }
+    return d;
+}
+
+ChurnDataPtr Analytics::fromCache(const QString& workDir, QString* err) {
+/*
+   Headless, without a loaded repository. File names come from the
+   cache qgit saves on exit, so repository must have been opened at
+   least once, authors and dates from a plain 'git log'.
+*/
+    QByteArray out;
+    if (!runProcess(workDir, "git rev-parse --git-dir", &out)) {
+        *err = "Not a git repository: " + workDir;
+        return ChurnDataPtr();
+    }
+    const QString gitDir(QDir(workDir).absoluteFilePath(QString(out).trimmed()));
+
+    QSharedPointer<ChurnData> d(new ChurnData);
+    RevFileMap rfm;
+    StrVect fileNames;
+    QByteArray shaBuf; // keeps rfm keys alive
+    if (!Cache::load(gitDir, rfm, d->dirNames, fileNames, shaBuf) || rfm.isEmpty()) {
+        *err = "File names cache not found, open the repository with qgit first";
+        return ChurnDataPtr();
+    }
+    d->keeper = QSharedPointer<RevFileKeeper>(new RevFileKeeper());
+    FOREACH (RevFileMap, it, rfm)
+        d->keeper->add(*it);
+
+    if (!runProcess(workDir, "git log --all --format=%H%x09%at%x09%an%x20<%ae>", &out)) {
+        *err = "Unable to read the log of " + workDir;
+        return ChurnDataPtr();
+    }
+    QHash<QByteArray, int> authorIds;
+    const QList<QByteArray> lines(out.split('\n'));
+    FOREACH (QList<QByteArray>, it, lines) {
+
+        const QList<QByteArray> f(it->split('\t'));
+        if (f.count() < 3 || f.at(0).length() != 40)
+            continue;
+
+        if (!authorIds.contains(f.at(2))) {
+            authorIds.insert(f.at(2), d->authors.count());
+            d->authors.append(QString::fromUtf8(f.at(2)));
+        }
+        d->files.append(rfm.value(ShaString(f.at(0).constData())));
+        d->authorIds.append(authorIds.value(f.at(2)));
+        d->authorTimes.append(f.at(1).toUInt());
+    }
+    return d;
+}
+
+bool Analytics::report(const QString& workDir, const ChurnQuery& q, QTextStream& out) {
+
+    QString err;
+    const ChurnDataPtr d(fromCache(workDir, &err));
+    if (!d) {
+        out << err << "\n";
+        return false;
+    }
+    out << compute(*d, q, CancelToken()).toText();
+    return true;
+}
+
+const QString ChurnReport::toText() const {
+// tab separated, easy to feed to other tools
+
+    QString s;
+    QTextStream ts(&s);
+    ts << "# " << commits << " commits, " << changes << " file changes\n";
+
+    const char* titles[] = { "path", "author", "period" };
+    const QVector<ChurnEntry>* tables[] = { &byPath, &byAuthor, &byPeriod };
+    for (int i = 0; i < 3; i++) {
+        ts << "\n# " << titles[i] << "\tcommits\tchanges\n";
+        FOREACH (QVector<ChurnEntry>, it, *tables[i])
+            ts << it->key << '\t' << it->commits << '\t' << it->changes << '\n';
+    }
+    ts.flush();
+    return s;
+}
@@ -0,0 +1,83 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <climits>
+
+#include <QSharedPointer>
+#include <QVector>
+
+#include "common.h"
+
+class CancelToken;
+class QTextStream;
+class RepoSnapshot;
+class RevFileKeeper;
+
+struct ChurnQuery {
+    ChurnQuery() : depth(1), since(0), until(UINT_MAX), periodDays(30) {}
+    QString prefix;  // only paths below this directory, empty for all
+    int depth;       // path components after prefix to group by
+    uint since;      // author time range
+    uint until;
+    int periodDays;  // time bucket size
+};
+
+struct ChurnEntry {
+    ChurnEntry() : commits(0), changes(0) {}
+    QString key;
+    int commits;
+    int changes;     // changed files
+};
+
+struct ChurnReport {
+    ChurnReport() : commits(0), changes(0) {}
+    const QString toText() const;
+
+    QVector<ChurnEntry> byPath;   // most changed first
+    QVector<ChurnEntry> byAuthor; // most changed first
+    QVector<ChurnEntry> byPeriod; // oldest first
+    int commits;
+    int changes;
+};
+
+/*
+ * The tables a query runs on, by row. They are taken once from a
+ * repository snapshot, or from the file names cache when headless,
+ * and then shared by all the queries on the same data.
+ */
+struct ChurnData {
+    QVector<const RevFile*> files; // NULL if not known
+    QVector<int> authorIds;        // -1 if not known
+    QVector<uint> authorTimes;
+    QVector<QString> authors;      // by author id
+    StrVect dirNames;
+    QSharedPointer<const RepoSnapshot> snapshot; // keep files alive
+    QSharedPointer<RevFileKeeper> keeper;
+};
+typedef QSharedPointer<const ChurnData> ChurnDataPtr;
+
+/*
+ * Churn statistics over the file names data: changed files and
+ * commits per path prefix, per author and per time period. No git
+ * command is run, rows are split in chunks counted in parallel and
+ * then reduced, directories are grouped once per query and counters
+ * are plain vectors, so that a query can be recomputed interactively
+ * also on very big histories.
+ *
+ * There are no line counts in the file names data, churn is the
+ * number of file changes.
+ */
+class Analytics {
+public:
+    static ChurnDataPtr fromSnapshot(const QSharedPointer<const RepoSnapshot>& s);
+    static ChurnDataPtr fromCache(const QString& workDir, QString* err);
+    static const ChurnReport compute(const ChurnData& d, const ChurnQuery& q,
+                                     const CancelToken& tok);
+    static bool report(const QString& workDir, const ChurnQuery& q, QTextStream& out);
+
+private:
+    static const QVector<int> groupDirs(const StrVect& dirNames, const ChurnQuery& q,
+                                        QStringList* groups);
+};
+
+#endif // ANALYTICS_H
@@ -0,0 +1,291 @@
+#include "annotate.h"
+
+#include <QMutexLocker>
+#include <QtConcurrentMap>
+
+#include "common.h"
+#include "task.h"
+
+static const int PARSE_CHUNK = 64; // revisions parsed together, then progress is reported
+
+struct AnnotateParse {
+    typedef Annotate::Patches result_type;
+
+    Annotate::Patches operator()(const QString& patch) const { return Annotate::parse(patch); }
+};
+
+static bool parseRange(const QString& s, int* start, int* cnt) {
+// "12,3" or "12", as in a hunk header after the sign
+
+    bool ok1, ok2 = true;
+    *start = s.section(',', 0, 0).toInt(&ok1);
+    *cnt = (s.contains(',') ? s.section(',', 1, 1).toInt(&ok2) : 1);
+    if (*cnt == 0)
+        (*start)++; // empty range starts after the line given
+
+    return ok1 && ok2;
+}
+
+void Annotate::clear() {
+
+    QMutexLocker lock(&mutex);
+    results.clear();
+    patches.clear();
+}
+
+const Annotate::Patches Annotate::parse(const QString& patch) {
+/*
+   Only what is needed to map lines is kept: file names and blobs
+   from the header and, for each hunk, the old line of each new one.
+*/
+    Patches ps;
+    Hunk* h = NULL;
+    int oldLine = 0, oldLeft = 0, newLeft = 0;
+    const QStringList sl(patch.split('\n'));
+    FOREACH_SL (it, sl) {
+
+        const QString& l = *it;
+        if (h && (oldLeft > 0 || newLeft > 0)) {
+
+            const QChar c(l.isEmpty() ? QChar(' ') : l.at(0));
+            if (c == '+') {
+                h->oldLines.append(0);
+                newLeft--;
+            } else if (c == '-') {
+                oldLine++;
+                oldLeft--;
+            } else if (c != '\\') { // not a 'No newline at end of file'
+                h->oldLines.append(oldLine++);
+                oldLeft--;
+                newLeft--;
+            }
+            continue;
+        }
+        h = NULL;
+        if (l.startsWith("diff --git a/")) {
+            int i = l.lastIndexOf(" b/");
+            ps.append(Patch());
+            ps.last().oldPath = l.mid(13, i - 13);
+            ps.last().newPath = l.mid(i + 3);
+            continue;
+        }
+        if (ps.isEmpty())
+            continue;
+
+        Patch& p = ps.last();
+        if (l.startsWith("new file mode"))
+            p.isNew = true;
+
+        else if (l.startsWith("index ")) {
+            const QString blobs(l.mid(6).section(' ', 0, 0));
+            p.oldBlob = blobs.section("..", 0, 0);
+            p.newBlob = blobs.section("..", 1, 1);
+
+        } else if (l.startsWith("rename from "))
+            p.oldPath = l.mid(12);
+
+        else if (l.startsWith("rename to "))
+            p.newPath = l.mid(10);
+
+        else if (l.startsWith("--- a/")) // unambiguous with spaces in names
+            p.oldPath = l.mid(6);
+
+        else if (l.startsWith("+++ b/"))
+            p.newPath = l.mid(6);
+
+        else if (l.startsWith("@@ -")) {
+            Hunk hk;
+            if (   !parseRange(l.section(' ', 1, 1).mid(1), &hk.oldStart, &hk.oldCnt)
+                || !parseRange(l.section(' ', 2, 2).mid(1), &hk.newStart, &hk.newCnt)) {
+                dbp("ASSERT in Annotate::parse, bad hunk header %1", l);
+                continue;
+            }
+            hk.oldLines.reserve(hk.newCnt);
+            p.hunks.append(hk);
+            h = &p.hunks.last();
+            oldLine = hk.oldStart;
+            oldLeft = hk.oldCnt;
+            newLeft = hk.newCnt;
+        }
+    }
+    return ps;
+}
+
+int Annotate::mapLine(const Patch& p, int line) {
+// line number in the parent, 0 if the line is added by the patch
+
+    int ofs = 0;
+    FOREACH (QVector<Hunk>, h, p.hunks) {
+
+        if (line < h->newStart)
+            break;
+
+        if (line < h->newStart + h->newCnt)
+            return h->oldLines.value(line - h->newStart);
+
+        ofs = (h->oldStart + h->oldCnt) - (h->newStart + h->newCnt);
+    }
+    return line + ofs;
+}
+
+const Annotate::Patch* Annotate::findPatch(const Patches& ps, const QString& path) {
+
+    for (int i = 0; i < ps.count(); i++)
+        if (ps.at(i).newPath == path)
+            return &ps.at(i);
+
+    return NULL; // file not changed by this revision
+}
+
+const QVector<Annotate::Patches> Annotate::parseChunk(const Steps& steps, int first,
+                                                      int last, const QString& path) {
+// patches not already parsed are parsed on all the available cores
+
+    QVector<Patches> res(last - first);
+    QVector<int> todo;
+    QStringList texts;
+    {
+        QMutexLocker lock(&mutex);
+        for (int i = first; i < last; i++) {
+            const Patches* ps = patches.object(steps.at(i).sha + ':' + path);
+            if (ps)
+                res[i - first] = *ps;
+            else {
+                todo.append(i);
+                texts.append(steps.at(i).patch);
+            }
+        }
+    }
+    if (todo.isEmpty())
+        return res;
+
+    const QList<Patches> parsed(QtConcurrent::blockingMapped<QList<Patches> >(texts, AnnotateParse()));
+
+    QMutexLocker lock(&mutex);
+    for (int i = 0; i < todo.count(); i++) {
+
+        const Patches& ps = parsed.at(i);
+        int cost = 1;
+        FOREACH (Patches, p, ps)
+            cost += p->hunks.count();
+
+        res[todo.at(i) - first] = ps;
+        patches.insert(steps.at(todo.at(i)).sha + ':' + path, new Patches(ps), cost);
+    }
+    return res;
+}
+
+bool Annotate::lookup(const QString& fileSha, const QString& path, QStringList* origins) {
+
+    if (fileSha.isEmpty())
+        return false;
+
+    QMutexLocker lock(&mutex);
+    const QStringList* o = results.object(fileSha + ':' + path);
+    if (o)
+        *origins = *o;
+
+    return (o != NULL);
+}
+
+bool Annotate::run(const Steps& steps, const QString& fileSha, const QString& path, int lineCnt,
+                   int screenLines, const CancelToken& tok, const Progress& progress, Result* res) {
+/*
+   Steps are the revisions from the annotated one back to the oldest,
+   following first parents. For each line still unknown we keep its
+   number in the file of the current revision, mapped back through
+   the patches until some patch adds it. File sha, if not empty, is
+   used to cache the result.
+*/
+    *res = Result();
+    if (lookup(fileSha, path, &res->origins) && res->origins.count() == lineCnt) {
+        res->known = lineCnt;
+        res->isComplete = true;
+        return true;
+    }
+    res->origins.clear();
+    QVector<int> pending, cur; // unknown lines and their current numbers
+    pending.reserve(lineCnt);
+    cur.reserve(lineCnt);
+    for (int i = 0; i < lineCnt; i++) {
+        res->origins.append(QString());
+        pending.append(i);
+        cur.append(i + 1);
+    }
+    QString curPath(path), curBlob(fileSha);
+    bool screenDone = (screenLines <= 0);
+    for (int first = 0; first < steps.count() && !pending.isEmpty(); first += PARSE_CHUNK) {
+
+        if (tok.isCanceled())
+            return false;
+
+        int last = qMin(first + PARSE_CHUNK, steps.count());
+        const QVector<Patches> chunk(parseChunk(steps, first, last, path));
+
+        for (int i = first; i < last && !pending.isEmpty(); i++) {
+
+            const QString& sha = steps.at(i).sha;
+
+            // an already annotated file ends the walk
+            QStringList cached;
+            if (i > 0 && lookup(curBlob, curPath, &cached)) {
+                FOREACH (QVector<int>, t, pending)
+                    res->origins[*t] = cached.value(cur.at(*t) - 1, sha);
+
+                pending.clear();
+                break;
+            }
+            const Patch* p = findPatch(chunk.at(i - first), curPath);
+            if (!p)
+                continue;
+
+            if (p->isNew) {
+                FOREACH (QVector<int>, t, pending)
+                    res->origins[*t] = sha;
+
+                pending.clear();
+                break;
+            }
+            QVector<int> left;
+            FOREACH (QVector<int>, t, pending) {
+                int line = mapLine(*p, cur.at(*t));
+                if (line == 0)
+                    res->origins[*t] = sha;
+                else {
+                    cur[*t] = line;
+                    left.append(*t);
+                }
+            }
+            pending = left;
+            curPath = p->oldPath;
+            curBlob = p->oldBlob;
+
+            // pending lines are sorted, the ones on screen come first
+            if (   !screenDone && !pending.isEmpty()
+                && *pending.constBegin() >= screenLines) {
+                screenDone = true;
+                res->known = lineCnt - pending.count();
+                if (progress)
+                    progress(*res);
+            }
+        }
+        res->known = lineCnt - pending.count();
+        if (progress && !pending.isEmpty())
+            progress(*res);
+    }
+    if (tok.isCanceled())
+        return false;
+
+    // lines older than loaded history, e.g. past a boundary revision
+    if (!steps.isEmpty())
+        FOREACH (QVector<int>, t, pending)
+            res->origins[*t] = steps.last().sha;
+
+    res->known = lineCnt;
+    res->isComplete = true;
+    if (!fileSha.isEmpty()) {
+        QMutexLocker lock(&mutex);
+        results.insert(fileSha + ':' + path, new QStringList(res->origins), qMax(lineCnt, 1));
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef ANNOTATE_H
+#define ANNOTATE_H
+
+#include <functional>
+
+#include <QCache>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+class CancelToken;
+
+/*
+ * File annotation (blame) computed in process from the patches of a
+ * file history, as loaded with 'git log -p'. Each line of the file is
+ * followed back, from the annotated revision along first parents and
+ * through the patch of each revision, until a patch adds it: that
+ * revision is where the line comes from.
+ *
+ * Patches are parsed in parallel, a chunk of revisions at a time, and
+ * the walk stops as soon as all lines are known, so the top of a file
+ * is normally annotated well before the whole history has been seen.
+ * Progress is reported after each chunk, and at once when the first
+ * 'screenLines' lines, the ones on screen, are all known.
+ *
+ * Results are cached by file sha and path and the walk stops at any
+ * revision whose file is already annotated, parsed patches are cached
+ * too, so annotating a neighbour revision costs only the difference.
+ * Does not use any Git or Rev data, so it can run in a pool thread.
+ */
+class Annotate {
+public:
+    struct Step { // a revision along the walk, newest first
+        Step() : isRoot(false) {}
+        Step(const QString& s, const QString& p, bool r) : sha(s), patch(p), isRoot(r) {}
+        QString sha;
+        QString patch; // with '--full-index', could be empty
+        bool isRoot;   // no parent in file history
+    };
+    typedef QVector<Step> Steps;
+
+    struct Result {
+        Result() : known(0), isComplete(false) {}
+        QStringList origins; // sha per line, empty while still unknown
+        int known;
+        bool isComplete;
+    };
+    typedef std::function<void(const Result&)> Progress;
+
+    Annotate() : results(MAX_CACHED_LINES), patches(MAX_CACHED_HUNKS) {}
+    void clear();
+    bool run(const Steps& steps, const QString& fileSha, const QString& path, int lineCnt,
+             int screenLines, const CancelToken& tok, const Progress& progress, Result* res);
+
+private:
+    friend struct AnnotateParse;
+    friend class AnnotateTest;
+
+    enum { MAX_CACHED_LINES = 1000000, MAX_CACHED_HUNKS = 200000 };
+
+    struct Hunk { // start lines are 1 based, also when count is 0
+        int oldStart, oldCnt, newStart, newCnt;
+        QVector<int> oldLines; // for each new line, 0 if added
+    };
+    struct Patch { // one file of a revision patch
+        Patch() : isNew(false) {}
+        QString oldPath, newPath, oldBlob, newBlob;
+        bool isNew;
+        QVector<Hunk> hunks;
+    };
+    typedef QVector<Patch> Patches;
+
+    static const Patches parse(const QString& patch);
+    static int mapLine(const Patch& p, int line);
+    static const Patch* findPatch(const Patches& ps, const QString& path);
+    const QVector<Patches> parseChunk(const Steps& steps, int first, int last, const QString& path);
+    bool lookup(const QString& fileSha, const QString& path, QStringList* origins);
+
+    QMutex mutex; // tasks for different files could run at the same time
+    QCache<QString, QStringList> results; // by file sha and path
+    QCache<QString, Patches> patches;     // by revision sha and history path
+};
+
+#endif // ANNOTATE_H
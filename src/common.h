@@ -7,6 +7,8 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <QAtomicPointer>
+#include <QCache>
 #include <QColor>
 #include <QEvent>
 #include <QFont>
@@ -15,6 +17,8 @@
 #include <QVariant>
 #include <QVector>
 
+#include "logformat.h"
+
 /*
    QVariant does not support size_t type used in Qt containers, this is
    a problem on 64bit systems where size_t != uint and when using debug
@@ -71,6 +75,13 @@ namespace QGit {
         TAB_REV
 	};
 
+	// order of main view rows, see Git::setHistoryOrder()
+	enum OrderType {
+		TOPO_ORDER,   // as loaded, 'git log --topo-order'
+		DATE_ORDER,   // newest author date first, children before parents
+		REVERSE_ORDER // oldest first
+	};
+
 	// graph elements
 	enum LaneType {
 		EMPTY,
@@ -212,6 +223,9 @@ namespace QGit {
 	extern const QString ACT_GROUP_KEY;
 	extern const QString ACT_TEXT_KEY;
 	extern const QString ACT_FLAGS_KEY;
+	extern const QString LOG_MEM_KEY;
+	extern const QString WARM_MEM_KEY;
+	extern const QString DAEMON_REPOS_KEY;
 
 	// settings default values
 	extern const QString CMT_TEMPL_DEF;
@@ -236,8 +250,11 @@ namespace QGit {
 		WHOLE_HISTORY_F = 1 << 12,
         //1 << 13 has been removed
 		REOPEN_REPO_F   = 1 << 14,
-		USE_CMT_MSG_F   = 1 << 15
+		USE_CMT_MSG_F   = 1 << 15,
+		NATIVE_LOG_F    = 1 << 16,
+		PATCH_ID_F      = 1 << 17
 	};
+    const int WARM_MEM_DEF = 256; // MB
     const int FLAGS_DEF = USE_CMT_MSG_F | SMART_LBL_F | VERIFY_CMT_F | SIGN_PATCH_F | LOG_DIFF_TAB_F | MSG_ON_NEW_F;
 
 	// ShaString helpers
@@ -265,6 +282,7 @@ namespace QGit {
 	bool writeToFile(SCRef fileName, const QByteArray& data, bool setExecutable = false);
 	bool readFromFile(SCRef fileName, QString& data);
 	bool startProcess(QProcess* proc, SCList args, SCRef buf = "", bool* winShell = NULL);
+	bool runProcess(SCRef workDir, SCRef cmd, QByteArray* out);
 
 	// cache file
 	const uint C_MAGIC  = 0xA0B0C0D0;
@@ -272,11 +290,16 @@ namespace QGit {
 
 	extern const QString BAK_EXT;
 	extern const QString C_DAT_FILE;
+	extern const QString P_ID_FILE;
 
 	// misc
 	const int MAX_DICT_SIZE    = 100003; // must be a prime number see QDict docs
 	const int MAX_MENU_ENTRIES = 20;
 	const int MAX_RECENT_REPOS = 7;
+	const int MAX_BLOOM_PATHS  = 64; // above this Bloom filters checks cost more than they save
+	const int LANES_PAGE_SIZE  = 4096; // rows
+	const int MAX_LANES_PAGES  = 32;   // pages with lanes kept in memory
+	const int REV_TEXT_CACHE   = 4096; // revisions with decoded text kept, more than any view shows
 	extern const QString QUOTE_CHAR;
 	extern const QString SCRIPT_EXT;
 }
@@ -294,30 +317,67 @@ public:
 	}
 };
 
+class QTextCodec;
+class QThread;
+class RowBlocks;
+class RevTexts;
+struct RevText;
+
+class RowBlock : public QByteArray { // a chunk of 'git log' output, see RowBlocks
+/*
+   When evicted by RowBlocks data is valid only after touch(), and
+   only in the GUI thread, where touch() and eviction happen. Revisions
+   are indexed there, tasks read their text from a shared copy.
+*/
+public:
+	enum State { RESIDENT, COMPRESSED, DROPPED };
+
+	explicit RowBlock(qint64 ofs = -1, int f = -1)
+	    : mgr(NULL), texts(NULL), fileOfs(ofs), file(f), len(0), lastUse(0), state(RESIDENT) {}
+	inline void touch() const { if (mgr) doTouch(); }
+
+	RowBlocks* mgr;  // NULL if the block is never evicted
+	RevTexts* texts; // decoded text cache of the owner history, could be NULL
+	qint64 fileOfs;  // block position in the retained 'git log' output file
+	int file;        // retained file index, -1 if data is not in a file
+	mutable int len;
+	mutable quint64 lastUse;
+	mutable State state;
+	mutable QByteArray packed;
+private:
+	void doTouch() const;
+};
+
 class Rev {
 	// prevent implicit C++ compiler defaults
 	Rev();
 	Rev(const Rev&);
 	Rev& operator=(const Rev&);
 public:
-	Rev(const QByteArray& b, uint s, int idx, int* next, bool withDiff)
-	    : orderIdx(idx), ba(b), start(s) {
+	Rev(const RowBlock& b, uint s, int idx, int* next, LogFormatId f)
+	    : orderIdx(idx), ba(b), start(s), fmt(f) {
 
 		indexed = isDiffCache = isApplied = isUnApplied = false;
 		descRefsMaster = ancRefsMaster = descBrnMaster = -1;
-		*next = indexData(true, withDiff);
+		authorId = committerId = -1;
+		autTime = 0;
+		*next = indexData(true);
+		shaLine = (*next >= 0 ? keepShaLine() : NULL);
 	}
-	bool isBoundary() const { return (ba.at(shaStart - 1) == '-'); }
+	bool isBoundary() const { return (shaLine[-1] == '-'); }
 	uint parentsCount() const { return parentsCnt; }
-	const ShaString parent(int idx) const;
+	const ShaString parent(int idx) const { return ShaString(shaLine + 41 + 41 * idx); }
 	const QStringList parents() const;
-	const ShaString sha() const { return ShaString(ba.constData() + shaStart); }
-	const QString committer() const { setup(); return mid(comStart, autStart - comStart - 1); }
-	const QString author() const { setup(); return mid(autStart, autDateStart - autStart - 1); }
+	const ShaString sha() const { return ShaString(shaLine); }
+	const QString committer() const { setup(); return text(COMMITTER, comStart, autStart - comStart - 1); }
+	const QString author() const { setup(); return text(AUTHOR, autStart, autDateStart - autStart - 1); }
 	const QString authorDate() const { setup(); return mid(autDateStart, 10); }
-	const QString shortLog() const { setup(); return mid(sLogStart, sLogLen); }
-	const QString longLog() const { setup(); return mid(lLogStart, lLogLen); }
+	uint authorTime() const { return autTime; }
+	const QString shortLog() const { setup(); return text(SHORT_LOG, sLogStart, sLogLen); }
+	const QString longLog() const { setup(); return text(LONG_LOG, lLogStart, lLogLen); }
 	const QString diff() const { setup(); return mid(diffStart, diffLen); }
+	const QByteArray rawAuthor() const { return rawData(autStart, autDateStart - autStart - 1); }
+	const QByteArray rawCommitter() const { return rawData(comStart, autStart - comStart - 1); }
 
 	QVector<int> lanes, childs;
 	QVector<int> descRefs;     // list of descendant refs index, normally tags
@@ -327,15 +387,25 @@ public:
 	int ancRefsMaster;  // descBranches these are stored only once in a Rev pointed
 	int descBrnMaster;  // by corresponding index xxxMaster
 	int orderIdx;
+	int authorId, committerId; // in FileHistory identities, -1 if not interned
 private:
-	inline void setup() const { if (!indexed) indexData(false, false); }
-	int indexData(bool quick, bool withDiff) const;
+	friend struct RevText;
+	enum TextField { COMMITTER, AUTHOR, SHORT_LOG, LONG_LOG, TEXT_FIELDS };
+
+	inline void setup() const { if (!indexed) indexData(false); }
+	int indexData(bool quick) const;
+	template <class F> int parseRecord(bool quick) const;
+	const char* keepShaLine() const;
 	const QString mid(int start, int len) const;
-	const QString midSha(int start, int len) const;
+	const QString text(TextField f, int start, int len) const;
+	const QByteArray rawData(int start, int len) const;
 
-	const QByteArray& ba; // reference here!
+	const RowBlock& ba; // reference here!
+	const char* shaLine; // sha and parents, always resident
 	const int start;
+	const LogFormatId fmt;
 	mutable int parentsCnt, shaStart, comStart, autStart, autDateStart;
+	mutable uint autTime;
 	mutable int sLogStart, sLogLen, lLogStart, lLogLen, diffStart, diffLen;
 	mutable bool indexed;
 public:
@@ -343,6 +413,34 @@ public:
 };
 typedef QHash<ShaString, const Rev*> RevMap;  // faster then a map
 
+class RevTexts { // decoded text of the revisions on screen, see Rev::text()
+public:
+	RevTexts();
+	~RevTexts();
+	void clear();
+	void setCodec(QTextCodec* tc);
+	QTextCodec* codec() const { return textCodec.load(); }
+private:
+	friend class Rev;
+
+	QCache<const Rev*, RevText> cache;
+	QThread* owner; // the only thread using the cache
+	QAtomicPointer<QTextCodec> textCodec; // of the history repository, NULL for UTF-8
+};
+
+class Identities { // authors and committers, "name <email>", stored once
+public:
+	int intern(const QByteArray& raw, QTextCodec* tc = NULL);
+	void recode(QTextCodec* tc);
+	const QString& name(int id) const { return names.at(id); }
+	const QVector<QString>& allNames() const { return names; }
+	int count() const { return names.count(); }
+	void clear() { ids.clear(); names.clear(); }
+private:
+	QHash<QByteArray, int> ids;
+	QVector<QString> names;
+};
+
 
 class RevFile {
 
@@ -400,6 +498,7 @@ public:
 
 		return pathsIdx.size() / ((int)sizeof(int) * 2);
 	}
+	qint64 memorySize() const; // an estimate, see RepoSnapshot::memorySize()
 	bool statusCmp(int idx, StatusFlag sf) const {
 
 		return ((onlyModified ? MODIFIED : status.at(idx)) & sf);
@@ -7,13 +7,22 @@
 
 */
 #include <QDir>
+#include <QLocalSocket>
 #include <QTemporaryFile>
 #include "git.h"
 #include "filehistory.h"
 #include "dataloader.h"
-
-#define GUI_UPDATE_INTERVAL 500
+#include "logdaemon.h"
+#include "rowblocks.h"
+#include "odb/commitwalker.h"
+
+#define GUI_UPDATE_INTERVAL 500  // max time between views updates
+#define IDLE_POLL_INTERVAL  20   // waiting for 'git log' output
+#define FRAME_BUDGET        8    // parsing time slice, half a frame at 60 fps
+#define EMIT_COST_RATIO     10   // views update at most 1/10 of the time
 #define READ_BLOCK_SIZE     65535
+#define NATIVE_WALK_STEP    200
+#define DAEMON_TIMEOUT      200  // ms, daemon is local and answers at once
 
 class UnbufferedTemporaryFile : public QTemporaryFile {
 public:
@@ -23,10 +32,17 @@ public:
 
 DataLoader::DataLoader(Git* g, FileHistory* f) : QProcess(g), git(g), fh(f) {
 
-	canceling = parsing = false;
+	canceling = parsing = pendingData = false;
 	isProcExited = true;
+	emittedRows = emitInterval = 0;
 	halfChunk = NULL;
 	dataFile = NULL;
+	dataFileId = -1;
+	walker = NULL;
+	sharedIdx = 0;
+	isShared = false;
+	daemon = NULL;
+	daemonLeft = 0;
 	loadedBytes = 0;
 	guiUpdateTimer.setSingleShot(true);
 
@@ -39,6 +55,7 @@ DataLoader::~DataLoader() {
 	// avoid a Qt warning in case we are
 	// destroyed while still running
 	waitForFinished(1000);
+	delete walker;
 }
 
 void DataLoader::on_cancel(const FileHistory* f) {
@@ -71,8 +88,77 @@ bool DataLoader::start(SCList args, SCRef wd, SCRef buf) {
 		deleteLater();
 		return false;
 	}
+	if (dataFile) // keep output to read again evicted row data
+		dataFileId = fh->rowBlocks->reserveFile(dataFile->fileName());
+
+	loadTime.start();
+	emitTime.start();
+	guiUpdateTimer.start(IDLE_POLL_INTERVAL);
+	return true;
+}
+
+bool DataLoader::startNative(SCList tips, SCRef gitDir) {
+// no process is started, data is read directly from the
+// object database in time slices driven by guiUpdateTimer
+
+	if (!isProcExited) {
+		dbs("ASSERT in DataLoader::startNative(), called while processing");
+		return false;
+	}
+	walker = new CommitWalker(gitDir);
+	if (!walker->start(tips)) {
+		dbp("WARNING: native history reader not available, %1", walker->errorString());
+		deleteLater();
+		return false;
+	}
+	isProcExited = false;
+	loadTime.start();
+	emitTime.start();
+	guiUpdateTimer.start(1);
+	return true;
+}
+
+bool DataLoader::startShared(const QList<QByteArray>& data) {
+// no process is started, 'git log' output already read by another
+// window on the same repository is parsed again, in time slices as
+// with native reader, blocks are shared, not copied
+
+	if (!isProcExited) {
+		dbs("ASSERT in DataLoader::startShared(), called while processing");
+		return false;
+	}
+	sharedData = data;
+	sharedIdx = 0;
+	isShared = true;
+	isProcExited = false;
+	loadTime.start();
+	emitTime.start();
+	guiUpdateTimer.start(1);
+	return true;
+}
+
+bool DataLoader::startDaemon(const LogRequest& r) {
+/*
+   Ask a running 'qgit --daemon' for the output, answer comes at once,
+   data is then received in time slices. If there is no daemon, or it
+   has not the output for current refs, caller loads as usual.
+*/
+	if (!isProcExited) {
+		dbs("ASSERT in DataLoader::startDaemon(), called while processing");
+		return false;
+	}
+	daemon = new QLocalSocket(this);
+	daemon->connectToServer(LogDaemon::socketName());
+	if (   !daemon->waitForConnected(DAEMON_TIMEOUT)
+	    || !LogDaemon::sendRequest(daemon, r)
+	    || (daemonLeft = LogDaemon::waitReply(daemon, DAEMON_TIMEOUT)) < 0) {
+		deleteLater();
+		return false;
+	}
+	isProcExited = false;
 	loadTime.start();
-	guiUpdateTimer.start(GUI_UPDATE_INTERVAL);
+	emitTime.start();
+	guiUpdateTimer.start(1);
 	return true;
 }
 
@@ -91,32 +177,69 @@ void DataLoader::on_finished(int, QProcess::ExitStatus) {
 }
 
 void DataLoader::on_timeout() {
-
+/*
+   Data is parsed in slices of at most FRAME_BUDGET ms, then control
+   goes back to the event loop so that the GUI can repaint. When a
+   slice ends with data still to parse, next one is scheduled at once,
+   otherwise we wait for 'git log' to produce more.
+*/
 	if (canceling) {
 		deleteLater();
 		return; // we leave with guiUpdateTimer not active
 	}
 	parsing = true;
+	sliceTime.start();
 
 	// process could exit while we are processing so save the flag now
 	bool lastBuffer = isProcExited;
-	loadedBytes += readNewData(lastBuffer);
-	emit newDataReady(fh); // inserting in list view is about 3% of total time
+	if (walker)
+		loadedBytes += readNativeData(lastBuffer);
+	else if (isShared)
+		loadedBytes += readSharedData();
+	else if (daemon)
+		loadedBytes += readDaemonData();
+	else
+		loadedBytes += readNewData(lastBuffer);
 
-	if (lastBuffer) {
-		emit loaded(fh, loadedBytes, loadTime.elapsed(), true, "", "");
-		deleteLater();
+	if (lastBuffer && !pendingData) {
+		QString err(walker ? walker->errorString() : "");
+		if (daemon && daemonLeft > 0)
+			err = "connection lost, " + QString::number(daemonLeft) + " bytes missing";
 
-	} else if (isProcExited) { // exited while parsing
-		dbs("Exited while parsing!!!!");
-		guiUpdateTimer.start(1);
-	} else
-		guiUpdateTimer.start(GUI_UPDATE_INTERVAL);
+		const QString cmd(err.isEmpty() ? "" : (walker ? "native history reader" : "log daemon"));
+		if (dataFile && dataFileId != -1) { // we are done with it
+			dataFile->close();
+			fh->rowBlocks->adoptFile(dataFileId, dataFile);
+		}
+		emit loaded(fh, loadedBytes, loadTime.elapsed(), true, cmd, err);
+		deleteLater();
 
+	} else {
+		emitNewRows();
+		guiUpdateTimer.start(pendingData || isProcExited ? 0 : IDLE_POLL_INTERVAL);
+	}
 	parsing = false;
 }
 
-void DataLoader::parseSingleBuffer(const QByteArray& ba) {
+void DataLoader::emitNewRows() {
+/*
+   Inserting rows in the views, and filtering them again if a filter is
+   active, costs more as the history grows, so batches are adaptive: the
+   next one is delayed to keep this cost a small fraction of the loading.
+*/
+	int rows = fh->revOrder.count();
+	if (rows == emittedRows || emitTime.elapsed() < emitInterval)
+		return;
+
+	QTime t;
+	t.start();
+	emit newDataReady(fh);
+	emittedRows = rows;
+	emitInterval = qMin(t.elapsed() * EMIT_COST_RATIO, GUI_UPDATE_INTERVAL);
+	emitTime.start();
+}
+
+void DataLoader::parseSingleBuffer(const RowBlock& ba) {
 
 	if (ba.size() == 0 || canceling)
 		return;
@@ -149,18 +272,31 @@ void DataLoader::parseSingleBuffer(const QByteArray& ba) {
 				break;
 
 			ofs = end + 1;
-			baAppend(&halfChunk, ba.constData(), ofs);
-			fh->rowData.append(halfChunk);
+			baAppend(&halfChunk, ba.constData(), ofs, -1);
+			addBlock(halfChunk, false);
 			addSplittedChunks(halfChunk);
 			halfChunk = NULL;
 		}
 	}
 	// save any remaining half chunk
 	if (bz - ofs > 0)
-		baAppend(&halfChunk, ba.constData() + ofs,  bz - ofs);
+		baAppend(&halfChunk, ba.constData() + ofs,  bz - ofs,
+		         ba.fileOfs != -1 ? ba.fileOfs + ofs : -1);
 }
 
-void DataLoader::addSplittedChunks(const QByteArray* hc) {
+void DataLoader::addBlock(RowBlock* ba, bool inStream) {
+
+	// half chunks repeat data of stream blocks, so they are not kept,
+	// stream blocks are shared, a deep copy happens only on eviction
+	if (inStream && fh->keepLogStream)
+		fh->logStream.append(*ba);
+
+	ba->texts = &fh->revTexts;
+	fh->rowData.append(ba);
+	fh->rowBlocks->add(ba); // could be evicted from now on
+}
+
+void DataLoader::addSplittedChunks(const RowBlock* hc) {
 
 	if (hc->at(hc->size() - 1) != 0) {
 		dbs("ASSERT in DataLoader, bad half chunk");
@@ -172,14 +308,102 @@ void DataLoader::addSplittedChunks(const QByteArray* hc) {
 		ofs = git->addChunk(fh, *hc, ofs);
 }
 
-void DataLoader::baAppend(QByteArray** baPtr, const char* ascii, int len) {
+void DataLoader::baAppend(RowBlock** baPtr, const char* ascii, int len, qint64 fileOfs) {
+
+	// a half chunk is a contiguous range of the output file, so
+	// only the position of its first part needs to be known
+	if (!*baPtr)
+		*baPtr = new RowBlock(fileOfs, fileOfs != -1 ? dataFileId : -1);
+
+	// we cannot use QByteArray::append(const char*)
+	// because 'ascii' is not '\0' terminating
+	(*baPtr)->append(QByteArray::fromRawData(ascii, len));
+}
+
+ulong DataLoader::readNativeData(bool lastBuffer) {
+
+	pendingData = false;
+	if (lastBuffer) { // be sure stream is null terminated
+		RowBlock* zb = new RowBlock();
+		zb->append('\0');
+		addBlock(zb);
+		parseSingleBuffer(*zb);
+		return 0;
+	}
+	while (!walker->isWalked() && sliceTime.elapsed() < FRAME_BUDGET)
+		walker->walk(NATIVE_WALK_STEP);
+
+	// records are never split among buffers, so no half chunks here
+	ulong cnt = 0;
+	while (walker->isWalked() && !walker->atEnd() && sliceTime.elapsed() < FRAME_BUDGET) {
+
+		RowBlock* ba = new RowBlock();
+		ba->reserve(READ_BLOCK_SIZE);
+		walker->format(ba, READ_BLOCK_SIZE);
+		if (ba->isEmpty()) {
+			delete ba;
+			break;
+		}
+		cnt += ba->size();
+		addBlock(ba);
+		parseSingleBuffer(*ba);
+	}
+	if (walker->atEnd())
+		isProcExited = true; // as if 'git log' exited
+	else
+		pendingData = true;
+
+	return cnt;
+}
+
+ulong DataLoader::readSharedData() {
 
-	if (*baPtr)
-		// we cannot use QByteArray::append(const char*)
-		// because 'ascii' is not '\0' terminating
-		(*baPtr)->append(QByteArray::fromRawData(ascii, len));
+	ulong cnt = 0;
+	pendingData = false;
+	while (sharedIdx < sharedData.count() && sliceTime.elapsed() < FRAME_BUDGET) {
+
+		RowBlock* ba = new RowBlock();
+		static_cast<QByteArray&>(*ba) = sharedData.at(sharedIdx++);
+		cnt += ba->size();
+		addBlock(ba);
+		parseSingleBuffer(*ba);
+	}
+	if (sharedIdx < sharedData.count())
+		pendingData = true;
 	else
-		*baPtr = new QByteArray(ascii, len);
+		isProcExited = true; // as if 'git log' exited
+
+	return cnt;
+}
+
+ulong DataLoader::readDaemonData() {
+
+	ulong cnt = 0;
+	pendingData = false;
+	while (daemonLeft > 0 && daemon->bytesAvailable() > 0) {
+
+		RowBlock* ba = new RowBlock();
+		ba->append(daemon->read(qMin(daemonLeft, (qint64)READ_BLOCK_SIZE)));
+		daemonLeft -= ba->size();
+		cnt += ba->size();
+		addBlock(ba);
+		parseSingleBuffer(*ba);
+
+		if (sliceTime.elapsed() >= FRAME_BUDGET) {
+			pendingData = true;
+			return cnt;
+		}
+	}
+	// terminator is added once, next call finds isProcExited already set
+	bool lost = (daemon->state() != QLocalSocket::ConnectedState && daemon->bytesAvailable() == 0);
+	if (!isProcExited && (daemonLeft == 0 || lost)) {
+		RowBlock* zb = new RowBlock(); // be sure stream is null terminated
+		zb->append('\0');
+		addBlock(zb);
+		parseSingleBuffer(*zb);
+		isProcExited = true; // as if 'git log' exited
+	}
+	return cnt;
 }
 
 // *************** git interface facility dependant code *****************************
@@ -207,7 +431,9 @@ ulong DataLoader::readNewData(bool lastBuffer) {
 		....
 		return buf->readAll(); // memcpy() here
 	*/
-	QByteArray* ba = new QByteArray(readAllStandardOutput());
+	pendingData = false;
+	RowBlock* ba = new RowBlock();
+	ba->append(readAllStandardOutput());
 	if (lastBuffer)
 		ba->append('\0'); // be sure stream is null terminated
 
@@ -215,7 +441,7 @@ ulong DataLoader::readNewData(bool lastBuffer) {
 		delete ba;
 		return 0;
 	}
-	fh->rowData.append(ba);
+	addBlock(ba);
 	parseSingleBuffer(*ba);
 	return ba->size();
 }
@@ -234,12 +460,13 @@ ulong DataLoader::readNewData(bool lastBuffer) {
 
 	ulong cnt = 0;
 	qint64 readPos = dataFile->pos();
+	pendingData = false;
 
 	while (true) {
 		// this is the ONLY deep copy involved in the whole loading
 		// QFile::read() calls standard C read() function when
 		// file is open with Unbuffered flag, or fread() otherwise
-		QByteArray* ba = new QByteArray();
+		RowBlock* ba = new RowBlock(readPos, dataFileId);
 		ba->resize(READ_BLOCK_SIZE);
 		int len = dataFile->read(ba->data(), READ_BLOCK_SIZE);
 
@@ -257,16 +484,23 @@ ulong DataLoader::readNewData(bool lastBuffer) {
 		dataFile->seek(readPos);
 
 		cnt += len;
-		fh->rowData.append(ba);
+		addBlock(ba);
 		parseSingleBuffer(*ba);
 
 		// avoid reading small chunks if data producer is still running
 		if (len < READ_BLOCK_SIZE && !lastBuffer)
 			break;
+
+		// a full block could mean more data, continue in next slice
+		if (len == READ_BLOCK_SIZE && sliceTime.elapsed() >= FRAME_BUDGET) {
+			pendingData = true;
+			break;
+		}
 	}
-	if (lastBuffer) { // be sure stream is null terminated
-		QByteArray* zb = new QByteArray(1, '\0');
-		fh->rowData.append(zb);
+	if (lastBuffer && !pendingData) { // be sure stream is null terminated
+		RowBlock* zb = new RowBlock();
+		zb->append('\0');
+		addBlock(zb);
 		parseSingleBuffer(*zb);
 	}
 	return cnt;
@@ -7,14 +7,19 @@
 #ifndef DATALOADER_H
 #define DATALOADER_H
 
+#include <QList>
 #include <QProcess>
 #include <QTime>
 #include <QTimer>
 
 class Git;
+class CommitWalker;
 class FileHistory;
+class QLocalSocket;
 class QString;
+class RowBlock;
 class UnbufferedTemporaryFile;
+struct LogRequest;
 
 // data exchange facility with 'git log' could be based on QProcess or on
 // a temporary file (default). Uncomment following line to use QProcess
@@ -26,6 +31,9 @@ public:
 	DataLoader(Git* g, FileHistory* f);
 	~DataLoader();
 	bool start(const QStringList& args, const QString& wd, const QString& buf);
+	bool startNative(const QStringList& tips, const QString& gitDir);
+	bool startShared(const QList<QByteArray>& data);
+	bool startDaemon(const LogRequest& r);
 
 signals:
 	void newDataReady(const FileHistory*);
@@ -38,21 +46,38 @@ private slots:
 	void on_timeout();
 
 private:
-	void parseSingleBuffer(const QByteArray& ba);
-	void baAppend(QByteArray** src, const char* ascii, int len);
-	void addSplittedChunks(const QByteArray* halfChunk);
+	void parseSingleBuffer(const RowBlock& ba);
+	void baAppend(RowBlock** src, const char* ascii, int len, qint64 fileOfs);
+	void addSplittedChunks(const RowBlock* halfChunk);
+	void addBlock(RowBlock* ba, bool inStream = true);
 	bool createTemporaryFile();
 	ulong readNewData(bool lastBuffer);
+	ulong readNativeData(bool lastBuffer);
+	ulong readSharedData();
+	ulong readDaemonData();
+	void emitNewRows();
 
 	Git* git;
 	FileHistory* fh;
-	QByteArray* halfChunk;
+	RowBlock* halfChunk;
 	UnbufferedTemporaryFile* dataFile;
+	int dataFileId; // once retained by row data manager
+	CommitWalker* walker;
+	QList<QByteArray> sharedData;
+	int sharedIdx;
+	bool isShared;
+	QLocalSocket* daemon;
+	qint64 daemonLeft; // bytes still to be received
 	QTime loadTime;
+	QTime sliceTime;
+	QTime emitTime;
 	QTimer guiUpdateTimer;
 	ulong loadedBytes;
+	int emittedRows;
+	int emitInterval;
 	bool isProcExited;
 	bool parsing;
+	bool pendingData; // current slice ended before all data was parsed
 	bool canceling;
 };
 
@@ -0,0 +1,66 @@
+#include "dateindex.h"
+
+#include <algorithm>
+#include <climits>
+
+#include <QDateTime>
+
+void DateIndex::append(const QVector<uint>& times) {
+// times of the rows following the last indexed one
+
+    const int first = idx.count();
+    idx.reserve(first + times.count());
+    for (int i = 0; i < times.count(); i++)
+        idx.append(qMakePair(times.at(i), first + i));
+
+    std::sort(idx.begin() + first, idx.end());
+    std::inplace_merge(idx.begin(), idx.begin() + first, idx.end());
+}
+
+const QVector<int> DateIndex::rows(uint from, uint to) const {
+// rows with author time in [from, to], oldest first
+
+    QVector<QPair<uint, int> >::const_iterator it, end;
+    it = std::lower_bound(idx.constBegin(), idx.constEnd(), qMakePair(from, INT_MIN));
+    end = std::upper_bound(it, idx.constEnd(), qMakePair(to, INT_MAX));
+
+    QVector<int> res;
+    res.reserve(int(end - it));
+    for ( ; it != end; ++it)
+        res.append(it->second);
+
+    return res;
+}
+
+bool DateIndex::parseRange(const QString& exp, uint now, uint* from, uint* to) {
+/*
+   Accepted are a number of days back from now, as '30', a date
+   in ISO format, as '2012-03-25', or a range of dates 'from..to'
+   where an empty side means no limit. Dates are local ones.
+*/
+    const QString s(exp.trimmed());
+    *from = 0;
+    *to = UINT_MAX;
+
+    bool ok;
+    int days = s.toInt(&ok);
+    if (ok && days >= 0) {
+        *from = QDateTime::fromTime_t(now).addDays(-days).toTime_t();
+        return true;
+    }
+    int sep = s.indexOf("..");
+    const QString a(sep != -1 ? s.left(sep) : s);
+    const QString b(sep != -1 ? s.mid(sep + 2) : s);
+    const QDate da(QDate::fromString(a, Qt::ISODate));
+    const QDate db(QDate::fromString(b, Qt::ISODate));
+
+    if ((!a.isEmpty() && !da.isValid()) || (!b.isEmpty() && !db.isValid()))
+        return false;
+
+    if (da.isValid())
+        *from = QDateTime(da).toTime_t();
+    if (db.isValid()) // up to the end of the day
+        *to = QDateTime(db.addDays(1)).toTime_t() - 1;
+
+    return true;
+}
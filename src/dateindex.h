@@ -0,0 +1,27 @@
+#ifndef DATEINDEX_H
+#define DATEINDEX_H
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+/*
+ * Rows sorted by author time, so that date range queries, as the
+ * ones of the date filter, are answered by binary search. Rows are
+ * only appended while loading, new ones are sorted on their own and
+ * then merged with the ones already indexed.
+ */
+class DateIndex {
+public:
+    void clear() { idx.clear(); }
+    int count() const { return idx.count(); }
+    void append(const QVector<uint>& times);
+    const QVector<int> rows(uint from, uint to) const;
+
+    static bool parseRange(const QString& exp, uint now, uint* from, uint* to);
+
+private:
+    QVector<QPair<uint, int> > idx; // (author time, row)
+};
+
+#endif // DATEINDEX_H
@@ -4,6 +4,7 @@
 #include "filehistory.h"
 #include "git.h"
 #include "lanes.h"
+#include "rowblocks.h"
 
 using namespace QGit;
 
@@ -11,6 +12,7 @@ FileHistory::FileHistory(QObject* p, Git* g) : QAbstractItemModel(p), git(g) {
 
     headerInfo << "Graph" << "Id" << "Short Log" << "Author" << "Author Date";
     lns = new Lanes();
+    rowBlocks = new RowBlocks();
     revs.reserve(QGit::MAX_DICT_SIZE);
     clear(); // after _headerInfo is set
 
@@ -21,12 +23,16 @@ FileHistory::FileHistory(QObject* p, Git* g) : QAbstractItemModel(p), git(g) {
             this, SLOT(on_loadCompleted(const FileHistory*, const QString&)));
 
     connect(git, SIGNAL(changeFont(const QFont&)), this, SLOT(on_changeFont(const QFont&)));
+
+    connect(git, SIGNAL(changeTextCodec(QTextCodec*)), this, SLOT(on_changeTextCodec(QTextCodec*)));
+    revTexts.setCodec(git->revTextCodec());
 }
 
 FileHistory::~FileHistory() {
 
     clear();
     delete lns;
+    delete rowBlocks;
 }
 
 void FileHistory::resetFileNames(SCRef fn) {
@@ -57,52 +63,115 @@ const QString FileHistory::sha(int row) const {
     return (row < 0 || row >= rowCnt ? "" : QString(revOrder.at(row)));
 }
 
-void FileHistory::flushTail() {
-    beginResetModel();
-    if (earlyOutputCnt < 0 || earlyOutputCnt >= revOrder.count()) {
-        dbp("ASSERT in FileHistory::flushTail(), earlyOutputCnt is %1", earlyOutputCnt);
+void FileHistory::flushTail(int first) {
+// remove revisions from 'first' on, rows before are kept so that
+// views do not lose current selection and scroll position
+
+    if (first < earlyOutputCntBase || first >= revOrder.count()) {
+        dbp("ASSERT in FileHistory::flushTail(), first row is %1", first);
         return;
     }
-    int cnt = revOrder.count() - earlyOutputCnt + 1;
-    while (cnt > 0) {
+    bool removeRows = (first < rowCnt);
+    if (removeRows)
+        beginRemoveRows(QModelIndex(), first, rowCnt - 1);
+
+    while (revOrder.count() > first) {
         const ShaString& sha = revOrder.last();
         const Rev* c = revs[sha];
         delete c;
         revs.remove(sha);
         revOrder.pop_back();
-        cnt--;
     }
+    rowCnt = qMin(rowCnt, first);
+    if (removeRows)
+        endRemoveRows();
+
     // reset all lanes, will be redrawn
     for (int i = earlyOutputCntBase; i < revOrder.count(); i++) {
         Rev* c = const_cast<Rev*>(revs[revOrder[i]]);
         c->lanes.clear();
     }
+    QMutableSetIterator<int> it(lanesPreset);
+    while (it.hasNext())
+        if (it.next() >= earlyOutputCntBase)
+            it.remove();
+
     firstFreeLane = earlyOutputCntBase;
     lns->clear();
-    rowCnt = revOrder.count();
+    clearLanesPages();
+    dateIndex.clear();
+
+    for (int i = 0; i < laneSegments.count(); i++) {
+        QVector<LaneSegment>& s = laneSegments[i];
+        while (!s.isEmpty() && s.last().start >= earlyOutputCntBase)
+            s.pop_back();
+
+        if (!s.isEmpty() && s.last().end >= earlyOutputCntBase)
+            s.last().end = -1; // will be closed again
+    }
+    lastLanesCnt = laneSegments.count(); // ends of lanes will be checked again
+    if (earlyOutputCntBase < rowCnt)
+        emit dataChanged(index(earlyOutputCntBase, 0), index(rowCnt - 1, 0));
+}
+
+void FileHistory::clearLanesPages() {
+// rows with preset lanes are kept, they are never computed again
+
+    qDeleteAll(lanesCkpt);
+    lanesCkpt.clear();
+    lanesCkptRow.clear();
+    lanesPages.clear();
+}
+
+void FileHistory::setRevOrder(const ShaVect& ro, int type) {
+// rows are moved, lanes are computed again from the first one
+
+    beginResetModel();
+    revOrder = ro;
+    order = type;
+    firstFreeLane = 0;
+    lns->clear();
+    clearLanesPages();
+    lanesPreset.clear();
+    laneSegments.clear();
+    lastLanesCnt = 0;
+    dateIndex.clear();
     endResetModel();
 }
 
 void FileHistory::clear(bool complete) {
 
-    beginResetModel();
-    if (!complete) {
+    if (!complete) { // flush the tail from current early output position
         if (revOrder.count() > 0)
-            flushTail();
+            flushTail(qMax(earlyOutputCnt - 1, earlyOutputCntBase));
         return;
     }
+    beginResetModel();
     git->cancelDataLoading(this);
 
     qDeleteAll(revs);
     revs.clear();
+    revTexts.clear();
+    idents.clear();
     revOrder.clear();
+    loadOrder.clear();
+    order = TOPO_ORDER;
     firstFreeLane = loadTime = earlyOutputCntBase = 0;
     setEarlyOutputState(false);
     lns->clear();
+    clearLanesPages();
+    lanesPreset.clear();
+    laneSegments.clear();
+    lastLanesCnt = 0;
+    dateIndex.clear();
     fNames.clear();
     curFNames.clear();
     qDeleteAll(rowData);
     rowData.clear();
+    logStream.clear();
+    keepLogStream = false;
+    rowBlocks->clear();
+    rowBlocks->setBudget(QSettings().value(LOG_MEM_KEY, 0).toLongLong() * 1024 * 1024);
 
     if (testFlag(REL_DATE_F)) {
         secs = QDateTime::currentDateTime().toTime_t();
@@ -141,16 +210,28 @@ void FileHistory::on_loadCompleted(const FileHistory* fh, const QString&) {
     if (fh != this || rowCnt >= revOrder.count())
         return;
 
-    // now we can process last revision
-    beginResetModel();
+    // revisions of a file history could have been replaced
+    // while following renames, refresh the rows already shown
+    if (!git->isMainHistory(this) && rowCnt > 0)
+        emit dataChanged(index(0, 0), index(rowCnt - 1, columnCount(QModelIndex()) - 1));
+
+    // now we can process last revision, rows already shown are
+    // not touched so that views keep selection and scroll position
+    beginInsertRows(QModelIndex(), rowCnt, revOrder.count() - 1);
     rowCnt = revOrder.count();
-    endResetModel();
+    endInsertRows();
 
     // adjust Id column width according to the numbers of revisions we have
     if (!git->isMainHistory(this))
         on_changeFont(QGit::STD_FONT);
 }
 
+void FileHistory::on_changeTextCodec(QTextCodec* tc) {
+
+    revTexts.setCodec(tc);
+    idents.recode(tc); // ids in revisions stay valid
+}
+
 void FileHistory::on_changeFont(const QFont& f) {
 
     QString maxStr(QString::number(rowCnt).length() + 1, '8');
@@ -244,14 +325,14 @@ QVariant FileHistory::data(const QModelIndex& index, int role) const {
         return r->shortLog();
 
     if (col == QGit::AUTH_COL)
-        return r->author();
+        return (r->authorId != -1 ? idents.name(r->authorId) : r->author());
 
     if (col == QGit::TIME_COL && r->sha() != QGit::ZERO_SHA_RAW) {
 
         if (secs != 0) // secs is 0 for absolute date
-            return timeDiff(secs - r->authorDate().toULong());
+            return timeDiff(secs - r->authorTime());
         else
-            return git->getLocalDate(r->authorDate());
+            return git->getLocalDate(r->authorTime());
     }
     return no_value;
 }
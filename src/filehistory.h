@@ -2,11 +2,24 @@
 #define FILEHISTORY_H
 
 #include <QAbstractItemModel>
+#include <QPair>
+#include <QPointer>
+#include <QSet>
 
 #include "common.h"
+#include "dateindex.h"
 
 class Lanes;
 class Git;
+class RowBlocks;
+class Task;
+
+struct LaneSegment { // rows [start, end) of a lane, owned by the commit at start
+    explicit LaneSegment(int s = 0) : start(s), end(-1) {}
+
+    int start;
+    int end; // -1 while the lane is in use
+};
 
 class FileHistory : public QAbstractItemModel {
 Q_OBJECT
@@ -20,6 +33,8 @@ public:
     void resetFileNames(SCRef fn);
     void setEarlyOutputState(bool b = true) { earlyOutputCnt = (b ? earlyOutputCntBase : -1); }
     void setAnnIdValid(bool b = true) { annIdValid = b; }
+    int orderType() const { return order; }
+    const Identities& identities() const { return idents; }
 
     virtual QVariant data(const QModelIndex &index, int role) const;
     virtual Qt::ItemFlags flags(const QModelIndex& index) const;
@@ -32,6 +47,7 @@ public:
 
 public slots:
     void on_changeFont(const QFont&);
+    void on_changeTextCodec(QTextCodec*);
 
 private slots:
     void on_newRevsAdded(const FileHistory*, const QVector<ShaString>&);
@@ -41,15 +57,31 @@ private:
     friend class DataLoader;
     friend class Git;
 
-    void flushTail();
+    void flushTail(int first);
+    void clearLanesPages();
+    void setRevOrder(const ShaVect& ro, int type);
     const QString timeDiff(unsigned long secs) const;
 
     Git* git;
-    RevMap revs;
+    RevMap revs;       // all the revisions, always in memory, only their lanes are paged
     ShaVect revOrder;
+    ShaVect loadOrder; // revOrder as loaded, empty if rows never moved
+    int order;         // QGit::OrderType of revOrder
+    Identities idents;
+    RevTexts revTexts;
     Lanes* lns;
     uint firstFreeLane;
-    QList<QByteArray*> rowData;
+    QVector<Lanes*> lanesCkpt;  // lanes state at first computed row of each page, see Git::setLane()
+    QVector<int> lanesCkptRow;
+    QList<int> lanesPages;      // pages with lanes in memory, least recently used first
+    QSet<int> lanesPreset;      // rows with lanes not computed by setLane()
+    QVector<QVector<LaneSegment> > laneSegments; // per lane, see Git::recordLaneSegments()
+    int lastLanesCnt;
+    DateIndex dateIndex;        // see Git::updateDateIndex()
+    QList<RowBlock*> rowData;
+    RowBlocks* rowBlocks;
+    QList<QByteArray> logStream; // 'git log' output as read, shared with snapshots
+    bool keepLogStream;
     QList<QVariant> headerInfo;
     int rowCnt;
     bool annIdValid;
@@ -61,6 +93,7 @@ private:
     QStringList curFNames;
     QStringList renamedRevs;
     QHash<QString, QString> renamedPatches;
+    QPointer<Task> renameTask; // see Git::startFileHistory()
 };
 
 #endif // FILEHISTORY_H
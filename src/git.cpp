@@ -6,6 +6,9 @@
 	Copyright: See COPYING file that comes with this distribution
 
 */
+#include <algorithm>
+#include <climits>
+
 #include <QApplication>
 #include <QDateTime>
 #include <QDir>
@@ -15,21 +18,34 @@
 #include <QRegExp>
 #include <QSet>
 #include <QSettings>
+#include <QSharedPointer>
 #include <QTextCodec>
 #include <QTextDocument>
 #include <QTextStream>
 
 #include <grantlee_templates.h>
 
+#include "annotate.h"
 #include "cache.h"
+#include "dateindex.h"
 #include "git.h"
 #include "lanes.h"
 #include "myprocess.h"
+#include "patchid.h"
 #include "filehistory.h"
+#include "historyorder.h"
+#include "reachability.h"
+#include "snapshot.h"
+#include "task.h"
 #include "diff/diff.h"
+#include "odb/commitgraph.h"
+#include "odb/objectdb.h"
+#include "odb/packbitmap.h"
 
 using namespace QGit;
 
+static const int BIG_DIFF_LINES = 5000; // above this HTML layout gets slow
+
 bool Git::TreeEntry::operator<(const TreeEntry& te) const {
 
 	if (this->type == te.type)
@@ -52,9 +68,23 @@ Git::Git(QObject* p) : QObject(p) {
 
 	fileCacheAccessed = cacheNeedsUpdate = isMergeHead = false;
 	isStGIT = isGIT = loadingUnAppliedPatches = isTextHighlighterFound = false;
+	loadingPreview = false;
 	errorReportingEnabled = true; // report errors if run() fails
 	curDomain = NULL;
 	revData = NULL;
+	revCodec = NULL;
+	commitGraph = NULL;
+	packBitmaps = NULL;
+	reachability = new Reachability();
+	historyOrder = new HistoryOrder();
+	orderType = TOPO_ORDER;
+	treeIndexed = false;
+	patchIds = new PatchIds();
+	fileKeeper = QSharedPointer<RevFileKeeper>(new RevFileKeeper());
+	annotate = QSharedPointer<Annotate>(new Annotate());
+	curSnapshot = RepoSnapshotPtr(new RepoSnapshot());
+	snapshotGen = 0;
+	knownPathsGen = -1;
 	revsFiles.reserve(MAX_DICT_SIZE);
 
     //initialize template engine
@@ -67,6 +97,11 @@ Git::Git(QObject* p) : QObject(p) {
 
 Git::~Git() {
     delete engine;
+    delete commitGraph;
+    delete packBitmaps;
+    delete reachability;
+    delete historyOrder;
+    delete patchIds;
 }
 
 void Git::checkEnvironment() {
@@ -179,6 +214,14 @@ void Git::setTextCodec(QTextCodec* tc) {
 		name = "Big5";
 
     run("git config i18n.commitencoding " + name);
+	setRevTextCodec(tc);
+}
+
+void Git::setRevTextCodec(QTextCodec* tc) {
+// each history decodes its revisions with the codec of its repository
+
+	revCodec = (tc && tc->mibEnum() != 106 ? tc : NULL);
+	emit changeTextCodec(revCodec);
 }
 
 QTextCodec* Git::getTextCodec(bool* isGitArchive) {
@@ -292,46 +335,67 @@ const QString Git::getRefSha(SCRef refName, RefType type, bool askGit) {
 	return (ok ? runOutput.trimmed() : "");
 }
 
-void Git::appendNamesWithId(QStringList& names, SCRef sha, SCList data, bool onlyLoaded) {
+const Rev* Git::revAt(int idx) const {
 
-	const Rev* r = revLookup(sha);
-	if (onlyLoaded && !r)
-		return;
+	const ShaVect& v = revData->revOrder;
+	return (idx >= 0 && idx < v.count() ? revLookup(v[idx]) : NULL);
+}
 
-	if (onlyLoaded) { // prepare for later sorting
-		SCRef cap = QString("%1 ").arg(r->orderIdx, 6);
-		FOREACH_SL (it, data)
-			names.append(cap + *it);
-	} else
-		names += data;
+const QVector<int> Git::getRefsIdx(uint mask) const {
+// loaded revisions with a reference of type in 'mask', in loading order
+
+	QVector<int> idx;
+	FOREACH (RefMap, it, refsShaMap)
+		if ((*it).type & mask) {
+			const Rev* r = revLookup(it.key());
+			if (r)
+				idx.append(r->orderIdx);
+		}
+
+	std::sort(idx.begin(), idx.end());
+	return idx;
 }
 
 const QStringList Git::getAllRefNames(uint mask, bool onlyLoaded) {
 // returns reference names sorted by loading order if 'onlyLoaded' is set
 
 	QStringList names;
+	if (onlyLoaded) {
+		const QVector<int> idx(getRefsIdx(mask & (TAG | BRANCH | RMT_BRANCH | REF)));
+		FOREACH (QVector<int>, it, idx) {
+
+			const Reference& rf = *refsShaMap.constFind(revData->revOrder[*it]);
+			QStringList n;
+			if (mask & TAG)
+				n += rf.tags;
+			if (mask & BRANCH)
+				n += rf.branches;
+			if (mask & RMT_BRANCH)
+				n += rf.remoteBranches;
+			if (mask & REF)
+				n += rf.refs;
+
+			n.sort(); // names of the same revision
+			names += n;
+		}
+		return names;
+	}
 	FOREACH (RefMap, it, refsShaMap) {
 
 		if (mask & TAG)
-			appendNamesWithId(names, it.key(), (*it).tags, onlyLoaded);
+			names += (*it).tags;
 
 		if (mask & BRANCH)
-			appendNamesWithId(names, it.key(), (*it).branches, onlyLoaded);
+			names += (*it).branches;
 
 		if (mask & RMT_BRANCH)
-			appendNamesWithId(names, it.key(), (*it).remoteBranches, onlyLoaded);
+			names += (*it).remoteBranches;
 
 		if (mask & REF)
-			appendNamesWithId(names, it.key(), (*it).refs, onlyLoaded);
+			names += (*it).refs;
 
-		if ((mask & (APPLIED | UN_APPLIED)) && !onlyLoaded)
+		if (mask & (APPLIED | UN_APPLIED))
 			names.append((*it).stgitPatch); // doesn't work with 'onlyLoaded'
-        }
-        if (onlyLoaded) {
-		names.sort();
-		QStringList::iterator itN(names.begin());
-		for ( ; itN != names.end(); ++itN) // strip 'idx'
-			(*itN) = (*itN).section(' ', -1, -1);
 	}
 	return names;
 }
@@ -447,6 +511,9 @@ void Git::formatPatchFileHeader(QString* rowName, SCRef sha, SCRef diffToSha,
 void Git::cancelDataLoading(const FileHistory* fh) {
 // normally called when closing file viewer
 
+	if (fh->renameTask) // history not started yet
+		fh->renameTask->cancel();
+
 	emit cancelLoading(fh); // non blocking
 }
 
@@ -533,32 +600,50 @@ int Git::findFileIndex(const RevFile& rf, SCRef name) {
 	return -1;
 }
 
+static bool startsBefore(const LaneSegment& s, int row) { return s.start < row; }
+
 const QString Git::getLaneParent(SCRef fromSHA, int laneNum) {
 
 	const Rev* rs = revLookup(fromSHA);
-	if (!rs)
+	if (!rs || laneNum < 0 || laneNum >= revData->laneSegments.count())
 		return "";
 
-	for (int idx = rs->orderIdx - 1; idx >= 0; idx--) {
+	// last segment started above, the lane must still be in use at our row
+	const int row = rs->orderIdx;
+	const QVector<LaneSegment>& ls = revData->laneSegments.at(laneNum);
+	QVector<LaneSegment>::const_iterator it = std::lower_bound(ls.constBegin(), ls.constEnd(), row, startsBefore);
+	if (it == ls.constBegin() || ((--it)->end != -1 && it->end <= row))
+		return "";
 
-		const Rev* r = revLookup(revData->revOrder[idx]);
-		if (laneNum >= r->lanes.count())
-			return "";
+	int idx = it->start;
+	if (revData->order == REVERSE_ORDER) // lane goes down to a child, owner is the parent
+		return revData->revOrder[idx];
 
-		if (!isFreeLane(r->lanes[laneNum])) {
+	const Rev* r = revLookup(revData->revOrder[idx]);
+	if (r->lanes.count() == 0) // evicted, see setLane()
+		setLane(revData->revOrder[idx], revData);
 
-			int type = r->lanes[laneNum], parNum = 0;
-			while (!isMerge(type) && type != ACTIVE) {
+	int type = r->lanes[laneNum], parNum = 0;
+	while (!isMerge(type) && type != ACTIVE) {
 
-				if (isHead(type))
-					parNum++;
+		if (isHead(type))
+			parNum++;
 
-				type = r->lanes[--laneNum];
-			}
-			return r->parent(parNum);
-		}
+		type = r->lanes[--laneNum];
 	}
-	return "";
+	return r->parent(parNum);
+}
+
+const QVector<int> Git::getChildsIdx(int idx) const {
+// childs are stored by index, sorting them gives rows order
+
+	const Rev* r = revAt(idx);
+	if (!r)
+		return QVector<int>();
+
+	QVector<int> childs(r->childs);
+	std::sort(childs.begin(), childs.end());
+	return childs;
 }
 
 const QStringList Git::getChilds(SCRef parent) {
@@ -568,18 +653,9 @@ const QStringList Git::getChilds(SCRef parent) {
 	if (!r)
 		return childs;
 
-	for (int i = 0; i < r->childs.count(); i++)
-		childs.append(revData->revOrder[r->childs[i]]);
-
-	// reorder childs by loading order
-	QStringList::iterator itC(childs.begin());
-	for ( ; itC != childs.end(); ++itC) {
-		const Rev* r = revLookup(*itC);
-		(*itC).prepend(QString("%1 ").arg(r->orderIdx, 6));
-	}
-	childs.sort();
-	for (itC = childs.begin(); itC != childs.end(); ++itC)
-		(*itC) = (*itC).section(' ', -1, -1);
+	const QVector<int> idx(getChildsIdx(r->orderIdx));
+	FOREACH (QVector<int>, it, idx)
+		childs.append(revData->revOrder[*it]);
 
 	return childs;
 }
@@ -862,14 +938,37 @@ bool Git::isSameFiles(SCRef tree1Sha, SCRef tree2Sha) {
 	return !isChanged;
 }
 
+const QVector<int> Git::getDescendantBranchesIdx(int idx) const {
+
+	const Rev* r = revAt(idx);
+	if (!r || r->descBrnMaster == -1)
+		return QVector<int>();
+
+	return revAt(r->descBrnMaster)->descBranches;
+}
+
+const QVector<int> Git::getNearTagsIdx(bool goDown, int idx) const {
+
+	const Rev* r = revAt(idx);
+	if (!r)
+		return QVector<int>();
+
+	int nearRefsMaster = (goDown ? r->descRefsMaster : r->ancRefsMaster);
+	if (nearRefsMaster == -1)
+		return QVector<int>();
+
+	const Rev* m = revAt(nearRefsMaster);
+	return (goDown ? m->descRefs : m->ancRefs);
+}
+
 const QStringList Git::getDescendantBranches(SCRef sha, bool shaOnly) {
 
 	QStringList tl;
 	const Rev* r = revLookup(sha);
-	if (!r || (r->descBrnMaster == -1))
+	if (!r)
 		return tl;
 
-	const QVector<int>& nr = revLookup(revData->revOrder[r->descBrnMaster])->descBranches;
+	const QVector<int> nr(getDescendantBranchesIdx(r->orderIdx));
 
 	for (int i = 0; i < nr.count(); i++) {
 
@@ -899,12 +998,7 @@ const QStringList Git::getNearTags(bool goDown, SCRef sha) {
 	if (!r)
 		return tl;
 
-	int nearRefsMaster = (goDown ? r->descRefsMaster : r->ancRefsMaster);
-	if (nearRefsMaster == -1)
-		return tl;
-
-	const QVector<int>& nr = goDown ? revLookup(revData->revOrder[nearRefsMaster])->descRefs :
-	                                  revLookup(revData->revOrder[nearRefsMaster])->ancRefs;
+	const QVector<int> nr(getNearTagsIdx(goDown, r->orderIdx));
 
 	for (int i = 0; i < nr.count(); i++) {
 
@@ -975,7 +1069,16 @@ const QString Git::colorMatch(SCRef txt, QRegExp& regExp) {
 	return text;
 }
 
-const QString Git::getDesc(SCRef sha, FileHistory* fh) {
+const QString Git::getDesc(SCRef sha, FileHistory* fh, QSharedPointer<TreeDiff>* bigDiff) {
+/*
+   Diffs bigger than BIG_DIFF_LINES are not rendered in the HTML,
+   when caller can show them in a DiffView, see RevsView, only the
+   list of changed files is. Laying out a huge page is what makes
+   the description slow, the diff parsing is cheap.
+*/
+	if (bigDiff)
+		bigDiff->clear();
+
 
 	if (sha.isEmpty())
 		return "";
@@ -996,7 +1099,7 @@ const QString Git::getDesc(SCRef sha, FileHistory* fh) {
 
         mapping["committer"] = c->committer();
         mapping["author"] = c->author();
-        mapping["author_date"] = getLocalDate(c->authorDate());
+        mapping["author_date"] = getLocalDate(c->authorTime());
 
         if(c->isApplied || c->isUnApplied) {
             QStringList patches(getRefName(sha, APPLIED));
@@ -1011,6 +1114,7 @@ const QString Git::getDesc(SCRef sha, FileHistory* fh) {
             mapping["preceding"] = getNearTags(optGoDown, sha);
         }
 
+        mapping["equivalents"] = getEquivalentRevs(sha);
         mapping["short_log"] = c->shortLog();
         mapping["long_log"] = c->longLog();
 
@@ -1021,7 +1125,10 @@ const QString Git::getDesc(SCRef sha, FileHistory* fh) {
         {
             mapping["diff_exists"] = true;
             mapping["diff"] = QVariant::fromValue(diff.to_value());
-            FileDiff::HunksList d = diff.to_value()->entries()[0]->fileDiff()->hunks();
+            if (bigDiff && diffText.count('\n') > BIG_DIFF_LINES) {
+                *bigDiff = diff.to_value();
+                mapping["diff_in_view"] = true;
+            }
         }
         else {
             mapping["diff_exists"] = false;
@@ -1041,7 +1148,7 @@ const QString Git::getDesc(SCRef sha, FileHistory* fh) {
 	return text;
 }
 
-const RevFile* Git::insertNewFiles(SCRef sha, SCRef data) {
+RevFile* Git::parseNewFiles(SCRef data) {
 
 	/* we use an independent FileNamesLoader to avoid data
 	 * corruption if we are loading file names in background
@@ -1051,7 +1158,13 @@ const RevFile* Git::insertNewFiles(SCRef sha, SCRef data) {
 	RevFile* rf = new RevFile();
 	parseDiffFormat(*rf, data, fl);
 	flushFileNames(fl);
+	return rf;
+}
 
+const RevFile* Git::insertNewFiles(SCRef sha, SCRef data) {
+
+	RevFile* rf = parseNewFiles(data);
+	fileKeeper->add(rf);
 	revsFiles.insert(toPersistentSha(sha, revsFilesShaBackupBuf), rf);
 	return rf;
 }
@@ -1076,93 +1189,157 @@ bool Git::runDiffTreeWithRenameDetection(SCRef runCmd, QString* runOutput) {
 	return true;
 }
 
-const RevFile* Git::getAllMergeFiles(const Rev* r) {
-
-	SCRef mySha(ALL_MERGE_FILES + r->sha());
-	if (revsFiles.contains(toTempSha(mySha)))
-		return revsFiles[toTempSha(mySha)];
-
-	EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
-
-	QString runCmd("git diff-tree --no-color -r -m " + r->sha()), runOutput;
-	if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
-		return NULL;
-
-	return insertNewFiles(mySha, runOutput);
-}
-
-const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef path) {
+bool Git::filesCommand(SCRef sha, SCRef diffToSha, bool allFiles, SCRef path,
+                       const RevFile** cached, QString* runCmd, QString* fileSha) {
+// returns true if 'git diff-tree' is needed, otherwise answer is in *cached
 
+	*cached = NULL;
 	const Rev* r = revLookup(sha);
 	if (!r)
-		return NULL;
+		return false;
 
 	if (r->parentsCount() == 0) // skip initial rev
-		return NULL;
-
-	if (r->parentsCount() > 1 && diffToSha.isEmpty() && allFiles)
-		return getAllMergeFiles(r);
+		return false;
 
-	if (!diffToSha.isEmpty() && (sha != ZERO_SHA)) {
+	if (r->parentsCount() > 1 && diffToSha.isEmpty() && allFiles) {
+		*fileSha = ALL_MERGE_FILES + r->sha();
+		*runCmd = "git diff-tree --no-color -r -m " + r->sha();
 
-		QString runCmd("git diff-tree --no-color -r -m ");
-		runCmd.append(diffToSha + " " + sha);
+	} else if (!diffToSha.isEmpty() && (sha != ZERO_SHA)) {
+		// not stored in revsFiles, see storeFiles()
+		*fileSha = CUSTOM_SHA;
+		*runCmd = "git diff-tree --no-color -r -m " + diffToSha + " " + sha;
 		if (!path.isEmpty())
-			runCmd.append(" " + path);
-
-		EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
-
-		QString runOutput;
-		if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
-			return NULL;
+			runCmd->append(" " + path);
 
-		// we insert a dummy revision file object. It will be
-		// overwritten at each request but we don't care.
-		return insertNewFiles(CUSTOM_SHA, runOutput);
+		return true;
+	} else {
+		*fileSha = r->sha();
+		*runCmd = "git diff-tree --no-color -r -c " + sha;
+	}
+	if (revsFiles.contains(toTempSha(*fileSha))) {
+		*cached = revsFiles[toTempSha(*fileSha)]; // ZERO_SHA search arrives here
+		return false;
 	}
-	if (revsFiles.contains(r->sha()))
-		return revsFiles[r->sha()]; // ZERO_SHA search arrives here
-
 	if (sha == ZERO_SHA) {
 		dbs("ASSERT in Git::getFiles, ZERO_SHA not found");
-		return NULL;
+		return false;
 	}
+	return true;
+}
 
-	EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
+const RevFile* Git::storeFiles(SCRef fileSha, SCRef runOutput) {
+
+	if (fileSha == CUSTOM_SHA) {
+		// asked again at each request, only the last one is kept and
+		// never published, so the previous one is deleted right now
+		customFiles = QSharedPointer<const RevFile>(parseNewFiles(runOutput));
+		return customFiles.data();
+	}
+
+	if (revsFiles.contains(toTempSha(fileSha))) // has been created in the mean time?
+		return revsFiles[toTempSha(fileSha)];
+
+	if (!fileSha.startsWith(ALL_MERGE_FILES))
+		cacheNeedsUpdate = true;
+
+	return insertNewFiles(fileSha, runOutput);
+}
+
+const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef path) {
+
+	const RevFile* files;
+	QString runCmd, fileSha, runOutput;
+	if (!filesCommand(sha, diffToSha, allFiles, path, &files, &runCmd, &fileSha))
+		return files;
 
-	QString runCmd("git diff-tree --no-color -r -c " + sha), runOutput;
 	if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
 		return NULL;
 
-	if (revsFiles.contains(r->sha())) // has been created in the mean time?
-		return revsFiles[r->sha()];
+	return storeFiles(fileSha, runOutput);
+}
 
-	cacheNeedsUpdate = true;
-	return insertNewFiles(sha, runOutput);
+const RevFile* Git::requestFiles(SCRef sha, SCRef diffToSha, bool allFiles) {
+/*
+   Same as getFiles() but never blocks. If files are not known yet
+   NULL is returned and 'git diff-tree' runs in background, then
+   filesReady() is emitted when they are stored. Only the last
+   request is kept, a pending different one is canceled.
+*/
+	const QString key(sha + ' ' + diffToSha + (allFiles ? " all" : ""));
+	if (filesTask && filesTaskKey == key)
+		return NULL; // already on the way
+
+	if (filesTask)
+		filesTask->cancel();
+
+	const RevFile* files;
+	QString runCmd, fileSha;
+	if (!filesCommand(sha, diffToSha, allFiles, "", &files, &runCmd, &fileSha))
+		return files;
+
+	Task* t = new Task(this, parent());
+	connect(this, SIGNAL(cancelAllProcesses()), t, SLOT(cancel()));
+	filesTask = t;
+	filesTaskKey = key;
+
+	// as runDiffTreeWithRenameDetection() but from a pool thread
+	const QString wd(workDir);
+	QSharedPointer<QString> runOutput(new QString);
+	QSharedPointer<bool> ok(new bool(false));
+	t->start([=]() {
+		QString cmd(runCmd);
+		cmd.replace("git diff-tree", "git diff-tree -C");
+		QByteArray ba;
+		*ok = t->run(cmd, wd, &ba, "", false) || t->run(runCmd, wd, &ba);
+		*runOutput = ba;
+	}, [=]() {
+		filesTaskKey.clear();
+		if (*ok)
+			emit filesReady(sha, diffToSha, allFiles, storeFiles(fileSha, *runOutput));
+	});
+	return NULL;
 }
 
 bool Git::startFileHistory(SCRef sha, SCRef startingFileName, FileHistory* fh) {
+// following renames back could take a while, so it runs in background
+// and history is loaded only after, returns true if the search started
+
+	if (startingFileName.isEmpty() || !revLookup(sha))
+		return false;
+
+	QStringList branches(getDescendantBranches(sha, true));
+	if (branches.isEmpty())
+		branches << "HEAD";
 
-	QStringList args(getDescendantBranches(sha, true));
-	if (args.isEmpty())
-		args << "HEAD";
+	// load history from all the branches
+	const QStringList args(getAllRefSha(BRANCH | RMT_BRANCH));
 
-	QString newestFileName = getNewestFileName(args, startingFileName);
-	fh->resetFileNames(newestFileName);
+	if (fh->renameTask) // a new search for the same history
+		fh->renameTask->cancel();
 
-	args.clear(); // load history from all the branches
-	args << getAllRefSha(BRANCH | RMT_BRANCH);
+	Task* t = new Task(fh, parent());
+	connect(this, SIGNAL(cancelAllProcesses()), t, SLOT(cancel()));
+	fh->renameTask = t;
 
-	args << "--" << newestFileName;
-	return startRevList(args, fh);
+	QSharedPointer<QString> newestFileName(new QString);
+	t->start([=]() {
+		*newestFileName = getNewestFileName(t, branches, startingFileName);
+	}, [=]() {
+		fh->resetFileNames(*newestFileName);
+		startRevList(QStringList(args) << "--" << *newestFileName, fh);
+	});
+	return true;
 }
 
-const QString Git::getNewestFileName(SCList branches, SCRef fileName) {
+const QString Git::getNewestFileName(const Task* t, SCList branches, SCRef fileName) const {
+// runs in a pool thread, does not touch any revision data
 
-	QString curFileName(fileName), runOutput, args;
-	while (true) {
+	QString curFileName(fileName), args;
+	QByteArray runOutput;
+	while (!t->isCanceled()) {
 		args = branches.join(" ") + " -- " + curFileName;
-		if (!run("git ls-tree " + args, &runOutput))
+		if (!t->run("git ls-tree " + args, workDir, &runOutput))
 			break;
 
 		if (!runOutput.isEmpty())
@@ -1170,71 +1347,498 @@ const QString Git::getNewestFileName(SCList branches, SCRef fileName) {
 
 		QString msg("Retrieving file renames, now at '" + curFileName + "'...");
 		QApplication::postEvent(parent(), new MessageEvent(msg));
-		EM_PROCESS_EVENTS_NO_INPUT;
 
-		if (!run("git rev-list -n1 " + args, &runOutput))
+		if (!t->run("git rev-list -n1 " + args, workDir, &runOutput))
 			break;
 
 		if (runOutput.isEmpty()) // try harder
-			if (!run("git rev-list --full-history -n1 " + args, &runOutput))
+			if (!t->run("git rev-list --full-history -n1 " + args, workDir, &runOutput))
 				break;
 
 		if (runOutput.isEmpty())
 			break;
 
-		SCRef sha = runOutput.trimmed();
-		QStringList newCur;
-		if (!populateRenamedPatches(sha, QStringList(curFileName), NULL, &newCur, true))
+		const QString sha(QString(runOutput).trimmed());
+		if (!t->run("git diff-tree -r -M " + sha, workDir, &runOutput))
+			break;
+
+		SCRef oldName = renamedFrom(QString(runOutput), curFileName);
+		if (oldName.isEmpty())
 			break;
 
-		curFileName = newCur.first();
+		curFileName = oldName;
 	}
 	return curFileName;
 }
 
-void Git::getFileFilter(SCRef path, ShaSet& shaSet) const {
+void Git::updateKnownPaths(const RepoSnapshot& s) {
+// index of distinct paths, so that filters can match each of them only once
+
+	if (knownPathsGen == s.generation())
+		return;
+
+	knownPaths.clear();
+	FOREACH (RevFileMap, it, s.revFiles) {
+		const RevFile* rf = *it;
+		for (int i = 0; i < rf->count(); ++i)
+			knownPaths.insert(pathId(*rf, i));
+	}
+	knownPathsGen = s.generation();
+}
+
+CommitGraph* Git::getCommitGraph() {
+
+	if (!commitGraph) {
+		commitGraph = new CommitGraph(gitDir);
+		commitGraph->open();
+	}
+	return (commitGraph->hasBloomFilters() ? commitGraph : NULL);
+}
+
+void Git::getFileFilter(SCRef path, ShaSet& shaSet) {
+// on the published snapshot, file names loaded after are not seen
 
 	shaSet.clear();
 	QRegExp rx(path, Qt::CaseInsensitive, QRegExp::Wildcard);
-	FOREACH (ShaVect, it, revData->revOrder) {
+	const RepoSnapshotPtr s(snapshot());
+
+	// case insensitive, wildcard search on each known path
+	updateKnownPaths(*s);
+	QSet<quint64> matched;
+	QVector<CommitGraph::BloomKeys> bloomKeys;
+	FOREACH (QSet<quint64>, it, knownPaths) {
+		const QString fp(s->dirNames.at(*it >> 32) + s->fileNames.at(*it & 0xffffffff));
+		if (fp.contains(rx)) {
+			matched.insert(*it);
+			if (bloomKeys.count() <= MAX_BLOOM_PATHS)
+				bloomKeys.append(CommitGraph::pathKeys(fp));
+		}
+	}
+	if (matched.isEmpty())
+		return;
+
+	// with few candidate paths changed-path Bloom filters, when available,
+	// let us skip revisions that certainly did not touch any of them
+	const CommitGraph* cg = (bloomKeys.count() <= MAX_BLOOM_PATHS ? getCommitGraph() : NULL);
+
+	for (int row = 0; row < s->count(); row++) {
 
-		if (!revsFiles.contains(*it))
+		const RevFile* rf = s->files(row);
+		if (!rf)
+			continue;
+
+		const ShaString sha(s->shaBuf.constData() + 41 * row);
+		if (cg && sha != ZERO_SHA_RAW && !cg->maybeChangedAny(ObjectDb::toRaw(sha.latin1()), bloomKeys))
 			continue;
 
-		// case insensitive, wildcard search
-		const RevFile* rf = revsFiles[*it];
 		for (int i = 0; i < rf->count(); ++i)
-			if (filePath(*rf, i).contains(rx)) {
-				shaSet.insert(*it);
+			if (matched.contains(pathId(*rf, i))) {
+				shaSet.insert(sha);
 				break;
 			}
 	}
 }
 
-bool Git::getPatchFilter(SCRef exp, bool isRegExp, ShaSet& shaSet) {
+Task* Git::startPatchFilter(QObject* owner, SCRef exp, bool isRegExp,
+                            std::function<void(bool, const ShaSet&)> done) {
+// 'git diff-tree' could be slow, so done() is called back when finished,
+// unless the returned task is canceled before. Task is owned by owner
 
-	shaSet.clear();
 	QString buf;
 	FOREACH (ShaVect, it, revData->revOrder)
 		if (*it != ZERO_SHA_RAW)
 			buf.append(*it).append('\n');
 
-	if (buf.isEmpty())
-		return true;
-
-	EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
-
-	QString runCmd("git diff-tree --no-color -r -s --stdin "), runOutput;
+	if (buf.isEmpty()) {
+		done(true, ShaSet());
+		return NULL;
+	}
+	QString runCmd("git diff-tree --no-color -r -s --stdin ");
 	if (isRegExp)
 		runCmd.append("--pickaxe-regex ");
 
 	runCmd.append(quote("-S" + exp));
-	if (!run(runCmd, &runOutput, NULL, buf))
+
+	Task* t = new Task(owner, parent());
+	connect(this, SIGNAL(cancelAllProcesses()), t, SLOT(cancel()));
+
+	const QString wd(workDir);
+	QSharedPointer<ShaSet> shaSet(new ShaSet);
+	QSharedPointer<bool> ok(new bool(false));
+	t->start([=]() {
+		QByteArray runOutput;
+		*ok = t->run(runCmd, wd, &runOutput, buf);
+		if (!*ok)
+			return;
+
+		const QStringList sl(QString(runOutput).split('\n', QString::SkipEmptyParts));
+		FOREACH_SL (it, sl)
+			shaSet->insert(*it);
+	}, [=]() {
+		done(*ok, *shaSet);
+	});
+	return t;
+}
+
+static const FileAnnotation toFileAnnotation(const FileHistory* fh, SCRef sha,
+                                             SCRef fileSha, const Annotate::Result& r) {
+// origin of each line as annotation id, the one shown in file history
+
+	const int rowCnt = fh->rowCount();
+	FileAnnotation fa(rowCnt - fh->row(sha));
+	fa.fileSha = fileSha;
+	fa.isValid = r.isComplete;
+	FOREACH_SL (it, r.origins) {
+		int row = (it->isEmpty() ? -1 : fh->row(*it));
+		fa.lines.append(row != -1 ? QString::number(rowCnt - row) : "");
+	}
+	return fa;
+}
+
+Task* Git::startAnnotate(QObject* owner, FileHistory* fh, SCRef sha, SCRef fileName,
+                         int screenLines, std::function<void(const FileAnnotation&)> update) {
+// patches are the ones already loaded in file history, update() is called
+// back with partial results while they are walked, as soon as the first
+// 'screenLines' lines are known, and with the complete one when finished,
+// unless the returned task is canceled before. Task is owned by owner
+
+	// revision data is not thread safe, take the patches here
+	Annotate::Steps steps;
+	const Rev* r = revLookup(sha, fh);
+	while (r && steps.count() < fh->revOrder.count()) {
+		const Rev* p = (r->parentsCount() > 0 ? revLookup(r->parent(0), fh) : NULL);
+		steps.append(Annotate::Step(QString(r->sha()), r->diff(), p == NULL));
+		r = p;
+	}
+	if (steps.isEmpty())
+		return NULL;
+
+	const QString blobCmd("git rev-parse " + quote(sha + ':' + fileName));
+	const QString wd(workDir);
+	QSharedPointer<Annotate> ann(annotate);
+
+	Task* t = new Task(owner, parent());
+	connect(this, SIGNAL(cancelAllProcesses()), t, SLOT(cancel()));
+
+	QSharedPointer<QMutex> mtx(new QMutex);
+	QSharedPointer<Annotate::Result> partial(new Annotate::Result), res(new Annotate::Result);
+	QSharedPointer<QString> fileSha(new QString);
+	QSharedPointer<bool> ok(new bool(false));
+
+	connect(t, &Task::progress, t, [=]() {
+		mtx->lock();
+		const Annotate::Result r(*partial);
+		const QString fs(*fileSha);
+		mtx->unlock();
+		update(toFileAnnotation(fh, sha, fs, r));
+	});
+	t->start([=]() {
+		QByteArray runOutput;
+		if (sha == ZERO_SHA) { // not in git yet, not cached
+			QFile f(wd + '/' + fileName);
+			if (!f.open(QIODevice::ReadOnly))
+				return;
+			runOutput = f.readAll();
+		} else {
+			if (!t->run(blobCmd, wd, &runOutput))
+				return;
+			{
+				QMutexLocker lock(mtx.data());
+				*fileSha = QString(runOutput).trimmed();
+			}
+			if (!t->run("git cat-file blob " + *fileSha, wd, &runOutput))
+				return;
+		}
+		int lineCnt = runOutput.count('\n');
+		if (!runOutput.isEmpty() && !runOutput.endsWith('\n'))
+			lineCnt++;
+
+		*ok = ann->run(steps, *fileSha, fileName, lineCnt, screenLines, t->token(),
+		               [=](const Annotate::Result& r) {
+			{
+				QMutexLocker lock(mtx.data());
+				*partial = r;
+			}
+			t->setProgress(r.known, r.origins.count());
+		}, res.data());
+	}, [=]() {
+		if (!*ok)
+			return;
+
+		fh->setAnnIdValid();
+		update(toFileAnnotation(fh, sha, *fileSha, *res));
+	});
+	return t;
+}
+
+void Git::startPatchIds() {
+// ids are saved, only revisions never seen before are diffed
+
+	if (!testFlag(PATCH_ID_F) || patchIdsTask)
+		return;
+
+	QStringList todo;
+	FOREACH (ShaVect, it, revData->revOrder) {
+		const Rev* r = revLookup(*it);
+		if (!r || r->parentsCount() != 1 || r->isBoundary() || *it == ZERO_SHA_RAW)
+			continue; // merges have not a single patch
+
+		if (!patchIds->contains(ObjectDb::toRaw(it->latin1())))
+			todo.append(*it);
+	}
+	if (todo.isEmpty()) {
+		updateEquivalentRevs();
+		return;
+	}
+	Task* t = new Task(this); // no error popups from a background job
+	connect(this, SIGNAL(cancelAllProcesses()), t, SLOT(cancel()));
+	patchIdsTask = t;
+
+	const QString wd(workDir);
+	QSharedPointer<QHash<QByteArray, QByteArray> > res(new QHash<QByteArray, QByteArray>);
+	t->start([=]() {
+		PatchIds::compute(t, wd, todo, res.data());
+	}, [=]() {
+		QHashIterator<QByteArray, QByteArray> it(*res);
+		while (it.hasNext()) {
+			it.next();
+			patchIds->insert(it.key(), it.value());
+		}
+		updateEquivalentRevs();
+		emit patchIdsReady();
+	});
+}
+
+void Git::updateEquivalentRevs() {
+// saved ids could refer to revisions no more loaded, e.g. rebased away
+
+	equivalentRevs.clear();
+	FOREACH (ShaVect, it, revData->revOrder) {
+		if (*it == ZERO_SHA_RAW)
+			continue;
+
+		const QList<QByteArray> eq(patchIds->equivalents(ObjectDb::toRaw(it->latin1())));
+		FOREACH (QList<QByteArray>, e, eq)
+			if (revLookup(QString(ObjectDb::toHex(*e)))) {
+				equivalentRevs.insert(*it);
+				break;
+			}
+	}
+}
+
+const QStringList Git::getEquivalentRevs(SCRef sha) const {
+// loaded revisions with the same changes, e.g. cherry-picked ones
+
+	QStringList sl;
+	if (sha.isEmpty() || sha == ZERO_SHA)
+		return sl;
+
+	const QList<QByteArray> eq(patchIds->equivalents(ObjectDb::toRaw(sha)));
+	FOREACH (QList<QByteArray>, it, eq) {
+		const QString s(ObjectDb::toHex(*it));
+		if (revLookup(s))
+			sl.append(s);
+	}
+	return sl;
+}
+
+bool Git::hasEquivalentRevs(const ShaString& sha) const {
+// fast check for painting, same result of getEquivalentRevs()
+
+	return equivalentRevs.contains(sha);
+}
+
+PackBitmaps* Git::getPackBitmaps() {
+
+	if (!packBitmaps) {
+		packBitmaps = new PackBitmaps(gitDir);
+		packBitmaps->open();
+	}
+	return (packBitmaps->isEmpty() ? NULL : packBitmaps);
+}
+
+RepoSnapshotPtr Git::snapshot() const {
+// can be called from any thread, see publishSnapshot()
+
+	QMutexLocker lock(&snapshotMutex);
+	return curSnapshot;
+}
+
+bool Git::updateReachability() {
+// parent rows table is built once per load, afterwards range
+// queries do not need to look at the revisions anymore
+
+	const ShaVect& ro = revData->revOrder;
+	if (reachability->isValid(ro.count()))
+		return true;
+
+	if (ro.isEmpty())
 		return false;
 
-	const QStringList sl(runOutput.split('\n', QString::SkipEmptyParts));
-	FOREACH_SL (it, sl)
-		shaSet.insert(*it);
+	QVector<int> firstParent, parentRows;
+	QVector<QByteArray> rawShas(ro.count());
+	firstParent.reserve(ro.count() + 1);
+	parentRows.reserve(ro.count() * 2);
+
+	for (int i = 0; i < ro.count(); i++) {
+
+		firstParent.append(parentRows.count());
+		const Rev* r = revLookup(ro[i]);
+		for (uint j = 0; r && j < r->parentsCount(); j++) {
+			const Rev* p = revLookup(r->parent(j));
+			parentRows.append(p ? p->orderIdx : -1);
+		}
+		if (ro[i] != ZERO_SHA_RAW)
+			rawShas[i] = ObjectDb::toRaw(ro[i].latin1());
+	}
+	firstParent.append(parentRows.count());
+	reachability->setGraph(firstParent, parentRows);
+
+	PackBitmaps* pb = getPackBitmaps();
+	if (pb)
+		pb->setRows(rawShas);
+
+	return true;
+}
+
+int Git::rangeRow(SCRef ref) {
+
+	SCRef sha = getRefSha(ref.isEmpty() ? "HEAD" : ref, ANY_REF, true);
+	const Rev* r = (sha.isEmpty() ? NULL : revLookup(sha));
+	return (r ? r->orderIdx : -1);
+}
+
+bool Git::getRangeFilter(SCRef exp, ShaSet& shaSet) {
+/*
+   Evaluate a revision range on the loaded graph, without running
+   git again. Accepted terms, separated by spaces, are the ones of
+   'git rev-list': 'A', '^A', 'A..B' and 'A...B', where an empty
+   side means HEAD. When only exclusions are given, as in '^master',
+   the whole loaded history is the starting set.
+*/
+	shaSet.clear();
+	const QStringList terms(exp.split(' ', QString::SkipEmptyParts));
+	if (terms.isEmpty() || !updateReachability())
+		return false;
+
+	struct Term {
+		bool neg, sym, isRange;
+		QString a, b;
+	};
+	QVector<Term> parsed;
+	QHash<QString, int> rows;
+	QVector<int> tips;
+
+	FOREACH_SL (it, terms) {
+
+		Term t;
+		QString s(*it);
+		t.neg = s.startsWith('^');
+		if (t.neg)
+			s.remove(0, 1);
+
+		int sep = s.indexOf("..");
+		t.isRange = (sep != -1);
+		t.sym = t.isRange && s.mid(sep, 3) == "...";
+		t.a = t.isRange ? s.left(sep) : s;
+		t.b = t.isRange ? s.mid(sep + (t.sym ? 3 : 2)) : "";
+		parsed.append(t);
+
+		QStringList names(t.a);
+		if (t.isRange)
+			names.append(t.b);
+
+		FOREACH_SL (n, names) {
+			if (rows.contains(*n))
+				continue;
+
+			int row = rangeRow(*n);
+			if (row == -1) {
+				dbp("WARNING in getRangeFilter, <%1> not found in loaded revisions", *n);
+				return false;
+			}
+			rows.insert(*n, row);
+			tips.append(row);
+		}
+	}
+	// pack bitmaps, when available, save the walks for the tips they cover
+	PackBitmaps* pb = getPackBitmaps();
+	FOREACH (QVector<int>, it, tips) {
+		QBitArray set;
+		if (   pb && !reachability->isKnown(*it)
+		    && pb->reachableRows(ObjectDb::toRaw(revData->revOrder[*it].latin1()), &set))
+			reachability->seed(*it, set);
+	}
+	reachability->compute(tips); // remaining ones in parallel
+
+	const int cnt = revData->revOrder.count();
+	QBitArray include(cnt), exclude(cnt);
+	bool hasInclude = false;
+
+	FOREACH (QVector<Term>, it, parsed) {
+
+		const QBitArray a(reachability->reachable(rows.value(it->a)));
+		if (!it->isRange) {
+			if (it->neg)
+				exclude |= a;
+			else
+				include |= a;
+
+			hasInclude = hasInclude || !it->neg;
+			continue;
+		}
+		const QBitArray b(reachability->reachable(rows.value(it->b)));
+		if (it->sym) { // reachable from either side but not from both
+			include |= a;
+			include |= b;
+			exclude |= (a & b);
+		} else {
+			include |= b;
+			exclude |= a;
+		}
+		hasInclude = true;
+	}
+	if (!hasInclude)
+		include.fill(true);
+
+	include &= ~exclude;
+	for (int i = 0; i < cnt; i++)
+		if (include.testBit(i))
+			shaSet.insert(revData->revOrder[i]);
+
+	return true;
+}
+
+void Git::updateDateIndex(FileHistory* fh) {
+// rows are only appended while loading, so index just the new ones
+
+	DateIndex& idx = fh->dateIndex;
+	const int cnt = fh->revOrder.count();
+	if (idx.count() > cnt)
+		idx.clear();
+
+	QVector<uint> times;
+	times.reserve(cnt - idx.count());
+	for (int row = idx.count(); row < cnt; row++) {
+		const Rev* r = revLookup(fh->revOrder[row], fh);
+		times.append(r ? r->authorTime() : 0);
+	}
+	idx.append(times);
+}
+
+bool Git::getDateFilter(SCRef exp, ShaSet& shaSet) {
+// revisions with author date in range, see DateIndex::parseRange()
+
+	shaSet.clear();
+	uint from, to;
+	if (!DateIndex::parseRange(exp, QDateTime::currentDateTime().toTime_t(), &from, &to)) {
+		dbp("WARNING in getDateFilter, bad date range <%1>", exp);
+		return false;
+	}
+	updateDateIndex(revData);
+	const QVector<int> rows(revData->dateIndex.rows(from, to));
+	FOREACH (QVector<int>, it, rows)
+		shaSet.insert(revData->revOrder[*it]);
 
 	return true;
 }
@@ -1273,18 +1877,28 @@ bool Git::applyPatchFile(SCRef patchPath, bool fold, bool isDragDrop) {
 	return run(runCmd + quote(patchPath));
 }
 
+const QVector<int> Git::sortedIdx(SCList shaList) const {
+// indexes of the loaded ones, in loading order
+
+	QVector<int> idx;
+	idx.reserve(shaList.count());
+	FOREACH_SL (it, shaList) {
+		const Rev* r = revLookup(*it);
+		if (r)
+			idx.append(r->orderIdx);
+	}
+	std::sort(idx.begin(), idx.end());
+	return idx;
+}
+
 const QStringList Git::sortShaListByIndex(SCList shaList) {
 
 	QStringList orderedShaList;
-	FOREACH_SL (it, shaList)
-		appendNamesWithId(orderedShaList, *it, QStringList(*it), true);
-
-	orderedShaList.sort();
-	QStringList::iterator itN(orderedShaList.begin());
-	for ( ; itN != orderedShaList.end(); ++itN) // strip 'idx'
-		(*itN) = (*itN).section(' ', -1, -1);
+	const QVector<int> idx(sortedIdx(shaList));
+	FOREACH (QVector<int>, it, idx)
+		orderedShaList.append(revData->revOrder[*it]);
 
-        return orderedShaList;
+	return orderedShaList;
 }
 
 bool Git::formatPatch(SCList shaList, SCRef dirPath, SCRef remoteDir) {
@@ -7,20 +7,39 @@
 #ifndef GIT_H
 #define GIT_H
 
+#include <functional>
+
 #include <QAbstractItemModel>
+#include <QMutex>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QSet>
 #include "exceptionmanager.h"
 #include "common.h"
 
 template <class, class> struct QPair;
 class QRegExp;
 class QTextCodec;
+class Annotate;
 class Cache;
+class CommitGraph;
 class DataLoader;
 class Domain;
 class Git;
 class Lanes;
 class MyProcess;
 class FileHistory;
+class HistoryOrder;
+class PackBitmaps;
+class PatchIds;
+class Reachability;
+class RepoSnapshot;
+class RevFileKeeper;
+class Task;
+class TreeDiff;
+
+typedef QSharedPointer<const RepoSnapshot> RepoSnapshotPtr;
+
 namespace Grantlee {
     class Engine;
 }
@@ -87,6 +106,7 @@ public:
 	void setThrowOnStop(bool b);
 	bool isThrowOnStopRaised(int excpId, SCRef curContext);
 	void setLane(SCRef sha, FileHistory* fh);
+	bool setHistoryOrder(QGit::OrderType type);
 	bool startFileHistory(SCRef sha, SCRef startingFileName, FileHistory* fh);
 	void cancelDataLoading(const FileHistory* fh);
 	void cancelProcess(MyProcess* p);
@@ -101,6 +121,9 @@ public:
 	bool isTextHighlighter() const { return isTextHighlighterFound; }
 	const QString textHighlighterVersion() const { return textHighlighterVersionFound; }
 	bool isMainHistory(const FileHistory* fh) { return (fh == revData); }
+	RepoSnapshotPtr snapshot() const;
+	static const QStringList revListCmd(bool mainHistory);
+	static const QByteArray refsFingerprint(SCRef headSha, SCRef showRefOutput);
 	MyProcess* getDiff(SCRef sha, QObject* receiver, SCRef diffToSha, bool combined);
     QString getDiff(SCRef sha);
 	const QString getWorkDirDiff(SCRef fileName = "");
@@ -108,18 +131,32 @@ public:
 	MyProcess* getHighlightedFile(SCRef fileSha, QObject* receiver, QString* result, SCRef fileName);
 	const QString getFileSha(SCRef file, SCRef revSha);
 	bool saveFile(SCRef fileSha, SCRef fileName, SCRef path);
-	void getFileFilter(SCRef path, ShaSet& shaSet) const;
-	bool getPatchFilter(SCRef exp, bool isRegExp, ShaSet& shaSet);
+	void getFileFilter(SCRef path, ShaSet& shaSet);
+	Task* startPatchFilter(QObject* owner, SCRef exp, bool isRegExp,
+	                       std::function<void(bool, const ShaSet&)> done);
+	const QStringList getEquivalentRevs(SCRef sha) const;
+	bool hasEquivalentRevs(const ShaString& sha) const;
+	Task* startAnnotate(QObject* owner, FileHistory* fh, SCRef sha, SCRef fileName,
+	                    int screenLines, std::function<void(const FileAnnotation&)> update);
+	bool getRangeFilter(SCRef exp, ShaSet& shaSet);
+	bool getDateFilter(SCRef exp, ShaSet& shaSet);
 	const RevFile* getFiles(SCRef sha, SCRef sha2 = "", bool all = false, SCRef path = "");
+	const RevFile* requestFiles(SCRef sha, SCRef sha2 = "", bool all = false);
 	bool getTree(SCRef ts, TreeInfo& ti, bool wd, SCRef treePath);
 	static const QString getLocalDate(SCRef gitDate);
-    const QString getDesc(SCRef sha, FileHistory* fh);
+	static const QString getLocalDate(uint secs);
+    const QString getDesc(SCRef sha, FileHistory* fh, QSharedPointer<TreeDiff>* bigDiff = NULL);
 	const QString getLastCommitMsg();
 	const QString getNewCommitMsg();
 	const QString getLaneParent(SCRef fromSHA, int laneNum);
 	const QStringList getChilds(SCRef parent);
 	const QStringList getNearTags(bool goDown, SCRef sha);
 	const QStringList getDescendantBranches(SCRef sha, bool shaOnly = false);
+	const QVector<int> getChildsIdx(int idx) const;
+	const QVector<int> getNearTagsIdx(bool goDown, int idx) const;
+	const QVector<int> getDescendantBranchesIdx(int idx) const;
+	const QVector<int> getRefsIdx(uint mask) const;
+	const QVector<int> sortedIdx(SCList shaList) const;
 	const QString getShortLog(SCRef sha);
 	const QString getTagMsg(SCRef sha);
 	const Rev* revLookup(const ShaString& sha, const FileHistory* fh = NULL) const;
@@ -146,6 +183,7 @@ public:
 	bool stgPush(SCRef sha);
 	bool stgPop(SCRef sha);
 	void setTextCodec(QTextCodec* tc);
+	QTextCodec* revTextCodec() const { return revCodec; }
 	void addExtraFileInfo(QString* rowName, SCRef sha, SCRef diffToSha, bool allMergeFiles);
 	void removeExtraFileInfo(QString* rowName);
 	void formatPatchFileHeader(QString* rowName, SCRef sha, SCRef dts, bool cmb, bool all);
@@ -154,6 +192,10 @@ public:
 
 		return dirNamesVec[rf.dirAt(i)] + fileNamesVec[rf.nameAt(i)];
 	}
+	static quint64 pathId(const RevFile& rf, uint i) {
+
+		return (quint64(rf.dirAt(i)) << 32) | uint(rf.nameAt(i));
+	}
 	void setCurContext(Domain* d) { curDomain = d; }
 	Domain* curContext() const { return curDomain; }
 
@@ -162,8 +204,12 @@ signals:
 	void loadCompleted(const FileHistory*, const QString&);
 	void cancelLoading(const FileHistory*);
 	void cancelAllProcesses();
+	void patchIdsReady();
+	void historyReordered();
 	void fileNamesLoad(int, int);
+	void filesReady(const QString&, const QString&, bool, const RevFile*);
 	void changeFont(const QFont&);
+	void changeTextCodec(QTextCodec*);
 
 public slots:
 	void procReadyRead(const QByteArray&);
@@ -207,6 +253,7 @@ private:
 	FileNamesLoader fileLoader;
 
 	void init2();
+	void setRevTextCodec(QTextCodec* tc);
 	bool run(SCRef cmd, QString* out = NULL, QObject* rcv = NULL, SCRef buf = "");
 	bool run(QByteArray* runOutput, SCRef cmd, QObject* rcv = NULL, SCRef buf = "");
 	MyProcess* runAsync(SCRef cmd, QObject* rcv, SCRef buf = "");
@@ -218,11 +265,20 @@ private:
 	void clearFileNames();
 	bool startRevList(SCList args, FileHistory* fh);
 	bool startUnappliedList();
+	bool startPreviewList(SCList args);
+	const QStringList revListArgs() const;
 	bool startParseProc(SCList initCmd, FileHistory* fh, SCRef buf);
+	bool startNativeRevList(FileHistory* fh);
+	bool startSharedRevList(const RepoSnapshotPtr& s);
+	bool startDaemonRevList(SCList args);
+	bool adoptFileNames(const RepoSnapshotPtr& s);
+	DataLoader* createDataLoader(FileHistory* fh);
 	bool tryFollowRenames(FileHistory* fh);
-	bool populateRenamedPatches(SCRef sha, SCList nn, FileHistory* fh, QStringList* on, bool bt);
+	bool populateRenamedPatches(SCRef sha, SCList nn, FileHistory* fh, QStringList* on);
+	static const QString renameLine(SCRef diffTree, SCList newNames, bool backTrack);
+	static const QString renamedFrom(SCRef diffTree, SCRef newName);
 	bool filterEarlyOutputRev(FileHistory* fh, Rev* rev);
-	int addChunk(FileHistory* fh, const QByteArray& ba, int ofs);
+	int addChunk(FileHistory* fh, const RowBlock& ba, int ofs);
 	void parseDiffFormat(RevFile& rf, SCRef buf, FileNamesLoader& fl);
 	void parseDiffFormatLine(RevFile& rf, SCRef line, int parNum, FileNamesLoader& fl);
 	Rev* fakeRevData(SCRef sha, SCList parents, SCRef author, SCRef date, SCRef log,
@@ -230,8 +286,12 @@ private:
 	const Rev* fakeWorkDirRev(SCRef parent, SCRef log, SCRef longLog, int idx, FileHistory* fh);
 	const RevFile* fakeWorkDirRevFile(const WorkingDirInfo& wd);
 	bool copyDiffIndex(FileHistory* fh, SCRef parent);
+	RevFile* parseNewFiles(SCRef data);
 	const RevFile* insertNewFiles(SCRef sha, SCRef data);
-	const RevFile* getAllMergeFiles(const Rev* r);
+	void publishSnapshot(bool empty = false);
+	bool filesCommand(SCRef sha, SCRef sha2, bool all, SCRef path, const RevFile** cached,
+	                  QString* runCmd, QString* fileSha);
+	const RevFile* storeFiles(SCRef fileSha, SCRef runOutput);
 	bool runDiffTreeWithRenameDetection(SCRef runCmd, QString* runOutput);
 	bool isParentOf(SCRef par, SCRef child);
 	bool isTreeModified(SCRef sha);
@@ -240,22 +300,34 @@ private:
 	                   QHash<uint, QVector<int> >& dv);
 	void mergeNearTags(bool down, Rev* p, const Rev* r, const QHash<QPair<uint, uint>, bool>&dm);
 	void mergeBranches(Rev* p, const Rev* r);
-	void updateLanes(Rev& c, Lanes& lns, SCRef sha);
+	void updateLanes(Rev& c, Lanes& lns, SCRef sha, const FileHistory* fh);
+	bool applyHistoryOrder();
+	void restoreLanesPage(FileHistory* fh, int page);
+	void touchLanesPage(FileHistory* fh, int page);
+	void recordLaneSegments(FileHistory* fh, int row, const QVector<int>& lanes);
 	bool mkPatchFromWorkDir(SCRef msg, SCRef patchFile, SCList files);
 	const QStringList getOthersFiles();
 	const QStringList getOtherFiles(SCList selFiles, bool onlyInIndex);
-	const QString getNewestFileName(SCList args, SCRef fileName);
+	const QString getNewestFileName(const Task* t, SCList branches, SCRef fileName) const;
 	static const QString colorMatch(SCRef txt, QRegExp& regExp);
 	void appendFileName(RevFile& rf, SCRef name, FileNamesLoader& fl);
 	void flushFileNames(FileNamesLoader& fl);
 	void populateFileNamesMap();
+	void updateKnownPaths(const RepoSnapshot& s);
+	CommitGraph* getCommitGraph();
+	PackBitmaps* getPackBitmaps();
+	bool updateReachability();
+	void startPatchIds();
+	void updateEquivalentRevs();
+	int rangeRow(SCRef ref);
+	void updateDateIndex(FileHistory* fh);
 	static const QString quote(SCRef nm);
 	static const QString quote(SCList sl);
 	static const QStringList noSpaceSepHack(SCRef cmd);
 	void removeDeleted(SCList selFiles);
 	void setStatus(RevFile& rf, SCRef rowSt);
 	void setExtStatus(RevFile& rf, SCRef rowSt, int parNum, FileNamesLoader& fl);
-	void appendNamesWithId(QStringList& names, SCRef sha, SCList data, bool onlyLoaded);
+	const Rev* revAt(int idx) const;
 	Reference* lookupReference(const ShaString& sha, bool create = false);
 
 	EM_DECLARE(exGitStopped);
@@ -272,19 +344,41 @@ private:
 	bool isStGIT;
 	bool isGIT;
 	bool isTextHighlighterFound;
+	QTextCodec* revCodec; // of commit messages, NULL for UTF-8, git default
 	QString textHighlighterVersionFound;
 	bool loadingUnAppliedPatches;
+	bool loadingPreview;
 	bool fileCacheAccessed;
 	int patchesStillToFind;
 	QString firstNonStGitPatch;
 	RevFileMap revsFiles;
 	QVector<QByteArray> revsFilesShaBackupBuf;
+	QSharedPointer<RevFileKeeper> fileKeeper; // owns revsFiles values
+	QSharedPointer<const RevFile> customFiles; // last "diff to" request, not in revsFiles
+	QSharedPointer<Annotate> annotate; // shared with running blame tasks
+	QPointer<Task> filesTask; // pending requestFiles()
+	QString filesTaskKey;
 	RefMap refsShaMap;
 	QVector<QByteArray> shaBackupBuf;
+	QByteArray refsKey; // refs fingerprint, see getRefs()
 	StrVect fileNamesVec;
 	StrVect dirNamesVec;
 	QHash<QString, int> fileNamesMap; // quick lookup file name
 	QHash<QString, int> dirNamesMap;  // quick lookup directory name
+	QSet<quint64> knownPaths;         // distinct paths as pathId()
+	int knownPathsGen;                // snapshot generation of knownPaths
+	CommitGraph* commitGraph;
+	PackBitmaps* packBitmaps;
+	Reachability* reachability;
+	HistoryOrder* historyOrder;
+	QGit::OrderType orderType; // requested one, applied after each load
+	bool treeIndexed;
+	PatchIds* patchIds;
+	QPointer<Task> patchIdsTask;
+	QSet<ShaString> equivalentRevs; // loaded, with a loaded equivalent
+	RepoSnapshotPtr curSnapshot; // protected by snapshotMutex
+	mutable QMutex snapshotMutex;
+	int snapshotGen;
 	FileHistory* revData;
     Grantlee::Engine* engine;
 };
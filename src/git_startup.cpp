@@ -7,17 +7,35 @@
 
 */
 #include <QApplication>
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDesktopWidget>
+#include <QFontMetrics>
 #include <QPair>
 #include <QSettings>
 #include <QTextCodec>
+#include <QThread>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "annotate.h"
 #include "exceptionmanager.h"
 #include "lanes.h"
 #include "myprocess.h"
 #include "cache.h"
 #include "mainimpl.h"
+#include "patchid.h"
 #include "dataloader.h"
+#include "logdaemon.h"
 #include "git.h"
 #include "filehistory.h"
+#include "historyorder.h"
+#include "reachability.h"
+#include "rowblocks.h"
+#include "snapshot.h"
+#include "task.h"
+#include "odb/commitgraph.h"
+#include "odb/packbitmap.h"
 
 #define SHOW_MSG(x) QApplication::postEvent(parent(), new MessageEvent(x)); EM_PROCESS_EVENTS_NO_INPUT;
 
@@ -25,22 +43,27 @@ using namespace QGit;
 
 static bool startup = true; // it's OK to be unique among qgit windows
 
-static QHash<QString, QString> localDates;
+static QHash<uint, QString> localDates;
 
-const QString Git::getLocalDate(SCRef gitDate) {
+const QString Git::getLocalDate(uint secs) {
 // fast path here, we use a cache to avoid the slow date calculation
 
-	QString localDate(localDates.value(gitDate));
+	QString localDate(localDates.value(secs));
 	if (!localDate.isEmpty())
 		return localDate;
 
 	QDateTime d;
-	d.setTime_t(gitDate.toULong());
+	d.setTime_t(secs);
 	localDate = d.toString(Qt::LocalDate);
-	localDates[gitDate] = localDate;
+	localDates.insert(secs, localDate);
 	return localDate;
 }
 
+const QString Git::getLocalDate(SCRef gitDate) {
+
+	return getLocalDate(gitDate.toUInt());
+}
+
 const QStringList Git::getArgs() {
     QStringList arguments(qApp->arguments());
     arguments.removeFirst();
@@ -86,6 +109,13 @@ Reference* Git::lookupReference(const ShaString& sha, bool create) {
 	return (it != refsShaMap.end() ? &(*it) : NULL);
 }
 
+const QByteArray Git::refsFingerprint(SCRef headSha, SCRef showRefOutput) {
+// same refs and HEAD give the same 'git log --all' output
+
+	return QCryptographicHash::hash((headSha + '\n' + showRefOutput).toLatin1(),
+	                                QCryptographicHash::Sha1);
+}
+
 bool Git::getRefs() {
 
 	// check for a StGIT stack
@@ -117,6 +147,7 @@ bool Git::getRefs() {
 	if (!run("git show-ref -d", &runOutput))
 		return false;
 
+	refsKey = refsFingerprint(curBranchSHA, runOutput);
 	refsShaMap.clear();
 	shaBackupBuf.clear(); // revs are already empty now
 
@@ -256,12 +287,14 @@ Rev* Git::fakeRevData(SCRef sha, SCList parents, SCRef author, SCRef date, SCRef
 	if (!patch.isEmpty())
 		data.append('\n' + patch);
 
-    QByteArray* ba = new QByteArray(data.toLatin1());
+	RowBlock* ba = new RowBlock();
+	ba->append(data.toLatin1());
 	ba->append('\0');
+	ba->texts = &fh->revTexts;
 
 	fh->rowData.append(ba);
 	int dummy;
-	Rev* c = new Rev(*ba, 0, idx, &dummy, !isMainHistory(fh));
+	Rev* c = new Rev(*ba, 0, idx, &dummy, isMainHistory(fh) ? MAIN_LOG : FILE_LOG);
 	return c;
 }
 
@@ -284,6 +317,7 @@ const RevFile* Git::fakeWorkDirRevFile(const WorkingDirInfo& wd) {
 
 	FileNamesLoader fl;
 	RevFile* rf = new RevFile();
+	fileKeeper->add(rf);
 	parseDiffFormat(*rf, wd.diffIndex, fl);
 	rf->onlyModified = false;
 
@@ -414,7 +448,7 @@ void Git::parseDiffFormat(RevFile& rf, SCRef buf, FileNamesLoader& fl) {
 	}
 }
 
-bool Git::startParseProc(SCList initCmd, FileHistory* fh, SCRef buf) {
+DataLoader* Git::createDataLoader(FileHistory* fh) {
 
 	DataLoader* dl = new DataLoader(this, fh); // auto-deleted when done
 
@@ -429,24 +463,83 @@ bool Git::startParseProc(SCList initCmd, FileHistory* fh, SCRef buf) {
 	        SLOT(on_loaded(FileHistory*, ulong, int,
 	        bool, const QString&, const QString&)));
 
+	return dl;
+}
+
+bool Git::startParseProc(SCList initCmd, FileHistory* fh, SCRef buf) {
+
+	DataLoader* dl = createDataLoader(fh);
 	return dl->start(initCmd, workDir, buf);
 }
 
-bool Git::startRevList(SCList args, FileHistory* fh) {
+bool Git::startNativeRevList(FileHistory* fh) {
+// same tips of 'git log --all', that is all the refs and HEAD
 
-    QString baseCmd("git log --all --topo-order --no-color "
+	QStringList tips(getAllRefSha(ANY_REF));
+	QString head;
+	if (run("git rev-parse --revs-only HEAD", &head) && !tips.contains(head.trimmed()))
+		tips.append(head.trimmed());
 
-#ifndef Q_OS_WIN32
-	                "--log-size " // FIXME broken on Windows
-#endif
-	                "--parents --boundary -z "
-	                "--pretty=format:%m%HX%PX%n%cn<%ce>%n%an<%ae>%n%at%n%s%n");
+	DataLoader* dl = createDataLoader(fh);
+	return dl->startNative(tips, gitDir);
+}
+
+bool Git::startSharedRevList(const RepoSnapshotPtr& s) {
+/*
+   Main view loaded from the 'git log' output read by another window,
+   git is not run but the output is parsed again. The parsed commit
+   table is not shared: Rev objects point into the row data of their
+   own history, and lanes, children and row order are per window.
+*/
+	revData->keepLogStream = true; // to be shared again after this one
+	revData->logStream.clear();
+	DataLoader* dl = createDataLoader(revData);
+	return dl->startShared(s->logData());
+}
+
+bool Git::startDaemonRevList(SCList args) {
+// main view loaded from a running 'qgit --daemon', if any
+
+	LogRequest r;
+	r.workDir = workDir;
+	r.gitDir = gitDir;
+	r.cmd = revListCmd(true) + args;
+	r.refsKey = refsKey;
+
+	revData->keepLogStream = !revData->rowBlocks->isEnabled();
+	revData->logStream.clear();
+	DataLoader* dl = createDataLoader(revData);
+	return dl->startDaemon(r);
+}
+
+const QStringList Git::revListCmd(bool mainHistory) {
+// also used by log daemon, output must be the same
 
 	// we don't need log message body for file history
-	if (isMainHistory(fh))
-		baseCmd.append("%b");
+	QString baseCmd("git log --all --topo-order --boundary ");
+	if (mainHistory)
+		baseCmd.append(logFormatArgs<LogFormat<MAIN_LOG> >());
+	else
+		baseCmd.append(logFormatArgs<LogFormat<FILE_LOG> >());
+
+	return baseCmd.split(' ');
+}
 
-	QStringList initCmd(baseCmd.split(' '));
+bool Git::startRevList(SCList args, FileHistory* fh) {
+
+	// main view output is kept to be shared with other windows, but
+	// not when row data could be evicted, nor for the StGIT filter
+	if (isMainHistory(fh)) {
+		fh->keepLogStream = !fh->rowBlocks->isEnabled() && !isStGIT;
+		fh->logStream.clear();
+	}
+	// native reader handles only the plain whole history case,
+	// anything else, or any failure, falls back on 'git log'
+	if (   isMainHistory(fh) && args.isEmpty() && !isStGIT
+	    && testFlag(NATIVE_LOG_F) && startNativeRevList(fh))
+		return true;
+
+	QStringList initCmd(revListCmd(isMainHistory(fh)));
 	if (!isMainHistory(fh)) {
 	/*
 	   NOTE: we don't use '--remove-empty' option because
@@ -470,23 +563,45 @@ bool Git::startUnappliedList() {
 
 	// WARNING: with this command 'git log' could send spurious
 	// revs so we need some filter out logic during loading
-	QString cmd("git log --no-color --parents -z "
-
-#ifndef Q_OS_WIN32
-	            "--log-size " // FIXME broken on Windows
-#endif
-	            "--pretty=format:%m%HX%PX%n%an<%ae>%n%at%n%s%n%b ^HEAD");
+	QString cmd("git log " + logFormatArgs<LogFormat<UNAPPLIED_LOG> >() + " ^HEAD");
 
 	QStringList sl(cmd.split(' '));
 	sl << unAppliedShaList;
+	revData->keepLogStream = false;
 	return startParseProc(sl, revData, QString());
 }
 
+bool Git::startPreviewList(SCList args) {
+/*
+   With '--topo-order' git has to walk the whole history before
+   sending the first revision, so we first load with '--date-order'
+   just the revisions needed to fill the screen. In the common case
+   the two orders agree on the newest revisions, so the full load
+   that follows reuses them as in early output state, and replaces
+   only the ones from the first mismatch on.
+*/
+	if (isStGIT) // StGIT spurious revs filter would be confused
+		return false;
+
+	int cnt = QApplication::desktop()->height() / QFontMetrics(QGit::STD_FONT).height() + 1;
+
+	QString cmd("git log --all --date-order " + logFormatArgs<LogFormat<MAIN_LOG> >() + " -n");
+
+	QStringList initCmd(cmd.split(' '));
+	initCmd << QString::number(cnt);
+	revData->keepLogStream = false; // preview output is not complete
+	return startParseProc(initCmd + args, revData, QString());
+}
+
 void Git::stop(bool saveCache) {
 // normally called when changing directory or closing
 
 	EM_RAISE(exGitStopped);
 
+	// keep loaded data, the same repository could be opened again soon
+	const qint64 warmBudget = QSettings().value(WARM_MEM_KEY, WARM_MEM_DEF).toLongLong();
+	RepoRegistry::keepWarm(snapshot(), warmBudget * 1024 * 1024);
+
 	// stop all data sending from process and asks them
 	// to terminate. Note that process could still keep
 	// running for a while although silently
@@ -509,11 +624,19 @@ void Git::stop(bool saveCache) {
 				dbs("ERROR unable to save file names cache");
 		}
 	}
+	if (saveCache)
+		patchIds->save(gitDir); // only if changed
 }
 
 void Git::clearRevs() {
 
+	publishSnapshot(true); // readers should not see a half loaded repository
 	revData->clear();
+	reachability->clear();
+	historyOrder->clear();
+	equivalentRevs.clear();
+	treeIndexed = false;
+	loadingPreview = false;
 	patchesStillToFind = 0; // TODO TEST WITH FILTERING
 	firstNonStGitPatch = "";
 	workingDirInfo.clear();
@@ -522,13 +645,20 @@ void Git::clearRevs() {
 
 void Git::clearFileNames() {
 
-	qDeleteAll(revsFiles);
+	if (filesTask) // output would refer to old file names
+		filesTask->cancel();
+
+	// RevFile objects are deleted when no snapshot refers to them anymore
+	fileKeeper = QSharedPointer<RevFileKeeper>(new RevFileKeeper());
+	customFiles.clear();
 	revsFiles.clear();
 	fileNamesMap.clear();
 	dirNamesMap.clear();
 	dirNamesVec.clear();
 	fileNamesVec.clear();
 	revsFilesShaBackupBuf.clear();
+	knownPaths.clear();
+	knownPathsGen = -1;
 	cacheNeedsUpdate = false;
 }
 
@@ -556,14 +686,27 @@ bool Git::init(SCRef wd, const QStringList* passedArgs, bool overwriteArgs) {
 		bool repoChanged;
 		workDir = getBaseDir(&repoChanged, wd, &isGIT, &gitDir);
 
+		// commit-graph could have been rewritten since last time
+		delete commitGraph;
+		commitGraph = NULL;
+		delete packBitmaps;
+		packBitmaps = NULL;
+		reachability->clear();
+
 		if (repoChanged) {
 			localDates.clear();
+			annotate->clear();
+			if (!patchIds->load(gitDir))
+				dbs("ERROR: unable to load patch-ids");
 			clearFileNames();
 			fileCacheAccessed = false;
 
-			SHOW_MSG(msg1 + "file names cache...");
-			loadFileCache();
-			SHOW_MSG("");
+			// another window could have already loaded them
+			if (!adoptFileNames(RepoRegistry::lookup(gitDir))) {
+				SHOW_MSG(msg1 + "file names cache...");
+				loadFileCache();
+				SHOW_MSG("");
+			}
 		}
 		if (!isGIT) {
 			setThrowOnStop(false);
@@ -572,7 +715,8 @@ bool Git::init(SCRef wd, const QStringList* passedArgs, bool overwriteArgs) {
 		if (!passedArgs) {
 
 			// update text codec according to repo settings
-//			QTextCodec::setCodecForCStrings(getTextCodec(&dummy)); //FIXME: no longer available
+			bool dummy;
+			setRevTextCodec(getTextCodec(&dummy));
 
 			// load references
 			SHOW_MSG(msg1 + "refs...");
@@ -631,15 +775,25 @@ void Git::init2() {
 
 		SHOW_MSG(msg1 + "revisions...");
 
-		// build up command line arguments
-		QStringList args(loadArguments.args);
-		if (loadArguments.filteredLoading) {
-			if (!args.contains("--"))
-				args << "--";
-
-			args << loadArguments.filterList;
+		// same repository, arguments and refs of another window, its
+		// 'git log' output is parsed again, no need to run git
+		const QStringList args(revListArgs());
+		const RepoSnapshotPtr s(RepoRegistry::lookup(gitDir));
+		if (   s && !isStGIT && !s->logData().isEmpty()
+		    && s->loadArgs() == args && s->refsFingerprint() == refsKey
+		    && startSharedRevList(s)) {
+			setThrowOnStop(false);
+			return;
+		}
+		// or a daemon could have it, same check on its side
+		if (!isStGIT && startDaemonRevList(args)) {
+			setThrowOnStop(false);
+			return;
 		}
-		if (!startRevList(args, revData))
+		// paint first screen as soon as possible, see on_loaded()
+		loadingPreview = startPreviewList(args);
+
+		if (!loadingPreview && !startRevList(args, revData))
 			SHOW_MSG("ERROR: unable to start 'git log'");
 
 		setThrowOnStop(false);
@@ -659,6 +813,19 @@ void Git::init2() {
 	}
 }
 
+const QStringList Git::revListArgs() const {
+// build up command line arguments
+
+	QStringList args(loadArguments.args);
+	if (loadArguments.filteredLoading) {
+		if (!args.contains("--"))
+			args << "--";
+
+		args << loadArguments.filterList;
+	}
+	return args;
+}
+
 void Git::on_newDataReady(const FileHistory* fh) {
 
 	emit newRevsAdded(fh , fh->revOrder);
@@ -671,11 +838,21 @@ void Git::on_loaded(FileHistory* fh, ulong byteSize, int loadTime,
 		MainExecErrorEvent* e = new MainExecErrorEvent(cmd, errorDesc);
 		QApplication::postEvent(parent(), e);
 	}
+	bool isPreview = (loadingPreview && isMainHistory(fh));
+
 	if (normalExit) { // do not send anything if killed
 
+		if (!isPreview && fh->earlyOutputCnt != -1) {
+			// loading ended before all the early output revisions
+			// have been received again, they are stale, remove them
+			if (fh->earlyOutputCnt < fh->revOrder.count())
+				fh->flushTail(fh->earlyOutputCnt);
+
+			fh->setEarlyOutputState(false);
+		}
 		on_newDataReady(fh);
 
-		if (!loadingUnAppliedPatches) {
+		if (!loadingUnAppliedPatches && !isPreview) {
 
 			fh->loadTime += loadTime;
 
@@ -686,15 +863,34 @@ void Git::on_loaded(FileHistory* fh, ulong byteSize, int loadTime,
 			            "time elapsed: %i ms  (%.2f MB/s)",
 			            fh->revs.count(), kb, fh->loadTime, mbs);
 
+			if (fh->rowBlocks->isEnabled())
+				tmp.append(",   " + fh->rowBlocks->report());
+
 			if (!tryFollowRenames(fh))
 				emit loadCompleted(fh, tmp);
 
-			if (isMainHistory(fh))
+			if (isMainHistory(fh)) {
+				publishSnapshot();
+				if (fh->order != orderType)
+					applyHistoryOrder(); // publishes again, with rows moved
+
+				startPatchIds();
+
 				// wait the dust to settle down before to start
 				// background file names loading for new revisions
 				QTimer::singleShot(500, this, SLOT(loadFileNames()));
+			}
 		}
 	}
+	if (isPreview && normalExit) {
+		loadingPreview = false;
+		fh->loadTime += loadTime;
+
+		// now the real thing, already shown revisions are reused
+		fh->setEarlyOutputState(true);
+		if (!startRevList(revListArgs(), fh))
+			SHOW_MSG("ERROR: unable to start 'git log'");
+	}
 	if (loadingUnAppliedPatches) {
 		loadingUnAppliedPatches = false;
 		revData->lns->clear(); // again to reset lanes
@@ -702,6 +898,171 @@ void Git::on_loaded(FileHistory* fh, ulong byteSize, int loadTime,
 	}
 }
 
+void Git::publishSnapshot(bool empty) {
+/*
+   Called in GUI thread once main view data is complete. Containers
+   are copied by reference, Git detaches its own ones when changing
+   them later. Revisions are stored by row so that readers do not
+   need Rev objects, that belong to the main view and are changed
+   while lanes are computed. The swap is the only locked part,
+   readers holding the previous snapshot are not affected.
+*/
+	RepoSnapshot* s = new RepoSnapshot();
+	s->gen = ++snapshotGen;
+	s->dir = gitDir;
+	s->firstParent.append(0);
+
+	if (!empty) {
+		const FileHistory* fh = revData;
+		const ShaVect& ro = fh->revOrder;
+		s->args = revListArgs();
+
+		s->shaBuf.reserve(41 * ro.count());
+		FOREACH (ShaVect, it, ro) // shas are always 40 chars long
+			s->shaBuf.append(it->latin1(), 40).append('\0');
+
+		const char* shas = s->shaBuf.constData();
+		s->rowOf.reserve(ro.count());
+		s->authorIds.reserve(ro.count());
+		s->authorTimes.reserve(ro.count());
+		for (int i = 0; i < ro.count(); i++) {
+
+			s->rowOf.insert(ShaString(shas + 41 * i), i);
+			const Rev* r = revLookup(ro[i], fh);
+			for (uint j = 0; r && j < r->parentsCount(); j++) {
+				const Rev* p = revLookup(r->parent(j), fh);
+				s->parents.append(p ? p->orderIdx : -1);
+			}
+			s->firstParent.append(s->parents.count());
+			s->authorIds.append(r ? r->authorId : -1);
+			s->authorTimes.append(r ? r->authorTime() : 0);
+		}
+		s->authorNames = fh->identities().allNames();
+
+		FOREACH (RefMap, it, refsShaMap)
+			s->refMap.insert(QByteArray(it.key().latin1()), *it);
+
+		// RevFile being filled by file names loading is not ready
+		s->revFiles = revsFiles;
+		if (!filesLoadingCurSha.isEmpty())
+			s->revFiles.remove(toTempSha(filesLoadingCurSha));
+
+		s->revFilesShaBuf = revsFilesShaBackupBuf;
+		s->keeper = fileKeeper;
+		s->dirNames = dirNamesVec;
+		s->fileNames = fileNamesVec;
+
+		s->refsKey = refsKey;
+		if (fh->keepLogStream)
+			s->rawLog = fh->logStream;
+	}
+	RepoSnapshotPtr p(s);
+	RepoRegistry::publish(p);
+	QMutexLocker lock(&snapshotMutex);
+	curSnapshot.swap(p);
+}
+
+bool Git::setHistoryOrder(OrderType type) {
+// requested order is kept for next loads, see on_loaded()
+
+	orderType = type;
+	return (revData->order == type || applyHistoryOrder());
+}
+
+static void remapRows(QVector<int>& v, const QVector<int>& newRow) {
+
+	for (int i = 0; i < v.count(); i++)
+		if (v.at(i) >= 0)
+			v[i] = newRow.at(v.at(i));
+}
+
+static void remapRow(int& idx, const QVector<int>& newRow) {
+
+	if (idx >= 0)
+		idx = newRow.at(idx);
+}
+
+bool Git::applyHistoryOrder() {
+/*
+   Rows of main view are moved in memory, without running git again.
+   Parent rows and author times are taken once from the snapshot
+   published at the end of loading, when rows are still in loading
+   order, then each change of order translates every index by row:
+   Rev order, children, nearest refs and branches. Lanes are computed
+   again on demand, as after a load.
+*/
+	FileHistory* fh = revData;
+	const ShaVect& ro = fh->revOrder;
+	if (fh->loadOrder.isEmpty()) {
+
+		const RepoSnapshotPtr s(snapshot());
+		if (ro.isEmpty() || s->count() != ro.count())
+			return false; // still loading, order is applied in on_loaded()
+
+		indexTree(); // children and nearest refs walk rows in loading order
+
+		int pinned = 0;
+		while (pinned < ro.count()) {
+			const Rev* r = revLookup(ro[pinned], fh);
+			if (!r->isDiffCache && !r->isUnApplied)
+				break;
+			pinned++;
+		}
+		historyOrder->setGraph(s->firstParent, s->parents, s->authorTimes, pinned);
+		fh->loadOrder = ro;
+	}
+	const QVector<int> rows(historyOrder->rows(orderType));
+	if (rows.count() != ro.count())
+		return false;
+
+	ShaVect newOrder(rows.count());
+	QVector<int> newRow(rows.count());
+	for (int i = 0; i < rows.count(); i++) {
+		newOrder[i] = fh->loadOrder.at(rows.at(i));
+		newRow[revLookup(newOrder[i], fh)->orderIdx] = i;
+	}
+	for (int i = 0; i < newOrder.count(); i++) {
+
+		Rev* r = const_cast<Rev*>(revLookup(newOrder[i], fh));
+		r->orderIdx = i;
+		remapRows(r->childs, newRow);
+		remapRows(r->descRefs, newRow);
+		remapRows(r->ancRefs, newRow);
+		remapRows(r->descBranches, newRow);
+		remapRow(r->descRefsMaster, newRow);
+		remapRow(r->ancRefsMaster, newRow);
+		remapRow(r->descBrnMaster, newRow);
+
+		if (!r->isDiffCache && !r->isUnApplied) // preset lanes are kept
+			r->lanes.clear();
+	}
+	fh->setRevOrder(newOrder, orderType);
+	reachability->clear();
+	publishSnapshot();
+	emit historyReordered();
+	return true;
+}
+
+bool Git::adoptFileNames(const RepoSnapshotPtr& s) {
+/*
+   Start from the file names data of another window on the same
+   repository instead of reading the cache. RevFile objects are
+   never changed once stored, so they are shared, and new ones of
+   both windows go in the same keeper.
+*/
+	if (!s || s->keeper.isNull())
+		return false;
+
+	fileCacheAccessed = true; // cache data is already in there
+	fileKeeper = s->keeper;
+	revsFiles = s->revFiles;
+	revsFilesShaBackupBuf = s->revFilesShaBuf;
+	dirNamesVec = s->dirNames;
+	fileNamesVec = s->fileNames;
+	populateFileNamesMap();
+	return true;
+}
+
 bool Git::tryFollowRenames(FileHistory* fh) {
 
 	if (isMainHistory(fh))
@@ -710,7 +1071,7 @@ bool Git::tryFollowRenames(FileHistory* fh) {
 	QStringList oldNames;
 	QMutableStringListIterator it(fh->renamedRevs);
 	while (it.hasNext())
-		if (!populateRenamedPatches(it.next(), fh->curFNames, fh, &oldNames, false))
+		if (!populateRenamedPatches(it.next(), fh->curFNames, fh, &oldNames))
 			it.remove();
 
 	if (fh->renamedRevs.isEmpty())
@@ -724,22 +1085,19 @@ bool Git::tryFollowRenames(FileHistory* fh) {
 	return startRevList(args, fh);
 }
 
-bool Git::populateRenamedPatches(SCRef renamedSha, SCList newNames, FileHistory* fh,
-                                 QStringList* oldNames, bool backTrack) {
-
-	QString runOutput;
-	if (!run("git diff-tree -r -M " + renamedSha, &runOutput))
-		return false;
+const QString Git::renameLine(SCRef diffTree, SCList newNames, bool backTrack) {
+// 'git diff-tree -M' output line of the first file renamed to one
+// of newNames, or an empty string if none of them has been renamed
 
 	// find the first renamed file with the new file name in renamedFiles list
 	QString line;
 	FOREACH_SL (it, newNames) {
 		if (backTrack) {
-			line = runOutput.section('\t' + *it + '\t', 0, 0,
-			                         QString::SectionIncludeTrailingSep);
+			line = diffTree.section('\t' + *it + '\t', 0, 0,
+			                        QString::SectionIncludeTrailingSep);
 			line.chop(1);
 		} else
-			line = runOutput.section('\t' + *it + '\n', 0, 0);
+			line = diffTree.section('\t' + *it + '\n', 0, 0);
 
 		if (!line.isEmpty())
 			break;
@@ -748,14 +1106,30 @@ bool Git::populateRenamedPatches(SCRef renamedSha, SCList newNames, FileHistory*
 		line = line.section('\n', -1, -1);
 
 	SCRef status = line.section('\t', -2, -2).section(' ', -1, -1);
-	if (!status.startsWith('R'))
+	return (status.startsWith('R') ? line : "");
+}
+
+const QString Git::renamedFrom(SCRef diffTree, SCRef newName) {
+
+	SCRef line = renameLine(diffTree, QStringList(newName), true);
+	if (line.isEmpty())
+		return "";
+
+	SCRef nextFile = diffTree.section(line, 1, 1).section('\t', 1, 1);
+	return nextFile.section('\n', 0, 0);
+}
+
+bool Git::populateRenamedPatches(SCRef renamedSha, SCList newNames, FileHistory* fh,
+                                 QStringList* oldNames) {
+
+	QString runOutput;
+	if (!run("git diff-tree -r -M " + renamedSha, &runOutput))
+		return false;
+
+	SCRef line = renameLine(runOutput, newNames, false);
+	if (line.isEmpty())
 		return false;
 
-	if (backTrack) {
-		SCRef nextFile = runOutput.section(line, 1, 1).section('\t', 1, 1);
-		oldNames->append(nextFile.section('\n', 0, 0));
-		return true;
-	}
 	// get the diff betwen two files
 	SCRef prevFileSha = line.section(' ', 2, 2);
 	SCRef lastFileSha = line.section(' ', 3, 3);
@@ -797,6 +1171,9 @@ void Git::loadFileCache() {
 			populateFileNamesMap();
 		} else
 			dbs("ERROR: unable to load file names cache");
+
+		FOREACH (RevFileMap, it, revsFiles)
+			fileKeeper->add(*it);
 	}
 }
 
@@ -837,7 +1214,8 @@ bool Git::filterEarlyOutputRev(FileHistory* fh, Rev* rev) {
 				// mismatch found! set correct value, 'rev' will
 				// overwrite 'c' upon returning
 				rev->orderIdx = c->orderIdx;
-				revData->clear(false); // flush the tail
+				reachability->clear();
+				fh->clear(false); // flush the tail
 			} else
 				return true; // filter out 'rev'
 		}
@@ -847,15 +1225,19 @@ bool Git::filterEarlyOutputRev(FileHistory* fh, Rev* rev) {
 	return false;
 }
 
-int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
+int Git::addChunk(FileHistory* fh, const RowBlock& ba, int start) {
 
 	RevMap& r = fh->revs;
 	int nextStart;
 	Rev* rev;
 
+	LogFormatId fmt = FILE_LOG;
+	if (isMainHistory(fh))
+		fmt = (loadingUnAppliedPatches ? UNAPPLIED_LOG : MAIN_LOG);
+
 	do {
 		// only here we create a new rev
-		rev = new Rev(ba, start, fh->revOrder.count(), &nextStart, !isMainHistory(fh));
+		rev = new Rev(ba, start, fh->revOrder.count(), &nextStart, fmt);
 
 		if (nextStart == -2) {
 			delete rev;
@@ -955,6 +1337,9 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
 		if (rev->parentsCount() == 0 && !isMainHistory(fh))
 			fh->renamedRevs.append(sha);
 	}
+	rev->authorId = fh->idents.intern(rev->rawAuthor(), fh->revTexts.codec());
+	rev->committerId = fh->idents.intern(rev->rawCommitter(), fh->revTexts.codec());
+
 	if (isStGIT) {
 		// updateLanes() is called too late, after loadingUnAppliedPatches
 		// has been reset so update the lanes now.
@@ -1007,37 +1392,141 @@ bool Git::copyDiffIndex(FileHistory* fh, SCRef parent) {
 }
 
 void Git::setLane(SCRef sha, FileHistory* fh) {
-
+/*
+   Lanes are computed top down, when rows are shown for the first
+   time. On huge histories keeping them for every row costs a lot,
+   so only the last used pages of rows keep their lanes, while the
+   Lanes state at the start of each page is saved as a checkpoint.
+   An evicted page is then computed again from its checkpoint.
+*/
+	const Rev* target = revLookup(sha, fh);
+	if (target && target->orderIdx < int(fh->firstFreeLane)) {
+		restoreLanesPage(fh, target->orderIdx / LANES_PAGE_SIZE);
+		return;
+	}
 	Lanes* l = fh->lns;
 	uint i = fh->firstFreeLane;
+	int firstPage = i / LANES_PAGE_SIZE;
 	QVector<QByteArray> ba;
 	const ShaString& ss = toPersistentSha(sha, ba);
 	const ShaVect& shaVec(fh->revOrder);
 
 	for (uint cnt = shaVec.count(); i < cnt; ++i) {
 
+		if (int(i / LANES_PAGE_SIZE) >= fh->lanesCkpt.count()) {
+			fh->lanesCkpt.append(new Lanes(*l));
+			fh->lanesCkptRow.append(i);
+		}
 		const ShaString& curSha = shaVec[i];
 		Rev* r = const_cast<Rev*>(revLookup(curSha, fh));
 		if (r->lanes.count() == 0)
-			updateLanes(*r, *l, curSha);
+			updateLanes(*r, *l, curSha, fh);
+		else
+			fh->lanesPreset.insert(i);
+
+		recordLaneSegments(fh, i, r->lanes);
 
 		if (curSha == ss)
 			break;
 	}
 	fh->firstFreeLane = ++i;
+
+	for (int p = firstPage, last = (i - 1) / LANES_PAGE_SIZE; p <= last; p++)
+		touchLanesPage(fh, p);
 }
 
-void Git::updateLanes(Rev& c, Lanes& lns, SCRef sha) {
+void Git::recordLaneSegments(FileHistory* fh, int row, const QVector<int>& lanes) {
+/*
+   For each lane we keep, in row order, the segments where it is
+   owned by the same commit: a segment starts where a commit takes
+   the lane and ends where another one takes it or where the lane
+   becomes free. So entries are about one per commit, not one per
+   row and lane, and the owner of a lane at any row is found with
+   a binary search, see getLaneParent(). Rows are recorded once,
+   when lanes are first computed, pages computed again are not.
+*/
+	QVector<QVector<LaneSegment> >& ls = fh->laneSegments;
+	const int cnt = lanes.count();
+	if (ls.count() < cnt)
+		ls.resize(cnt);
+
+	for (int i = 0, last = qMax(cnt, fh->lastLanesCnt); i < last; i++) {
+
+		int t = (i < cnt ? lanes[i] : EMPTY);
+		bool ends = (t == EMPTY || t == CROSS_EMPTY);
+		bool owned = (!ends && !isFreeLane(t));
+		if (!ends && !owned) // lane goes on with the same owner
+			continue;
+
+		QVector<LaneSegment>& s = ls[i];
+		if (!s.isEmpty() && s.last().end == -1)
+			s.last().end = row;
+
+		if (owned)
+			s.append(LaneSegment(row));
+	}
+	fh->lastLanesCnt = cnt;
+}
+
+void Git::restoreLanesPage(FileHistory* fh, int page) {
+
+	if (page >= fh->lanesCkpt.count())
+		return;
+
+	Lanes l(*fh->lanesCkpt.at(page));
+	const ShaVect& shaVec(fh->revOrder);
+	int end = qMin((page + 1) * LANES_PAGE_SIZE, int(fh->firstFreeLane));
+
+	for (int i = fh->lanesCkptRow.at(page); i < end; i++)
+		if (!fh->lanesPreset.contains(i)) {
+			Rev* r = const_cast<Rev*>(revLookup(shaVec[i], fh));
+			updateLanes(*r, l, shaVec[i], fh);
+		}
+
+	touchLanesPage(fh, page);
+}
+
+void Git::touchLanesPage(FileHistory* fh, int page) {
+// evict least recently used pages, but never the last one
+
+	QList<int>& lru = fh->lanesPages;
+	lru.removeOne(page);
+	lru.append(page);
+
+	while (lru.count() > MAX_LANES_PAGES) {
+
+		int p = lru.takeFirst();
+		int end = qMin((p + 1) * LANES_PAGE_SIZE, int(fh->firstFreeLane));
+		for (int i = p * LANES_PAGE_SIZE; i < end; i++)
+			if (!fh->lanesPreset.contains(i)) {
+				Rev* r = const_cast<Rev*>(revLookup(fh->revOrder[i], fh));
+				r->lanes.clear();
+			}
+	}
+}
+
+void Git::updateLanes(Rev& c, Lanes& lns, SCRef sha, const FileHistory* fh) {
 // we could get third argument from c.sha(), but we are in fast path here
 // and c.sha() involves a deep copy, so we accept a little redundancy
 
 	if (lns.isEmpty())
 		lns.init(sha);
 
+	// oldest first, lanes go down from a revision to its children
+	const bool isReversed = (fh->order == REVERSE_ORDER);
+	QStringList down;
+	if (isReversed) {
+		const QVector<int> childs(getChildsIdx(c.orderIdx));
+		FOREACH (QVector<int>, it, childs)
+			if (*it > c.orderIdx) // pinned rows are on top
+				down.append(fh->revOrder[*it]);
+	}
+	int parentsCnt = (isReversed ? down.count() : int(c.parentsCount()));
+
 	bool isDiscontinuity;
 	bool isFork = lns.isFork(sha, isDiscontinuity);
-	bool isMerge = (c.parentsCount() > 1);
-	bool isInitial = (c.parentsCount() == 0);
+	bool isMerge = (parentsCnt > 1);
+	bool isInitial = (parentsCnt == 0);
 
 	if (isDiscontinuity)
 		lns.changeActiveLane(sha); // uses previous isBoundary state
@@ -1047,7 +1536,7 @@ void Git::updateLanes(Rev& c, Lanes& lns, SCRef sha) {
 	if (isFork)
 		lns.setFork(sha);
 	if (isMerge)
-		lns.setMerge(c.parents());
+		lns.setMerge(isReversed ? down : c.parents());
 	if (c.isApplied)
 		lns.setApplied();
 	if (isInitial)
@@ -1055,7 +1544,7 @@ void Git::updateLanes(Rev& c, Lanes& lns, SCRef sha) {
 
 	lns.getLanes(c.lanes); // here lanes are snapshotted
 
-	SCRef nextSha = (isInitial) ? "" : QString(c.parent(0));
+	SCRef nextSha = (isInitial) ? "" : (isReversed ? down.first() : QString(c.parent(0)));
 
 	lns.nextParent(nextSha);
 
@@ -1081,6 +1570,7 @@ void Git::procFinished() {
 	flushFileNames(fileLoader);
 	filesLoadingPending = filesLoadingCurSha = "";
 	emit fileNamesLoad(1, revsFiles.count() - filesLoadingStartOfs);
+	publishSnapshot();
 }
 
 void Git::procReadyRead(const QByteArray& fileChunk) {
@@ -1103,6 +1593,7 @@ void Git::procReadyRead(const QByteArray& fileChunk) {
 			SCRef sha = line.left(40);
 			if (!rf || sha != filesLoadingCurSha) { // new commit
 				rf = new RevFile();
+				fileKeeper->add(rf);
 				revsFiles.insert(toPersistentSha(sha, revsFilesShaBackupBuf), rf);
 				filesLoadingCurSha = sha;
 				cacheNeedsUpdate = true;
@@ -1288,11 +1779,14 @@ void Git::mergeNearTags(bool down, Rev* p, const Rev* r, const QHash<QPair<uint,
 }
 
 void Git::indexTree() {
+// once per load and before any change of rows order, see applyHistoryOrder()
 
 	const ShaVect& ro = revData->revOrder;
-	if (ro.count() == 0)
+	if (ro.count() == 0 || treeIndexed)
 		return;
 
+	treeIndexed = true;
+
 	// we keep the pairs(x, y). Value is true if x is
 	// ancestor of y or false if y is ancestor of x
 	QHash<QPair<uint, uint>, bool> descMap;
@@ -1366,38 +1860,184 @@ void Git::indexTree() {
 
 // ********************************* Rev **************************
 
+struct RevText { // decoded text of a Rev, valid while its row data is
+	RevText(const RowBlock* b, int s) : block(b), start(s), done(0) {}
+
+	const RowBlock* block;
+	int start;
+	uint done;
+	QString fields[Rev::TEXT_FIELDS];
+};
+
+RevTexts::RevTexts() : cache(REV_TEXT_CACHE), textCodec(NULL) {
+
+	owner = QThread::currentThread();
+}
+
+RevTexts::~RevTexts() {}
+
+void RevTexts::clear() {
+
+	cache.clear();
+}
+
+void RevTexts::setCodec(QTextCodec* tc) {
+
+	// called by the owner thread, tasks just load the pointer
+	textCodec.store(tc);
+	cache.clear();
+}
+
+static bool isAscii(const char* data, int len) {
+/*
+   Almost all commit metadata is plain ASCII, so check for a byte
+   with the high bit set 16 bytes at a time, or a word at a time
+   without SSE2, before to pay for a real decoding.
+*/
+	int i = 0;
+#ifdef __SSE2__
+	for ( ; i + 16 <= len; i += 16)
+		if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))))
+			return false;
+#else
+	for ( ; i + 8 <= len; i += 8) {
+		quint64 w;
+		memcpy(&w, data + i, 8);
+		if (w & Q_UINT64_C(0x8080808080808080))
+			return false;
+	}
+#endif
+	for ( ; i < len; i++)
+		if (data[i] & 0x80)
+			return false;
+
+	return true;
+}
+
+static const QString decodeText(const char* data, int len, QTextCodec* tc) {
+
+	if (isAscii(data, len))
+		return QString::fromLatin1(data, len);
+
+	if (tc)
+		return tc->toUnicode(data, len);
+
+	// old commits of an UTF-8 repository could be in another
+	// encoding, show them as Latin1 instead of garbage
+	static QTextCodec* utf8 = QTextCodec::codecForMib(106);
+	QTextCodec::ConverterState st;
+	const QString s(utf8->toUnicode(data, len, &st));
+	return (st.invalidChars ? QString::fromLatin1(data, len) : s);
+}
+
 const QString Rev::mid(int start, int len) const {
 
 	// warning no sanity check is done on arguments
-	const char* data = ba.constData();
-    return QString::fromLatin1(data + start, len);
+	QTextCodec* tc = (ba.texts ? ba.texts->codec() : NULL);
+	if (!ba.mgr)
+		return decodeText(ba.constData() + start, len, tc);
+
+	// a shared copy, data could be evicted meanwhile, also by
+	// the GUI thread if we are called by a task
+	const QByteArray d(ba.mgr->dataOf(ba));
+	return decodeText(d.constData() + start, len, tc);
+}
+
+const QString Rev::text(TextField f, int ofs, int len) const {
+/*
+   Views ask for the same fields of the visible revisions at each
+   repaint, so keep them decoded. A Rev could be deleted and another
+   one allocated at the same address, entries are checked against
+   row data position, that cannot be reused before the history is
+   cleared, and the cache with it.
+
+   Each history has its own cache, used only from the thread that
+   created it, the GUI one. Accessors called by tasks just decode.
+*/
+	RevTexts* c = ba.texts;
+	if (!c || QThread::currentThread() != c->owner)
+		return mid(ofs, len);
+
+	RevText* t = c->cache.object(this);
+	if (!t || t->block != &ba || t->start != start) {
+		t = new RevText(&ba, start);
+		c->cache.insert(this, t);
+	}
+	if (!(t->done & (1 << f))) {
+		t->fields[f] = mid(ofs, len);
+		t->done |= (1 << f);
+	}
+	return t->fields[f];
 }
 
-const QString Rev::midSha(int start, int len) const {
+const QByteArray Rev::rawData(int ofs, int len) const {
 
-	// warning no sanity check is done on arguments
-	const char* data = ba.constData();
-	return QString::fromLatin1(data + start, len); // faster then formAscii
+	// no copy, valid until row data is evicted, that happens
+	// only in the GUI thread, so tasks get a real copy
+	if (ba.mgr && !ba.mgr->isOwnerThread())
+		return ba.mgr->dataOf(ba).mid(ofs, len);
+
+	ba.touch();
+	return QByteArray::fromRawData(ba.constData() + ofs, len);
 }
 
-const ShaString Rev::parent(int idx) const {
+const char* Rev::keepShaLine() const {
+/*
+   Sha and parents are used as keys all around, so when row data
+   could be evicted the sha line, with the boundary information in
+   front, is copied where it stays resident. The copy is small,
+   41 bytes each sha.
+*/
+	const char* line = ba.constData() + shaStart;
+	if (!ba.mgr)
+		return line;
 
-	return ShaString(ba.constData() + shaStart + 41 + 41 * idx);
+	return ba.mgr->keepShaLine(line - 1, 41 * (parentsCnt + 1) + 1) + 1;
 }
 
 const QStringList Rev::parents() const {
 
 	QStringList p;
-	int idx = shaStart + 41;
+	for (int i = 0; i < parentsCnt; i++)
+		p.append(QString::fromLatin1(parent(i).latin1(), 40));
 
-	for (int i = 0; i < parentsCnt; i++) {
-		p.append(midSha(idx, 40));
-		idx += 41;
-	}
 	return p;
 }
 
-int Rev::indexData(bool quick, bool withDiff) const {
+int Identities::intern(const QByteArray& raw, QTextCodec* tc) {
+
+	QHash<QByteArray, int>::const_iterator it(ids.constFind(raw));
+	if (it != ids.constEnd())
+		return *it;
+
+	// a deep copy, raw data could be evicted
+	int id = names.count();
+	ids.insert(QByteArray(raw.constData(), raw.size()), id);
+	names.append(decodeText(raw.constData(), raw.size(), tc));
+	return id;
+}
+
+void Identities::recode(QTextCodec* tc) {
+
+	QHash<QByteArray, int>::const_iterator it(ids.constBegin());
+	for ( ; it != ids.constEnd(); ++it)
+		names[*it] = decodeText(it.key().constData(), it.key().size(), tc);
+}
+
+int Rev::indexData(bool quick) const {
+// the only runtime dispatch, once per record
+
+	switch (fmt) {
+	case FILE_LOG:
+		return parseRecord<LogFormat<FILE_LOG> >(quick);
+	case UNAPPLIED_LOG:
+		return parseRecord<LogFormat<UNAPPLIED_LOG> >(quick);
+	default:
+		return parseRecord<LogFormat<MAIN_LOG> >(quick);
+	}
+}
+
+template <class F> int Rev::parseRecord(bool quick) const {
 /*
   This is what 'git log' produces:
 
@@ -1414,6 +2054,7 @@ int Rev::indexData(bool quick, bool withDiff) const {
 	- zero or more lines with diff content (only for file history)
 	- a terminating '\0'
 */
+	ba.touch();
 	const int last = ba.size() - 1;
 	int logSize = 0, idx = start;
 	int logEnd, revEnd;
@@ -1425,7 +2066,7 @@ int Rev::indexData(bool quick, bool withDiff) const {
 	if (start + 42 > last) // at least sha + 'X' + 'X' + '\n' + must be present
 		return -1;
 
-	if (data[start] == 'F') // "Final output", let caller handle this
+	if (F::earlyOutput && data[start] == 'F') // "Final output", let caller handle this
 		return (ba.indexOf('\n', start) != -1 ? -2 : -1);
 
 	// parse log size if present
@@ -1470,7 +2111,7 @@ int Rev::indexData(bool quick, bool withDiff) const {
 	++idx; // now points to the trailing '\n' of sha line
 
 	// check for !msgSize
-	if (withDiff || !logSize) {
+	if (F::withDiff || !logSize) {
 
 		revEnd = (logEnd > idx) ? logEnd - 1: idx;
 		do { // search for "\n\0" to handle (rare) cases of '\0'
@@ -1488,11 +2129,6 @@ int Rev::indexData(bool quick, bool withDiff) const {
 		return -1;
 
 	// ok, now revEnd is valid but logEnd could be not if !logSize
-	// in case of diff we are sure content will be consumed so
-	// we go all the way
-	if (quick && !withDiff)
-		return ++revEnd;
-
 	comStart = ++idx;
 	idx = ba.indexOf('\n', idx); // committer line end
 	if (idx == -1) {
@@ -1507,10 +2143,20 @@ int Rev::indexData(bool quick, bool withDiff) const {
 		return -1;
 	}
 	autDateStart = ++idx;
-	idx += 11; // date length + trailing '\n'
+	autTime = 0;
+	while (data[idx] >= '0' && data[idx] <= '9')
+		autTime = autTime * 10 + data[idx++] - '0';
+
+	idx = autDateStart + 11; // date length + trailing '\n'
+
+	// identities are interned at loading, so we stop here. In
+	// case of diff we are sure content will be consumed so we
+	// go all the way
+	if (quick && !F::withDiff)
+		return ++revEnd;
 
 	diffStart = diffLen = 0;
-	if (withDiff) {
+	if (F::withDiff) {
 		diffStart = logSize ? logEnd : ba.indexOf("\ndiff ", idx);
 
 		if (diffStart != -1 && diffStart < revEnd)
@@ -0,0 +1,167 @@
+#include "historyorder.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include <QtConcurrentMap>
+
+#include "common.h"
+
+using namespace QGit;
+
+static const int SORT_CHUNK = 65536; // rows sorted by a single map call
+
+struct NewerFirst { // loading order among revisions with the same date
+
+    explicit NewerFirst(const uint* t) : times(t) {}
+    bool operator()(int a, int b) const {
+        return (times[a] != times[b] ? times[a] > times[b] : a < b);
+    }
+    const uint* times;
+};
+
+struct SortChunk {
+    typedef void result_type;
+
+    SortChunk(int* r, int c, const uint* t) : rows(r), cnt(c), times(t) {}
+    void operator()(int first) const {
+        std::sort(rows + first, rows + qMin(first + SORT_CHUNK, cnt), NewerFirst(times));
+    }
+    int* rows;
+    int cnt;
+    const uint* times;
+};
+
+struct MergeRuns {
+    typedef void result_type;
+
+    MergeRuns(int* r, int c, int w, const uint* t) : rows(r), cnt(c), width(w), times(t) {}
+    void operator()(int first) const {
+        std::inplace_merge(rows + first, rows + first + width,
+                           rows + qMin(first + 2 * width, cnt), NewerFirst(times));
+    }
+    int* rows;
+    int cnt;
+    int width;
+    const uint* times;
+};
+
+void HistoryOrder::clear() {
+
+    pinned = 0;
+    firstParent.clear();
+    parentRows.clear();
+    times.clear();
+}
+
+void HistoryOrder::setGraph(const QVector<int>& fp, const QVector<int>& pr,
+                            const QVector<uint>& t, int pinnedRows) {
+    firstParent = fp;
+    parentRows = pr;
+    times = t;
+    pinned = qBound(0, pinnedRows, t.count());
+}
+
+const QVector<int> HistoryOrder::rows(int orderType) const {
+
+    const int cnt = times.count();
+    if (orderType == DATE_ORDER) {
+        const QVector<int> res(dateOrder());
+        if (res.count() == cnt)
+            return res;
+
+        dbs("ASSERT in HistoryOrder::rows, parent rows are not a graph");
+    }
+    QVector<int> res;
+    res.reserve(cnt);
+    for (int r = 0; r < pinned; r++)
+        res.append(r);
+
+    if (orderType == REVERSE_ORDER)
+        for (int r = cnt - 1; r >= pinned; r--)
+            res.append(r);
+    else
+        for (int r = pinned; r < cnt; r++)
+            res.append(r);
+
+    return res;
+}
+
+const QVector<int> HistoryOrder::byDate() const {
+/*
+   Rows not pinned, newest first. Chunks are sorted on all the cores,
+   then sorted runs are merged in pairs, again in parallel, until a
+   single run is left.
+*/
+    const int cnt = times.count();
+    QVector<int> res;
+    res.reserve(cnt - pinned);
+    for (int r = pinned; r < cnt; r++)
+        res.append(r);
+
+    int* rows = res.data();
+    const int n = res.count();
+    QVector<int> chunks;
+    for (int i = 0; i < n; i += SORT_CHUNK)
+        chunks.append(i);
+
+    QtConcurrent::blockingMap(chunks, SortChunk(rows, n, times.constData()));
+
+    for (int w = SORT_CHUNK; w < n; w *= 2) {
+        QVector<int> runs;
+        for (int i = 0; i + w < n; i += 2 * w)
+            runs.append(i);
+
+        QtConcurrent::blockingMap(runs, MergeRuns(rows, n, w, times.constData()));
+    }
+    return res;
+}
+
+const QVector<int> HistoryOrder::dateOrder() const {
+/*
+   As 'git log --author-date-order': newest first, but a revision is
+   shown only after all its children. Next one is taken among the
+   revisions with no children left to show, by its position in date
+   order, so the heap holds plain ints instead of (date, row) pairs.
+*/
+    const int cnt = times.count();
+    const QVector<int> dates(byDate());
+    QVector<int> pos(cnt, -1);
+    for (int i = 0; i < dates.count(); i++)
+        pos[dates.at(i)] = i;
+
+    // children still to show, pinned ones do not count
+    QVector<int> childs(cnt, 0);
+    for (int r = pinned; r < cnt; r++)
+        for (int i = firstParent.at(r), end = firstParent.at(r + 1); i < end; i++) {
+            int p = parentRows.at(i);
+            if (p >= pinned)
+                childs[p]++;
+        }
+
+    std::priority_queue<int, std::vector<int>, std::greater<int> > ready;
+    for (int r = pinned; r < cnt; r++)
+        if (childs.at(r) == 0)
+            ready.push(pos.at(r));
+
+    QVector<int> res;
+    res.reserve(cnt);
+    for (int r = 0; r < pinned; r++)
+        res.append(r);
+
+    while (!ready.empty()) {
+
+        int r = dates.at(ready.top());
+        ready.pop();
+        res.append(r);
+
+        for (int i = firstParent.at(r), end = firstParent.at(r + 1); i < end; i++) {
+            int p = parentRows.at(i);
+            if (p >= pinned && --childs[p] == 0)
+                ready.push(pos.at(p));
+        }
+    }
+    return res;
+}
@@ -0,0 +1,34 @@
+#ifndef HISTORYORDER_H
+#define HISTORYORDER_H
+
+#include <QVector>
+
+/*
+ * Orders of the loaded revisions other than the one of 'git log',
+ * computed in memory from a table of parent rows, as the one of
+ * Reachability, and the author times, so that changing order does
+ * not run git again. Rows are the ones of the loading order.
+ *
+ * The first 'pinned' rows, working dir and StGIT unapplied patches,
+ * stay on top in any order, their lanes are not computed.
+ */
+class HistoryOrder {
+public:
+    HistoryOrder() : pinned(0) {}
+
+    void clear();
+    void setGraph(const QVector<int>& firstParent, const QVector<int>& parentRows,
+                  const QVector<uint>& authorTimes, int pinnedRows);
+    const QVector<int> rows(int orderType) const;
+
+private:
+    const QVector<int> byDate() const;
+    const QVector<int> dateOrder() const;
+
+    int pinned;
+    QVector<int> firstParent; // rows + 1 entries, as in Reachability
+    QVector<int> parentRows;
+    QVector<uint> times;
+};
+
+#endif // HISTORYORDER_H
@@ -687,9 +687,10 @@ void ListViewDelegate::paintLog(QPainter* p, const QStyleOptionViewItem& opt,
 		p->fillRect(opt.rect, LIGHT_BLUE);
 
 	bool isHighlighted = lp->isHighlighted(row);
+	bool isEquivalent = git->hasEquivalentRevs(r->sha()); // e.g. cherry-picked
 	QPixmap* pm = getTagMarks(r->sha(), opt);
 
-	if (!pm && !isHighlighted) { // fast path in common case
+	if (!pm && !isHighlighted && !isEquivalent) { // fast path in common case
 		QItemDelegate::paint(p, opt, index);
 		return;
 	}
@@ -702,6 +703,9 @@ void ListViewDelegate::paintLog(QPainter* p, const QStyleOptionViewItem& opt,
 	if (isHighlighted)
 		newOpt.font.setBold(true);
 
+	if (isEquivalent)
+		newOpt.font.setItalic(true);
+
 	QItemDelegate::paint(p, newOpt, index);
 }
 
@@ -834,6 +838,10 @@ bool ListViewProxy::isMatch(SCRef sha) const {
 		dbp("ASSERT in ListViewFilter::isMatch, sha <%1> not found", sha);
 		return false;
 	}
+	// identities are far less than revisions, they have been matched already
+	if (colNum == AUTH_COL && r->authorId != -1 && r->authorId < authorMatch.size())
+		return authorMatch.testBit(r->authorId);
+
 	QString target;
 	if (colNum == LOG_COL)
 		target = r->shortLog();
@@ -878,12 +886,20 @@ int ListViewProxy::setFilter(bool isOn, bool h, SCRef fl, int cn, ShaSet* s) {
 	if (s)
 		shaSet = *s;
 
+	FileHistory* fh = d->model();
+	authorMatch.clear();
+	if (isOn && colNum == AUTH_COL) {
+		const Identities& ids = fh->identities();
+		authorMatch.resize(ids.count());
+		for (int i = 0; i < ids.count(); i++)
+			if (ids.name(i).contains(filter))
+				authorMatch.setBit(i);
+	}
 	// isHighlighted() is called also when filter is off,
 	// so reset 'isHighLight' flag in that case
 	isHighLight = h && isOn;
 
     HistoryView* lv = static_cast<HistoryView*>(parent());
-	FileHistory* fh = d->model();
 
 	if (!isOn && sourceModel()){
 		lv->setModel(fh);
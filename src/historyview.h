@@ -10,6 +10,7 @@
 #include <QItemDelegate>
 #include <QSortFilterProxyModel>
 #include <QRegExp>
+#include <QBitArray>
 #include "common.h"
 
 class Git;
@@ -127,6 +128,7 @@ private:
 	QRegExp filter;
 	int colNum;
 	ShaSet shaSet;
+	QBitArray authorMatch; // by identity id, when filtering on author
 };
 
 #endif
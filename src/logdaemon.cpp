@@ -0,0 +1,378 @@
+#include "logdaemon.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QSettings>
+
+#include "common.h"
+#include "git.h"
+
+using namespace QGit;
+
+static const quint32 PROTOCOL_VERSION = 1;
+static const int REFRESH_DELAY = 500; // ms, git changes many files at once
+static const int PROBE_TIMEOUT = 500; // ms, a running daemon answers at once
+static const int MAX_CLIENT_ENTRIES = 16;
+static const QStringList REV_OPTIONS = QStringList() // harmless, as revisions
+    << "--all" << "--branches" << "--tags" << "--remotes" << "--no-merges";
+
+static bool readRefsKey(const QString& workDir, QByteArray* key) {
+// same fingerprint Git::getRefs() computes
+
+    QByteArray head, refs;
+    if (   !runProcess(workDir, "git rev-parse --revs-only HEAD", &head)
+        || !runProcess(workDir, "git show-ref -d", &refs))
+        return false;
+
+    *key = Git::refsFingerprint(QString(head).trimmed(), QString(refs));
+    return true;
+}
+
+LogDaemon::LogDaemon(QObject* p) : QObject(p) {
+
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    watcher = new QFileSystemWatcher(this);
+    refreshTimer.setSingleShot(true);
+
+    connect(server, SIGNAL(newConnection()), this, SLOT(on_newConnection()));
+    connect(watcher, SIGNAL(directoryChanged(const QString&)),
+            this, SLOT(on_pathChanged(const QString&)));
+    connect(&refreshTimer, SIGNAL(timeout()), this, SLOT(on_refresh()));
+}
+
+LogDaemon::~LogDaemon() {
+
+    qDeleteAll(entries); // running processes are children of us
+}
+
+const QString LogDaemon::socketName() {
+// one daemon per user, socket is not reachable by other users
+
+    return "qgit-log-daemon-" + QDir::home().dirName();
+}
+
+bool LogDaemon::listen() {
+
+    // a stale socket of a crashed daemon would make listen() fail,
+    // but the one of a running daemon must not be taken over
+    QLocalSocket probe;
+    probe.connectToServer(socketName());
+    if (probe.waitForConnected(PROBE_TIMEOUT)) {
+        dbs("ERROR: log daemon already running");
+        return false;
+    }
+    QLocalServer::removeServer(socketName());
+    if (!server->listen(socketName())) {
+        dbp("ERROR: log daemon unable to listen, %1", server->errorString());
+        return false;
+    }
+    // configured repositories are loaded at once, full history
+    const QStringList repos(QSettings().value(DAEMON_REPOS_KEY).toStringList());
+    FOREACH_SL (it, repos) {
+
+        QByteArray gd;
+        if (!runProcess(*it, "git rev-parse --git-dir", &gd)) {
+            dbp("WARNING: log daemon, %1 is not a git repository", *it);
+            continue;
+        }
+        LogRequest r;
+        r.workDir = *it;
+        r.gitDir = QDir(*it).absoluteFilePath(QString(gd).trimmed());
+        r.cmd = Git::revListCmd(true);
+        addEntry(r, true);
+    }
+    return true;
+}
+
+const QString LogDaemon::key(const LogRequest& r) {
+
+    return r.workDir + '\n' + r.cmd.join(" ");
+}
+
+bool LogDaemon::isValidRequest(const LogRequest& r) {
+/*
+   We run the command on behalf of the client, so only the one of the
+   main view is accepted, followed by revisions and ranges, a few
+   options that only select them, and paths after "--". An option as
+   --output would let any local program of the user write files
+   through us. Then workDir must be the
+   working directory of gitDir, that is the one we watch.
+*/
+    const QStringList base(Git::revListCmd(true));
+    if (r.cmd.mid(0, base.count()) != base)
+        return false;
+
+    bool paths = false;
+    for (int i = base.count(); i < r.cmd.count() && !paths; i++) {
+        SCRef arg = r.cmd.at(i);
+        if (arg == "--")
+            paths = true;
+        else if (arg.isEmpty() || (arg.startsWith('-') && !REV_OPTIONS.contains(arg)))
+            return false;
+    }
+    QByteArray gd;
+    if (   !QDir::isAbsolutePath(r.workDir) || !QDir(r.workDir).exists()
+        || !runProcess(r.workDir, "git rev-parse --git-dir", &gd))
+        return false;
+
+    const QString dir(QDir(r.workDir).absoluteFilePath(QString(gd).trimmed()));
+    const QString canonical(QDir(dir).canonicalPath());
+    return !canonical.isEmpty() && canonical == QDir(r.gitDir).canonicalPath();
+}
+
+LogDaemon::Entry* LogDaemon::addEntry(const LogRequest& r, bool configured) {
+
+    Entry* e = new Entry();
+    e->req = r;
+    e->req.refsKey.clear();
+    entries.insert(key(r), e);
+    watch(r.gitDir);
+
+    if (!configured) {
+        clientKeys.append(key(r));
+        if (clientKeys.count() > MAX_CLIENT_ENTRIES)
+            removeEntry(clientKeys.first());
+    }
+
+    QByteArray refsKey;
+    if (readRefsKey(r.workDir, &refsKey)) {
+        e->pendingKey = refsKey;
+        load(e);
+    }
+    return e;
+}
+
+void LogDaemon::watch(const QString& gitDir) {
+/*
+   Directories only: git updates refs by renaming a lock file, so
+   files are replaced, not changed. Remote directories could be
+   added later, so the list is updated at each refresh.
+*/
+    QStringList dirs;
+    dirs << gitDir << gitDir + "/refs/heads" << gitDir + "/refs/tags";
+
+    QDir remotes(gitDir + "/refs/remotes");
+    const QStringList rl(remotes.entryList(QDir::Dirs | QDir::NoDotAndDotDot));
+    dirs << remotes.path();
+    FOREACH_SL (it, rl)
+        dirs << remotes.filePath(*it);
+
+    const QStringList watched(watcher->directories());
+    FOREACH_SL (it, dirs)
+        if (!watched.contains(*it) && QDir(*it).exists())
+            watcher->addPath(*it);
+}
+
+void LogDaemon::removeEntry(const QString& k) {
+
+    Entry* e = entries.take(k);
+    if (!e)
+        return;
+
+    clientKeys.removeAll(k);
+    stopLoad(e);
+    unwatch(e->req.gitDir);
+    delete e;
+}
+
+void LogDaemon::unwatch(const QString& gitDir) {
+// only if no other entry is on the same repository
+
+    FOREACH (QHash<QString, Entry*>, it, entries)
+        if ((*it)->req.gitDir == gitDir)
+            return;
+
+    const QStringList watched(watcher->directories());
+    FOREACH_SL (it, watched)
+        if (*it == gitDir || it->startsWith(gitDir + '/'))
+            watcher->removePath(*it);
+}
+
+void LogDaemon::stopLoad(Entry* e) {
+
+    if (!e->proc)
+        return;
+
+    e->proc->disconnect(this);
+    e->proc->kill();
+    e->proc->deleteLater();
+    e->proc = NULL;
+}
+
+void LogDaemon::load(Entry* e) {
+
+    stopLoad(e); // refs changed again in the mean time
+    e->proc = new QProcess(this);
+    e->proc->setWorkingDirectory(e->req.workDir);
+    connect(e->proc, SIGNAL(finished(int, QProcess::ExitStatus)),
+            this, SLOT(on_logFinished()));
+
+    if (!startProcess(e->proc, e->req.cmd)) {
+        dbp("ERROR: log daemon unable to run 'git log' in %1", e->req.workDir);
+        e->proc->deleteLater();
+        e->proc = NULL;
+    }
+}
+
+void LogDaemon::on_logFinished() {
+
+    QProcess* p = static_cast<QProcess*>(sender());
+    FOREACH (QHash<QString, Entry*>, it, entries) {
+
+        Entry* e = *it;
+        if (e->proc != p)
+            continue;
+
+        if (p->exitStatus() == QProcess::NormalExit && p->exitCode() == 0) {
+            e->log = p->readAllStandardOutput();
+            e->req.refsKey = e->pendingKey;
+            e->ready = true;
+        }
+        e->proc = NULL;
+        break;
+    }
+    p->deleteLater();
+}
+
+void LogDaemon::on_pathChanged(const QString& path) {
+
+    FOREACH (QHash<QString, Entry*>, it, entries)
+        if (path.startsWith((*it)->req.gitDir))
+            dirtyDirs.insert((*it)->req.gitDir);
+
+    refreshTimer.start(REFRESH_DELAY);
+}
+
+void LogDaemon::on_refresh() {
+/*
+   Index and other files in git directory change more often than refs,
+   so 'git log' runs again only if refs fingerprint is changed. Old
+   output is not sent anymore, new one has a different fingerprint.
+*/
+    QHash<QString, QByteArray> newKeys; // by git dir, many commands per repo
+    FOREACH (QHash<QString, Entry*>, it, entries) {
+
+        Entry* e = *it;
+        if (!dirtyDirs.contains(e->req.gitDir))
+            continue;
+
+        if (!newKeys.contains(e->req.gitDir)) {
+            QByteArray k;
+            readRefsKey(e->req.workDir, &k);
+            newKeys.insert(e->req.gitDir, k);
+            watch(e->req.gitDir);
+        }
+        const QByteArray& k = newKeys[e->req.gitDir];
+        if (k.isEmpty() || (e->ready && k == e->req.refsKey) || (e->proc && k == e->pendingKey))
+            continue;
+
+        e->pendingKey = k;
+        load(e);
+    }
+    dirtyDirs.clear();
+}
+
+void LogDaemon::on_newConnection() {
+
+    while (server->hasPendingConnections()) {
+        QLocalSocket* s = server->nextPendingConnection();
+        connect(s, SIGNAL(readyRead()), this, SLOT(on_readyRead()));
+        connect(s, SIGNAL(disconnected()), s, SLOT(deleteLater()));
+    }
+}
+
+void LogDaemon::on_readyRead() {
+
+    QLocalSocket* s = static_cast<QLocalSocket*>(sender());
+    if (s->bytesAvailable() < (qint64)sizeof(quint32))
+        return;
+
+    quint32 size;
+    QDataStream hdr(s->peek(sizeof(quint32)));
+    hdr >> size;
+    if (s->bytesAvailable() < (qint64)(sizeof(quint32) + size))
+        return;
+
+    s->read(sizeof(quint32));
+    QDataStream in(s->read(size));
+    quint32 version;
+    LogRequest r;
+    in >> version >> r.workDir >> r.gitDir >> r.cmd >> r.refsKey;
+    s->disconnect(this); // one request per connection
+
+    if (version != PROTOCOL_VERSION || in.status() != QDataStream::Ok) {
+        QDataStream out(s);
+        out << qint64(-1);
+        s->disconnectFromServer();
+        return;
+    }
+    reply(s, r);
+}
+
+void LogDaemon::reply(QLocalSocket* s, const LogRequest& r) {
+// pending data is written before the connection is closed
+
+    const QString k(key(r));
+    Entry* e = entries.value(k);
+    QDataStream out(s);
+
+    if (!e && !isValidRequest(r)) {
+        dbp("WARNING: log daemon, request refused for %1", r.workDir);
+        out << qint64(-1);
+        s->disconnectFromServer();
+        return;
+    }
+    if (clientKeys.contains(k)) // most recently used last
+        clientKeys.move(clientKeys.indexOf(k), clientKeys.count() - 1);
+
+    if (e && e->ready && e->req.refsKey == r.refsKey) {
+        out << qint64(e->log.size());
+        s->write(e->log);
+
+        s->disconnectFromServer();
+        return;
+    }
+    // client loads by itself, answer before doing anything else
+    out << qint64(-1);
+    s->disconnectFromServer();
+
+    // to be ready next time, unknown refs are checked again
+    if (!e)
+        addEntry(r, false);
+    else if (!e->proc) {
+        dirtyDirs.insert(e->req.gitDir);
+        refreshTimer.start(REFRESH_DELAY);
+    }
+}
+
+bool LogDaemon::sendRequest(QLocalSocket* s, const LogRequest& r) {
+
+    QByteArray payload;
+    QDataStream in(&payload, QIODevice::WriteOnly);
+    in << PROTOCOL_VERSION << r.workDir << r.gitDir << r.cmd << r.refsKey;
+
+    QByteArray msg;
+    QDataStream out(&msg, QIODevice::WriteOnly);
+    out << quint32(payload.size());
+    msg.append(payload);
+
+    return s->write(msg) == msg.size() && s->waitForBytesWritten();
+}
+
+qint64 LogDaemon::waitReply(QLocalSocket* s, int timeout) {
+// size of the 'git log' output that follows, -1 if not available
+
+    while (s->bytesAvailable() < (qint64)sizeof(qint64))
+        if (!s->waitForReadyRead(timeout))
+            return -1;
+
+    qint64 size;
+    QDataStream in(s->read(sizeof(qint64)));
+    in >> size;
+    return size;
+}
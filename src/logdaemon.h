@@ -0,0 +1,89 @@
+#ifndef LOGDAEMON_H
+#define LOGDAEMON_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+class QFileSystemWatcher;
+class QLocalServer;
+class QLocalSocket;
+class QProcess;
+
+/*
+ * What a client asks for: the output of 'git log' command cmd, run in
+ * workDir, as it is when refs fingerprint is refsKey, see Git::getRefs().
+ */
+struct LogRequest {
+    QString workDir;
+    QString gitDir;
+    QStringList cmd;
+    QByteArray refsKey;
+};
+
+/*
+ * Optional local helper started with 'qgit --daemon'. It keeps the
+ * 'git log' output of the configured repositories, and of the ones
+ * asked for by clients, and runs it again in background whenever
+ * their refs change. A qgit instance then reads the output through
+ * a local socket, owned by the user, instead of waiting for git.
+ *
+ * The output is sent only if the refs are the same the client has
+ * just read, otherwise client loads as usual. Parsing, lanes and file
+ * names stay in the client, as with any other DataLoader backend.
+ *
+ * Only the main view command is run, with revision ranges, and only
+ * in the working directory of the requested repository. Entries
+ * asked for by clients are limited, least recently used are dropped.
+ */
+class LogDaemon : public QObject {
+Q_OBJECT
+public:
+    explicit LogDaemon(QObject* parent = NULL);
+    ~LogDaemon();
+
+    bool listen();
+
+    // client side
+    static const QString socketName();
+    static bool sendRequest(QLocalSocket* s, const LogRequest& r);
+    static qint64 waitReply(QLocalSocket* s, int timeout);
+
+private slots:
+    void on_newConnection();
+    void on_readyRead();
+    void on_pathChanged(const QString& path);
+    void on_refresh();
+    void on_logFinished();
+
+private:
+    struct Entry {
+        Entry() : proc(NULL), ready(false) {}
+        LogRequest req;  // refsKey is the one of log
+        QByteArray log;
+        QByteArray pendingKey;
+        QProcess* proc;  // 'git log' running, if any
+        bool ready;
+    };
+    static const QString key(const LogRequest& r);
+    static bool isValidRequest(const LogRequest& r);
+    Entry* addEntry(const LogRequest& r, bool configured);
+    void removeEntry(const QString& k);
+    void watch(const QString& gitDir);
+    void unwatch(const QString& gitDir);
+    void load(Entry* e);
+    void stopLoad(Entry* e);
+    void reply(QLocalSocket* s, const LogRequest& r);
+
+    QLocalServer* server;
+    QFileSystemWatcher* watcher;
+    QTimer refreshTimer;
+    QHash<QString, Entry*> entries;
+    QStringList clientKeys; // entries asked for by clients, least recently used first
+    QSet<QString> dirtyDirs;
+};
+
+#endif // LOGDAEMON_H
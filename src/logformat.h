@@ -0,0 +1,53 @@
+#ifndef LOGFORMAT_H
+#define LOGFORMAT_H
+
+#include <QString>
+
+/*
+ * The 'git log' record layouts we parse. Each one is described once,
+ * at compile time, by a LogFormat specialization: the command line
+ * options are built from it and Rev::parseRecord() is instantiated
+ * for it, so the parser has no runtime checks for features a layout
+ * cannot have.
+ *
+ * All the layouts share the same fields, see Rev::parseRecord():
+ *
+ *     %m%HX%PX%n%cn<%ce>%n%an<%ae>%n%at%n%s%n[%b][diff]
+ */
+enum LogFormatId {
+    MAIN_LOG,      // main view, with log message body
+    FILE_LOG,      // file history, patch follows the header
+    UNAPPLIED_LOG  // StGIT unapplied patches, loaded in main view
+};
+
+template <LogFormatId> struct LogFormat;
+
+template <> struct LogFormat<MAIN_LOG> {
+    enum { withBody = 1, withDiff = 0, earlyOutput = 1 };
+};
+
+template <> struct LogFormat<FILE_LOG> {
+    enum { withBody = 0, withDiff = 1, earlyOutput = 0 };
+};
+
+template <> struct LogFormat<UNAPPLIED_LOG> {
+    enum { withBody = 1, withDiff = 0, earlyOutput = 0 };
+};
+
+template <class F> inline const QString logFormatArgs() {
+// options common to all the commands, as a space separated string
+
+    QString s("--no-color "
+
+#ifndef Q_OS_WIN32
+              "--log-size " // FIXME broken on Windows
+#endif
+              "--parents -z --pretty=format:%m%HX%PX%n%cn<%ce>%n%an<%ae>%n%at%n%s%n");
+
+    if (F::withBody)
+        s.append("%b");
+
+    return s;
+}
+
+#endif // LOGFORMAT_H
@@ -6,6 +6,7 @@
 	Copyright: See COPYING file that comes with this distribution
 
 */
+#include <QActionGroup>
 #include <QCloseEvent>
 #include <QDrag>
 #include <QEvent>
@@ -32,6 +33,9 @@
 #include "revdesc.h"
 #include "revsview.h"
 #include "settingsimpl.h"
+#include "task.h"
+#include "ui/analyticsview.h"
+#include "ui/annotateview.h"
 #include "navigator/navigatorcontroller.h"
 #include "filehistory.h"
 #include "ui_help.h"
@@ -56,9 +60,17 @@ MainImpl::MainImpl(SCRef cd, QWidget* p) : QMainWindow(p) {
     lineEditFilter->addFilter("File", CS_FILE);
     lineEditFilter->addFilter("Patch", CS_PATCH);
     lineEditFilter->addFilter("Patch (regExp)", CS_PATCH_REGEXP);
+    lineEditFilter->addFilter("Range", CS_RANGE);
+    lineEditFilter->addFilter("Date", CS_DATE);
     toolBar->insertWidget(ActSearchAndFilter, lineEditFilter);
 	connect(lineEditFilter, SIGNAL(returnPressed()), this, SLOT(lineEditFilter_returnPressed()));
 
+	// history orders are exclusive
+	QActionGroup* orderGroup = new QActionGroup(this);
+	orderGroup->addAction(ActOrderTopo);
+	orderGroup->addAction(ActOrderDate);
+	orderGroup->addAction(ActOrderReverse);
+
 	// create light and dark colors for alternate background
 	ODD_LINE_COL = palette().color(QPalette::Base);
 	EVEN_LINE_COL = ODD_LINE_COL.dark(103);
@@ -198,6 +210,32 @@ void MainImpl::ActForward_activated() {
     //TODO: reimplement functionality that got lost when removing lineEditSHA
 }
 
+void MainImpl::ActAnnotate_activated() {
+
+	AnnotateView* av = new AnnotateView(this, git, rv->st.sha(), rv->st.fileName());
+	av->show();
+}
+
+void MainImpl::ActAnalytics_activated() {
+
+	AnalyticsView* av = new AnalyticsView(this, git);
+	av->show();
+}
+
+void MainImpl::ActHistoryOrder_activated() {
+// rows are moved in memory, selected revision is kept
+
+	OrderType type = TOPO_ORDER;
+	if (ActOrderDate->isChecked())
+		type = DATE_ORDER;
+	else if (ActOrderReverse->isChecked())
+		type = REVERSE_ORDER;
+
+	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+	git->setHistoryOrder(type);
+	QApplication::restoreOverrideCursor();
+}
+
 // *************************** ExternalDiffViewer ***************************
 
 void MainImpl::ActExternalDiff_activated() {
@@ -355,6 +393,10 @@ void MainImpl::updateGlobalActions(bool b) {
 	ActRefresh->setEnabled(b);
 	ActCheckWorkDir->setEnabled(b);
 	ActViewRev->setEnabled(b);
+	ActAnalytics->setEnabled(b);
+	ActOrderTopo->setEnabled(b);
+	ActOrderDate->setEnabled(b);
+	ActOrderReverse->setEnabled(b);
 
 	rv->setEnabled(b);
 }
@@ -367,6 +409,7 @@ void MainImpl::updateContextActions(SCRef newRevSha, SCRef newFileName,
 
 	ActExternalDiff->setEnabled(fileActionsEnabled);
 	ActSaveFile->setEnabled(fileActionsEnabled);
+	ActAnnotate->setEnabled(fileActionsEnabled);
 
 	bool isTag, isUnApplied, isApplied;
 	isTag = isUnApplied = isApplied = false;
@@ -515,6 +558,9 @@ void MainImpl::filterList(bool isOn, bool onlyHighlight) {
 
 	lineEditFilter->setEnabled(!isOn);
 
+	if (patchFilterTask) // a patch search still running is obsolete now
+		patchFilterTask->cancel();
+
 	SCRef filter(lineEditFilter->text());
 	if (filter.isEmpty())
 		return;
@@ -542,19 +588,38 @@ void MainImpl::filterList(bool isOn, bool onlyHighlight) {
 		case CS_FILE:
 		case CS_PATCH:
 		case CS_PATCH_REGEXP:
+		case CS_RANGE:
+		case CS_DATE:
 			colNum = SHA_MAP_COL;
 			QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 			EM_PROCESS_EVENTS; // to paint wait cursor
 			if (idx == CS_FILE)
 				git->getFileFilter(filter, shaSet);
-			else {
-				isRegExp = (idx == CS_PATCH_REGEXP);
-				if (!git->getPatchFilter(filter, isRegExp, shaSet)) {
+			else if (idx == CS_RANGE || idx == CS_DATE) {
+				// evaluated on loaded revisions, no reload needed
+				bool ok = (idx == CS_RANGE ? git->getRangeFilter(filter, shaSet)
+				                           : git->getDateFilter(filter, shaSet));
+				if (!ok) {
 					QApplication::restoreOverrideCursor();
 					ActSearchAndFilter->toggle();
 					return;
 				}
-				patchNeedsUpdate = (shaSet.count() > 0);
+			} else {
+				// 'git diff-tree' could be slow, results are shown when ready
+				isRegExp = (idx == CS_PATCH_REGEXP);
+				QApplication::restoreOverrideCursor();
+				statusBar()->showMessage("Searching in patches...");
+				patchFilterTask = git->startPatchFilter(this, filter, isRegExp,
+				                      [=](bool ok, const ShaSet& result) {
+					if (!ok) {
+						statusBar()->clearMessage();
+						ActSearchAndFilter->toggle();
+						return;
+					}
+					ShaSet s(result);
+					showFilterResult(true, onlyHighlight, filter, colNum, s, s.count() > 0, isRegExp);
+				});
+				return;
 			}
 			QApplication::restoreOverrideCursor();
 			break;
@@ -564,6 +629,12 @@ void MainImpl::filterList(bool isOn, bool onlyHighlight) {
 		shortLogRE.setPattern("");
 		longLogRE.setPattern("");
 	}
+	showFilterResult(isOn, onlyHighlight, filter, colNum, shaSet, patchNeedsUpdate, isRegExp);
+}
+
+void MainImpl::showFilterResult(bool isOn, bool onlyHighlight, SCRef filter, int colNum,
+                                ShaSet& shaSet, bool patchNeedsUpdate, bool isRegExp) {
+
 	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 
     HistoryView* lv = rv->tab()->listViewLog;
@@ -950,8 +1021,8 @@ void MainImpl::goRef_triggered(QAction* act) {
 	UPDATE_DOMAIN(rv);
 }
 
-const QString MainImpl::getRevisionDesc(SCRef sha) {
-    return git->getDesc(sha, NULL);
+const QString MainImpl::getRevisionDesc(SCRef sha, QSharedPointer<TreeDiff>* bigDiff) {
+    return git->getDesc(sha, NULL, bigDiff);
 }
 
 void MainImpl::ActSaveFile_activated() {
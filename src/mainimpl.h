@@ -7,7 +7,9 @@
 #ifndef MAINIMPL_H
 #define MAINIMPL_H
 
+#include <QPointer>
 #include <QProcess>
+#include <QSharedPointer>
 #include <QRegExp>
 #include <QDir>
 #include <QTreeWidgetItem>
@@ -30,6 +32,8 @@ class Domain;
 class Git;
 class FileHistory;
 class RevsView;
+class Task;
+class TreeDiff;
 class NavigatorController;
 
 class MainImpl : public QMainWindow, public Ui_MainBase {
@@ -37,7 +41,7 @@ Q_OBJECT
 public:
 	MainImpl(const QString& curDir = "", QWidget* parent = 0);
 	void updateContextActions(SCRef newRevSha, SCRef newFileName, bool isDir, bool found);
-	const QString getRevisionDesc(SCRef sha);
+	const QString getRevisionDesc(SCRef sha, QSharedPointer<TreeDiff>* bigDiff = NULL);
 
     enum ComboSearch {
         CS_SHORT_LOG,
@@ -46,7 +50,9 @@ public:
         CS_SHA1,
         CS_FILE,
         CS_PATCH,
-        CS_PATCH_REGEXP
+        CS_PATCH_REGEXP,
+        CS_RANGE,
+        CS_DATE
     };
 
 	// not buildable with Qt designer, will be created manually
@@ -84,6 +90,9 @@ protected slots:
 	void ActFindNext_activated();
 	void ActViewRev_activated();
 	void ActExternalDiff_activated();
+	void ActAnnotate_activated();
+	void ActAnalytics_activated();
+	void ActHistoryOrder_activated();
 	void ActOpenRepo_activated();
 	void ActOpenRepoNewWindow_activated();
 	void ActRefresh_activated();
@@ -112,6 +121,8 @@ private:
 	void setupShortcuts();
 	int currentTabType(Domain** t);
 	void filterList(bool isOn, bool onlyHighlight);
+	void showFilterResult(bool isOn, bool onlyHighlight, SCRef filter, int colNum,
+	                      ShaSet& shaSet, bool patchNeedsUpdate, bool isRegExp);
 	bool isMatch(SCRef sha, SCRef f, int cn, const QMap<QString,bool>& sm);
 	void setRepository(SCRef wd, bool = false, bool = false, const QStringList* = NULL, bool = false);
 	void getExternalDiffArgs(QStringList* args, QStringList* filenames);
@@ -145,6 +156,7 @@ private:
 	QString textToFind;
 	QRegExp shortLogRE;
 	QRegExp longLogRE;
+	QPointer<Task> patchFilterTask;
 	bool setRepositoryBusy;
 };
 
@@ -7,11 +7,12 @@
 
 */
 #include <QApplication>
-#include <QTime>
-#include "exceptionmanager.h"
 #include "common.h"
 #include "domain.h"
 #include "myprocess.h"
+#include "spawner.h"
+
+static const int CANCEL_WAIT = 30000; // ms, as QProcess::waitForFinished()
 
 MyProcess::MyProcess(QObject *go, Git* g, const QString& wd, bool err) : QProcess(g) {
 
@@ -20,6 +21,7 @@ MyProcess::MyProcess(QObject *go, Git* g, const QString& wd, bool err) : QProces
 	workDir = wd;
 	runOutput = NULL;
 	receiver = NULL;
+	spawned = NULL;
 	errorReportingEnabled = err;
 	canceling = async = isWinShell = isErrorExit = false;
 }
@@ -49,18 +51,14 @@ bool MyProcess::runSync(SCRef rc, QByteArray* ro, QObject* rcv, SCRef buf) {
 	if (!launchMe(runCmd, buf))
 		return false;
 
-	QTime t;
-	t.start();
-
-	busy = true; // we have to wait here until we exit
-
-	while (busy) {
-		waitForFinished(20); // suspend 20ms to let OS reschedule
-
-		if (t.elapsed() > 200) {
-			EM_PROCESS_EVENTS;
-			t.restart();
-		}
+	// we have to wait here until we exit, without going back to the
+	// event loop, a slot called from there could re-enter us. Signals
+	// are emitted from waitFinished(), so receiver is fed as usual.
+	// Long commands run in background, see task.h
+	busy = true;
+	if (!waitFinished(-1) && busy) {
+		busy = false;
+		isErrorExit = true;
 	}
 	return !isErrorExit;
 }
@@ -96,7 +94,7 @@ void MyProcess::sendErrorMsg(bool notStarted, SCRef err) {
 	if (!errorReportingEnabled)
 		return;
 
-	QString errorDesc(readAllStandardError());
+	QString errorDesc(readError());
 	errorDesc.prepend(err);
 
 	if (notStarted)
@@ -113,6 +111,10 @@ bool MyProcess::launchMe(SCRef runCmd, SCRef buf) {
 	if (arguments.isEmpty())
 		return false;
 
+	// the common case, no input, is started without QProcess
+	if (buf.isEmpty() && spawnMe())
+		return true;
+
 	setWorkingDirectory(workDir);
 	if (!QGit::startProcess(this, arguments, buf, &isWinShell)) {
 		sendErrorMsg(true);
@@ -121,16 +123,56 @@ bool MyProcess::launchMe(SCRef runCmd, SCRef buf) {
 	return true;
 }
 
+bool MyProcess::spawnMe() {
+/*
+   QProcess costs some milliseconds per run, and we run git a lot
+   while browsing. Signals of SpawnedProcess have the same names,
+   so the usual slots are used. On failure we fall back on QProcess
+   that gives a proper error report.
+*/
+	spawned = new SpawnedProcess(this);
+	if (!spawned->start(arguments, workDir)) {
+		delete spawned;
+		spawned = NULL;
+		return false;
+	}
+	connect(spawned, SIGNAL(readyReadStandardOutput()),
+	        this, SLOT(on_readyReadStandardOutput()));
+
+	connect(spawned, SIGNAL(finished(int, QProcess::ExitStatus)),
+	        this, SLOT(on_finished(int, QProcess::ExitStatus)));
+
+	if (receiver)
+		connect(spawned, SIGNAL(readyReadStandardError()),
+		        this, SLOT(on_readyReadStandardError()));
+	return true;
+}
+
+const QByteArray MyProcess::readOutput() {
+
+	return (spawned ? spawned->readAllStandardOutput() : readAllStandardOutput());
+}
+
+const QByteArray MyProcess::readError() {
+
+	return (spawned ? spawned->readAllStandardError() : readAllStandardError());
+}
+
+bool MyProcess::waitFinished(int msecs) {
+
+	return (spawned ? spawned->waitForFinished(msecs) : waitForFinished(msecs));
+}
+
 void MyProcess::on_readyReadStandardOutput() {
 
 	if (canceling)
 		return;
 
 	if (receiver)
-		emit procDataReady(readAllStandardOutput());
+		emit procDataReady(readOutput());
 
 	else if (runOutput)
-		runOutput->append(readAllStandardOutput());
+		runOutput->append(readOutput());
 }
 
 void MyProcess::on_readyReadStandardError() {
@@ -139,7 +181,7 @@ void MyProcess::on_readyReadStandardError() {
 		return;
 
 	if (receiver)
-		emit procDataReady(readAllStandardError()); // redirect to stdout
+		emit procDataReady(readError()); // redirect to stdout
 	else
 		dbs("ASSERT in myReadFromStderr: NULL receiver");
 }
@@ -157,7 +199,7 @@ void MyProcess::on_finished(int exitCode, QProcess::ExitStatus exitStatus) {
 	// in Window shell interpreter.
 	//
 	// So to detect a failing command we check also if stderr is not empty.
-	QString errorDesc(readAllStandardError());
+	QString errorDesc(readError());
 
 	isErrorExit =   (exitStatus != QProcess::NormalExit)
 	             || (exitCode != 0 && isWinShell)
@@ -181,6 +223,14 @@ void MyProcess::on_cancel() {
 
 	canceling = true;
 
+	if (spawned) {
+		spawned->terminate();
+		if (!spawned->waitForFinished(CANCEL_WAIT)) {
+			spawned->kill(); // SIGTERM ignored
+			spawned->waitForFinished(CANCEL_WAIT);
+		}
+		return;
+	}
 #ifdef Q_OS_WIN32
 	kill(); // uses TerminateProcess
 #else
@@ -11,6 +11,7 @@
 #include "git.h"
 
 class Git;
+class SpawnedProcess;
 
 //custom process used to run shell commands in parallel
 
@@ -37,6 +38,10 @@ private slots:
 private:
 	void setupSignals();
 	bool launchMe(SCRef runCmd, SCRef buf);
+	bool spawnMe();
+	const QByteArray readOutput();
+	const QByteArray readError();
+	bool waitFinished(int msecs);
 	void sendErrorMsg(bool notStarted = false, SCRef errDesc = "");
 	static void restoreSpaces(QString& newCmd, const QChar& sepChar);
 
@@ -47,6 +52,7 @@ private:
 	QString workDir;
 	QObject* receiver;
 	QStringList arguments;
+	SpawnedProcess* spawned; // if not NULL QProcess is not used
 	bool errorReportingEnabled;
 	bool canceling;
 	bool busy;
@@ -190,6 +190,9 @@ const QString QGit::CMT_TEMPL_KEY   = "Commit/template_file_path";
 const QString QGit::CMT_ARGS_KEY    = "Commit/args";
 const QString QGit::ACT_TEXT_KEY    = "/commands";
 const QString QGit::ACT_FLAGS_KEY   = "/flags";
+const QString QGit::LOG_MEM_KEY     = "Log/memory_budget";
+const QString QGit::WARM_MEM_KEY    = "Log/recent_repos_memory";
+const QString QGit::DAEMON_REPOS_KEY = "Daemon/repositories";
 
 // settings default values
 const QString QGit::CMT_TEMPL_DEF   = ".git/commit-template";
@@ -200,6 +203,7 @@ const QString QGit::EXT_DIFF_DEF    = "kompare";
 // cache file
 const QString QGit::BAK_EXT          = ".bak";
 const QString QGit::C_DAT_FILE       = "/qgit_cache.dat";
+const QString QGit::P_ID_FILE        = "/qgit_patchid.dat";
 
 // misc
 const QString QGit::QUOTE_CHAR = "$";
@@ -488,3 +492,16 @@ bool QGit::startProcess(QProcess* proc, SCList args, SCRef buf, bool* winShell)
 	proc->start(prog, arguments); // TODO test QIODevice::Unbuffered
 	return proc->waitForStarted();
 }
+
+bool QGit::runProcess(SCRef workDir, SCRef cmd, QByteArray* out) {
+// blocking, without an event loop, for headless callers and pool threads
+
+	QProcess p;
+	p.setWorkingDirectory(workDir);
+	if (!startProcess(&p, cmd.split(' ')))
+		return false;
+
+	p.waitForFinished(-1);
+	*out = p.readAllStandardOutput();
+	return p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0;
+}
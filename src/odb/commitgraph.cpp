@@ -0,0 +1,273 @@
+#include "commitgraph.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QtEndian>
+
+#include "common.h"
+
+static inline quint32 be32(const uchar* p) { return qFromBigEndian<quint32>(p); }
+static inline quint64 be64(const uchar* p) { return qFromBigEndian<quint64>(p); }
+static inline quint32 rotl32(quint32 x, int r) { return (x << r) | (x >> (32 - r)); }
+
+// seeds and layout are the ones of git bloom.c
+static const quint32 BLOOM_SEED_0 = 0x293ae76f;
+static const quint32 BLOOM_SEED_1 = 0x7e646e2c;
+
+static quint32 murmur3(quint32 seed, const QByteArray& data, bool v2) {
+/*
+   Version 1 of the changed-path filters was computed by git with
+   a murmur3 implementation that sign extends bytes above 0x7f,
+   version 2 fixed that. Both are needed to read older files.
+*/
+    const quint32 c1 = 0xcc9e2d51;
+    const quint32 c2 = 0x1b873593;
+    const int len = data.size();
+    const char* d = data.constData();
+    quint32 h = seed;
+
+#define BYTE(x) (v2 ? quint32(uchar(x)) : quint32(qint32(qint8(x))))
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        quint32 k = BYTE(d[i]) | (BYTE(d[i + 1]) << 8) | (BYTE(d[i + 2]) << 16) | (BYTE(d[i + 3]) << 24);
+        k *= c1;
+        k = rotl32(k, 15);
+        k *= c2;
+        h ^= k;
+        h = rotl32(h, 13);
+        h = h * 5 + 0xe6546b64;
+    }
+    quint32 k = 0;
+    switch (len & 3) {
+    case 3:
+        k ^= BYTE(d[i + 2]) << 16;
+        // fall through
+    case 2:
+        k ^= BYTE(d[i + 1]) << 8;
+        // fall through
+    case 1:
+        k ^= BYTE(d[i]);
+        k *= c1;
+        k = rotl32(k, 15);
+        k *= c2;
+        h ^= k;
+    }
+#undef BYTE
+
+    h ^= quint32(len);
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+CommitGraph::CommitGraph(const QString& gitDir) : bloomLayers(0) {
+
+    QString baseDir(gitDir);
+    QFile common(gitDir + "/commondir");
+    if (common.open(QIODevice::ReadOnly)) {
+        const QString cd(QString::fromLocal8Bit(common.readAll()).trimmed());
+        baseDir = QDir::isAbsolutePath(cd) ? cd : gitDir + '/' + cd;
+    }
+    objDir = QDir::cleanPath(baseDir + "/objects");
+}
+
+CommitGraph::~CommitGraph() {
+
+    for (int i = 0; i < layers.count(); i++)
+        delete layers[i].file;
+}
+
+bool CommitGraph::open() {
+
+    const QString single(objDir + "/info/commit-graph");
+    if (QFile::exists(single))
+        return openLayer(single);
+
+    // split commit-graph, chain file lists the layers base first
+    const QString chainDir(objDir + "/info/commit-graphs/");
+    QFile chain(chainDir + "commit-graph-chain");
+    if (!chain.open(QIODevice::ReadOnly))
+        return false;
+
+    const QStringList hashes(QString::fromLatin1(chain.readAll()).split('\n', QString::SkipEmptyParts));
+    FOREACH_SL (it, hashes)
+        if (!openLayer(chainDir + "graph-" + (*it).trimmed() + ".graph"))
+            return false;
+
+    return !layers.isEmpty();
+}
+
+bool CommitGraph::openLayer(const QString& path) {
+
+    Layer l;
+    l.file = new QFile(path);
+    if (!l.file->open(QIODevice::ReadOnly)) {
+        delete l.file;
+        return false;
+    }
+    qint64 size = l.file->size();
+    const uchar* d = l.file->map(0, size);
+
+    // only sha1 repositories are supported
+    if (!d || size < 8 || memcmp(d, "CGPH", 4) || d[4] != 1 || d[5] != 1) {
+        dbp("WARNING: unsupported commit-graph %1", path);
+        delete l.file;
+        return false;
+    }
+    int chunks = d[6];
+    if (8 + (chunks + 1) * 12 > size) {
+        delete l.file;
+        return false;
+    }
+    for (int i = 0; i < chunks; i++) {
+
+        const uchar* entry = d + 8 + i * 12;
+        quint64 ofs = be64(entry + 4);
+        quint64 next = be64(entry + 16);
+        if (next > quint64(size) || ofs > next)
+            break;
+
+        if (!memcmp(entry, "OIDF", 4))
+            l.fanout = d + ofs;
+        else if (!memcmp(entry, "OIDL", 4))
+            l.oids = d + ofs;
+        else if (!memcmp(entry, "BIDX", 4))
+            l.bidx = d + ofs;
+        else if (!memcmp(entry, "BDAT", 4)) {
+            l.bdat = d + ofs;
+            l.bdatSize = qint64(next - ofs);
+        }
+    }
+    if (!l.fanout || !l.oids) {
+        delete l.file;
+        return false;
+    }
+    l.count = be32(l.fanout + 255 * 4);
+
+    // BDAT starts with hash version, number of hashes and bits per entry
+    if (l.bidx && l.bdat && l.bdatSize >= 12) {
+        l.hashVersion = be32(l.bdat);
+        l.numHashes = be32(l.bdat + 4);
+        if ((l.hashVersion == 1 || l.hashVersion == 2) && l.numHashes > 0)
+            bloomLayers++;
+        else
+            l.bidx = l.bdat = NULL;
+    } else
+        l.bidx = l.bdat = NULL;
+
+    layers.append(l);
+    return true;
+}
+
+bool CommitGraph::find(const uchar* sha, int* layer, uint* pos) const {
+
+    for (int i = 0; i < layers.count(); i++) {
+
+        const Layer& l = layers.at(i);
+        uint lo = sha[0] ? be32(l.fanout + 4 * (sha[0] - 1)) : 0;
+        uint hi = be32(l.fanout + 4 * sha[0]);
+
+        while (lo < hi) {
+            uint mid = lo + (hi - lo) / 2;
+            int cmp = memcmp(l.oids + 20 * mid, sha, 20);
+            if (cmp == 0) {
+                *layer = i;
+                *pos = mid;
+                return true;
+            }
+            if (cmp < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+    }
+    return false;
+}
+
+const CommitGraph::BloomKey CommitGraph::bloomKey(const QByteArray& path) {
+
+    BloomKey k;
+    for (int v = 0; v < 2; v++) {
+        k.hash0[v] = murmur3(BLOOM_SEED_0, path, v == 1);
+        k.hash1[v] = murmur3(BLOOM_SEED_1, path, v == 1);
+    }
+    return k;
+}
+
+const CommitGraph::BloomKeys CommitGraph::pathKeys(const QString& path) {
+// git adds to the filters also all the leading directories of a changed
+// path, checking them too greatly reduces the false positive rate
+
+    BloomKeys keys;
+    QByteArray p(path.toUtf8());
+    while (p.endsWith('/'))
+        p.chop(1);
+
+    if (p.isEmpty())
+        return keys;
+
+    keys.append(bloomKey(p));
+    int sep = p.lastIndexOf('/');
+    while (sep > 0) {
+        p.truncate(sep);
+        keys.append(bloomKey(p));
+        sep = p.lastIndexOf('/');
+    }
+    return keys;
+}
+
+int CommitGraph::filterContains(const Layer& l, uint pos, const BloomKeys& keys) const {
+// returns 0 if path is certainly not in the filter, 1 if it may be, -1 if unknown
+
+    if (!l.bidx)
+        return -1;
+
+    quint32 start = pos ? be32(l.bidx + 4 * (pos - 1)) : 0;
+    quint32 end = be32(l.bidx + 4 * pos);
+    if (end <= start || 12 + qint64(end) > l.bdatSize)
+        return -1; // filter not computed, as for too many changes
+
+    const uchar* data = l.bdat + 12 + start;
+    const quint64 bits = quint64(end - start) * 8;
+    const int v = l.hashVersion - 1;
+
+    for (int k = 0; k < keys.count(); k++) {
+
+        const BloomKey& key = keys.at(k);
+        for (uint i = 0; i < l.numHashes; i++) {
+            quint64 bit = quint32(key.hash0[v] + i * key.hash1[v]) % bits;
+            if (!(data[bit >> 3] & (1 << (bit & 7))))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+bool CommitGraph::maybeChanged(const QByteArray& rawSha, const BloomKeys& keys) const {
+
+    int layer;
+    uint pos;
+    if (keys.isEmpty() || !find(reinterpret_cast<const uchar*>(rawSha.constData()), &layer, &pos))
+        return true;
+
+    return (filterContains(layers.at(layer), pos, keys) != 0);
+}
+
+bool CommitGraph::maybeChangedAny(const QByteArray& rawSha, const QVector<BloomKeys>& paths) const {
+
+    int layer;
+    uint pos;
+    if (!find(reinterpret_cast<const uchar*>(rawSha.constData()), &layer, &pos))
+        return true;
+
+    for (int i = 0; i < paths.count(); i++)
+        if (paths.at(i).isEmpty() || filterContains(layers.at(layer), pos, paths.at(i)) != 0)
+            return true;
+
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef COMMITGRAPH_H
+#define COMMITGRAPH_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class QFile;
+
+/*
+ * Reader for the changed-path Bloom filters stored in the commit-graph
+ * file, as written by 'git commit-graph write --changed-paths'. Both
+ * a single commit-graph file and split commit-graph chains are read.
+ *
+ * Filters answer "this commit certainly did not touch the path" or
+ * "it may have touched it", so they are used only to skip revisions
+ * before looking at the real data. When the file or the chunks are
+ * missing every query answers "maybe".
+ */
+class CommitGraph {
+public:
+    struct BloomKey {
+        quint32 hash0[2]; // indexed by hash version - 1
+        quint32 hash1[2];
+    };
+    typedef QVector<BloomKey> BloomKeys;
+
+    explicit CommitGraph(const QString& gitDir);
+    ~CommitGraph();
+
+    bool open();
+    bool hasBloomFilters() const { return bloomLayers > 0; }
+    bool maybeChanged(const QByteArray& rawSha, const BloomKeys& keys) const;
+    bool maybeChangedAny(const QByteArray& rawSha, const QVector<BloomKeys>& paths) const;
+
+    static const BloomKeys pathKeys(const QString& path);
+
+private:
+    struct Layer {
+        Layer() : file(NULL), fanout(NULL), oids(NULL), bidx(NULL), bdat(NULL),
+                  bdatSize(0), count(0), hashVersion(0), numHashes(0) {}
+
+        QFile* file;
+        const uchar* fanout;
+        const uchar* oids;
+        const uchar* bidx;
+        const uchar* bdat;
+        qint64 bdatSize;
+        uint count;
+        uint hashVersion;
+        uint numHashes;
+    };
+
+    bool openLayer(const QString& path);
+    bool find(const uchar* sha, int* layer, uint* pos) const;
+    int filterContains(const Layer& l, uint pos, const BloomKeys& keys) const;
+    static const BloomKey bloomKey(const QByteArray& path);
+
+    QString objDir;
+    QList<Layer> layers;
+    int bloomLayers;
+};
+
+#endif // COMMITGRAPH_H
@@ -0,0 +1,323 @@
+#include "commitwalker.h"
+
+#include <algorithm>
+
+#include "objectdb.h"
+
+static const char* lineEnd(const char* p, const char* end) {
+
+    const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    return (nl ? nl : end);
+}
+
+static bool startsWith(const char* p, const char* end, const char* prefix, int len) {
+
+    return (end - p >= len && !memcmp(p, prefix, len));
+}
+
+static void appendIdent(QByteArray* out, const char* p, const char* end, uint* date = NULL) {
+// "Name <email> 1234567890 +0100" -> "Name<email>", as with "%an<%ae>"
+
+    const char* lt = static_cast<const char*>(memchr(p, '<', end - p));
+    const char* gt = lt ? static_cast<const char*>(memchr(lt, '>', end - lt)) : NULL;
+    if (!lt || !gt) {
+        out->append(p, int(end - p));
+        return;
+    }
+    const char* nameEnd = lt;
+    while (nameEnd > p && nameEnd[-1] == ' ')
+        --nameEnd;
+
+    out->append(p, int(nameEnd - p));
+    out->append(lt, int(gt - lt + 1));
+
+    if (date) {
+        uint d = 0;
+        for (const char* c = gt + 1; c < end && *c != '\n'; ++c) {
+            if (*c == ' ' && d)
+                break;
+            if (*c >= '0' && *c <= '9')
+                d = d * 10 + (*c - '0');
+        }
+        *date = d;
+    }
+}
+
+static uint identDate(const char* p, const char* end) {
+
+    const char* gt = static_cast<const char*>(memchr(p, '>', end - p));
+    uint d = 0;
+    if (gt)
+        for (const char* c = gt + 2; c < end && *c >= '0' && *c <= '9'; ++c)
+            d = d * 10 + (*c - '0');
+    return d;
+}
+
+CommitWalker::CommitWalker(const QString& gitDir) : nextOut(0), sorted(false) {
+
+    odb = new ObjectDb(gitDir);
+}
+
+CommitWalker::~CommitWalker() {
+
+    delete odb;
+}
+
+bool CommitWalker::start(const QStringList& tips) {
+
+    if (!odb->open()) {
+        error = odb->errorString();
+        return false;
+    }
+    for (int i = 0; i < tips.count(); i++) {
+
+        if (tips.at(i).length() != 40)
+            continue;
+
+        // refs could point to tags of tags, peel them down to the commit
+        QByteArray sha(ObjectDb::toRaw(tips.at(i)));
+        ObjectDb::ObjectType type = ObjectDb::OBJ_NONE;
+        QByteArray data;
+        for (int depth = 0; depth <= 10; depth++) {
+
+            if (!odb->read(sha, &type, &data)) { // e.g. missing in a partial clone
+                type = ObjectDb::OBJ_NONE;
+                break;
+            }
+            if (type != ObjectDb::OBJ_TAG)
+                break;
+
+            // "object <sha>\n" comes first, a bad tag is skipped as a missing object
+            if (data.size() < 47 || !data.startsWith("object ")) {
+                type = ObjectDb::OBJ_NONE;
+                break;
+            }
+            sha = ObjectDb::toRaw(data.constData() + 7);
+        }
+        if (type != ObjectDb::OBJ_COMMIT) // could be a tag to a tree or a blob
+            continue;
+
+        lookupOrAdd(sha);
+    }
+    if (nodes.isEmpty()) {
+        error = "no commits found";
+        return false;
+    }
+    return true;
+}
+
+int CommitWalker::lookupOrAdd(const QByteArray& rawSha) {
+
+    QHash<QByteArray, int>::const_iterator it(nodeIdx.constFind(rawSha));
+    if (it != nodeIdx.constEnd())
+        return *it;
+
+    int idx = nodes.count();
+    Node n;
+    n.sha = rawSha;
+    nodes.append(n);
+    nodeIdx.insert(rawSha, idx);
+    toParse.push(idx);
+    return idx;
+}
+
+bool CommitWalker::walk(int maxCommits) {
+
+    while (!toParse.isEmpty() && maxCommits-- > 0)
+        parseNode(toParse.pop());
+
+    if (toParse.isEmpty() && !sorted)
+        sort();
+
+    return isWalked();
+}
+
+bool CommitWalker::parseNode(int idx) {
+
+    ObjectDb::ObjectType type;
+    QByteArray data;
+
+    if (!odb->read(nodes[idx].sha, &type, &data) || type != ObjectDb::OBJ_COMMIT) {
+        // shallow clones and partial clones have parents
+        // not available locally, git shows them as roots
+        nodes[idx].missing = true;
+        return false;
+    }
+    QVector<int> pl;
+    const char* p = data.constData();
+    const char* end = p + data.size();
+    uint date = 0;
+
+    while (p < end && *p != '\n') { // header ends with a blank line
+
+        const char* eol = lineEnd(p, end);
+        if (startsWith(p, eol, "parent ", 7) && eol - p >= 47)
+            pl.append(lookupOrAdd(ObjectDb::toRaw(p + 7)));
+
+        else if (startsWith(p, eol, "committer ", 10))
+            date = identDate(p + 10, eol);
+
+        p = eol + 1;
+    }
+    Node& n = nodes[idx]; // nodes could be reallocated by lookupOrAdd()
+    n.firstParent = parents.count();
+    n.parentsCnt = pl.count();
+    n.date = date;
+    parents += pl;
+    return true;
+}
+
+void CommitWalker::sort() {
+/*
+   Same algorithm of git sort_in_topological_order() with
+   REV_SORT_IN_GRAPH_ORDER: tips are taken newest first, then
+   a commit is shown only after all its children and, among the
+   ready ones, the last queued wins so that a line of development
+   is not interleaved with the others.
+*/
+    int cnt = nodes.count();
+    QVector<int> inDegree(cnt, 0);
+    for (int i = 0; i < cnt; i++) {
+        const Node& n = nodes.at(i);
+        for (int p = 0; p < n.parentsCnt; p++)
+            inDegree[parents.at(n.firstParent + p)]++;
+    }
+    QVector<int> tips;
+    for (int i = 0; i < cnt; i++)
+        if (inDegree.at(i) == 0 && !nodes.at(i).missing)
+            tips.append(i);
+
+    // newest tip must be the first one to be popped
+    struct OlderFirst {
+        explicit OlderFirst(const QVector<Node>& n) : nodes(n) {}
+        bool operator()(int a, int b) const { return nodes.at(a).date < nodes.at(b).date; }
+        const QVector<Node>& nodes;
+    };
+    std::stable_sort(tips.begin(), tips.end(), OlderFirst(nodes));
+
+    QStack<int> ready;
+    for (int i = 0; i < tips.count(); i++)
+        ready.push(tips.at(i));
+
+    order.clear();
+    order.reserve(cnt);
+    while (!ready.isEmpty()) {
+
+        int idx = ready.pop();
+        const Node& n = nodes.at(idx);
+        order.append(idx);
+
+        for (int p = 0; p < n.parentsCnt; p++) {
+            int par = parents.at(n.firstParent + p);
+            if (--inDegree[par] == 0 && !nodes.at(par).missing)
+                ready.push(par);
+        }
+    }
+    sorted = true;
+}
+
+int CommitWalker::format(QByteArray* out, int maxBytes) {
+
+    if (!sorted)
+        return 0;
+
+    int cnt = 0;
+    while (nextOut < order.count() && out->size() < maxBytes)
+        if (formatNode(order.at(nextOut++), out))
+            cnt++;
+
+    return cnt;
+}
+
+bool CommitWalker::formatNode(int idx, QByteArray* out) {
+
+    ObjectDb::ObjectType type;
+    QByteArray data;
+    const Node& n = nodes.at(idx);
+
+    if (!odb->read(n.sha, &type, &data)) {
+        error = odb->errorString();
+        return false;
+    }
+    QByteArray rec;
+    rec.reserve(data.size() + 128);
+
+    // "%m%HX%PX%n"
+    rec.append('>').append(n.sha.toHex()).append('X');
+    bool first = true;
+    for (int p = 0; p < n.parentsCnt; p++) {
+        const Node& par = nodes.at(parents.at(n.firstParent + p));
+        if (par.missing)
+            continue;
+
+        if (!first)
+            rec.append(' ');
+        rec.append(par.sha.toHex());
+        first = false;
+    }
+    rec.append("X\n");
+
+    const char* p = data.constData();
+    const char* end = p + data.size();
+    const char* author = NULL;
+    const char* authorEnd = NULL;
+    const char* committer = NULL;
+    const char* committerEnd = NULL;
+
+    while (p < end && *p != '\n') {
+
+        const char* eol = lineEnd(p, end);
+        if (startsWith(p, eol, "author ", 7)) {
+            author = p + 7;
+            authorEnd = eol;
+
+        } else if (startsWith(p, eol, "committer ", 10)) {
+            committer = p + 10;
+            committerEnd = eol;
+        }
+        p = eol + 1;
+    }
+    if (p < end) // skip the blank line
+        ++p;
+
+    // "%cn<%ce>%n%an<%ae>%n%at%n"
+    if (committer)
+        appendIdent(&rec, committer, committerEnd);
+    rec.append('\n');
+
+    uint autDate = 0;
+    if (author)
+        appendIdent(&rec, author, authorEnd, &autDate);
+    rec.append('\n');
+    rec.append(QByteArray::number(autDate)).append('\n');
+
+    // "%s%n%b", subject is the first paragraph with lines joined
+    while (p < end && *p == '\n')
+        ++p;
+
+    bool firstLine = true;
+    while (p < end && *p != '\n') {
+        const char* eol = lineEnd(p, end);
+        const char* e = eol;
+        while (e > p && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r'))
+            --e;
+
+        if (!firstLine)
+            rec.append(' ');
+        rec.append(p, int(e - p));
+        firstLine = false;
+        p = eol + 1;
+    }
+    rec.append('\n');
+
+    while (p < end && *p == '\n')
+        ++p;
+
+    if (p < end)
+        rec.append(p, int(end - p));
+
+    // "log size" counts the formatted record only
+    out->append("log size ").append(QByteArray::number(rec.size())).append('\n');
+    out->append(rec).append('\0');
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef COMMITWALKER_H
+#define COMMITWALKER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QStack>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class ObjectDb;
+
+/*
+ * Walks the commit graph directly from the object database and
+ * produces the same records 'git log --topo-order --log-size -z
+ * --parents --boundary' would produce with the main history
+ * format, so that they can be fed unchanged to Git::addChunk().
+ *
+ * Work is split in two phases, both can be run in small steps so
+ * that caller can keep the GUI responsive: first the whole graph
+ * is walked reading parents and dates only, then commits are
+ * sorted and formatted in topological order. Commit objects are
+ * read again while formatting, this keeps memory usage low.
+ */
+class CommitWalker {
+public:
+    explicit CommitWalker(const QString& gitDir);
+    ~CommitWalker();
+
+    bool start(const QStringList& tips);
+    bool walk(int maxCommits); // returns true when graph is complete
+    bool isWalked() const { return toParse.isEmpty(); }
+    int format(QByteArray* out, int maxBytes);
+    bool atEnd() const { return isWalked() && sorted && nextOut >= order.count(); }
+    int count() const { return nodes.count(); }
+    const QString& errorString() const { return error; }
+
+private:
+    struct Node {
+        Node() : firstParent(0), parentsCnt(0), date(0), missing(false) {}
+
+        QByteArray sha; // raw
+        int firstParent;
+        int parentsCnt;
+        uint date;
+        bool missing; // as in shallow clones
+    };
+
+    int lookupOrAdd(const QByteArray& rawSha);
+    bool parseNode(int idx);
+    void sort();
+    bool formatNode(int idx, QByteArray* out);
+
+    ObjectDb* odb;
+    QVector<Node> nodes;
+    QVector<int> parents; // flat list of parent indices, see Node::firstParent
+    QHash<QByteArray, int> nodeIdx;
+    QStack<int> toParse;
+    QVector<int> order;
+    int nextOut;
+    bool sorted;
+    QString error;
+};
+
+#endif // COMMITWALKER_H
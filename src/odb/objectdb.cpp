@@ -0,0 +1,649 @@
+#include "objectdb.h"
+
+#include <QDir>
+#include <QFile>
+#include <QtEndian>
+
+#include <zlib.h>
+
+#include "common.h"
+
+static inline quint32 be32(const uchar* p) { return qFromBigEndian<quint32>(p); }
+static inline quint64 be64(const uchar* p) { return qFromBigEndian<quint64>(p); }
+
+static inline quint64 cacheKey(int packIdx, qint64 ofs) {
+
+    return (quint64(packIdx) << 48) | quint64(ofs);
+}
+
+static bool inflateBlock(const uchar* src, qint64 avail, qint64 size, QByteArray* out) {
+// inflate a zlib stream of known uncompressed size, trailing data is ignored
+
+    if (size < 0 || size > INT_MAX - 1)
+        return false;
+
+    // one extra byte let us detect streams longer than expected
+    QByteArray buf(int(size) + 1, Qt::Uninitialized);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK)
+        return false;
+
+    zs.next_in = const_cast<Bytef*>(src);
+    zs.avail_in = uInt(qMin(avail, qint64(INT_MAX)));
+    zs.next_out = reinterpret_cast<Bytef*>(buf.data());
+    zs.avail_out = uInt(size + 1);
+
+    int ret = inflate(&zs, Z_FINISH);
+    bool ok = (ret == Z_STREAM_END && zs.total_out == uLong(size));
+    inflateEnd(&zs);
+
+    buf.resize(int(size));
+    *out = buf;
+    return ok;
+}
+
+static bool inflateAll(const QByteArray& src, QByteArray* out) {
+// inflate a zlib stream of unknown size, used for loose objects
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK)
+        return false;
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(src.constData()));
+    zs.avail_in = uInt(src.size());
+
+    QByteArray buf;
+    int ret;
+    do {
+        int pos = buf.size();
+        int chunk = qMax(4096, pos);
+        buf.resize(pos + chunk);
+        zs.next_out = reinterpret_cast<Bytef*>(buf.data() + pos);
+        zs.avail_out = uInt(chunk);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        buf.resize(pos + chunk - int(zs.avail_out));
+
+    } while (ret == Z_OK);
+
+    inflateEnd(&zs);
+    *out = buf;
+    return (ret == Z_STREAM_END);
+}
+
+static qint64 deltaSize(const uchar*& p, const uchar* end) {
+
+    qint64 v = 0;
+    int shift = 0;
+    uchar b;
+    do {
+        if (p >= end || shift > 56)
+            return -1;
+
+        b = *p++;
+        v |= qint64(b & 0x7f) << shift;
+        shift += 7;
+
+    } while (b & 0x80);
+
+    return v;
+}
+
+ObjectDb::ObjectDb(const QString& gitDir) : gDir(gitDir) {
+
+    deltaBaseCache.setMaxCost(DELTA_CACHE_SIZE);
+}
+
+ObjectDb::~ObjectDb() {
+
+    for (int i = 0; i < packs.count(); i++) {
+        delete packs[i].idxFile; // files are unmapped on close
+        delete packs[i].packFile;
+    }
+    for (int i = 0; i < midxs.count(); i++)
+        delete midxs[i].file;
+}
+
+const QByteArray ObjectDb::toRaw(const char* hexSha) {
+
+    return QByteArray::fromHex(QByteArray::fromRawData(hexSha, 40));
+}
+
+bool ObjectDb::open() {
+
+    // linked worktrees keep their objects in the common dir
+    QString baseDir(gDir);
+    QFile common(gDir + "/commondir");
+    if (common.open(QIODevice::ReadOnly)) {
+        const QString cd(QString::fromLocal8Bit(common.readAll()).trimmed());
+        baseDir = QDir::isAbsolutePath(cd) ? cd : gDir + '/' + cd;
+    }
+    return openObjectDir(QDir::cleanPath(baseDir + "/objects"), 0);
+}
+
+bool ObjectDb::openObjectDir(const QString& objDir, int depth) {
+
+    if (!QDir(objDir).exists())
+        return setError("object directory '" + objDir + "' not found");
+
+    if (objectDirs.contains(objDir))
+        return true;
+
+    objectDirs.append(objDir);
+
+    QDir packDir(objDir + "/pack");
+    const QStringList idxList(packDir.entryList(QStringList("pack-*.idx"), QDir::Files, QDir::Name));
+    FOREACH_SL (it, idxList)
+        if (!openPack(packDir.absoluteFilePath(*it)))
+            return false;
+
+    MultiPackIndex m;
+    if (openMultiPackIndex(objDir, m))
+        midxs.append(m);
+    else if (m.file) {
+        delete m.file;
+        return false;
+    }
+
+    // git allows up to 5 levels of nested alternates
+    QFile alt(objDir + "/info/alternates");
+    if (depth < 5 && alt.open(QIODevice::ReadOnly)) {
+
+        const QStringList alts(QString::fromLocal8Bit(alt.readAll()).split('\n', QString::SkipEmptyParts));
+        FOREACH_SL (it, alts) {
+            if ((*it).startsWith('#'))
+                continue;
+
+            const QString path(QDir::isAbsolutePath(*it) ? *it : objDir + '/' + *it);
+            if (!openObjectDir(QDir::cleanPath(path), depth + 1))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool ObjectDb::openPack(const QString& idxPath) {
+
+    Pack p;
+    p.name = idxPath.left(idxPath.length() - 4);
+    p.idxFile = new QFile(idxPath);
+    p.packFile = new QFile(p.name + ".pack");
+
+    if (!mapPack(p)) {
+        delete p.idxFile;
+        delete p.packFile;
+        return false;
+    }
+    packByName.insert(p.name, packs.count());
+    packs.append(p);
+    return true;
+}
+
+bool ObjectDb::mapPack(Pack& p) {
+
+    if (!p.idxFile->open(QIODevice::ReadOnly) || !p.packFile->open(QIODevice::ReadOnly))
+        return setError("unable to open pack '" + p.name + "'");
+
+    p.idxSize = p.idxFile->size();
+    p.packSize = p.packFile->size();
+    p.idx = p.idxFile->map(0, p.idxSize);
+    p.pack = p.packFile->map(0, p.packSize);
+
+    if (!p.idx || !p.pack)
+        return setError("unable to map pack '" + p.name + "'");
+
+    // only version 2 indexes are supported, git writes
+    // them by default since 1.5.2
+    if (p.idxSize < 8 + 1024 + 40 || memcmp(p.idx, "\377tOc", 4) || be32(p.idx + 4) != 2)
+        return setError("unsupported index format for pack '" + p.name + "'");
+
+    if (p.packSize < 32 || memcmp(p.pack, "PACK", 4))
+        return setError("bad pack file '" + p.name + "'");
+
+    p.count = be32(p.idx + 8 + 255 * 4);
+    if (8 + 1024 + qint64(p.count) * 28 > p.idxSize)
+        return setError("truncated index for pack '" + p.name + "'");
+
+    return true;
+}
+
+bool ObjectDb::openMultiPackIndex(const QString& objDir, MultiPackIndex& m) {
+
+    const QString path(objDir + "/pack/multi-pack-index");
+    if (!QFile::exists(path))
+        return false;
+
+    m.file = new QFile(path);
+    if (!m.file->open(QIODevice::ReadOnly))
+        return setError("unable to open '" + path + "'");
+
+    qint64 size = m.file->size();
+    const uchar* d = m.file->map(0, size);
+    if (!d || size < 12 || memcmp(d, "MIDX", 4) || d[4] != 1 || d[5] != 1)
+        return setError("unsupported multi-pack-index '" + path + "'");
+
+    int chunks = d[6];
+    uint packCnt = be32(d + 8);
+    const uchar* pnam = NULL;
+    const uchar* pnamEnd = NULL;
+
+    if (12 + (chunks + 1) * 12 > size)
+        return setError("truncated multi-pack-index '" + path + "'");
+
+    for (int i = 0; i < chunks; i++) {
+
+        const uchar* entry = d + 12 + i * 12;
+        quint64 ofs = be64(entry + 4);
+        quint64 next = be64(entry + 16);
+        if (next > quint64(size) || ofs > next)
+            return setError("bad chunk in multi-pack-index '" + path + "'");
+
+        if (!memcmp(entry, "PNAM", 4)) {
+            pnam = d + ofs;
+            pnamEnd = d + next;
+        } else if (!memcmp(entry, "OIDF", 4))
+            m.fanout = d + ofs;
+        else if (!memcmp(entry, "OIDL", 4))
+            m.oids = d + ofs;
+        else if (!memcmp(entry, "OOFF", 4))
+            m.offsets = d + ofs;
+        else if (!memcmp(entry, "LOFF", 4))
+            m.largeOffsets = d + ofs;
+    }
+    if (!pnam || !m.fanout || !m.oids || !m.offsets)
+        return setError("missing chunks in multi-pack-index '" + path + "'");
+
+    m.count = be32(m.fanout + 255 * 4);
+
+    // pack names are stored sorted and '\0' terminated
+    for (uint i = 0; i < packCnt; i++) {
+
+        const char* nm = reinterpret_cast<const char*>(pnam);
+        int len = int(qstrnlen(nm, uint(pnamEnd - pnam)));
+        if (len == pnamEnd - pnam)
+            return setError("bad pack names in multi-pack-index '" + path + "'");
+
+        QString name(objDir + "/pack/" + QString::fromLatin1(nm, len));
+        name.chop(4); // remove ".idx"
+        int idx = packByName.value(name, -1);
+        if (idx == -1)
+            return setError("pack '" + name + "' listed in multi-pack-index not found");
+
+        packs[idx].inMidx = true;
+        m.packIds.append(idx);
+        pnam += len + 1;
+        while (pnam < pnamEnd && *pnam == 0) // names are padded
+            ++pnam;
+    }
+    return true;
+}
+
+bool ObjectDb::findInPack(int packIdx, const uchar* sha, qint64* ofs) const {
+
+    int pos = packObjectPos(packIdx, sha);
+    if (pos == -1)
+        return false;
+
+    *ofs = packObjectOffset(packIdx, uint(pos));
+    return true;
+}
+
+bool ObjectDb::findInMidx(const MultiPackIndex& m, const uchar* sha, int* packIdx, qint64* ofs) const {
+
+    uint lo = sha[0] ? be32(m.fanout + 4 * (sha[0] - 1)) : 0;
+    uint hi = be32(m.fanout + 4 * sha[0]);
+
+    while (lo < hi) {
+        uint mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(m.oids + 20 * mid, sha, 20);
+        if (cmp == 0) {
+            uint packId = be32(m.offsets + 8 * mid);
+            quint32 o = be32(m.offsets + 8 * mid + 4);
+            if (packId >= uint(m.packIds.count()))
+                return false;
+
+            *packIdx = m.packIds.at(packId);
+            if ((o & 0x80000000) && m.largeOffsets)
+                *ofs = qint64(be64(m.largeOffsets + 8 * (o & 0x7fffffff)));
+            else
+                *ofs = o;
+            return true;
+        }
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return false;
+}
+
+bool ObjectDb::findPacked(const uchar* sha, int* packIdx, qint64* ofs) {
+
+    for (int i = 0; i < midxs.count(); i++)
+        if (findInMidx(midxs.at(i), sha, packIdx, ofs))
+            return true;
+
+    for (int i = 0; i < packs.count(); i++) {
+        if (!packs.at(i).inMidx && findInPack(i, sha, ofs)) {
+            *packIdx = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ObjectDb::packIndexOf(const QString& packName) const {
+
+    return packByName.value(packName, -1);
+}
+
+int ObjectDb::packObjectCount(int packIdx) const {
+
+    return (packIdx >= 0 && packIdx < packs.count() ? int(packs.at(packIdx).count) : 0);
+}
+
+int ObjectDb::packObjectPos(int packIdx, const uchar* sha) const {
+// position of the object in the index, that is in sha order
+
+    const Pack& p = packs.at(packIdx);
+    const uchar* fanout = p.idx + 8;
+    uint lo = sha[0] ? be32(fanout + 4 * (sha[0] - 1)) : 0;
+    uint hi = be32(fanout + 4 * sha[0]);
+    const uchar* shas = fanout + 1024;
+
+    while (lo < hi) {
+        uint mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(shas + 20 * mid, sha, 20);
+        if (cmp == 0)
+            return int(mid);
+
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+const QByteArray ObjectDb::packObjectSha(int packIdx, uint pos) const {
+
+    const Pack& p = packs.at(packIdx);
+    return QByteArray(reinterpret_cast<const char*>(p.idx + 8 + 1024 + 20 * pos), 20);
+}
+
+qint64 ObjectDb::packObjectOffset(int packIdx, uint pos) const {
+
+    const Pack& p = packs.at(packIdx);
+    const uchar* offsets = p.idx + 8 + 1024 + 24 * qint64(p.count);
+    quint32 o = be32(offsets + 4 * pos);
+    if (!(o & 0x80000000))
+        return o;
+
+    const uchar* large = offsets + 4 * qint64(p.count) + 8 * (o & 0x7fffffff);
+    if (large + 8 > p.idx + p.idxSize)
+        return -1;
+
+    return qint64(be64(large));
+}
+
+bool ObjectDb::contains(const QByteArray& rawSha) {
+
+    int packIdx;
+    qint64 ofs;
+    if (findPacked(reinterpret_cast<const uchar*>(rawSha.constData()), &packIdx, &ofs))
+        return true;
+
+    const QString hex(QString::fromLatin1(rawSha.toHex()));
+    for (int i = 0; i < objectDirs.count(); i++)
+        if (QFile::exists(objectDirs.at(i) + '/' + hex.left(2) + '/' + hex.mid(2)))
+            return true;
+
+    return false;
+}
+
+bool ObjectDb::read(const QByteArray& rawSha, ObjectType* type, QByteArray* data) {
+
+    if (rawSha.size() != 20)
+        return setError("bad object name");
+
+    int packIdx;
+    qint64 ofs;
+    if (findPacked(reinterpret_cast<const uchar*>(rawSha.constData()), &packIdx, &ofs))
+        return readPacked(packIdx, ofs, type, data);
+
+    return readLoose(rawSha, type, data);
+}
+
+bool ObjectDb::readLoose(const QByteArray& rawSha, ObjectType* type, QByteArray* data) {
+
+    const QString hex(QString::fromLatin1(rawSha.toHex()));
+    for (int i = 0; i < objectDirs.count(); i++) {
+
+        QFile f(objectDirs.at(i) + '/' + hex.left(2) + '/' + hex.mid(2));
+        if (!f.open(QIODevice::ReadOnly))
+            continue;
+
+        QByteArray buf;
+        if (!inflateAll(f.readAll(), &buf))
+            return setError("corrupt loose object " + hex);
+
+        // header is "<type> <size>\0"
+        int sp = buf.indexOf(' ');
+        int nul = buf.indexOf('\0');
+        if (sp == -1 || nul < sp)
+            return setError("bad header in loose object " + hex);
+
+        const QByteArray t(buf.left(sp));
+        if (t == "commit")
+            *type = OBJ_COMMIT;
+        else if (t == "tree")
+            *type = OBJ_TREE;
+        else if (t == "blob")
+            *type = OBJ_BLOB;
+        else if (t == "tag")
+            *type = OBJ_TAG;
+        else
+            return setError("unknown type in loose object " + hex);
+
+        *data = buf.mid(nul + 1);
+        return true;
+    }
+    return setError("object " + hex + " not found");
+}
+
+bool ObjectDb::entryHeader(const Pack& p, qint64 ofs, ObjectType* type, qint64* size,
+                           qint64* dataOfs, qint64* baseOfs, QByteArray* baseSha) const {
+
+    // the last 20 bytes are the pack checksum
+    const uchar* end = p.pack + p.packSize - 20;
+    const uchar* c = p.pack + ofs;
+    if (ofs < 12 || c >= end)
+        return false;
+
+    uchar b = *c++;
+    *type = ObjectType((b >> 4) & 7);
+    qint64 sz = b & 15;
+    int shift = 4;
+    while (b & 0x80) {
+        if (c >= end || shift > 56)
+            return false;
+
+        b = *c++;
+        sz += qint64(b & 0x7f) << shift;
+        shift += 7;
+    }
+    *size = sz;
+
+    if (*type == OBJ_OFS_DELTA) {
+        if (c >= end)
+            return false;
+
+        b = *c++;
+        qint64 rel = b & 0x7f;
+        while (b & 0x80) {
+            if (c >= end)
+                return false;
+
+            b = *c++;
+            rel = ((rel + 1) << 7) | (b & 0x7f);
+        }
+        *baseOfs = ofs - rel;
+        if (*baseOfs < 12)
+            return false;
+
+    } else if (*type == OBJ_REF_DELTA) {
+        if (c + 20 > end)
+            return false;
+
+        *baseSha = QByteArray(reinterpret_cast<const char*>(c), 20);
+        c += 20;
+
+    } else if (*type == OBJ_NONE || *type > OBJ_TAG)
+        return false;
+
+    *dataOfs = c - p.pack;
+    return true;
+}
+
+bool ObjectDb::readPacked(int packIdx, qint64 ofs, ObjectType* type, QByteArray* data) {
+/*
+   Walk down the delta chain until a full object, or a cached delta
+   base, is found. Then apply the deltas from the deepest one up.
+   Chains are walked iteratively because they can be very long in
+   aggressively packed repositories.
+*/
+    struct Link {
+        int pack;
+        qint64 ofs;
+        qint64 dataOfs;
+        qint64 size;
+    };
+    QVector<Link> chain;
+    ObjectType baseType = OBJ_NONE;
+    QByteArray base;
+    int curPack = packIdx;
+    qint64 curOfs = ofs;
+
+    while (true) {
+
+        CachedObject* co = deltaBaseCache.object(cacheKey(curPack, curOfs));
+        if (co) {
+            baseType = co->type;
+            base = co->data;
+            break;
+        }
+        const Pack& p = packs.at(curPack);
+        ObjectType t;
+        qint64 size, dataOfs, baseOfs = 0;
+        QByteArray baseSha;
+
+        if (!entryHeader(p, curOfs, &t, &size, &dataOfs, &baseOfs, &baseSha))
+            return setError("corrupt entry in pack '" + p.name + "'");
+
+        if (t == OBJ_OFS_DELTA || t == OBJ_REF_DELTA) {
+
+            Link l = { curPack, curOfs, dataOfs, size };
+            chain.append(l);
+
+            if (t == OBJ_OFS_DELTA)
+                curOfs = baseOfs;
+
+            else if (!findPacked(reinterpret_cast<const uchar*>(baseSha.constData()), &curPack, &curOfs)) {
+                if (!readLoose(baseSha, &baseType, &base))
+                    return false;
+                break;
+            }
+            continue;
+        }
+        if (!inflateBlock(p.pack + dataOfs, p.packSize - dataOfs, size, &base))
+            return setError("corrupt object data in pack '" + p.name + "'");
+
+        baseType = t;
+        if (!chain.isEmpty())
+            deltaBaseCache.insert(cacheKey(curPack, curOfs), new CachedObject(t, base), base.size());
+        break;
+    }
+    for (int i = chain.count() - 1; i >= 0; i--) {
+
+        const Link& l = chain.at(i);
+        const Pack& p = packs.at(l.pack);
+        QByteArray delta, result;
+
+        if (!inflateBlock(p.pack + l.dataOfs, p.packSize - l.dataOfs, l.size, &delta))
+            return setError("corrupt delta data in pack '" + p.name + "'");
+
+        if (!applyDelta(base, delta, &result))
+            return setError("bad delta in pack '" + p.name + "'");
+
+        base = result;
+        if (i > 0) // intermediate results are bases of the next delta
+            deltaBaseCache.insert(cacheKey(l.pack, l.ofs), new CachedObject(baseType, base), base.size());
+    }
+    *type = baseType;
+    *data = base;
+    return true;
+}
+
+bool ObjectDb::applyDelta(const QByteArray& base, const QByteArray& delta, QByteArray* result) const {
+
+    const uchar* p = reinterpret_cast<const uchar*>(delta.constData());
+    const uchar* end = p + delta.size();
+
+    qint64 srcSize = deltaSize(p, end);
+    qint64 dstSize = deltaSize(p, end);
+    if (srcSize != base.size() || dstSize < 0 || dstSize > INT_MAX)
+        return false;
+
+    QByteArray out(int(dstSize), Qt::Uninitialized);
+    char* dst = out.data();
+    const char* dstEnd = dst + dstSize;
+    const char* src = base.constData();
+
+    while (p < end) {
+
+        uchar cmd = *p++;
+        if (cmd & 0x80) { // copy from base
+
+            int n = 0;
+            for (int b = 0; b < 7; b++)
+                n += (cmd >> b) & 1;
+
+            if (p + n > end)
+                return false;
+
+            quint32 cpOfs = 0, cpSize = 0;
+            if (cmd & 0x01) cpOfs  = *p++;
+            if (cmd & 0x02) cpOfs |= quint32(*p++) << 8;
+            if (cmd & 0x04) cpOfs |= quint32(*p++) << 16;
+            if (cmd & 0x08) cpOfs |= quint32(*p++) << 24;
+            if (cmd & 0x10) cpSize  = *p++;
+            if (cmd & 0x20) cpSize |= quint32(*p++) << 8;
+            if (cmd & 0x40) cpSize |= quint32(*p++) << 16;
+            if (cpSize == 0)
+                cpSize = 0x10000;
+
+            if (qint64(cpOfs) + cpSize > srcSize || dst + cpSize > dstEnd)
+                return false;
+
+            memcpy(dst, src + cpOfs, cpSize);
+            dst += cpSize;
+
+        } else if (cmd) { // insert literal data
+
+            if (p + cmd > end || dst + cmd > dstEnd)
+                return false;
+
+            memcpy(dst, p, cmd);
+            dst += cmd;
+            p += cmd;
+        } else
+            return false; // reserved
+    }
+    if (dst != dstEnd)
+        return false;
+
+    *result = out;
+    return true;
+}
@@ -0,0 +1,118 @@
+#ifndef OBJECTDB_H
+#define OBJECTDB_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QFile;
+
+/*
+ * Read only access to a git object database without spawning git.
+ *
+ * Objects are looked up first through the multi-pack-index (if any),
+ * then in the pack indexes not covered by it and finally among the
+ * loose objects. Alternates are followed one level deep.
+ *
+ * Object names are always passed as 20 bytes raw sha, use toRaw() and
+ * toHex() to convert from/to the usual 40 chars representation.
+ */
+class ObjectDb {
+public:
+    enum ObjectType {
+        OBJ_NONE      = 0,
+        OBJ_COMMIT    = 1,
+        OBJ_TREE      = 2,
+        OBJ_BLOB      = 3,
+        OBJ_TAG       = 4,
+        OBJ_OFS_DELTA = 6,
+        OBJ_REF_DELTA = 7
+    };
+
+    explicit ObjectDb(const QString& gitDir);
+    ~ObjectDb();
+
+    bool open();
+    bool read(const QByteArray& rawSha, ObjectType* type, QByteArray* data);
+    bool contains(const QByteArray& rawSha);
+    const QString& errorString() const { return error; }
+    const QString& gitDir() const { return gDir; }
+    const QStringList& objectDirectories() const { return objectDirs; }
+
+    // pack level access, used by bitmap reader
+    int packIndexOf(const QString& packName) const;
+    int packObjectCount(int packIdx) const;
+    int packObjectPos(int packIdx, const uchar* rawSha) const;
+    const QByteArray packObjectSha(int packIdx, uint pos) const;
+    qint64 packObjectOffset(int packIdx, uint pos) const;
+
+    static const QByteArray toRaw(const char* hexSha);
+    static const QByteArray toRaw(const QString& hexSha) { return toRaw(hexSha.toLatin1().constData()); }
+    static const QByteArray toHex(const QByteArray& rawSha) { return rawSha.toHex(); }
+
+    // delta base cache budget, in bytes
+    static const int DELTA_CACHE_SIZE = 32 * 1024 * 1024;
+
+private:
+    struct Pack {
+        Pack() : idxFile(NULL), packFile(NULL), idx(NULL), pack(NULL),
+                 idxSize(0), packSize(0), count(0), inMidx(false) {}
+
+        QString name; // without extension
+        QFile* idxFile;
+        QFile* packFile;
+        const uchar* idx;
+        const uchar* pack;
+        qint64 idxSize;
+        qint64 packSize;
+        uint count;
+        bool inMidx;
+    };
+
+    struct MultiPackIndex {
+        MultiPackIndex() : file(NULL), fanout(NULL), oids(NULL),
+                           offsets(NULL), largeOffsets(NULL), count(0) {}
+
+        QFile* file;
+        const uchar* fanout;
+        const uchar* oids;
+        const uchar* offsets;
+        const uchar* largeOffsets;
+        uint count;
+        QVector<int> packIds; // midx pack id -> index in packs
+    };
+
+    bool openObjectDir(const QString& objDir, int depth);
+    bool openPack(const QString& idxPath);
+    bool openMultiPackIndex(const QString& objDir, MultiPackIndex& m);
+    bool mapPack(Pack& p);
+    bool findInPack(int packIdx, const uchar* sha, qint64* ofs) const;
+    bool findInMidx(const MultiPackIndex& m, const uchar* sha, int* packIdx, qint64* ofs) const;
+    bool findPacked(const uchar* sha, int* packIdx, qint64* ofs);
+    bool readPacked(int packIdx, qint64 ofs, ObjectType* type, QByteArray* data);
+    bool readLoose(const QByteArray& rawSha, ObjectType* type, QByteArray* data);
+    bool entryHeader(const Pack& p, qint64 ofs, ObjectType* type, qint64* size,
+                     qint64* dataOfs, qint64* baseOfs, QByteArray* baseSha) const;
+    bool applyDelta(const QByteArray& base, const QByteArray& delta, QByteArray* result) const;
+    bool setError(const QString& msg) { error = msg; return false; }
+
+    QString gDir;
+    QStringList objectDirs;
+    QList<Pack> packs;
+    QList<MultiPackIndex> midxs;
+    QHash<QString, int> packByName;
+    QString error;
+
+    struct CachedObject {
+        CachedObject(ObjectType t, const QByteArray& d) : type(t), data(d) {}
+        ObjectType type;
+        QByteArray data;
+    };
+    QCache<quint64, CachedObject> deltaBaseCache;
+};
+
+#endif // OBJECTDB_H
@@ -0,0 +1,237 @@
+#include "packbitmap.h"
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QPair>
+#include <QtEndian>
+
+#include "common.h"
+#include "objectdb.h"
+
+static inline quint16 be16(const uchar* p) { return qFromBigEndian<quint16>(p); }
+static inline quint32 be32(const uchar* p) { return qFromBigEndian<quint32>(p); }
+static inline quint64 be64(const uchar* p) { return qFromBigEndian<quint64>(p); }
+
+// layout is the one of git pack-bitmap.h, sha1 repositories only
+static const int BITMAP_HEADER_SIZE = 12 + 20;
+static const int BITMAP_OPT_FULL_DAG = 1;
+static const int MAX_XOR_CHAIN = 160;
+
+PackBitmaps::PackBitmaps(const QString& gitDir) : rowsCnt(0) {
+
+    odb = new ObjectDb(gitDir);
+}
+
+PackBitmaps::~PackBitmaps() {
+
+    for (int i = 0; i < bitmaps.count(); i++)
+        delete bitmaps[i].file;
+
+    delete odb;
+}
+
+bool PackBitmaps::open() {
+
+    if (!odb->open())
+        return false;
+
+    const QStringList& dirs(odb->objectDirectories());
+    FOREACH_SL (it, dirs) {
+        QDir packDir(*it + "/pack");
+        const QStringList bmList(packDir.entryList(QStringList("pack-*.bitmap"), QDir::Files, QDir::Name));
+        FOREACH_SL (bm, bmList)
+            openBitmap(packDir.absoluteFilePath(*bm));
+    }
+    return !bitmaps.isEmpty();
+}
+
+qint64 PackBitmaps::readEwah(const uchar* p, qint64 avail, Words* out) {
+/*
+   EWAH compressed bitmap: bit size, number of words, the words
+   and the position of the last marker word. Each marker word
+   holds the running bit, the number of words filled with it and
+   the number of literal words that follow.
+*/
+    if (avail < 8)
+        return -1;
+
+    quint32 bits = be32(p);
+    quint32 cnt = be32(p + 4);
+    qint64 len = 8 + 8 * qint64(cnt) + 4;
+    if (len > avail)
+        return -1;
+
+    const int size = int((qint64(bits) + 63) / 64);
+    out->clear();
+    out->reserve(size);
+
+    const uchar* w = p + 8;
+    quint32 i = 0;
+    while (i < cnt) {
+        quint64 rlw = be64(w + 8 * qint64(i++));
+        quint64 fill = (rlw & 1) ? ~quint64(0) : 0;
+        quint64 run = (rlw >> 1) & 0xffffffff;
+        quint32 lit = quint32(rlw >> 33);
+
+        if (out->count() + qint64(run) > size || i + lit > cnt)
+            return -1;
+
+        out->insert(out->count(), int(run), fill);
+        for (quint32 j = 0; j < lit; j++)
+            out->append(be64(w + 8 * qint64(i++)));
+    }
+    if (out->count() > size)
+        return -1;
+
+    out->resize(size); // trailing zero words are not stored
+    return len;
+}
+
+bool PackBitmaps::openBitmap(const QString& path) {
+
+    const QString packName(path.left(path.length() - 7)); // strip ".bitmap"
+    int packIdx = odb->packIndexOf(packName);
+    if (packIdx == -1)
+        return false;
+
+    Bitmap b;
+    b.packIdx = packIdx;
+    b.file = new QFile(path);
+    if (!b.file->open(QIODevice::ReadOnly)) {
+        delete b.file;
+        return false;
+    }
+    b.size = b.file->size();
+    b.data = b.file->map(0, b.size);
+
+    const uchar* d = b.data;
+    if (   !d || b.size < BITMAP_HEADER_SIZE || memcmp(d, "BITM", 4)
+        || be16(d + 4) != 1 || !(be16(d + 6) & BITMAP_OPT_FULL_DAG)) {
+        dbp("WARNING: unsupported pack bitmap %1", path);
+        delete b.file;
+        return false;
+    }
+    quint32 entriesCnt = be32(d + 8);
+    qint64 ofs = BITMAP_HEADER_SIZE;
+
+    // type bitmaps of commits, trees, blobs and tags, only first is needed
+    Words w;
+    for (int i = 0; i < 4; i++) {
+        qint64 len = readEwah(d + ofs, b.size - ofs, i == 0 ? &b.commits : &w);
+        if (len < 0) {
+            delete b.file;
+            return false;
+        }
+        ofs += len;
+    }
+    const int objCnt = odb->packObjectCount(packIdx);
+    b.entries.reserve(entriesCnt);
+
+    for (quint32 i = 0; i < entriesCnt; i++) {
+
+        if (ofs + 6 > b.size)
+            break;
+
+        quint32 pos = be32(d + ofs);
+        int xorOfs = d[ofs + 4];
+        Entry e;
+        e.ofs = ofs + 6;
+        e.xorWith = (xorOfs ? int(i) - xorOfs : -1);
+
+        qint64 len = readEwah(d + e.ofs, b.size - e.ofs, &w);
+        if (len < 0 || int(pos) >= objCnt || e.xorWith < -1) {
+            delete b.file;
+            return false;
+        }
+        ofs = e.ofs + len;
+        b.bySha.insert(odb->packObjectSha(packIdx, pos), b.entries.count());
+        b.entries.append(e);
+    }
+    bitmaps.append(b);
+    return true;
+}
+
+void PackBitmaps::setRows(const QVector<QByteArray>& rawShas) {
+// bits follow the order of objects in the pack, that is by offset
+
+    rowsCnt = rawShas.count();
+    for (int i = 0; i < bitmaps.count(); i++) {
+
+        Bitmap& b = bitmaps[i];
+        const int cnt = odb->packObjectCount(b.packIdx);
+
+        QVector<QPair<qint64, int> > byOfs(cnt);
+        for (int pos = 0; pos < cnt; pos++)
+            byOfs[pos] = qMakePair(odb->packObjectOffset(b.packIdx, pos), pos);
+
+        std::sort(byOfs.begin(), byOfs.end());
+
+        QVector<int> posToBit(cnt);
+        for (int bit = 0; bit < cnt; bit++)
+            posToBit[byOfs.at(bit).second] = bit;
+
+        b.bitToRow.fill(-1, cnt);
+        for (int row = 0; row < rowsCnt; row++) {
+            const QByteArray& sha = rawShas.at(row);
+            if (sha.size() != 20)
+                continue;
+
+            int pos = odb->packObjectPos(b.packIdx, reinterpret_cast<const uchar*>(sha.constData()));
+            if (pos != -1)
+                b.bitToRow[posToBit.at(pos)] = row;
+        }
+    }
+}
+
+bool PackBitmaps::decodeEntry(const Bitmap& b, int entry, Words* out) const {
+// stored bitmaps could be xor'ed with a previous one, that in
+// turn could be xor'ed with another one, so walk the chain
+
+    out->clear();
+    Words w;
+    int depth = 0;
+    while (entry != -1 && depth++ <= MAX_XOR_CHAIN) {
+
+        const Entry& e = b.entries.at(entry);
+        if (readEwah(b.data + e.ofs, b.size - e.ofs, &w) < 0)
+            return false;
+
+        if (out->count() < w.count())
+            out->resize(w.count());
+
+        for (int i = 0; i < w.count(); i++)
+            (*out)[i] ^= w.at(i);
+
+        entry = e.xorWith;
+    }
+    return (entry == -1);
+}
+
+bool PackBitmaps::reachableRows(const QByteArray& rawTip, QBitArray* rows) {
+
+    for (int i = 0; i < bitmaps.count(); i++) {
+
+        const Bitmap& b = bitmaps.at(i);
+        QHash<QByteArray, int>::const_iterator it(b.bySha.constFind(rawTip));
+        if (it == b.bySha.constEnd() || b.bitToRow.isEmpty())
+            continue;
+
+        Words w;
+        if (!decodeEntry(b, *it, &w))
+            return false;
+
+        rows->fill(false, rowsCnt);
+        const int cnt = qMin(w.count(), b.commits.count());
+        for (int j = 0; j < cnt; j++) {
+
+            quint64 word = w.at(j) & b.commits.at(j);
+            for (int bit = j * 64; word; word >>= 1, bit++)
+                if ((word & 1) && bit < b.bitToRow.count() && b.bitToRow.at(bit) != -1)
+                    rows->setBit(b.bitToRow.at(bit));
+        }
+        return true;
+    }
+    return false;
+}
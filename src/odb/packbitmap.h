@@ -0,0 +1,68 @@
+#ifndef PACKBITMAP_H
+#define PACKBITMAP_H
+
+#include <QBitArray>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class QFile;
+class ObjectDb;
+
+/*
+ * Reader for the reachability bitmaps git stores next to a pack
+ * ('pack-*.bitmap', written by 'git repack -b' and by gc on bare
+ * repositories). For the selected commits of the pack they give the
+ * whole set of reachable objects, so that the ancestry of a tip can be
+ * known without walking the history.
+ *
+ * Bitmaps are translated to the rows of the caller's revisions list:
+ * call setRows() with the raw sha of each row, then reachableRows()
+ * returns the rows reachable from a tip, if a bitmap for it exists.
+ * Multi-pack-index bitmaps are not read.
+ */
+class PackBitmaps {
+public:
+    explicit PackBitmaps(const QString& gitDir);
+    ~PackBitmaps();
+
+    bool open();
+    bool isEmpty() const { return bitmaps.isEmpty(); }
+    void setRows(const QVector<QByteArray>& rawShas);
+    bool reachableRows(const QByteArray& rawTip, QBitArray* rows);
+
+private:
+    typedef QVector<quint64> Words; // uncompressed bitmap
+
+    struct Entry {
+        Entry() : ofs(0), xorWith(-1) {}
+
+        qint64 ofs;  // of the compressed bitmap in the file
+        int xorWith; // entry to xor with, -1 if none
+    };
+
+    struct Bitmap {
+        Bitmap() : file(NULL), data(NULL), size(0), packIdx(-1) {}
+
+        QFile* file;
+        const uchar* data;
+        qint64 size;
+        int packIdx;
+        Words commits;             // type bitmap of commit objects
+        QVector<Entry> entries;
+        QHash<QByteArray, int> bySha;
+        QVector<int> bitToRow;     // bit position, pack order, -> row
+    };
+
+    bool openBitmap(const QString& path);
+    bool decodeEntry(const Bitmap& b, int entry, Words* out) const;
+    static qint64 readEwah(const uchar* p, qint64 avail, Words* out);
+
+    ObjectDb* odb;
+    QList<Bitmap> bitmaps;
+    int rowsCnt;
+};
+
+#endif // PACKBITMAP_H
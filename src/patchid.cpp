@@ -0,0 +1,207 @@
+#include "patchid.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QProcess>
+#include <QStringList>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include "common.h"
+#include "task.h"
+
+using namespace QGit;
+
+static const quint32 P_ID_MAGIC = 0xA0B0C0D1;
+static const qint32 P_ID_VERSION = 1;
+static const int RAW_SIZE = 20;
+static const int MIN_CHUNK = 256; // commits, below this one process is enough
+static const int CANCEL_POLL = 20; // ms, as in Task::run()
+static const QByteArray NO_CHANGES(RAW_SIZE, '\0'); // id of commits without a patch
+
+static bool runPatchId(const Task* t, const QString& workDir, const QString& shas, QByteArray* out) {
+/*
+   Same as 'git diff-tree -p --stdin | git patch-id --stable', diff
+   output goes from one process to the other untouched, a round trip
+   through a QString would change ids of non UTF-8 patches.
+*/
+    QProcess diff, pid;
+    diff.setWorkingDirectory(workDir);
+    pid.setWorkingDirectory(workDir);
+    diff.setStandardOutputProcess(&pid);
+    diff.setStandardErrorFile(QProcess::nullDevice());
+
+    if (   !startProcess(&pid, QString("git patch-id --stable").split(' '))
+        || !startProcess(&diff, QString("git diff-tree -r -p --no-color --stdin").split(' '), shas)) {
+        diff.kill();
+        pid.kill();
+        diff.waitForFinished();
+        pid.waitForFinished();
+        return false;
+    }
+    while (pid.state() != QProcess::NotRunning) {
+
+        if (t->isCanceled()) {
+            diff.kill();
+            pid.kill();
+            diff.waitForFinished();
+            pid.waitForFinished();
+            return false;
+        }
+        pid.waitForFinished(CANCEL_POLL);
+        out->append(pid.readAllStandardOutput());
+    }
+    diff.waitForFinished();
+    out->append(pid.readAllStandardOutput());
+    return (   diff.exitStatus() == QProcess::NormalExit && diff.exitCode() == 0
+            && pid.exitStatus() == QProcess::NormalExit && pid.exitCode() == 0);
+}
+
+struct PatchIdOut {
+    PatchIdOut() : ok(false) {}
+    QByteArray out;
+    bool ok; // an empty output is valid, all commits could be empty
+};
+
+struct PatchIdRun {
+    typedef PatchIdOut result_type;
+
+    PatchIdRun(const Task* t, const QString& wd) : task(t), workDir(wd) {}
+    PatchIdOut operator()(const QString& shas) const {
+
+        PatchIdOut res;
+        res.ok = runPatchId(task, workDir, shas, &res.out);
+        return res;
+    }
+    const Task* task;
+    QString workDir;
+};
+
+void PatchIds::clear() {
+
+    ids.clear();
+    byId.clear();
+    dirty = false;
+}
+
+void PatchIds::insert(const QByteArray& sha, const QByteArray& id) {
+
+    if (ids.contains(sha))
+        return;
+
+    ids.insert(sha, id);
+    if (id != NO_CHANGES)
+        byId.insert(id, sha);
+
+    dirty = true;
+}
+
+const QList<QByteArray> PatchIds::equivalents(const QByteArray& sha) const {
+// other commits with the same changes, in any order
+
+    QList<QByteArray> res;
+    QHash<QByteArray, QByteArray>::const_iterator it(ids.constFind(sha));
+    if (it == ids.constEnd() || *it == NO_CHANGES)
+        return res; // empty commits are not equivalent to each other
+
+    res = byId.values(*it);
+    res.removeAll(sha);
+    return res;
+}
+
+bool PatchIds::compute(const Task* t, const QString& workDir, const QStringList& shas,
+                       QHash<QByteArray, QByteArray>* res) {
+// commits are split among parallel pipes, one per core
+
+    int chunks = qBound(1, shas.count() / MIN_CHUNK, QThread::idealThreadCount());
+    int chunkSize = (shas.count() + chunks - 1) / chunks;
+    QStringList bufs;
+    for (int i = 0; i < shas.count(); i += chunkSize)
+        bufs.append(QStringList(shas.mid(i, chunkSize)).join("\n") + '\n');
+
+    const QList<PatchIdOut> outs(QtConcurrent::blockingMapped<QList<PatchIdOut> >(bufs, PatchIdRun(t, workDir)));
+    if (t->isCanceled())
+        return false;
+
+    // each line is '<patch-id> <commit>', commits without changes are missing
+    for (int i = 0; i < outs.count(); i++) {
+        if (!outs.at(i).ok)
+            continue; // to be tried again next time
+
+        const QList<QByteArray> lines(outs.at(i).out.split('\n'));
+        FOREACH (QList<QByteArray>, l, lines)
+            if (l->length() == 2 * 40 + 1)
+                res->insert(QByteArray::fromHex(l->mid(41)), QByteArray::fromHex(l->left(40)));
+
+        // so that they are not diffed again at each start
+        const QStringList chunk(shas.mid(i * chunkSize, chunkSize));
+        FOREACH_SL (it, chunk) {
+            const QByteArray sha(QByteArray::fromHex(it->toLatin1()));
+            if (!res->contains(sha))
+                res->insert(sha, NO_CHANGES);
+        }
+    }
+    return true;
+}
+
+bool PatchIds::load(const QString& gitDir) {
+
+    clear();
+    QFile f(gitDir + P_ID_FILE);
+    if (!f.exists())
+        return true; // no file is not an error
+
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return false;
+
+    QDataStream stream(qUncompress(f.readAll()));
+    quint32 magic;
+    qint32 version;
+    QByteArray buf;
+    stream >> magic >> version;
+    if (magic != P_ID_MAGIC || version != P_ID_VERSION)
+        return false;
+
+    // commit and patch-id pairs, in a single buffer to load fast
+    stream >> buf;
+    for (int i = 0; i + 2 * RAW_SIZE <= buf.size(); i += 2 * RAW_SIZE)
+        insert(buf.mid(i, RAW_SIZE), buf.mid(i + RAW_SIZE, RAW_SIZE));
+
+    dirty = false;
+    return true;
+}
+
+bool PatchIds::save(const QString& gitDir) {
+
+    if (!dirty || gitDir.isEmpty() || !QDir().exists(gitDir))
+        return false;
+
+    QByteArray buf;
+    buf.reserve(ids.count() * 2 * RAW_SIZE);
+    QHashIterator<QByteArray, QByteArray> it(ids);
+    while (it.hasNext()) {
+        it.next();
+        buf.append(it.key()).append(it.value());
+    }
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << P_ID_MAGIC << P_ID_VERSION << buf;
+
+    // write a new file, then replace the old one, as Cache::save()
+    const QString path(gitDir + P_ID_FILE);
+    QFile f(path + BAK_EXT);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Unbuffered))
+        return false;
+
+    bool ok = (f.write(qCompress(data, 1)) != -1);
+    f.close();
+    if (!ok)
+        return false;
+
+    QDir dir;
+    dir.remove(path);
+    dir.rename(path + BAK_EXT, path);
+    dirty = false;
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef PATCHID_H
+#define PATCHID_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+
+class QString;
+class QStringList;
+class Task;
+
+/*
+ * Stable patch-ids of commits, as 'git patch-id --stable' computes
+ * them: commits with the same id introduce the same changes, e.g.
+ * a fix cherry-picked to a release branch. Ids depend only on the
+ * commit, so they are saved next to the file names cache and each
+ * commit is diffed once in the life of a repository.
+ *
+ * Commits without changes are stored too, with an all zero id, so
+ * that they are not diffed again, but they have no equivalents.
+ *
+ * Shas and ids are kept raw, 20 bytes. GUI thread only, except for
+ * compute() that runs git and can be called from a pool thread.
+ */
+class PatchIds {
+public:
+    PatchIds() : dirty(false) {}
+
+    void clear();
+    bool load(const QString& gitDir);
+    bool save(const QString& gitDir);
+    bool contains(const QByteArray& sha) const { return ids.contains(sha); }
+    void insert(const QByteArray& sha, const QByteArray& id);
+    const QList<QByteArray> equivalents(const QByteArray& sha) const;
+
+    static bool compute(const Task* t, const QString& workDir, const QStringList& shas,
+                        QHash<QByteArray, QByteArray>* res);
+
+private:
+    QHash<QByteArray, QByteArray> ids;       // by commit
+    QMultiHash<QByteArray, QByteArray> byId; // commits, by patch-id
+    bool dirty;
+};
+
+#endif // PATCHID_H
@@ -0,0 +1,82 @@
+#include "reachability.h"
+
+#include <QtConcurrentMap>
+
+struct ReachabilityWalk {
+    typedef QBitArray result_type;
+
+    explicit ReachabilityWalk(const Reachability* r) : reach(r) {}
+    QBitArray operator()(int tip) const { return reach->walk(tip); }
+
+    const Reachability* reach;
+};
+
+void Reachability::clear() {
+
+    rows = 0;
+    firstParent.clear();
+    parentRows.clear();
+    sets.clear();
+}
+
+void Reachability::setGraph(const QVector<int>& fp, const QVector<int>& pr) {
+
+    sets.clear();
+    firstParent = fp;
+    parentRows = pr;
+    rows = qMax(fp.count() - 1, 0);
+}
+
+QBitArray Reachability::walk(int tip) const {
+/*
+   Rows are normally in topological order but do not rely on it,
+   a depth first visit costs the same and works with any order.
+   Parents not loaded, as with boundary revisions, have row -1.
+*/
+    QBitArray set(rows);
+    if (tip < 0 || tip >= rows)
+        return set;
+
+    QVector<int> stack;
+    stack.append(tip);
+    set.setBit(tip);
+
+    while (!stack.isEmpty()) {
+
+        int r = stack.last();
+        stack.removeLast();
+
+        for (int i = firstParent.at(r), end = firstParent.at(r + 1); i < end; i++) {
+            int p = parentRows.at(i);
+            if (p != -1 && !set.testBit(p)) {
+                set.setBit(p);
+                stack.append(p);
+            }
+        }
+    }
+    return set;
+}
+
+void Reachability::compute(const QVector<int>& tips) {
+// each walk is independent, so run them on all the available cores
+
+    QVector<int> todo;
+    for (int i = 0; i < tips.count(); i++)
+        if (!sets.contains(tips.at(i)) && !todo.contains(tips.at(i)))
+            todo.append(tips.at(i));
+
+    if (todo.isEmpty())
+        return;
+
+    const QList<QBitArray> res(QtConcurrent::blockingMapped<QList<QBitArray> >(todo, ReachabilityWalk(this)));
+    for (int i = 0; i < todo.count(); i++)
+        sets.insert(todo.at(i), res.at(i));
+}
+
+const QBitArray Reachability::reachable(int row) {
+
+    if (!sets.contains(row))
+        sets.insert(row, walk(row));
+
+    return sets.value(row);
+}
@@ -0,0 +1,40 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include <QBitArray>
+#include <QHash>
+#include <QVector>
+
+/*
+ * Sets of rows reachable from a given row of the loaded revisions
+ * graph. The graph is kept as a compact table of parent rows, so
+ * that walks do not touch Rev objects and can run in parallel.
+ *
+ * Sets are computed on demand and cached, they can also be seeded
+ * from outside, e.g. from pack bitmaps. With per ref sets at hand
+ * ranges like 'A..B' are just bitwise operations.
+ */
+class Reachability {
+public:
+    Reachability() : rows(0) {}
+
+    void clear();
+    bool isValid(int rowCnt) const { return (rows > 0 && rows == rowCnt); }
+    void setGraph(const QVector<int>& firstParent, const QVector<int>& parentRows);
+    void seed(int row, const QBitArray& set) { sets.insert(row, set); }
+    bool isKnown(int row) const { return sets.contains(row); }
+    void compute(const QVector<int>& tips);
+    const QBitArray reachable(int row);
+
+private:
+    friend struct ReachabilityWalk;
+
+    QBitArray walk(int tip) const;
+
+    int rows;
+    QVector<int> firstParent; // rows + 1 entries, see parentRows
+    QVector<int> parentRows;  // parents of row r are in [firstParent[r], firstParent[r + 1])
+    QHash<int, QBitArray> sets;
+};
+
+#endif // REACHABILITY_H
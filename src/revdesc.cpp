@@ -8,23 +8,46 @@
 #include <QContextMenuEvent>
 #include <QRegExp>
 #include <QClipboard>
+#include <QWebElement>
 #include <QWebFrame>
 #include <QRegularExpression>
 #include "domain.h"
 #include "revdesc.h"
+#include "ui/diffview.h"
 
-RevDesc::RevDesc(QWidget* p) : QWebView(p), d(NULL) {
+RevDesc::RevDesc(QWidget* p) : QWebView(p), d(NULL), diffView(NULL) {
     this->page()->setLinkDelegationPolicy(QWebPage::DelegateAllLinks);
     connect(this, &QWebView::linkClicked, this, &RevDesc::on_anchorClicked);
 }
 
+void RevDesc::scrollToFile(const QString& fileName) {
+// as a click on the file link, big diffs are in the diff view
+
+    if (diffView && diffView->isVisible() && diffView->scrollToFile(fileName))
+        return;
+
+    QWebElementCollection titles(page()->mainFrame()->findAllElements("h1.file_diff_title"));
+    foreach (QWebElement e, titles)
+        if (e.toPlainText() == fileName) {
+            e.evaluateJavaScript("this.scrollIntoView(true)");
+            return;
+        }
+}
+
 void RevDesc::on_anchorClicked(const QUrl& link) {
     static QRegularExpression anchorRE("^#(.+)$");
+    static QRegularExpression fileRE("^file_diff_(\\d+)$");
     qDebug() << "clicked on " << link.toDisplayString() << "\n";
     QWebFrame* frame = this->page()->mainFrame();
 
     QRegularExpressionMatch anchorMatch = anchorRE.match(link.toDisplayString());
     if(anchorMatch.hasMatch()) {
+        // big diffs are not in the page but in the diff view
+        QRegularExpressionMatch fileMatch = fileRE.match(anchorMatch.captured(1));
+        if (   fileMatch.hasMatch() && diffView && diffView->isVisible()
+            && diffView->scrollToFile(fileMatch.captured(1).toInt()))
+            return;
+
         frame->scrollToAnchor(anchorMatch.captured(1));
     }
 }
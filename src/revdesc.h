@@ -8,19 +8,22 @@
 
 #include <QWebView>
 
+class DiffView;
 class Domain;
 
 class RevDesc: public QWebView {
 Q_OBJECT
 public:
 	RevDesc(QWidget* parent);
-	void setup(Domain* dm) { d = dm; }
+	void setup(Domain* dm, DiffView* dv = NULL) { d = dm; diffView = dv; }
+	void scrollToFile(const QString& fileName);
 
 private slots:
     void on_anchorClicked(const QUrl& link);
 
 private:
 	Domain* d;
+	DiffView* diffView; // shows big diffs, file links point there
 	QString highlightedLink;
 };
 
@@ -13,6 +13,7 @@
 #include "domain.h"
 #include "historyview.h"
 #include "revdesc.h"
+#include "ui/diffview.h"
 #include "mainimpl.h"
 #include "revsview.h"
 
@@ -22,7 +23,7 @@ RevsView::RevsView(MainImpl* mi, Git* g, bool isMain) : Domain(mi, g, isMain) {
 	revTab->setupUi(container);
 
 	tab()->listViewLog->setup(this, g);
-	tab()->textBrowserDesc->setup(this);
+	tab()->textBrowserDesc->setup(this, tab()->diffView);
 
 	// restore geometry
 	QVector<QSplitter*> v;
@@ -35,11 +36,18 @@ RevsView::RevsView(MainImpl* mi, Git* g, bool isMain) : Domain(mi, g, isMain) {
 	connect(git, SIGNAL(loadCompleted(const FileHistory*, const QString&)),
 	        this, SLOT(on_loadCompleted(const FileHistory*, const QString&)));
 
+	connect(git, SIGNAL(filesReady(const QString&, const QString&, bool, const RevFile*)),
+	        this, SLOT(on_filesReady(const QString&, const QString&, bool, const RevFile*)));
+
 	connect(m(), SIGNAL(changeFont(const QFont&)),
 	        tab()->listViewLog, SLOT(on_changeFont(const QFont&)));
 
 	connect(m(), SIGNAL(updateRevDesc()), this, SLOT(on_updateRevDesc()));
 
+	connect(git, SIGNAL(patchIdsReady()), this, SLOT(on_patchIdsReady()));
+
+	connect(git, SIGNAL(historyReordered()), this, SLOT(on_historyReordered()));
+
 	connect(tab()->listViewLog, SIGNAL(lanesContextMenuRequested(const QStringList&,
 	        const QStringList&)), this, SLOT(on_lanesContextMenuRequested
 	       (const QStringList&, const QStringList&)));
@@ -80,6 +88,8 @@ void RevsView::clear(bool complete) {
 	Domain::clear(complete);
 
     tab()->textBrowserDesc->setUrl(QUrl("about:blank"));
+    tab()->diffView->clear();
+    tab()->diffView->hide();
 }
 
 void RevsView::setEnabled(bool b) {
@@ -89,10 +99,18 @@ void RevsView::setEnabled(bool b) {
 
 void RevsView::on_newRevsAdded(const FileHistory* fh, const QVector<ShaString>&) {
 
-	if (!git->isMainHistory(fh) || !st.sha().isEmpty())
+	if (!git->isMainHistory(fh))
 		return;
 
     HistoryView* lv = tab()->listViewLog;
+	if (!st.sha().isEmpty()) {
+		// the full load that follows the preview one could have
+		// moved current revision, select it again when back
+		int row = lv->row(st.sha());
+		if (!lv->currentIndex().isValid() && row != -1 && row < lv->model()->rowCount())
+			UPDATE();
+		return;
+	}
 	if (lv->model()->rowCount() == 0)
 		return;
 
@@ -112,8 +130,51 @@ void RevsView::on_loadCompleted(const FileHistory* fh, const QString& stats) {
 
 void RevsView::on_updateRevDesc() {
 
-	SCRef d = m()->getRevisionDesc(st.sha());
+	QSharedPointer<TreeDiff> bigDiff;
+	SCRef d = m()->getRevisionDesc(st.sha(), &bigDiff);
 	tab()->textBrowserDesc->setHtml(d);
+
+	// diff too big for the HTML page, see Git::getDesc()
+	DiffView* dv = tab()->diffView;
+	dv->setDiff(bigDiff);
+	dv->setVisible(!bigDiff.isNull());
+}
+
+void RevsView::on_patchIdsReady() {
+// equivalent revisions are shown both in list and description
+
+	tab()->listViewLog->viewport()->update();
+	on_updateRevDesc();
+}
+
+void RevsView::on_historyReordered() {
+// model has been reset, select current revision again in its new row
+
+	tab()->listViewLog->update();
+}
+
+void RevsView::on_filesReady(const QString& sha, const QString& diffToSha,
+                             bool allMergeFiles, const RevFile* files) {
+
+	if (   sha != st.sha() || diffToSha != st.diffToSha()
+	    || allMergeFiles != st.allMergeFiles())
+		return; // selection moved on in the mean time
+
+	showFiles(files);
+}
+
+void RevsView::showFiles(const RevFile* files) {
+// bring header of selected file in view, if the revision changed it
+
+	SCRef fileName(st.fileName());
+	if (!files || fileName.isEmpty())
+		return;
+
+	for (int i = 0; i < files->count(); i++)
+		if (git->filePath(*files, i) == fileName) {
+			tab()->textBrowserDesc->scrollToFile(fileName);
+			return;
+		}
 }
 
 bool RevsView::doUpdate(bool force) {
@@ -133,22 +194,15 @@ bool RevsView::doUpdate(bool force) {
 			showStatusBarMessage(git->getRevInfo(st.sha()));
 		}
 		const RevFile* files = NULL;
-		bool newFiles = false;
-
-		if (st.isChanged(StateInfo::ANY & ~StateInfo::FILE_NAME) || force) {
-			// blocking call, could be slow in case of all merge files
-			files = git->getFiles(st.sha(), st.diffToSha(), st.allMergeFiles());
-			newFiles = true;
-
-            //TODO update diff here
-		}
+		if (st.isChanged() || force)
+			// not blocking, if 'git diff-tree' is needed on_filesReady() follows
+			files = git->requestFiles(st.sha(), st.diffToSha(), st.allMergeFiles());
 
 		if (st.selectItem()) {
             bool isDir = st.isDir();
 			m()->updateContextActions(st.sha(), st.fileName(), isDir, found);
 		}
-		if (st.isChanged() || force)
-            /*TODO update diff here*/;
+		showFiles(files);
 	}
 	return (found || st.sha().isEmpty());
 }
@@ -31,6 +31,9 @@ private slots:
 	void on_loadCompleted(const FileHistory*, const QString& stats);
 	void on_lanesContextMenuRequested(const QStringList&, const QStringList&);
 	void on_updateRevDesc();
+	void on_patchIdsReady();
+	void on_historyReordered();
+	void on_filesReady(const QString&, const QString&, bool, const RevFile*);
 
 protected:
 	virtual bool doUpdate(bool force);
@@ -39,6 +42,7 @@ private:
 	friend class MainImpl;
 
 	void updateLineEditSHA(bool clear = false);
+	void showFiles(const RevFile* files);
 
 	Ui_TabRev* revTab;
 };
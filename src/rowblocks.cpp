@@ -0,0 +1,221 @@
+#include "rowblocks.h"
+
+#include <algorithm>
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+#include <QThread>
+
+static const int SHA_LINES_CHUNK = 64 * 1024;
+static const int COMPRESS_LEVEL = 1; // fast, row data is plain text and compresses well anyway
+
+static bool lessRecentlyUsed(const RowBlock* a, const RowBlock* b) { return a->lastUse < b->lastUse; }
+
+void RowBlock::doTouch() const {
+
+    mgr->touch(*this);
+}
+
+RowBlocks::RowBlocks() : owner(QThread::currentThread()), budget(0) {
+
+    clear();
+}
+
+RowBlocks::~RowBlocks() {
+
+    clear();
+}
+
+bool RowBlocks::isOwnerThread() const {
+
+    return QThread::currentThread() == owner;
+}
+
+void RowBlocks::clear() {
+// blocks are owned by FileHistory, here they are only forgotten
+
+    QMutexLocker lock(&mutex);
+    blocks.clear();
+    qDeleteAll(readers);
+    readers.clear();
+    qDeleteAll(files); // adopted temporary files are removed from disk
+    files.clear();
+    qDeleteAll(shaLines);
+    shaLines.clear();
+    total = resident = packedSize = 0;
+    clock = 0;
+}
+
+int RowBlocks::reserveFile(const QString& fileName) {
+/*
+   While loading, the file belongs to the loader, that is still
+   reading it, here it is only read with another handle. Once
+   loading is completed the loader hands it over with adoptFile(),
+   a clear() in between just forgets it.
+*/
+    if (!isEnabled())
+        return -1;
+
+    files.append(NULL);
+    readers.append(new QFile(fileName));
+    return files.count() - 1;
+}
+
+bool RowBlocks::adoptFile(int id, QTemporaryFile* f) {
+// id could be stale, if we have been cleared after reserveFile()
+
+    if (   id < 0 || id >= files.count() || files.at(id)
+        || readers.at(id)->fileName() != f->fileName())
+        return false;
+
+    f->setParent(NULL);
+    files[id] = f;
+    return true;
+}
+
+void RowBlocks::add(RowBlock* b) {
+
+    if (!isEnabled() || b->isEmpty())
+        return;
+
+    QMutexLocker lock(&mutex);
+    b->mgr = this;
+    b->len = b->size();
+    b->lastUse = ++clock;
+    b->state = RowBlock::RESIDENT;
+    blocks.append(b);
+    total += b->len;
+    resident += b->len;
+
+    if (resident > budget)
+        evict();
+}
+
+void RowBlocks::touch(const RowBlock& b) {
+
+    if (!isOwnerThread()) {
+        dbs("ASSERT in RowBlocks::touch(), use dataOf() from other threads");
+        return;
+    }
+    QMutexLocker lock(&mutex);
+    b.lastUse = ++clock;
+    if (b.state == RowBlock::RESIDENT)
+        return;
+
+    restore(b);
+    if (resident > budget)
+        evict();
+}
+
+const QByteArray RowBlocks::dataOf(const RowBlock& b) {
+/*
+   A shared copy, so the bytes stay alive if the block is evicted
+   meanwhile. In other threads an evicted block is restored only in
+   the copy, block state and LRU order are left to the owner.
+*/
+    if (isOwnerThread()) {
+        touch(b);
+        QMutexLocker lock(&mutex);
+        return data(b);
+    }
+    QMutexLocker lock(&mutex);
+    if (b.state == RowBlock::RESIDENT)
+        return data(b);
+
+    QFile f(b.file != -1 && readers.value(b.file) ? readers.at(b.file)->fileName() : QString());
+    return load(b, &f);
+}
+
+const QByteArray RowBlocks::load(const RowBlock& b, QFile* f) const {
+
+    QByteArray d;
+    if (b.state == RowBlock::COMPRESSED)
+        d = qUncompress(b.packed);
+
+    else if (f && (f->isOpen() || f->open(QIODevice::ReadOnly)) && f->seek(b.fileOfs))
+        d = f->read(b.len);
+
+    // the '\0' appended at the end of the stream is not in the file
+    if (d.size() < b.len - 1)
+        dbp("ASSERT in RowBlocks::load(), %1 bytes missing", b.len - d.size());
+
+    if (d.size() < b.len)
+        d.append(QByteArray(b.len - d.size(), '\0'));
+
+    return d;
+}
+
+void RowBlocks::restore(const RowBlock& b) {
+
+    data(b) = load(b, readers.value(b.file));
+    if (b.state == RowBlock::COMPRESSED) {
+        packedSize -= b.packed.size();
+        b.packed = QByteArray();
+    }
+    b.state = RowBlock::RESIDENT;
+    resident += b.len;
+}
+
+void RowBlocks::evict() {
+/*
+   Go down to 3/4 of the budget, so that next blocks can be added
+   without evicting again. The block touched last is in use, keep it.
+*/
+    QList<const RowBlock*> lru;
+    FOREACH (QList<const RowBlock*>, it, blocks)
+        if ((*it)->state == RowBlock::RESIDENT && (*it)->lastUse != clock)
+            lru.append(*it);
+
+    std::sort(lru.begin(), lru.end(), lessRecentlyUsed);
+
+    const qint64 target = budget - budget / 4;
+    for (int i = 0; i < lru.count() && resident > target; i++) {
+
+        const RowBlock& b = *lru.at(i);
+        QByteArray& d = data(b);
+
+        if (b.file != -1)
+            b.state = RowBlock::DROPPED;
+        else {
+            b.packed = qCompress(d, COMPRESS_LEVEL);
+            packedSize += b.packed.size();
+            b.state = RowBlock::COMPRESSED;
+        }
+        d = QByteArray();
+        resident -= b.len;
+    }
+}
+
+const char* RowBlocks::keepShaLine(const char* line, int len) {
+// lines are never moved, chunks are filled up to the reserved size
+
+    QByteArray* a = (shaLines.isEmpty() ? NULL : shaLines.last());
+    if (!a || a->size() + len > a->capacity()) {
+        a = new QByteArray();
+        a->reserve(qMax(len, SHA_LINES_CHUNK));
+        shaLines.append(a);
+    }
+    int ofs = a->size();
+    a->append(line, len);
+    return a->constData() + ofs;
+}
+
+const QString RowBlocks::report() const {
+
+    QMutexLocker lock(const_cast<QMutex*>(&mutex));
+    qint64 compressed = 0, dropped = 0, shaBytes = 0;
+    FOREACH (QList<const RowBlock*>, it, blocks) {
+        if ((*it)->state == RowBlock::COMPRESSED)
+            compressed += (*it)->len;
+        else if ((*it)->state == RowBlock::DROPPED)
+            dropped += (*it)->len;
+    }
+    for (int i = 0; i < shaLines.count(); i++)
+        shaBytes += shaLines.at(i)->size();
+
+    qint64 used = resident + packedSize + shaBytes;
+    return QString("log data in memory: %1 KB, saved %2 KB (%3 KB compressed, %4 KB dropped)")
+           .arg(used / 1024).arg(qMax(total - used, qint64(0)) / 1024)
+           .arg(compressed / 1024).arg(dropped / 1024);
+}
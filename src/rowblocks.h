@@ -0,0 +1,70 @@
+#ifndef ROWBLOCKS_H
+#define ROWBLOCKS_H
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#include "common.h"
+
+class QFile;
+class QTemporaryFile;
+class QThread;
+
+/*
+ * Keeps the memory used by the raw 'git log' output within a budget.
+ *
+ * Data is read in blocks of about 64KB, and revisions store offsets
+ * in them, so a block is never split or moved. When resident data
+ * exceeds the budget the least recently used blocks are evicted:
+ * the ones still in the 'git log' output file, that is retained
+ * until next clear(), are dropped and read again on demand, the
+ * other ones are compressed. Evicted blocks are restored before
+ * any access by RowBlock::touch(), same content at same offsets.
+ *
+ * Only the thread that created us, the GUI one, changes the blocks:
+ * it adds, touches and evicts them, and can use their data directly
+ * until next eviction, that happens only in that same thread. Other
+ * threads get a shared copy with dataOf(), that stays valid after an
+ * eviction, and restore an evicted block just for themselves. Block
+ * state is protected by a mutex.
+ *
+ * With a zero budget blocks are not tracked and nothing changes.
+ */
+class RowBlocks {
+public:
+    RowBlocks();
+    ~RowBlocks();
+
+    void clear();
+    void setBudget(qint64 bytes) { budget = bytes; }
+    bool isEnabled() const { return budget > 0; }
+    bool isOwnerThread() const;
+    int reserveFile(const QString& fileName);
+    bool adoptFile(int id, QTemporaryFile* f);
+    void add(RowBlock* b);
+    void touch(const RowBlock& b);
+    const QByteArray dataOf(const RowBlock& b);
+    const char* keepShaLine(const char* line, int len);
+    const QString report() const;
+
+private:
+    void evict();
+    void restore(const RowBlock& b);
+    const QByteArray load(const RowBlock& b, QFile* f) const;
+    static QByteArray& data(const RowBlock& b) { return const_cast<RowBlock&>(b); }
+
+    QThread* owner;
+    QMutex mutex; // guards block state, and data, against other threads
+    qint64 budget;
+    qint64 total;      // bytes of all the tracked blocks
+    qint64 resident;   // bytes of resident blocks
+    qint64 packedSize; // bytes of compressed blocks data
+    quint64 clock;
+    QList<const RowBlock*> blocks;
+    QList<QTemporaryFile*> files; // NULL until the loader hands them over
+    QList<QFile*> readers;        // files are read with their own handles
+    QList<QByteArray*> shaLines;
+};
+
+#endif // ROWBLOCKS_H
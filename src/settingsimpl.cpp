@@ -43,6 +43,8 @@ SettingsImpl::SettingsImpl(QWidget* p, Git* g, int defTab) : QDialog(p), git(g)
 	setupUi(this);
 	int f = flags(FLAGS_KEY);
 	checkBoxDiffCache->setChecked(f & DIFF_INDEX_F);
+	checkBoxNativeLog->setChecked(f & NATIVE_LOG_F);
+	checkBoxPatchId->setChecked(f & PATCH_ID_F);
 	checkBoxNumbers->setChecked(f & NUMBERS_F);
 	checkBoxSign->setChecked(f & SIGN_PATCH_F);
 	checkBoxCommitSign->setChecked(f & SIGN_CMT_F);
@@ -62,6 +64,8 @@ SettingsImpl::SettingsImpl(QWidget* p, Git* g, int defTab) : QDialog(p), git(g)
 	SCRef exPDir(set.value(EX_PER_DIR_KEY, EX_PER_DIR_DEF).toString());
 	SCRef tmplt(set.value(CMT_TEMPL_KEY, CMT_TEMPL_DEF).toString());
 	SCRef CMArgs(set.value(CMT_ARGS_KEY).toString());
+	int logMem = set.value(LOG_MEM_KEY, 0).toInt();
+	int warmMem = set.value(WARM_MEM_KEY, WARM_MEM_DEF).toInt();
 
 	lineEditApplyPatchExtraOptions->setText(APOpt);
 	lineEditFormatPatchExtraOptions->setText(FPOpt);
@@ -70,6 +74,8 @@ SettingsImpl::SettingsImpl(QWidget* p, Git* g, int defTab) : QDialog(p), git(g)
 	lineEditExcludePerDir->setText(exPDir);
 	lineEditTemplate->setText(tmplt);
 	lineEditCommitExtraOptions->setText(CMArgs);
+	spinBoxLogMemory->setValue(logMem);
+	spinBoxRecentMemory->setValue(warmMem);
 	lineEditTypeWriterFont->setText(TYPE_WRITER_FONT.toString());
 	lineEditTypeWriterFont->setCursorPosition(0); // font description could be long
 
@@ -197,6 +203,26 @@ void SettingsImpl::checkBoxDiffCache_toggled(bool b) {
 	changeFlag(DIFF_INDEX_F, b);
 }
 
+void SettingsImpl::checkBoxNativeLog_toggled(bool b) {
+
+	changeFlag(NATIVE_LOG_F, b);
+}
+
+void SettingsImpl::checkBoxPatchId_toggled(bool b) {
+
+	changeFlag(PATCH_ID_F, b);
+}
+
+void SettingsImpl::spinBoxLogMemory_valueChanged(int i) {
+
+	writeSetting(LOG_MEM_KEY, i);
+}
+
+void SettingsImpl::spinBoxRecentMemory_valueChanged(int i) {
+
+	writeSetting(WARM_MEM_KEY, i);
+}
+
 void SettingsImpl::checkBoxNumbers_toggled(bool b) {
 
 	changeFlag(NUMBERS_F, b);
@@ -30,6 +30,10 @@ protected slots:
 	void checkBoxSmartLabels_toggled(bool b);
 	void checkBoxMsgOnNewSHA_toggled(bool b);
 	void checkBoxDiffCache_toggled(bool b);
+	void checkBoxNativeLog_toggled(bool b);
+	void checkBoxPatchId_toggled(bool b);
+	void spinBoxLogMemory_valueChanged(int i);
+	void spinBoxRecentMemory_valueChanged(int i);
 	void checkBoxCommitSign_toggled(bool b);
 	void checkBoxCommitVerify_toggled(bool b);
 	void checkBoxCommitUseDefMsg_toggled(bool b);
@@ -0,0 +1,178 @@
+#include "snapshot.h"
+
+#include <QDir>
+#include <QWeakPointer>
+
+// toTempSha() uses a static buffer, not usable from other threads
+
+static const int CONTAINER_SIZE = 24; // header of a Qt5 string or vector on 64 bit
+
+static qint64 namesSize(const QVector<QString>& v) {
+
+    qint64 size = v.count() * sizeof(QString);
+    FOREACH (QVector<QString>, it, v)
+        size += CONTAINER_SIZE + 2 * it->size();
+
+    return size;
+}
+
+qint64 RevFile::memorySize() const {
+
+    qint64 size = sizeof(RevFile) + 3 * CONTAINER_SIZE + pathsIdx.size();
+    size += (status.count() + mergeParent.count()) * sizeof(int);
+    return size + namesSize(extStatus);
+}
+
+qint64 RevFileKeeper::memorySize() const {
+
+    qint64 size = owned.count() * sizeof(void*);
+    FOREACH (QList<const RevFile*>, it, owned)
+        size += (*it)->memorySize();
+
+    return size;
+}
+
+int RepoSnapshot::row(SCRef sha) const {
+
+    const QByteArray ba(sha.toLatin1());
+    return rowOf.value(ShaString(ba.constData()), -1);
+}
+
+const QVector<int> RepoSnapshot::parentRows(int row) const {
+// parents not in the main view, as with boundary revisions, have row -1
+
+    return parents.mid(firstParent.at(row), firstParent.at(row + 1) - firstParent.at(row));
+}
+
+const QString RepoSnapshot::author(int row) const {
+
+    int id = authorIds.at(row);
+    return (id != -1 ? authorNames.at(id) : "");
+}
+
+const Reference* RepoSnapshot::refs(SCRef sha) const {
+
+    QHash<QByteArray, Reference>::const_iterator it(refMap.constFind(sha.toLatin1()));
+    return (it != refMap.constEnd() ? &(*it) : NULL);
+}
+
+const RevFile* RepoSnapshot::files(SCRef sha) const {
+
+    const QByteArray ba(sha.toLatin1());
+    return revFiles.value(ShaString(ba.constData()));
+}
+
+const RevFile* RepoSnapshot::files(int row) const {
+
+    return revFiles.value(ShaString(shaBuf.constData() + 41 * row));
+}
+
+const QString RepoSnapshot::filePath(const RevFile& rf, uint i) const {
+
+    return dirNames.at(rf.dirAt(i)) + fileNames.at(rf.nameAt(i));
+}
+
+qint64 RepoSnapshot::memorySize() const {
+/*
+   An estimate of what a warm snapshot keeps alive once no window
+   shows its repository anymore. File names data is counted too,
+   it goes away with the last snapshot referring to its keeper.
+*/
+    qint64 size = shaBuf.size() + rowOf.count() * 2 * sizeof(void*);
+    size += (firstParent.count() + parents.count() + authorIds.count()) * sizeof(int);
+    size += authorTimes.count() * sizeof(uint);
+    size += namesSize(authorNames);
+    FOREACH (QList<QByteArray>, it, rawLog)
+        size += it->size();
+
+    size += revFiles.count() * (2 * sizeof(void*) + 41); // hash nodes and keys
+    size += namesSize(dirNames) + namesSize(fileNames);
+    if (keeper)
+        size += keeper->memorySize();
+
+    return size;
+}
+
+typedef QHash<QString, QWeakPointer<const RepoSnapshot> > RegistryMap;
+
+static RegistryMap& registry() {
+
+    static RegistryMap map;
+    return map;
+}
+
+static QList<RepoSnapshotPtr>& warmList() { // most recently used first
+
+    static QList<RepoSnapshotPtr> lst;
+    return lst;
+}
+
+const QString RepoRegistry::key(const QString& gitDir) {
+// same repository could be reached through different paths
+
+    const QString canonical(QDir(gitDir).canonicalPath());
+    return (canonical.isEmpty() ? gitDir : canonical);
+}
+
+void RepoRegistry::publish(const RepoSnapshotPtr& s) {
+
+    if (s.isNull() || s->logData().isEmpty())
+        return;
+
+    RegistryMap& map = registry();
+    map.insert(key(s->gitDir()), s.toWeakRef());
+
+    // drop repositories that are not shown anymore
+    QMutableHashIterator<QString, QWeakPointer<const RepoSnapshot> > it(map);
+    while (it.hasNext())
+        if (it.next().value().isNull())
+            it.remove();
+}
+
+RepoSnapshotPtr RepoRegistry::lookup(const QString& gitDir) {
+
+    const QString k(key(gitDir));
+    const RepoSnapshotPtr s(registry().value(k).toStrongRef());
+
+    // a warm repository is used again, move it in front
+    QList<RepoSnapshotPtr>& lst = warmList();
+    for (int i = 0; s && i < lst.count(); i++)
+        if (lst.at(i) == s) {
+            lst.move(i, 0);
+            break;
+        }
+    return s;
+}
+
+void RepoRegistry::keepWarm(const RepoSnapshotPtr& s, qint64 budget) {
+
+    QList<RepoSnapshotPtr>& lst = warmList();
+    if (!s.isNull() && !s->logData().isEmpty()) {
+
+        // only latest data of a repository is worth keeping
+        const QString k(key(s->gitDir()));
+        QMutableListIterator<RepoSnapshotPtr> it(lst);
+        while (it.hasNext())
+            if (key(it.next()->gitDir()) == k)
+                it.remove();
+
+        lst.prepend(s);
+        publish(s);
+    }
+    trimWarm(budget);
+}
+
+void RepoRegistry::trimWarm(qint64 budget) {
+// the most recently used one is kept only if it fits alone
+
+    QList<RepoSnapshotPtr>& lst = warmList();
+    qint64 total = 0;
+    int i = 0;
+    for ( ; i < lst.count(); i++) {
+        total += lst.at(i)->memorySize();
+        if (total > budget)
+            break;
+    }
+    while (lst.count() > i)
+        lst.removeLast(); // a window could still hold it
+}
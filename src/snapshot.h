@@ -0,0 +1,122 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "common.h"
+#include "git.h"
+
+/*
+ * Owns the RevFile objects created for a set of file names. Git
+ * drops its reference when file names are cleared, published
+ * snapshots keep theirs, so a RevFile lives as long as any reader
+ * could reach it.
+ */
+class RevFileKeeper {
+public:
+    ~RevFileKeeper() { qDeleteAll(owned); }
+    void add(const RevFile* rf) { owned.append(rf); }
+    qint64 memorySize() const;
+
+private:
+    QList<const RevFile*> owned;
+};
+
+/*
+ * Read only view of the repository data of the main history, as it
+ * was when published by Git::publishSnapshot(). Nothing is changed
+ * after publishing, so a snapshot can be held and read from any
+ * thread, containers are implicitly shared with Git and are copied
+ * only if Git changes its own ones in the mean time.
+ *
+ * Each load or refresh publishes a new generation, readers holding
+ * an old one keep seeing consistent, although stale, data.
+ */
+class RepoSnapshot {
+public:
+    RepoSnapshot() : gen(0) {}
+
+    int generation() const { return gen; }
+    const QString& gitDir() const { return dir; }
+    const QStringList& loadArgs() const { return args; }
+    int count() const { return authorIds.count(); }
+    int row(SCRef sha) const;
+    const QString sha(int row) const { return QString(ShaString(shaBuf.constData() + 41 * row)); }
+    const QVector<int> parentRows(int row) const;
+    const QString author(int row) const;
+    int authorId(int row) const { return authorIds.at(row); }
+    const QVector<QString>& authorList() const { return authorNames; }
+    uint authorTime(int row) const { return authorTimes.at(row); }
+    const Reference* refs(SCRef sha) const;
+    const RevFile* files(SCRef sha) const;
+    const RevFile* files(int row) const;
+    const StrVect& dirs() const { return dirNames; }
+    const QString filePath(const RevFile& rf, uint i) const;
+    const QByteArray& refsFingerprint() const { return refsKey; }
+    const QList<QByteArray>& logData() const { return rawLog; }
+    qint64 memorySize() const;
+
+private:
+    friend class Git;
+
+    int gen;
+    QString dir;
+    QStringList args;
+
+    // commit table, by row of the main view
+    QByteArray shaBuf;             // '\0' terminated shas, 41 bytes each
+    QHash<ShaString, int> rowOf;   // keys point into shaBuf
+    QVector<int> firstParent;      // rows + 1 entries, as in Reachability
+    QVector<int> parents;
+    QVector<int> authorIds;
+    QVector<uint> authorTimes;
+    QVector<QString> authorNames;  // by author id
+
+    // references
+    QHash<QByteArray, Reference> refMap;
+    QByteArray refsKey;            // hash of HEAD and 'git show-ref' output
+
+    // 'git log' output the commit table has been parsed from, empty if
+    // not kept, see FileHistory::logStream
+    QList<QByteArray> rawLog;
+
+    // file names data, see Git::revsFiles
+    RevFileMap revFiles;
+    QVector<QByteArray> revFilesShaBuf; // keeps revFiles keys alive
+    QSharedPointer<RevFileKeeper> keeper;
+    StrVect dirNames;
+    StrVect fileNames;
+};
+
+/*
+ * Latest snapshot with log data of each repository open in this
+ * process, so that a new window on a repository already loaded in
+ * another one parses the same 'git log' output and shares the file
+ * names data instead of running git again. Only weak references are
+ * kept, a repository is forgotten when no window shows it anymore.
+ *
+ * Repositories just closed are kept warm: the most recently used
+ * snapshots are held within a memory budget, so that going back to
+ * one of them runs neither 'git log' nor the file names loading.
+ * Its 'git log' output is still parsed again, and lanes computed
+ * again, Rev objects are not kept.
+ *
+ * GUI thread only, as every Git instance.
+ */
+class RepoRegistry {
+public:
+    static void publish(const RepoSnapshotPtr& s);
+    static RepoSnapshotPtr lookup(const QString& gitDir);
+    static void keepWarm(const RepoSnapshotPtr& s, qint64 budget);
+
+private:
+    static const QString key(const QString& gitDir);
+    static void trimWarm(qint64 budget);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,287 @@
+#include "spawner.h"
+
+#include <QList>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QTime>
+#include <QTimer>
+
+#include "common.h"
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// changing directory in the child needs glibc 2.29
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define HAVE_SPAWN_CHDIR
+#endif
+
+extern char** environ;
+#endif
+
+static const int READ_CHUNK = 65536;
+static const int REAP_POLL = 5; // ms, output closed but child not yet exited
+
+SpawnedProcess::SpawnedProcess(QObject* p) : QObject(p), pid(-1) {
+
+    for (int i = 0; i < CHANNELS; i++) {
+        fds[i] = -1;
+        notifiers[i] = NULL;
+    }
+}
+
+SpawnedProcess::~SpawnedProcess() {
+
+    for (int i = 0; i < CHANNELS; i++)
+        closeChannel(Channel(i));
+
+#ifdef Q_OS_LINUX
+    if (pid > 0) { // do not leave a zombie around
+        ::kill(pid, SIGKILL);
+        reap(true);
+    }
+#endif
+}
+
+#ifdef HAVE_SPAWN_CHDIR
+
+bool SpawnedProcess::start(const QStringList& args, const QString& workDir) {
+
+    if (args.isEmpty() || pid > 0)
+        return false;
+
+    // both ends close-on-exec, dup2() in the child clears the flag
+    int pipes[CHANNELS][2];
+    if (pipe2(pipes[OUT], O_CLOEXEC) != 0)
+        return false;
+
+    if (pipe2(pipes[ERR], O_CLOEXEC) != 0) {
+        close(pipes[OUT][0]);
+        close(pipes[OUT][1]);
+        return false;
+    }
+    // same environment of QGit::startProcess()
+    QList<QByteArray> env;
+    for (char** e = environ; *e; e++)
+        env.append(QByteArray(*e));
+    env.append("GIT_FLUSH=0"); // skip the fflush() in 'git log'
+
+    QList<QByteArray> argv8;
+    FOREACH_SL (it, args)
+        argv8.append(it->toLocal8Bit());
+
+    QVector<char*> argv, envp;
+    for (int i = 0; i < argv8.count(); i++)
+        argv.append(argv8[i].data());
+    argv.append(NULL);
+    for (int i = 0; i < env.count(); i++)
+        envp.append(env[i].data());
+    envp.append(NULL);
+
+    const QByteArray wd(workDir.toLocal8Bit());
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, pipes[OUT][1], 1);
+    posix_spawn_file_actions_adddup2(&fa, pipes[ERR][1], 2);
+    if (!wd.isEmpty())
+        posix_spawn_file_actions_addchdir_np(&fa, wd.constData());
+
+    pid_t child;
+    int err = posix_spawnp(&child, argv[0], &fa, NULL, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&fa);
+
+    close(pipes[OUT][1]);
+    close(pipes[ERR][1]);
+    if (err != 0) {
+        close(pipes[OUT][0]);
+        close(pipes[ERR][0]);
+        return false;
+    }
+    pid = child;
+    for (int i = 0; i < CHANNELS; i++) {
+        fds[i] = pipes[i][0];
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        notifiers[i] = new QSocketNotifier(fds[i], QSocketNotifier::Read, this);
+        connect(notifiers[i], SIGNAL(activated(int)), this, SLOT(on_activated(int)));
+    }
+    return true;
+}
+
+#else
+
+bool SpawnedProcess::start(const QStringList&, const QString&) {
+
+    return false; // use QProcess
+}
+
+#endif // HAVE_SPAWN_CHDIR
+
+QByteArray SpawnedProcess::takeData(Channel ch) {
+
+    QByteArray d(data[ch]);
+    data[ch].clear();
+    return d;
+}
+
+bool SpawnedProcess::readChannel(Channel ch) {
+// read what is available, false once the child closed its end
+
+#ifdef Q_OS_LINUX
+    while (fds[ch] != -1) {
+
+        int ofs = data[ch].size();
+        data[ch].resize(ofs + READ_CHUNK);
+        ssize_t n = read(fds[ch], data[ch].data() + ofs, READ_CHUNK);
+        data[ch].resize(ofs + int(qMax(n, ssize_t(0))));
+
+        if (n > 0)
+            continue;
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0 && errno == EAGAIN)
+            return true;
+
+        closeChannel(ch); // end of file or error
+    }
+#else
+    Q_UNUSED(ch);
+#endif
+    return false;
+}
+
+void SpawnedProcess::closeChannel(Channel ch) {
+// could be called from the notifier activated() signal
+
+    if (notifiers[ch]) {
+        notifiers[ch]->setEnabled(false);
+        notifiers[ch]->deleteLater();
+        notifiers[ch] = NULL;
+    }
+#ifdef Q_OS_LINUX
+    if (fds[ch] != -1)
+        close(fds[ch]);
+#endif
+    fds[ch] = -1;
+}
+
+void SpawnedProcess::on_activated(int fd) {
+
+    if (fd == -1 || (fd != fds[OUT] && fd != fds[ERR]))
+        return; // closed in the mean time
+
+    Channel ch = (fd == fds[OUT] ? OUT : ERR);
+    int before = data[ch].size();
+    readChannel(ch);
+
+    if (data[ch].size() > before) {
+        if (ch == OUT)
+            emit readyReadStandardOutput();
+        else
+            emit readyReadStandardError();
+    }
+    if (fds[OUT] == -1 && fds[ERR] == -1)
+        on_reap();
+}
+
+void SpawnedProcess::on_reap() {
+
+    if (pid > 0 && !reap(false))
+        QTimer::singleShot(REAP_POLL, this, SLOT(on_reap()));
+}
+
+bool SpawnedProcess::reap(bool block) {
+// emits finished() once the child has exited
+
+#ifdef Q_OS_LINUX
+    int status;
+    pid_t r;
+    do
+        r = waitpid(pid, &status, block ? 0 : WNOHANG);
+    while (r < 0 && errno == EINTR);
+
+    if (r == 0)
+        return false;
+
+    pid = -1;
+    if (r > 0 && WIFEXITED(status))
+        emit finished(WEXITSTATUS(status), QProcess::NormalExit);
+    else
+        emit finished(-1, QProcess::CrashExit);
+#else
+    Q_UNUSED(block);
+#endif
+    return true;
+}
+
+bool SpawnedProcess::waitForFinished(int msecs) {
+/*
+   As QProcess::waitForFinished(), signals are emitted from here,
+   without going back to the event loop. A negative value waits
+   until the child exits.
+*/
+#ifdef Q_OS_LINUX
+    QTime t;
+    t.start();
+    while (pid > 0) {
+
+        int left = (msecs < 0 ? -1 : qMax(msecs - t.elapsed(), 0));
+        if (fds[OUT] == -1 && fds[ERR] == -1) {
+            if (reap(left != 0 && msecs < 0))
+                return true;
+            if (left == 0)
+                return false;
+            usleep(1000);
+            continue;
+        }
+        struct pollfd pfd[CHANNELS];
+        memset(pfd, 0, sizeof(pfd));
+        int cnt = 0;
+        for (int i = 0; i < CHANNELS; i++)
+            if (fds[i] != -1) {
+                pfd[cnt].fd = fds[i];
+                pfd[cnt].events = POLLIN;
+                cnt++;
+            }
+        int n = poll(pfd, cnt, left);
+        if (n < 0 && errno == EINTR)
+            continue; // a signal, time left is computed again
+
+        if (n <= 0)
+            return false; // timeout or error
+
+        for (int i = 0; i < cnt; i++)
+            if (pfd[i].revents)
+                on_activated(pfd[i].fd);
+    }
+#else
+    Q_UNUSED(msecs);
+#endif
+    return pid <= 0;
+}
+
+void SpawnedProcess::terminate() {
+
+#ifdef Q_OS_LINUX
+    if (pid > 0)
+        ::kill(pid, SIGTERM);
+#endif
+}
+
+void SpawnedProcess::kill() {
+// for a child that ignores terminate()
+
+#ifdef Q_OS_LINUX
+    if (pid > 0)
+        ::kill(pid, SIGKILL);
+#endif
+}
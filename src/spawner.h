@@ -0,0 +1,59 @@
+#ifndef SPAWNER_H
+#define SPAWNER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QProcess>
+
+class QSocketNotifier;
+class QStringList;
+
+/*
+ * Minimal child process started with posix_spawn(), without the
+ * QProcess machinery: no fork of a big address space, no helper
+ * thread or signal pipe, just two output pipes watched by socket
+ * notifiers in the event loop. Standard input is /dev/null.
+ *
+ * Signals and accessors have the same names of QProcess ones, so
+ * that MyProcess can use it as is. Available only on Linux with a
+ * libc able to change directory at spawn, start() fails otherwise
+ * and caller should fall back on QProcess.
+ */
+class SpawnedProcess : public QObject {
+Q_OBJECT
+public:
+    explicit SpawnedProcess(QObject* parent);
+    ~SpawnedProcess();
+
+    bool start(const QStringList& args, const QString& workDir);
+    QByteArray readAllStandardOutput() { return takeData(OUT); }
+    QByteArray readAllStandardError() { return takeData(ERR); }
+    bool waitForFinished(int msecs);
+    void terminate();
+    void kill();
+    bool isRunning() const { return pid > 0; }
+
+signals:
+    void readyReadStandardOutput();
+    void readyReadStandardError();
+    void finished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private slots:
+    void on_activated(int fd);
+    void on_reap();
+
+private:
+    enum Channel { OUT, ERR, CHANNELS };
+
+    QByteArray takeData(Channel ch);
+    bool readChannel(Channel ch);
+    void closeChannel(Channel ch);
+    bool reap(bool block);
+
+    int pid;
+    int fds[CHANNELS]; // read ends, -1 once closed
+    QSocketNotifier* notifiers[CHANNELS];
+    QByteArray data[CHANNELS];
+};
+
+#endif // SPAWNER_H
@@ -3,8 +3,8 @@ QMAKE_CXXFLAGS +=-std=c++11
 INCLUDEPATH += $$PWD
 MAKEFILE = qmake
 RESOURCES += $$PWD/icons.qrc
-LIBS += -lGrantlee_Templates
-QT += webkitwidgets
+LIBS += -lGrantlee_Templates -lz
+QT += webkitwidgets concurrent network
 
 # Directories
 DESTDIR = $$PWD/../bin
@@ -23,9 +23,25 @@ HEADERS += $$PWD/cache.h $$PWD/commitimpl.h $$PWD/common.h $$PWD/config.h \
            $$PWD/git.h $$PWD/help.h $$PWD/lanes.h \
            $$PWD/mainimpl.h $$PWD/myprocess.h \
            $$PWD/revdesc.h $$PWD/revsview.h $$PWD/settingsimpl.h \
+    $$PWD/analytics.h \
+    $$PWD/annotate.h \
+    $$PWD/dateindex.h \
     $$PWD/filehistory.h \
+    $$PWD/historyorder.h \
     $$PWD/historyview.h \
+    $$PWD/logdaemon.h \
+    $$PWD/logformat.h \
     $$PWD/navigator/navigatorcontroller.h \
+    $$PWD/odb/objectdb.h \
+    $$PWD/odb/commitwalker.h \
+    $$PWD/odb/commitgraph.h \
+    $$PWD/odb/packbitmap.h \
+    $$PWD/patchid.h \
+    $$PWD/reachability.h \
+    $$PWD/rowblocks.h \
+    $$PWD/snapshot.h \
+    $$PWD/spawner.h \
+    $$PWD/task.h \
     $$PWD/diff/DiffLine.h \
     $$PWD/diff/TreeDiff.h \
     $$PWD/diff/FileDiff.h \
@@ -35,16 +51,34 @@ HEADERS += $$PWD/cache.h $$PWD/commitimpl.h $$PWD/common.h $$PWD/config.h \
     $$PWD/tools/tools.h \
     $$PWD/tools/optional.h \
     $$PWD/tools/maybe.h \
-    $$PWD/ui/searchedit.h
+    $$PWD/ui/searchedit.h \
+    $$PWD/ui/diffview.h \
+    $$PWD/ui/analyticsview.h \
+    $$PWD/ui/annotateview.h
 
 SOURCES += $$PWD/cache.cpp $$PWD/commitimpl.cpp \
            $$PWD/dataloader.cpp $$PWD/domain.cpp $$PWD/exceptionmanager.cpp \
            $$PWD/git.cpp $$PWD/git_startup.cpp \
            $$PWD/lanes.cpp $$PWD/mainimpl.cpp $$PWD/myprocess.cpp $$PWD/namespace_def.cpp \
            $$PWD/revdesc.cpp $$PWD/revsview.cpp $$PWD/settingsimpl.cpp \
+    $$PWD/analytics.cpp \
+    $$PWD/annotate.cpp \
+    $$PWD/dateindex.cpp \
     $$PWD/filehistory.cpp \
+    $$PWD/historyorder.cpp \
     $$PWD/historyview.cpp \
+    $$PWD/logdaemon.cpp \
     $$PWD/navigator/navigatorcontroller.cpp \
+    $$PWD/odb/objectdb.cpp \
+    $$PWD/odb/commitwalker.cpp \
+    $$PWD/odb/commitgraph.cpp \
+    $$PWD/odb/packbitmap.cpp \
+    $$PWD/patchid.cpp \
+    $$PWD/reachability.cpp \
+    $$PWD/rowblocks.cpp \
+    $$PWD/snapshot.cpp \
+    $$PWD/spawner.cpp \
+    $$PWD/task.cpp \
     $$PWD/diff/DiffLine.cpp \
     $$PWD/diff/TreeDiff.cpp \
     $$PWD/diff/FileDiff.cpp \
@@ -52,4 +86,7 @@ SOURCES += $$PWD/cache.cpp $$PWD/commitimpl.cpp \
     $$PWD/diff/diff.cpp \
     $$PWD/tools/tools.cpp \
     $$PWD/tools/maybe.cpp \
-    $$PWD/ui/searchedit.cpp
+    $$PWD/ui/searchedit.cpp \
+    $$PWD/ui/diffview.cpp \
+    $$PWD/ui/analyticsview.cpp \
+    $$PWD/ui/annotateview.cpp
@@ -0,0 +1,101 @@
+#include "task.h"
+
+#include <QApplication>
+#include <QProcess>
+#include <QtConcurrentRun>
+
+#include "common.h"
+#include "myprocess.h"
+
+static const int CANCEL_POLL = 20; // ms, as in MyProcess::runSync()
+
+Task::Task(QObject* p, QObject* er) : QObject(p), errorReceiver(er) {
+
+    connect(&watcher, SIGNAL(finished()), this, SLOT(on_workFinished()));
+}
+
+Task::~Task() {
+// work function could still be running and using us
+
+    tok.cancel();
+    watcher.waitForFinished();
+}
+
+void Task::start(const Func& work, const Func& done) {
+
+    continuation = done;
+    watcher.setFuture(QtConcurrent::run(work));
+}
+
+void Task::on_workFinished() {
+
+    if (!tok.isCanceled() && continuation)
+        continuation();
+
+    emit finished();
+    deleteLater();
+}
+
+void Task::setProgress(int done, int total) {
+// called from the pool thread, receivers in GUI thread get a queued signal
+
+    if (!tok.isCanceled())
+        emit progress(done, total);
+}
+
+bool Task::run(const QString& cmd, const QString& workDir, QByteArray* out,
+               const QString& buf, bool reportErrors) const {
+/*
+   Same as MyProcess::runSync() but without any event loop, the process
+   belongs to the calling pool thread and is killed as soon as the task
+   is canceled. A failing command is detected in the same way too.
+*/
+    if (out)
+        out->clear();
+
+    const QStringList args(MyProcess::splitArgList(cmd));
+    if (args.isEmpty() || tok.isCanceled())
+        return false;
+
+    QProcess p;
+    bool isWinShell = false;
+    p.setWorkingDirectory(workDir);
+    if (!QGit::startProcess(&p, args, buf, &isWinShell)) {
+        if (reportErrors)
+            sendErrorMsg(args, "Unable to start the process!");
+        return false;
+    }
+    while (p.state() != QProcess::NotRunning) {
+
+        if (tok.isCanceled()) {
+            p.kill();
+            p.waitForFinished();
+            return false;
+        }
+        p.waitForFinished(CANCEL_POLL);
+
+        const QByteArray data(p.readAllStandardOutput());
+        if (out)
+            out->append(data);
+    }
+    const QByteArray data(p.readAllStandardOutput());
+    if (out)
+        out->append(data);
+
+    const QString err(p.readAllStandardError());
+    bool isErrorExit =   (p.exitStatus() != QProcess::NormalExit)
+                      || (p.exitCode() != 0 && isWinShell)
+                      || !err.isEmpty();
+    if (isErrorExit && reportErrors)
+        sendErrorMsg(args, err);
+
+    return !isErrorExit && !tok.isCanceled();
+}
+
+void Task::sendErrorMsg(const QStringList& args, const QString& err) const {
+
+    if (!errorReceiver || tok.isCanceled())
+        return;
+
+    QApplication::postEvent(errorReceiver, new MainExecErrorEvent(args.join(" "), err));
+}
@@ -0,0 +1,75 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <functional>
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+
+class QStringList;
+
+/*
+ * A flag shared between who starts some work and the work itself,
+ * copies refer to the same flag. Once canceled stays canceled.
+ */
+class CancelToken {
+public:
+    CancelToken() : flag(new QAtomicInt(0)) {}
+    void cancel() const { flag->storeRelease(1); }
+    bool isCanceled() const { return flag->loadAcquire() != 0; }
+
+private:
+    QSharedPointer<QAtomicInt> flag;
+};
+
+/*
+ * Runs a long operation in the global thread pool instead of spinning
+ * the event loop with EM_PROCESS_EVENTS while the GUI thread waits.
+ *
+ * The work function runs in a pool thread, so it must not touch Git
+ * data or any widget, it checks isCanceled() often enough and can call
+ * setProgress(). When the work is done the continuation runs in the
+ * thread the task lives in, normally the GUI one, but only if the task
+ * has not been canceled in the mean time. Then the task deletes itself.
+ *
+ * A task deleted before, e.g. together with its parent, cancels the
+ * work and waits for it, so work functions can safely use the task.
+ */
+class Task : public QObject {
+Q_OBJECT
+public:
+    typedef std::function<void()> Func;
+
+    explicit Task(QObject* parent, QObject* errorReceiver = NULL);
+    ~Task();
+
+    void start(const Func& work, const Func& done);
+    const CancelToken& token() const { return tok; }
+    bool isCanceled() const { return tok.isCanceled(); }
+    void setProgress(int done, int total);
+    bool run(const QString& cmd, const QString& workDir, QByteArray* out,
+             const QString& buf = "", bool reportErrors = true) const;
+
+signals:
+    void progress(int done, int total);
+    void finished();
+
+public slots:
+    void cancel() { tok.cancel(); }
+
+private slots:
+    void on_workFinished();
+
+private:
+    void sendErrorMsg(const QStringList& args, const QString& err) const;
+
+    CancelToken tok;
+    QObject* errorReceiver;
+    QFutureWatcher<void> watcher;
+    Func continuation;
+};
+
+#endif // TASK_H
@@ -0,0 +1,167 @@
+#include "analyticsview.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QComboBox>
+#include <QDateTime>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTabWidget>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "git.h"
+#include "snapshot.h"
+#include "task.h"
+
+static const int QUERY_DELAY = 150; // ms, recompute once user stops typing
+
+static const int RANGE_DAYS[] = { 0, 30, 91, 365 };  // 0 for whole history
+static const int PERIOD_DAYS[] = { 7, 30, 91, 365 };
+
+AnalyticsView::AnalyticsView(QWidget* p, Git* g) : QDialog(p), git(g), dataGen(-1) {
+
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle("Repository statistics");
+
+    prefixEdit = new QLineEdit(this);
+    prefixEdit->setPlaceholderText("All paths");
+    depthBox = new QSpinBox(this);
+    depthBox->setRange(0, 16);
+    depthBox->setValue(1);
+    rangeBox = new QComboBox(this);
+    rangeBox->addItems(QStringList() << "Whole history" << "Last month"
+                                     << "Last quarter" << "Last year");
+    periodBox = new QComboBox(this);
+    periodBox->addItems(QStringList() << "Week" << "Month" << "Quarter" << "Year");
+    periodBox->setCurrentIndex(1);
+
+    QFormLayout* form = new QFormLayout;
+    form->addRow("Directory", prefixEdit);
+    form->addRow("Group depth", depthBox);
+    form->addRow("Authored in", rangeBox);
+    form->addRow("Period", periodBox);
+
+    summary = new QLabel(this);
+    paths = new QTreeWidget(this);
+    authors = new QTreeWidget(this);
+    periods = new QTreeWidget(this);
+    QTabWidget* tabs = new QTabWidget(this);
+    tabs->addTab(paths, "Paths");
+    tabs->addTab(authors, "Authors");
+    tabs->addTab(periods, "Periods");
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    QPushButton* copy = buttons->addButton("Copy report", QDialogButtonBox::ActionRole);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(summary);
+    layout->addWidget(tabs);
+    layout->addWidget(buttons);
+    resize(600, 500);
+
+    delay = new QTimer(this);
+    delay->setSingleShot(true);
+    delay->setInterval(QUERY_DELAY);
+
+    connect(delay, SIGNAL(timeout()), this, SLOT(on_recompute()));
+    connect(prefixEdit, SIGNAL(textChanged(const QString&)), this, SLOT(on_queryChanged()));
+    connect(depthBox, SIGNAL(valueChanged(int)), this, SLOT(on_queryChanged()));
+    connect(rangeBox, SIGNAL(currentIndexChanged(int)), this, SLOT(on_queryChanged()));
+    connect(periodBox, SIGNAL(currentIndexChanged(int)), this, SLOT(on_queryChanged()));
+    connect(copy, SIGNAL(clicked()), this, SLOT(on_copyReport()));
+    connect(buttons, SIGNAL(rejected()), this, SLOT(close()));
+
+    on_recompute();
+}
+
+const ChurnQuery AnalyticsView::query() const {
+
+    ChurnQuery q;
+    q.prefix = prefixEdit->text().trimmed();
+    q.depth = depthBox->value();
+    q.periodDays = PERIOD_DAYS[periodBox->currentIndex()];
+    int days = RANGE_DAYS[rangeBox->currentIndex()];
+    if (days > 0)
+        q.since = QDateTime::currentDateTime().addDays(-days).toTime_t();
+
+    return q;
+}
+
+void AnalyticsView::on_queryChanged() {
+
+    delay->start();
+}
+
+void AnalyticsView::on_recompute() {
+// previous query, if still running, is not interesting anymore
+
+    if (task)
+        task->cancel();
+
+    const RepoSnapshotPtr s(git->snapshot());
+    if (s->count() == 0) {
+        summary->setText("Repository not loaded yet");
+        return;
+    }
+    summary->setText("Computing...");
+
+    // tables are taken again only if a new snapshot has been published
+    const bool reload = (s->generation() != dataGen || !data);
+    const ChurnDataPtr cur(data);
+    const ChurnQuery q(query());
+    QSharedPointer<ChurnDataPtr> newData(new ChurnDataPtr(cur));
+    QSharedPointer<ChurnReport> res(new ChurnReport);
+
+    Task* t = new Task(this);
+    task = t;
+    t->start([=]() {
+        if (reload)
+            *newData = Analytics::fromSnapshot(s);
+
+        *res = Analytics::compute(**newData, q, t->token());
+    }, [=]() {
+        data = *newData;
+        dataGen = s->generation();
+        showReport(*res);
+    });
+}
+
+void AnalyticsView::fillTable(QTreeWidget* tw, const QVector<ChurnEntry>& entries) {
+
+    tw->clear();
+    QList<QTreeWidgetItem*> items;
+    FOREACH (QVector<ChurnEntry>, it, entries) {
+        QStringList sl;
+        sl << it->key << QString::number(it->commits) << QString::number(it->changes);
+        items.append(new QTreeWidgetItem(sl));
+    }
+    tw->addTopLevelItems(items);
+}
+
+void AnalyticsView::showReport(const ChurnReport& r) {
+
+    report = r;
+    summary->setText(QString("%1 commits, %2 file changes").arg(r.commits).arg(r.changes));
+
+    QTreeWidget* tables[] = { paths, authors, periods };
+    const char* titles[] = { "Path", "Author", "Period starting" };
+    for (int i = 0; i < 3; i++) {
+        tables[i]->setRootIsDecorated(false);
+        tables[i]->setHeaderLabels(QStringList() << titles[i] << "Commits" << "Changed files");
+    }
+    fillTable(paths, r.byPath);
+    fillTable(authors, r.byAuthor);
+    fillTable(periods, r.byPeriod);
+}
+
+void AnalyticsView::on_copyReport() {
+
+    QApplication::clipboard()->setText(report.toText());
+}
@@ -0,0 +1,55 @@
+#ifndef ANALYTICSVIEW_H
+#define ANALYTICSVIEW_H
+
+#include <QDialog>
+#include <QPointer>
+
+#include "analytics.h"
+
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QSpinBox;
+class QTimer;
+class QTreeWidget;
+class Git;
+class Task;
+
+/*
+ * Churn statistics of the repository shown in main view, recomputed
+ * in background at each change of the query. Tables are taken from
+ * the latest snapshot once, and again only when a new one has been
+ * published, e.g. after a refresh.
+ */
+class AnalyticsView : public QDialog {
+    Q_OBJECT
+public:
+    AnalyticsView(QWidget* parent, Git* git);
+
+private slots:
+    void on_queryChanged();
+    void on_recompute();
+    void on_copyReport();
+
+private:
+    const ChurnQuery query() const;
+    void showReport(const ChurnReport& r);
+    static void fillTable(QTreeWidget* tw, const QVector<ChurnEntry>& entries);
+
+    Git* git;
+    ChurnDataPtr data;
+    int dataGen;
+    ChurnReport report;
+    QPointer<Task> task;
+    QTimer* delay;
+    QLineEdit* prefixEdit;
+    QSpinBox* depthBox;
+    QComboBox* rangeBox;
+    QComboBox* periodBox;
+    QLabel* summary;
+    QTreeWidget* paths;
+    QTreeWidget* authors;
+    QTreeWidget* periods;
+};
+
+#endif // ANALYTICSVIEW_H
@@ -0,0 +1,131 @@
+#include "annotateview.h"
+
+#include <QDialogButtonBox>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QSplitter>
+#include <QTreeView>
+#include <QVBoxLayout>
+
+#include "filehistory.h"
+#include "git.h"
+#include "task.h"
+
+AnnotateView::AnnotateView(QWidget* p, Git* g, SCRef sha, SCRef fn)
+             : QDialog(p), git(g), startSha(sha), fileName(fn) {
+
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle("File history of '" + fileName + "'");
+
+    fh = new FileHistory(this, git);
+    history = new QTreeView(this);
+    history->setRootIsDecorated(false);
+    history->setUniformRowHeights(true);
+    history->setModel(fh);
+
+    text = new QPlainTextEdit(this);
+    text->setReadOnly(true);
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    text->setFont(QGit::TYPE_WRITER_FONT);
+
+    QSplitter* splitter = new QSplitter(Qt::Vertical, this);
+    splitter->addWidget(history);
+    splitter->addWidget(text);
+    splitter->setStretchFactor(1, 3);
+
+    status = new QLabel("Loading file history...", this);
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(splitter);
+    layout->addWidget(status);
+    layout->addWidget(buttons);
+    resize(800, 700);
+
+    connect(git, SIGNAL(loadCompleted(const FileHistory*, const QString&)),
+            this, SLOT(on_loadCompleted(const FileHistory*, const QString&)));
+    connect(history, SIGNAL(activated(const QModelIndex&)),
+            this, SLOT(on_activated(const QModelIndex&)));
+    connect(buttons, SIGNAL(rejected()), this, SLOT(close()));
+
+    if (!git->startFileHistory(sha, fileName, fh))
+        status->setText("Unable to load file history");
+}
+
+AnnotateView::~AnnotateView() {
+
+    git->cancelDataLoading(fh);
+}
+
+void AnnotateView::on_loadCompleted(const FileHistory* f, const QString&) {
+// patches are all loaded now, annotation can start
+
+    if (f != fh)
+        return;
+
+    if (fh->rowCount() == 0) {
+        status->setText("No history found");
+        return;
+    }
+    annotate(fh->row(startSha) != -1 ? startSha : fh->sha(0));
+}
+
+void AnnotateView::on_activated(const QModelIndex& index) {
+
+    if (index.isValid())
+        annotate(fh->sha(index.row()));
+}
+
+void AnnotateView::annotate(SCRef sha) {
+// previous annotation, if still running, is not interesting anymore
+
+    if (task)
+        task->cancel();
+
+    const int row = fh->row(sha);
+    history->setCurrentIndex(fh->index(row, 0));
+
+    QByteArray fileData;
+    git->getFile(git->getFileSha(fileName, sha), NULL, &fileData, fileName);
+    content = QString(fileData).split('\n');
+    if (!fileData.isEmpty() && fileData.endsWith('\n'))
+        content.removeLast();
+
+    text->setPlainText(content.join("\n"));
+    status->setText("Annotating...");
+
+    // lines on screen are the ones to be annotated first
+    const int lineH = qMax(text->fontMetrics().lineSpacing(), 1);
+    const int screenLines = text->viewport()->height() / lineH + 1;
+
+    task = git->startAnnotate(this, fh, sha, fileName, screenLines,
+                              [=](const FileAnnotation& fa) { showAnnotation(fa); });
+    if (!task)
+        status->setText("Unable to annotate");
+}
+
+void AnnotateView::showAnnotation(const FileAnnotation& fa) {
+
+    int width = 1;
+    FOREACH_SL (it, fa.lines)
+        width = qMax(width, it->length());
+
+    QStringList sl;
+    for (int i = 0; i < content.count(); i++) {
+        const QString id(i < fa.lines.count() ? fa.lines.at(i) : "");
+        sl.append(id.rightJustified(width) + "  " + content.at(i));
+    }
+    // keep what user is looking at while the rest is filled in
+    QScrollBar* vs = text->verticalScrollBar();
+    QScrollBar* hs = text->horizontalScrollBar();
+    const int v = vs->value(), h = hs->value();
+    text->setPlainText(sl.join("\n"));
+    vs->setValue(v);
+    hs->setValue(h);
+
+    if (fa.isValid)
+        status->setText(QString("Annotated %1 lines").arg(content.count()));
+    else
+        status->setText("Annotating...");
+}
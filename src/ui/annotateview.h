@@ -0,0 +1,48 @@
+#ifndef ANNOTATEVIEW_H
+#define ANNOTATEVIEW_H
+
+#include <QDialog>
+#include <QPointer>
+
+#include "common.h"
+
+class QLabel;
+class QModelIndex;
+class QPlainTextEdit;
+class QTreeView;
+class FileHistory;
+class Git;
+class Task;
+
+/*
+ * History of a file with the annotation of the selected revision. The
+ * annotation is computed in background from the patches loaded with the
+ * history, lines on screen are shown as soon as they are known and the
+ * rest is filled in while older revisions are walked.
+ */
+class AnnotateView : public QDialog {
+    Q_OBJECT
+public:
+    AnnotateView(QWidget* parent, Git* git, SCRef sha, SCRef fileName);
+    ~AnnotateView();
+
+private slots:
+    void on_loadCompleted(const FileHistory* f, const QString& msg);
+    void on_activated(const QModelIndex& index);
+
+private:
+    void annotate(SCRef sha);
+    void showAnnotation(const FileAnnotation& fa);
+
+    Git* git;
+    FileHistory* fh;
+    QString startSha;
+    QString fileName;
+    QStringList content;
+    QPointer<Task> task;
+    QTreeView* history;
+    QPlainTextEdit* text;
+    QLabel* status;
+};
+
+#endif // ANNOTATEVIEW_H
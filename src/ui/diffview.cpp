@@ -0,0 +1,203 @@
+#include "diffview.h"
+
+#include <QEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include "common.h"
+#include "diff/diff.h"
+
+static const int GLYPH_CACHE_ROWS = 4096; // a few screens, scrolling back is free
+static const int TEXT_MARGIN = 4;
+static const int TAB_WIDTH = 8;
+
+DiffView::DiffView(QWidget* p) : QAbstractScrollArea(p), glyphs(GLYPH_CACHE_ROWS) {
+
+    maxChars = gutterDigits = 0;
+    setFont(QGit::TYPE_WRITER_FONT);
+    viewport()->setBackgroundRole(QPalette::Base);
+    updateMetrics();
+}
+
+void DiffView::clear() {
+
+    rows.clear();
+    fileRows.clear();
+    diff.clear(); // after rows, they point into it
+    maxChars = gutterDigits = 0;
+    updateMetrics();
+}
+
+void DiffView::setDiff(const QSharedPointer<TreeDiff>& d) {
+// only an index of rows is built here, text is laid out when shown
+
+    clear();
+    diff = d;
+    if (!diff)
+        return;
+
+    linenumber maxLine = 0;
+    const TreeDiff::TreeDiffEntryList entries(diff->entries());
+    FOREACH (TreeDiff::TreeDiffEntryList, e, entries) {
+
+        TreeDiffEntry* entry = e->data();
+        fileRows.append(rows.count());
+        rows.append(Row(FILE_ROW, entry));
+
+        const FileDiff::HunksList hunks(entry->fileDiff()->hunks());
+        FOREACH (FileDiff::HunksList, h, hunks) {
+
+            Hunk* hunk = h->data();
+            rows.append(Row(HUNK_ROW, entry, hunk));
+            maxLine = qMax(maxLine, qMax(hunk->oldRangeStart() + hunk->oldRangeLength(),
+                                         hunk->newRangeStart() + hunk->newRangeLength()));
+
+            const Hunk::LinesList lines(hunk->lines());
+            FOREACH (Hunk::LinesList, l, lines) {
+
+                DiffLine* line = l->data();
+                RowType t = (line->adding() ? ADD_ROW : line->deleting() ? DELETE_ROW : CONTEXT_ROW);
+                rows.append(Row(t, entry, hunk, line));
+                maxChars = qMax(maxChars, line->content().length());
+            }
+        }
+    }
+    gutterDigits = QString::number(maxLine).length();
+    setFont(QGit::TYPE_WRITER_FONT); // could be changed in settings
+    updateMetrics();
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    viewport()->update();
+}
+
+bool DiffView::scrollToFile(int entryId) {
+
+    FOREACH (QVector<int>, it, fileRows)
+        if (rows.at(*it).file->id() == entryId) {
+            verticalScrollBar()->setValue(*it);
+            return true;
+        }
+    return false;
+}
+
+bool DiffView::scrollToFile(const QString& fileName) {
+
+    FOREACH (QVector<int>, it, fileRows)
+        if (rows.at(*it).file->displayedFileName() == fileName) {
+            verticalScrollBar()->setValue(*it);
+            return true;
+        }
+    return false;
+}
+
+void DiffView::updateMetrics() {
+
+    QFontMetrics fm(font());
+    lineHeight = qMax(fm.lineSpacing(), 1);
+    charWidth = qMax(fm.width(QLatin1Char('0')), 1); // fixed pitch font
+
+    // old and new line numbers columns
+    gutterWidth = (gutterDigits ? (2 * gutterDigits + 2) * charWidth : 0) + TEXT_MARGIN;
+    glyphs.clear();
+    updateScrollBars();
+}
+
+void DiffView::updateScrollBars() {
+// in rows and characters, not in pixels
+
+    int visibleRows = viewport()->height() / lineHeight;
+    int visibleChars = (viewport()->width() - gutterWidth - TEXT_MARGIN) / charWidth;
+
+    verticalScrollBar()->setRange(0, qMax(rows.count() - visibleRows, 0));
+    verticalScrollBar()->setPageStep(qMax(visibleRows, 1));
+    horizontalScrollBar()->setRange(0, qMax(maxChars - visibleChars, 0));
+    horizontalScrollBar()->setPageStep(qMax(visibleChars, 1));
+}
+
+void DiffView::resizeEvent(QResizeEvent*) {
+
+    updateScrollBars();
+}
+
+void DiffView::changeEvent(QEvent* e) {
+
+    if (e->type() == QEvent::FontChange)
+        updateMetrics();
+
+    QAbstractScrollArea::changeEvent(e);
+}
+
+const QString DiffView::rowText(const Row& r) const {
+
+    switch (r.type) {
+    case FILE_ROW:
+        if (r.file->isRenamed())
+            return r.file->oldName() + " -> " + r.file->fileName();
+        if (r.file->isNew())
+            return r.file->fileName() + " (new)";
+        if (r.file->isDeleted())
+            return r.file->displayedFileName() + " (deleted)";
+        return r.file->fileName();
+    case HUNK_ROW:
+        return QString("@@ -%1,%2 +%3,%4 @@").arg(r.hunk->oldRangeStart())
+               .arg(r.hunk->oldRangeLength()).arg(r.hunk->newRangeStart())
+               .arg(r.hunk->newRangeLength());
+    default:
+        break;
+    }
+    QString s(r.line->content());
+    s.replace('\t', QString(TAB_WIDTH, ' '));
+    return s;
+}
+
+const QString DiffView::gutterText(const Row& r) const {
+
+    if (!r.line)
+        return "";
+
+    const int digits = gutterDigits;
+    const QString o(r.line->hasOldLineNumber() ? QString::number(r.line->oldLineNumber()) : "");
+    const QString n(r.line->hasNewLineNumber() ? QString::number(r.line->newLineNumber()) : "");
+    return o.rightJustified(digits) + ' ' + n.rightJustified(digits);
+}
+
+void DiffView::paintEvent(QPaintEvent*) {
+
+    QPainter p(viewport());
+    const QPalette& pal = palette();
+    const int first = verticalScrollBar()->value();
+    const int last = qMin(first + viewport()->height() / lineHeight + 1, rows.count());
+    const int width = viewport()->width();
+    const int textX = gutterWidth + TEXT_MARGIN - horizontalScrollBar()->value() * charWidth;
+
+    for (int i = first, y = 0; i < last; i++, y += lineHeight) {
+
+        const Row& r = rows.at(i);
+        QColor bg;
+        switch (r.type) {
+        case FILE_ROW:   bg = pal.color(QPalette::AlternateBase).darker(110); break;
+        case HUNK_ROW:   bg = QColor(230, 236, 250); break;
+        case ADD_ROW:    bg = QColor(221, 255, 221); break;
+        case DELETE_ROW: bg = QColor(255, 221, 221); break;
+        default:         break;
+        }
+        if (bg.isValid())
+            p.fillRect(0, y, width, lineHeight, bg);
+
+        p.setPen(pal.color(QPalette::Dark));
+        p.setClipping(false);
+        p.drawText(QRect(0, y, gutterWidth, lineHeight), Qt::AlignLeft | Qt::AlignVCenter, gutterText(r));
+
+        // laid out glyphs are reused until font changes
+        QStaticText* st = glyphs.object(i);
+        if (!st) {
+            st = new QStaticText(rowText(r));
+            st->setTextFormat(Qt::PlainText);
+            st->prepare(QTransform(), font());
+            glyphs.insert(i, st);
+        }
+        p.setPen(pal.color(QPalette::Text));
+        p.setClipRect(gutterWidth, y, width - gutterWidth, lineHeight);
+        p.drawStaticText(textX, y, *st);
+    }
+}
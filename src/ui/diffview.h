@@ -0,0 +1,65 @@
+#ifndef DIFFVIEW_H
+#define DIFFVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QCache>
+#include <QSharedPointer>
+#include <QStaticText>
+#include <QVector>
+
+#include "diff/diff_def.h"
+
+class TreeDiffEntry;
+
+/*
+ * Shows a parsed diff painting only the rows in the viewport, so its
+ * cost does not depend on the diff size as with the HTML description.
+ *
+ * All rows have the same height, so the scroll bar is in rows and a
+ * row is found by index. Row text is laid out once, when first shown,
+ * and kept in a bounded cache; colours depend only on the row type.
+ */
+class DiffView : public QAbstractScrollArea {
+    Q_OBJECT
+public:
+    explicit DiffView(QWidget* parent = NULL);
+
+    void setDiff(const QSharedPointer<TreeDiff>& d);
+    void clear();
+    bool scrollToFile(int entryId);
+    bool scrollToFile(const QString& fileName);
+
+protected:
+    virtual void paintEvent(QPaintEvent*);
+    virtual void resizeEvent(QResizeEvent*);
+    virtual void changeEvent(QEvent*);
+
+private:
+    enum RowType { FILE_ROW, HUNK_ROW, CONTEXT_ROW, ADD_ROW, DELETE_ROW };
+
+    struct Row { // pointed objects are owned by diff
+        Row(RowType t, TreeDiffEntry* f, Hunk* h = NULL, DiffLine* l = NULL)
+            : type(t), file(f), hunk(h), line(l) {}
+        Row() : type(CONTEXT_ROW), file(NULL), hunk(NULL), line(NULL) {}
+        RowType type;
+        TreeDiffEntry* file;
+        Hunk* hunk;
+        DiffLine* line;
+    };
+    void updateMetrics();
+    void updateScrollBars();
+    const QString rowText(const Row& r) const;
+    const QString gutterText(const Row& r) const;
+
+    QSharedPointer<TreeDiff> diff;
+    QVector<Row> rows;
+    QVector<int> fileRows;   // first row of each file
+    QCache<int, QStaticText> glyphs;
+    int lineHeight;
+    int charWidth;
+    int gutterWidth;
+    int gutterDigits;        // of the biggest line number
+    int maxChars;            // longest row, for horizontal scroll bar
+};
+
+#endif // DIFFVIEW_H
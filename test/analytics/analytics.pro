@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_analytics
+
+SOURCES += \
+    $$PWD/tst_analytics.cpp
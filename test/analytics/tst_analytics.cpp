@@ -0,0 +1,230 @@
+#include <QtTest>
+
+#include "analytics.h"
+#include "task.h"
+
+static const int ROWS = 1000000;
+static const int TOP_DIRS = 20;
+static const int SUB_DIRS = 25;   // per top directory
+static const int AUTHORS = 300;
+static const uint BASE_TIME = 1300000000;
+static const uint SPAN = 10 * 365 * 86400;
+
+Q_DECLARE_METATYPE(ChurnQuery)
+
+class AnalyticsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void totals_data();
+    void totals();
+    void groups();
+    void canceled();
+    void computeTime_data() { totals_data(); }
+    void computeTime();
+
+private:
+    const ChurnReport scan(const ChurnQuery& q) const;
+
+    ChurnData data;
+    QList<RevFile*> files;
+};
+
+void AnalyticsTest::initTestCase()
+{
+/*
+   Ten years of history on a two level tree, rows change from one
+   to eight files, some rows have no file names yet.
+*/
+    data.dirNames.append(""); // root
+    for (int t = 0; t < TOP_DIRS; t++) {
+        data.dirNames.append(QString("top%1/").arg(t));
+        for (int s = 0; s < SUB_DIRS; s++)
+            data.dirNames.append(QString("top%1/sub%2/").arg(t).arg(s));
+    }
+    for (int a = 0; a < AUTHORS; a++)
+        data.authors.append(QString("Author %1 <a%1@example.com>").arg(a));
+
+    qsrand(1);
+    data.files.reserve(ROWS);
+    for (int r = 0; r < ROWS; r++) {
+        data.authorTimes.append(BASE_TIME + uint(qrand()) % SPAN);
+        data.authorIds.append(r % 97 == 0 ? -1 : qrand() % AUTHORS);
+        if (r % 101 == 0) {
+            data.files.append(NULL);
+            continue;
+        }
+        const int cnt = 1 + qrand() % 8;
+        QVector<int> idx(cnt * 2);
+        for (int i = 0; i < cnt; i++) {
+            idx[i] = qrand() % data.dirNames.count();
+            idx[cnt + i] = i;
+        }
+        RevFile* rf = new RevFile;
+        rf->pathsIdx = QByteArray((const char*)idx.constData(), idx.count() * (int)sizeof(int));
+        files.append(rf);
+        data.files.append(rf);
+    }
+}
+
+void AnalyticsTest::cleanupTestCase()
+{
+    data.files.clear();
+    qDeleteAll(files);
+}
+
+const ChurnReport AnalyticsTest::scan(const ChurnQuery& q) const
+{
+// totals and authors counted row by row, what compute() splits in chunks
+
+    QString prefix(q.prefix);
+    if (!prefix.isEmpty() && !prefix.endsWith('/'))
+        prefix.append('/');
+
+    ChurnReport r;
+    QVector<int> authorChanges(data.authors.count());
+    for (int row = 0; row < data.files.count(); row++) {
+
+        const RevFile* rf = data.files.at(row);
+        const uint t = data.authorTimes.at(row);
+        if (!rf || t < q.since || t > q.until)
+            continue;
+
+        int changed = 0;
+        for (int i = 0; i < rf->count(); i++)
+            if (data.dirNames.at(rf->dirAt(i)).startsWith(prefix))
+                changed++;
+
+        if (changed == 0)
+            continue;
+
+        r.commits++;
+        r.changes += changed;
+        if (data.authorIds.at(row) != -1)
+            authorChanges[data.authorIds.at(row)] += changed;
+    }
+    for (int a = 0; a < authorChanges.count(); a++)
+        if (authorChanges.at(a) > 0) {
+            ChurnEntry e;
+            e.key = data.authors.at(a);
+            e.changes = authorChanges.at(a);
+            r.byAuthor.append(e);
+        }
+    return r;
+}
+
+void AnalyticsTest::totals_data()
+{
+    QTest::addColumn<ChurnQuery>("query");
+
+    ChurnQuery all;
+    QTest::newRow("all paths") << all;
+
+    ChurnQuery deep;
+    deep.depth = 2;
+    QTest::newRow("two levels") << deep;
+
+    ChurnQuery dir;
+    dir.prefix = "top3";
+    QTest::newRow("a directory") << dir;
+
+    ChurnQuery year;
+    year.since = BASE_TIME + SPAN - 365 * 86400;
+    year.periodDays = 7;
+    QTest::newRow("last year by week") << year;
+}
+
+void AnalyticsTest::totals()
+{
+    // same totals and authors as a plain scan, periods add up
+    QFETCH(ChurnQuery, query);
+    const ChurnReport r(Analytics::compute(data, query, CancelToken()));
+    const ChurnReport expected(scan(query));
+
+    QVERIFY(r.commits > 0);
+    QCOMPARE(r.commits, expected.commits);
+    QCOMPARE(r.changes, expected.changes);
+    QCOMPARE(r.byAuthor.count(), expected.byAuthor.count());
+
+    QHash<QString, int> authorChanges;
+    foreach (const ChurnEntry& e, expected.byAuthor)
+        authorChanges.insert(e.key, e.changes);
+
+    for (int i = 0; i < r.byAuthor.count(); i++) {
+        const ChurnEntry& e = r.byAuthor.at(i);
+        QCOMPARE(e.changes, authorChanges.value(e.key));
+        if (i > 0) // most changed first
+            QVERIFY(r.byAuthor.at(i - 1).changes >= e.changes);
+    }
+    int commits = 0, changes = 0;
+    foreach (const ChurnEntry& e, r.byPeriod) {
+        commits += e.commits;
+        changes += e.changes;
+    }
+    QCOMPARE(commits, r.commits);
+    QCOMPARE(changes, r.changes);
+
+    changes = 0;
+    foreach (const ChurnEntry& e, r.byPath)
+        changes += e.changes;
+
+    QCOMPARE(changes, r.changes);
+}
+
+void AnalyticsTest::groups()
+{
+    // paths are grouped by the given number of components
+    ChurnQuery q;
+    q.depth = 1;
+    ChurnReport r(Analytics::compute(data, q, CancelToken()));
+    QCOMPARE(r.byPath.count(), TOP_DIRS + 1); // and root
+    foreach (const ChurnEntry& e, r.byPath)
+        QVERIFY2(e.key == "./" || e.key.count('/') == 1, qPrintable(e.key));
+
+    q.depth = 2;
+    r = Analytics::compute(data, q, CancelToken());
+    QCOMPARE(r.byPath.count(), TOP_DIRS * (SUB_DIRS + 1) + 1);
+    foreach (const ChurnEntry& e, r.byPath)
+        QVERIFY2(!e.key.contains("//"), qPrintable(e.key));
+
+    q.prefix = "top3/";
+    q.depth = 1;
+    r = Analytics::compute(data, q, CancelToken());
+    QCOMPARE(r.byPath.count(), SUB_DIRS + 1); // files directly in top3/ too
+    foreach (const ChurnEntry& e, r.byPath)
+        QVERIFY(e.key.startsWith("top3/"));
+
+    q.prefix = "none";
+    r = Analytics::compute(data, q, CancelToken());
+    QCOMPARE(r.commits, 0);
+    QVERIFY(r.byPath.isEmpty());
+}
+
+void AnalyticsTest::canceled()
+{
+    CancelToken tok;
+    tok.cancel();
+    const ChurnReport r(Analytics::compute(data, ChurnQuery(), tok));
+    QCOMPARE(r.commits, 0);
+    QVERIFY(r.byPath.isEmpty());
+    QVERIFY(r.byAuthor.isEmpty());
+}
+
+void AnalyticsTest::computeTime()
+{
+    // a query as recomputed at each change in the statistics view
+    QFETCH(ChurnQuery, query);
+    int commits = 0;
+
+    QBENCHMARK {
+        commits = Analytics::compute(data, query, CancelToken()).commits;
+    }
+    QVERIFY(commits > 0);
+}
+
+QTEST_GUILESS_MAIN(AnalyticsTest)
+
+#include "tst_analytics.moc"
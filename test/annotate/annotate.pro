@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_annotate
+
+SOURCES += \
+    $$PWD/tst_annotate.cpp
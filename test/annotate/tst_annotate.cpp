@@ -0,0 +1,268 @@
+#include <QtTest>
+
+#include "annotate.h"
+#include "task.h"
+#include "testrepo.h"
+
+static const int COMMITS = 30;
+
+class AnnotateTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void parseHunks();
+    void parseHeader();
+    void mapLine();
+    void runMatchesBlame();
+    void firstScreenFirst();
+
+private:
+    static bool steps(const TestRepo& repo, const QString& file, Annotate::Steps* res);
+    static const QByteArray text(const QStringList& lines);
+};
+
+bool AnnotateTest::steps(const TestRepo& repo, const QString& file, Annotate::Steps* res)
+{
+// as file history loads them, newest first, with a patch each
+
+    QByteArray out;
+    if (!repo.git(QStringList() << "log" << "--format=%H" << "--first-parent" << "--" << file, &out))
+        return false;
+
+    const QStringList shas(QString::fromLatin1(out).split('\n', QString::SkipEmptyParts));
+    for (int i = 0; i < shas.count(); i++) {
+        QStringList args;
+        args << "show" << "--format=" << "-r" << "-m" << "-p" << "--full-index"
+             << shas.at(i) << "--" << file;
+        if (!repo.git(args, &out))
+            return false;
+
+        res->append(Annotate::Step(shas.at(i), QString::fromLatin1(out), i == shas.count() - 1));
+    }
+    return !res->isEmpty();
+}
+
+const QByteArray AnnotateTest::text(const QStringList& lines)
+{
+    return lines.join("\n").toLatin1() + '\n';
+}
+
+void AnnotateTest::parseHunks()
+{
+    // old line of each new one, 0 when added, for each hunk
+    const QString patch(
+        "diff --git a/f.txt b/f.txt\n"
+        "index 1111111111111111111111111111111111111111..2222222222222222222222222222222222222222 100644\n"
+        "--- a/f.txt\n"
+        "+++ b/f.txt\n"
+        "@@ -1,3 +1,4 @@\n"
+        " a\n"
+        "-b\n"
+        "+B\n"
+        "+B2\n"
+        " c\n"
+        "@@ -10,2 +11,0 @@\n"
+        "-x\n"
+        "-y\n"
+        "@@ -20 +19 @@\n"
+        "-z\n"
+        "+Z\n"
+        "\\ No newline at end of file\n");
+
+    const Annotate::Patches ps(Annotate::parse(patch));
+    QCOMPARE(ps.count(), 1);
+    const Annotate::Patch& p = ps.first();
+    QCOMPARE(p.hunks.count(), 3);
+
+    const Annotate::Hunk& h1 = p.hunks.at(0);
+    QCOMPARE(h1.oldStart, 1);
+    QCOMPARE(h1.oldCnt, 3);
+    QCOMPARE(h1.newStart, 1);
+    QCOMPARE(h1.newCnt, 4);
+    QCOMPARE(h1.oldLines, QVector<int>() << 1 << 0 << 0 << 3);
+
+    // an empty range starts after the line given
+    const Annotate::Hunk& h2 = p.hunks.at(1);
+    QCOMPARE(h2.oldStart, 10);
+    QCOMPARE(h2.oldCnt, 2);
+    QCOMPARE(h2.newStart, 12);
+    QCOMPARE(h2.newCnt, 0);
+    QVERIFY(h2.oldLines.isEmpty());
+
+    const Annotate::Hunk& h3 = p.hunks.at(2);
+    QCOMPARE(h3.oldStart, 20);
+    QCOMPARE(h3.oldCnt, 1);
+    QCOMPARE(h3.newCnt, 1);
+    QCOMPARE(h3.oldLines, QVector<int>() << 0);
+}
+
+void AnnotateTest::parseHeader()
+{
+    // names and blobs of each file, renames and new files
+    const QString patch(
+        "diff --git a/old name.txt b/new name.txt\n"
+        "similarity index 90%\n"
+        "rename from old name.txt\n"
+        "rename to new name.txt\n"
+        "index aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa..bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb 100644\n"
+        "--- a/old name.txt\n"
+        "+++ b/new name.txt\n"
+        "@@ -1 +1 @@\n"
+        "-a\n"
+        "+A\n"
+        "diff --git a/n.txt b/n.txt\n"
+        "new file mode 100644\n"
+        "index 0000000000000000000000000000000000000000..cccccccccccccccccccccccccccccccccccccccc\n"
+        "--- /dev/null\n"
+        "+++ b/n.txt\n"
+        "@@ -0,0 +1,2 @@\n"
+        "+1\n"
+        "+2\n");
+
+    const Annotate::Patches ps(Annotate::parse(patch));
+    QCOMPARE(ps.count(), 2);
+
+    const Annotate::Patch& r = ps.at(0);
+    QCOMPARE(r.oldPath, QString("old name.txt"));
+    QCOMPARE(r.newPath, QString("new name.txt"));
+    QCOMPARE(r.oldBlob, QString(40, 'a'));
+    QCOMPARE(r.newBlob, QString(40, 'b'));
+    QVERIFY(!r.isNew);
+
+    const Annotate::Patch& n = ps.at(1);
+    QCOMPARE(n.newPath, QString("n.txt"));
+    QCOMPARE(n.newBlob, QString(40, 'c'));
+    QVERIFY(n.isNew);
+    QCOMPARE(n.hunks.count(), 1);
+    QCOMPARE(n.hunks.first().oldLines, QVector<int>() << 0 << 0);
+
+    QCOMPARE(Annotate::findPatch(ps, "n.txt"), &ps.at(1));
+    QVERIFY(Annotate::findPatch(ps, "old name.txt") == NULL);
+}
+
+void AnnotateTest::mapLine()
+{
+    // before, inside and after each hunk
+    const Annotate::Patches ps(Annotate::parse(
+        "diff --git a/f b/f\n"
+        "--- a/f\n"
+        "+++ b/f\n"
+        "@@ -5,2 +5,3 @@\n"
+        " e\n"
+        "+new\n"
+        " f\n"
+        "@@ -20,3 +21,1 @@\n"
+        "-t\n"
+        " u\n"
+        "-v\n"));
+    QCOMPARE(ps.count(), 1);
+    const Annotate::Patch& p = ps.first();
+
+    QCOMPARE(Annotate::mapLine(p, 1), 1);
+    QCOMPARE(Annotate::mapLine(p, 4), 4);
+    QCOMPARE(Annotate::mapLine(p, 5), 5);
+    QCOMPARE(Annotate::mapLine(p, 6), 0); // added
+    QCOMPARE(Annotate::mapLine(p, 7), 6);
+    QCOMPARE(Annotate::mapLine(p, 8), 7);
+    QCOMPARE(Annotate::mapLine(p, 20), 19);
+    QCOMPARE(Annotate::mapLine(p, 21), 21);
+    QCOMPARE(Annotate::mapLine(p, 22), 23);
+    QCOMPARE(Annotate::mapLine(p, 100), 101);
+}
+
+void AnnotateTest::runMatchesBlame()
+{
+/*
+   Lines are replaced, inserted and deleted at each commit, all
+   of them unique so that there is only one possible diff.
+*/
+    TestRepo repo;
+    QVERIFY(repo.isValid());
+
+    QStringList lines;
+    for (int i = 0; i < 40; i++)
+        lines.append(QString("line %1").arg(i));
+
+    QVERIFY(repo.commit("f.txt", text(lines), "create"));
+    for (int k = 1; k < COMMITS; k++) {
+        lines[(k * 7) % lines.count()] = QString("changed by %1").arg(k);
+        lines.insert((k * 13) % lines.count(), QString("added by %1").arg(k));
+        if (k % 3 == 0)
+            lines.removeAt((k * 5) % lines.count());
+
+        QVERIFY(repo.commit("f.txt", text(lines), QString("commit %1").arg(k)));
+    }
+    Annotate::Steps st;
+    QVERIFY(steps(repo, "f.txt", &st));
+    QCOMPARE(st.count(), COMMITS);
+
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "blame" << "-l" << "-s" << "--root" << "f.txt", &out));
+    QStringList expected;
+    foreach (const QString& l, QString::fromLatin1(out).split('\n', QString::SkipEmptyParts))
+        expected.append(l.left(40));
+
+    QCOMPARE(expected.count(), lines.count());
+
+    Annotate ann;
+    Annotate::Result res;
+    QVERIFY(ann.run(st, "", "f.txt", lines.count(), 0, CancelToken(), Annotate::Progress(), &res));
+    QVERIFY(res.isComplete);
+    QCOMPARE(res.known, lines.count());
+    QCOMPARE(res.origins, expected);
+}
+
+void AnnotateTest::firstScreenFirst()
+{
+/*
+   Only the newest commit changes the lines on screen, the older ones
+   change the bottom of the file: screen is reported at the first step.
+*/
+    TestRepo repo;
+    QVERIFY(repo.isValid());
+
+    const int screenLines = 10;
+    QStringList lines;
+    for (int i = 0; i < 100; i++)
+        lines.append(QString("line %1").arg(i));
+
+    QVERIFY(repo.commit("f.txt", text(lines), "create"));
+    for (int k = 1; k < COMMITS; k++) {
+        lines[90 + k % 10] = QString("bottom changed by %1").arg(k);
+        QVERIFY(repo.commit("f.txt", text(lines), QString("commit %1").arg(k)));
+    }
+    for (int i = 0; i < screenLines; i++)
+        lines[i] = QString("top changed %1").arg(i);
+
+    QVERIFY(repo.commit("f.txt", text(lines), "top"));
+
+    Annotate::Steps st;
+    QVERIFY(steps(repo, "f.txt", &st));
+
+    QList<Annotate::Result> reports;
+    Annotate ann;
+    Annotate::Result res;
+    QVERIFY(ann.run(st, "", "f.txt", lines.count(), screenLines, CancelToken(),
+                    [&](const Annotate::Result& r) { reports.append(r); }, &res));
+
+    QVERIFY(!reports.isEmpty());
+    const Annotate::Result& first = reports.first();
+    QCOMPARE(first.known, screenLines);
+    for (int i = 0; i < screenLines; i++)
+        QCOMPARE(first.origins.at(i), st.first().sha);
+
+    QVERIFY(res.isComplete);
+    QCOMPARE(res.known, lines.count());
+
+    // a canceled walk gives nothing
+    CancelToken tok;
+    tok.cancel();
+    Annotate ann2;
+    QVERIFY(!ann2.run(st, "", "f.txt", lines.count(), screenLines, tok,
+                      Annotate::Progress(), &res));
+}
+
+QTEST_GUILESS_MAIN(AnnotateTest)
+
+#include "tst_annotate.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_dateindex
+
+SOURCES += \
+    $$PWD/tst_dateindex.cpp
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <climits>
+
+#include <QDateTime>
+#include <QtTest>
+
+#include "dateindex.h"
+#include "git.h"
+
+static const int ROWS = 1000000;
+
+class DateIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void appendInBatches();
+    void ranges_data();
+    void ranges();
+    void parseRange_data();
+    void parseRange();
+    void localDate();
+    void rangeTime();
+    void scanTime();
+
+private:
+    const QVector<int> scan(uint from, uint to) const;
+
+    QVector<uint> times;
+    DateIndex idx;
+};
+
+const QVector<int> DateIndexTest::scan(uint from, uint to) const {
+// what the index replaces, sorted as the index does
+
+    QVector<QPair<uint, int> > v;
+    for (int r = 0; r < times.count(); r++)
+        if (times.at(r) >= from && times.at(r) <= to)
+            v.append(qMakePair(times.at(r), r));
+
+    std::sort(v.begin(), v.end());
+    QVector<int> res;
+    for (int i = 0; i < v.count(); i++)
+        res.append(v.at(i).second);
+
+    return res;
+}
+
+void DateIndexTest::initTestCase()
+{
+    // ten years of history, not sorted as rows are in topological order
+    qsrand(1);
+    const uint base = 1300000000;
+    for (int r = 0; r < ROWS; r++)
+        times.append(base + uint(qrand()) % (10 * 365 * 86400));
+
+    // loaded in slices, as the date filter can be used while loading
+    for (int first = 0; first < ROWS; first += 300000)
+        idx.append(times.mid(first, 300000));
+
+    QCOMPARE(idx.count(), ROWS);
+}
+
+void DateIndexTest::appendInBatches()
+{
+    DateIndex one;
+    one.append(times);
+    QCOMPARE(idx.rows(0, UINT_MAX), one.rows(0, UINT_MAX));
+    QCOMPARE(idx.rows(0, UINT_MAX).count(), ROWS);
+}
+
+void DateIndexTest::ranges_data()
+{
+    QTest::addColumn<uint>("from");
+    QTest::addColumn<uint>("to");
+    QTest::newRow("all") << 0u << UINT_MAX;
+    QTest::newRow("a month") << 1400000000u << 1400000000u + 30 * 86400;
+    QTest::newRow("a second") << times.at(42) << times.at(42);
+    QTest::newRow("before") << 0u << 1000000000u;
+    QTest::newRow("empty") << 2000000000u << 1000000000u;
+}
+
+void DateIndexTest::ranges()
+{
+    QFETCH(uint, from);
+    QFETCH(uint, to);
+    QCOMPARE(idx.rows(from, to), scan(from, to));
+}
+
+void DateIndexTest::parseRange_data()
+{
+    QTest::addColumn<QString>("exp");
+    QTest::addColumn<bool>("ok");
+    QTest::addColumn<uint>("from");
+    QTest::addColumn<uint>("to");
+
+    const uint now = 1500000000;
+    const QDate d(2012, 3, 25);
+    const uint dayStart = QDateTime(d).toTime_t();
+    const uint dayEnd = QDateTime(d.addDays(1)).toTime_t() - 1;
+
+    QTest::newRow("days") << "30" << true << QDateTime::fromTime_t(now).addDays(-30).toTime_t() << UINT_MAX;
+    QTest::newRow("date") << "2012-03-25" << true << dayStart << dayEnd;
+    QTest::newRow("from") << " 2012-03-25.." << true << dayStart << UINT_MAX;
+    QTest::newRow("to") << "..2012-03-25" << true << 0u << dayEnd;
+    QTest::newRow("range") << "2012-03-25..2012-03-25" << true << dayStart << dayEnd;
+    QTest::newRow("bad date") << "2012-13-01" << false << 0u << 0u;
+    QTest::newRow("text") << "yesterday" << false << 0u << 0u;
+}
+
+void DateIndexTest::parseRange()
+{
+    QFETCH(QString, exp);
+    QFETCH(bool, ok);
+    QFETCH(uint, from);
+    QFETCH(uint, to);
+
+    uint f, t;
+    QCOMPARE(DateIndex::parseRange(exp, 1500000000, &f, &t), ok);
+    if (ok) {
+        QCOMPARE(f, from);
+        QCOMPARE(t, to);
+    }
+}
+
+void DateIndexTest::localDate()
+{
+    // cached by seconds, same text as without cache
+    const uint secs = times.at(7);
+    const QString expected(QDateTime::fromTime_t(secs).toString(Qt::LocalDate));
+    QCOMPARE(Git::getLocalDate(secs), expected);
+    QCOMPARE(Git::getLocalDate(secs), expected);
+    QCOMPARE(Git::getLocalDate(QString::number(secs)), expected);
+}
+
+void DateIndexTest::rangeTime()
+{
+    // "last 30 days" filter on 1M rows
+    const uint to = 1300000000 + 10 * 365 * 86400;
+    int cnt = 0;
+    QBENCHMARK {
+        cnt = idx.rows(to - 30 * 86400, to).count();
+    }
+    QVERIFY(cnt > 0);
+}
+
+void DateIndexTest::scanTime()
+{
+    // same filter with a scan of the author times
+    const uint to = 1300000000 + 10 * 365 * 86400;
+    int cnt = 0;
+    QBENCHMARK {
+        cnt = 0;
+        for (int r = 0; r < times.count(); r++)
+            cnt += (times.at(r) >= to - 30 * 86400 && times.at(r) <= to);
+    }
+    QVERIFY(cnt > 0);
+}
+
+QTEST_GUILESS_MAIN(DateIndexTest)
+
+#include "tst_dateindex.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_diffview
+
+SOURCES += \
+    $$PWD/tst_diffview.cpp
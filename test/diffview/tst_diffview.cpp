@@ -0,0 +1,161 @@
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QScrollBar>
+#include <QtTest>
+
+#include "diff/diff.h"
+#include "ui/diffview.h"
+
+static const int FILES = 100;
+static const int HUNKS = 20;          // per file
+static const int HUNK_CONTEXT = 40;   // lines, plus 5 removed and 5 added
+static const int DIFF_LINES = FILES * HUNKS * (HUNK_CONTEXT + 11); // ~100k
+
+class DiffViewTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void rows();
+    void firstPaintTime();
+    void scrollFrameTime();
+
+private:
+    QString diffText;
+};
+
+static const QString fileName(int f) {
+
+    return QString("src/dir%1/file%2.cpp").arg(f % 10).arg(f);
+}
+
+static const QString bigDiff() {
+/*
+   As 'git diff-tree -p' prints it: files with evenly spaced hunks,
+   some lines with tabs, that the view expands.
+*/
+    QString s;
+    for (int f = 0; f < FILES; f++) {
+        const QString name(fileName(f));
+        s.append("diff --git a/" + name + " b/" + name + '\n');
+        s.append("index 1111111..2222222 100644\n");
+        s.append("--- a/" + name + "\n+++ b/" + name + '\n');
+
+        for (int h = 0; h < HUNKS; h++) {
+            const int start = h * 100 + 1;
+            const int len = HUNK_CONTEXT + 5;
+            s.append(QString("@@ -%1,%2 +%1,%2 @@ function%3()\n").arg(start).arg(len).arg(h));
+            for (int l = 0; l < HUNK_CONTEXT / 2; l++)
+                s.append(QString(" \tcontext line %1 of hunk %2;\n").arg(l).arg(h));
+            for (int l = 0; l < 5; l++)
+                s.append(QString("-    old = compute(%1, %2);\n").arg(l).arg(h));
+            for (int l = 0; l < 5; l++)
+                s.append(QString("+    value = compute(%1, %2) + offset;\n").arg(l).arg(h));
+            for (int l = HUNK_CONTEXT / 2; l < HUNK_CONTEXT; l++)
+                s.append(QString(" context line %1 of hunk %2;\n").arg(l).arg(h));
+        }
+    }
+    return s;
+}
+
+static qint64 paint(DiffView* v, QImage* img) {
+// a frame of the viewport, in microseconds
+
+    QElapsedTimer t;
+    t.start();
+    v->viewport()->render(img);
+    return t.nsecsElapsed() / 1000;
+}
+
+void DiffViewTest::initTestCase()
+{
+    diffText = bigDiff();
+    QVERIFY(diffText.count('\n') >= DIFF_LINES);
+}
+
+void DiffViewTest::rows()
+{
+    // every file header is reachable, in diff order
+    Maybe<QSharedPointer<TreeDiff> > d(TreeDiff::createFromString(diffText));
+    QVERIFY(d);
+    QCOMPARE(d.to_value()->entries().count(), FILES);
+
+    DiffView v;
+    v.resize(800, 600);
+    v.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&v));
+    v.setDiff(d.to_value());
+    QVERIFY(v.verticalScrollBar()->maximum() > DIFF_LINES);
+
+    int prev = -1;
+    for (int f = 0; f < FILES; f++) {
+        QVERIFY(v.scrollToFile(fileName(f)));
+        QVERIFY(v.verticalScrollBar()->value() > prev);
+        prev = v.verticalScrollBar()->value();
+    }
+    QVERIFY(!v.scrollToFile(QString("not/in/diff.cpp")));
+}
+
+void DiffViewTest::firstPaintTime()
+{
+    // from diff text to the first screen, as on a revision selection
+    DiffView v;
+    v.resize(1000, 800);
+    v.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&v));
+    QImage img(v.viewport()->size(), QImage::Format_ARGB32_Premultiplied);
+
+    QElapsedTimer t;
+    t.start();
+    Maybe<QSharedPointer<TreeDiff> > d(TreeDiff::createFromString(diffText));
+    QVERIFY(d);
+    const qint64 parseUs = t.nsecsElapsed() / 1000;
+
+    t.restart();
+    v.setDiff(d.to_value());
+    const qint64 indexUs = t.nsecsElapsed() / 1000;
+    const qint64 paintUs = paint(&v, &img);
+
+    qDebug("%d diff lines: parsed in %lld ms, indexed in %lld ms, first paint in %lld us",
+           diffText.count('\n'), parseUs / 1000, indexUs / 1000, paintUs);
+}
+
+void DiffViewTest::scrollFrameTime()
+{
+/*
+   Page down through a part of the diff, rows are laid out the first
+   time they are shown, then back up again over cached glyphs.
+*/
+    Maybe<QSharedPointer<TreeDiff> > d(TreeDiff::createFromString(diffText));
+    QVERIFY(d);
+
+    DiffView v;
+    v.resize(1000, 800);
+    v.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&v));
+    v.setDiff(d.to_value());
+    QImage img(v.viewport()->size(), QImage::Format_ARGB32_Premultiplied);
+
+    QScrollBar* sb = v.verticalScrollBar();
+    QVector<qint64> down, up;
+    for (int i = 0; i < 200; i++) {
+        sb->setValue(i * sb->pageStep());
+        down.append(paint(&v, &img));
+    }
+    for (int i = 199; i >= 0; i--) {
+        sb->setValue(i * sb->pageStep());
+        up.append(paint(&v, &img));
+    }
+    std::sort(down.begin(), down.end());
+    std::sort(up.begin(), up.end());
+
+    qDebug("scroll frame, median/max: %lld/%lld us new rows, %lld/%lld us cached rows",
+           down.at(down.count() / 2), down.last(), up.at(up.count() / 2), up.last());
+}
+
+QTEST_MAIN(DiffViewTest)
+
+#include "tst_diffview.moc"
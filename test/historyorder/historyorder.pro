@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_historyorder
+
+SOURCES += \
+    $$PWD/tst_historyorder.cpp
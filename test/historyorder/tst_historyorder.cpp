@@ -0,0 +1,192 @@
+#include <QtTest>
+
+#include "common.h"
+#include "historyorder.h"
+
+using namespace QGit;
+
+static const int ROWS = 1000000;
+static const int PINNED = 2; // working dir and an unapplied patch
+static const uint BASE_TIME = 1300000000;
+
+struct Graph { // parent rows as Reachability keeps them
+    QVector<int> firstParent;
+    QVector<int> parentRows;
+    QVector<uint> times;
+};
+
+class HistoryOrderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void dateOrder_data();
+    void dateOrder();
+    void newestFirst();
+    void notAGraph();
+    void otherOrders();
+    void dateOrderTime();
+
+private:
+    static const Graph history(int rows, int pinned, bool merges, int skew);
+};
+
+const Graph HistoryOrderTest::history(int rows, int pinned, bool merges, int skew)
+{
+/*
+   Rows are in loading order, children before parents: mostly a line,
+   with branches forking some rows below and merges of older rows.
+   Author times go back one minute per row, plus up to 'skew' seconds
+   of clock skew, so date order is not the loading one.
+*/
+    Graph g;
+    qsrand(1);
+    for (int r = 0; r < rows; r++) {
+        g.firstParent.append(g.parentRows.count());
+        g.times.append(BASE_TIME + uint(rows - r) * 60 + (skew ? uint(qrand() % skew) : 0));
+
+        if (r < pinned) { // on top of the first real revision
+            g.parentRows.append(pinned < rows ? pinned : -1);
+            continue;
+        }
+        int p = r + 1 + (qrand() % 50 == 0 ? qrand() % 20 : 0);
+        if (p < rows)
+            g.parentRows.append(p);
+
+        int m = r + 2 + qrand() % 100;
+        if (merges && qrand() % 10 == 0 && m < rows && m != p)
+            g.parentRows.append(m);
+
+        if (qrand() % 1000 == 0)
+            g.parentRows.append(-1); // not loaded, e.g. a boundary parent
+    }
+    g.firstParent.append(g.parentRows.count());
+    return g;
+}
+
+void HistoryOrderTest::dateOrder_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("pinned");
+    QTest::addColumn<bool>("merges");
+    QTest::addColumn<int>("skew");
+    QTest::newRow("linear") << 1000 << 0 << false << 0;
+    QTest::newRow("linear with skew") << 1000 << 0 << false << 3600;
+    QTest::newRow("merges") << 10000 << 0 << true << 600;
+    QTest::newRow("merges and pinned") << 10000 << PINNED << true << 600;
+    QTest::newRow("only pinned") << PINNED << PINNED << false << 0;
+    QTest::newRow("empty") << 0 << 0 << false << 0;
+}
+
+void HistoryOrderTest::dateOrder()
+{
+    // a permutation of rows, pinned first, then parents after children
+    QFETCH(int, rows);
+    QFETCH(int, pinned);
+    QFETCH(bool, merges);
+    QFETCH(int, skew);
+    const Graph g(history(rows, pinned, merges, skew));
+
+    HistoryOrder ho;
+    ho.setGraph(g.firstParent, g.parentRows, g.times, pinned);
+    const QVector<int> res(ho.rows(DATE_ORDER));
+    QCOMPARE(res.count(), rows);
+
+    QVector<int> pos(rows, -1);
+    for (int i = 0; i < res.count(); i++) {
+        const int r = res.at(i);
+        QVERIFY(r >= 0 && r < rows);
+        QCOMPARE(pos.at(r), -1);
+        pos[r] = i;
+    }
+    for (int r = 0; r < pinned; r++)
+        QCOMPARE(res.at(r), r);
+
+    for (int r = pinned; r < rows; r++)
+        for (int i = g.firstParent.at(r); i < g.firstParent.at(r + 1); i++) {
+            const int p = g.parentRows.at(i);
+            if (p >= pinned)
+                QVERIFY2(pos.at(p) > pos.at(r), qPrintable(QString("%1 before %2").arg(p).arg(r)));
+        }
+
+    // without skew dates follow loading order, and so does the result
+    if (skew == 0)
+        for (int i = 0; i < res.count(); i++)
+            QCOMPARE(res.at(i), i);
+}
+
+void HistoryOrderTest::newestFirst()
+{
+    // without parents it is a plain sort, ties in loading order
+    const int rows = 300000; // more than a sort chunk
+    Graph g;
+    qsrand(2);
+    for (int r = 0; r < rows; r++) {
+        g.firstParent.append(0);
+        g.times.append(BASE_TIME + uint(qrand() % 100000));
+    }
+    g.firstParent.append(0);
+
+    HistoryOrder ho;
+    ho.setGraph(g.firstParent, g.parentRows, g.times, 1);
+    const QVector<int> res(ho.rows(DATE_ORDER));
+    QCOMPARE(res.count(), rows);
+    QCOMPARE(res.first(), 0);
+    for (int i = 2; i < rows; i++) {
+        const int a = res.at(i - 1), b = res.at(i);
+        QVERIFY(g.times.at(a) > g.times.at(b) || (g.times.at(a) == g.times.at(b) && a < b));
+    }
+}
+
+void HistoryOrderTest::notAGraph()
+{
+    // rows in a cycle are never ready, loading order is kept instead
+    Graph g;
+    g.firstParent << 0 << 1 << 2 << 2;
+    g.parentRows << 1 << 0;
+    g.times << BASE_TIME << BASE_TIME + 60 << BASE_TIME + 120;
+
+    HistoryOrder ho;
+    ho.setGraph(g.firstParent, g.parentRows, g.times, 0);
+    QCOMPARE(ho.rows(DATE_ORDER), QVector<int>() << 0 << 1 << 2);
+}
+
+void HistoryOrderTest::otherOrders()
+{
+    const Graph g(history(100, PINNED, true, 600));
+    HistoryOrder ho;
+    ho.setGraph(g.firstParent, g.parentRows, g.times, PINNED);
+
+    const QVector<int> topo(ho.rows(TOPO_ORDER));
+    const QVector<int> reverse(ho.rows(REVERSE_ORDER));
+    QCOMPARE(topo.count(), 100);
+    QCOMPARE(reverse.count(), 100);
+    for (int i = 0; i < 100; i++)
+        QCOMPARE(topo.at(i), i);
+
+    QCOMPARE(reverse.at(0), 0);
+    QCOMPARE(reverse.at(1), 1);
+    QCOMPARE(reverse.at(PINNED), 99);
+    QCOMPARE(reverse.last(), PINNED);
+
+    ho.clear();
+    QVERIFY(ho.rows(DATE_ORDER).isEmpty());
+}
+
+void HistoryOrderTest::dateOrderTime()
+{
+    // what changing order costs on a big repository
+    const Graph g(history(ROWS, PINNED, true, 600));
+    HistoryOrder ho;
+    ho.setGraph(g.firstParent, g.parentRows, g.times, PINNED);
+    int cnt = 0;
+
+    QBENCHMARK {
+        cnt = ho.rows(DATE_ORDER).count();
+    }
+    QCOMPARE(cnt, ROWS);
+}
+
+QTEST_GUILESS_MAIN(HistoryOrderTest)
+
+#include "tst_historyorder.moc"
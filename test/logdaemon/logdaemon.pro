@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_logdaemon
+
+SOURCES += \
+    $$PWD/tst_logdaemon.cpp
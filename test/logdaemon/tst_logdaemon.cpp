@@ -0,0 +1,265 @@
+#include <QLocalSocket>
+#include <QThread>
+#include <QtTest>
+
+#include "filehistory.h"
+#include "git.h"
+#include "logdaemon.h"
+#include "testrepo.h"
+
+static const int COMMITS = 500;
+static const int WAIT_LOAD = 30000; // ms, for the daemon to run 'git log'
+
+class LogDaemonTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    LogDaemonTest() : thread(NULL), daemon(NULL) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void hitAndMiss();
+    void refsChanged();
+    void badRequests();
+    void secondDaemon();
+    void clientFallback();
+
+private:
+    bool startDaemon();
+    void stopDaemon();
+    const LogRequest request(const QStringList& args = QStringList()) const;
+    const QByteArray gitLog(const QStringList& args = QStringList()) const;
+    int revCount() const;
+    qint64 ask(const LogRequest& r, QByteArray* log) const;
+    qint64 waitHit(const LogRequest& r, QByteArray* log) const;
+
+    TestRepo repo;
+    QThread* thread;
+    LogDaemon* daemon;
+};
+
+bool LogDaemonTest::startDaemon() {
+/*
+   Daemon runs in its own thread, as it would in its own process,
+   so that clients here can block waiting for the answer.
+*/
+    bool ok = false;
+    thread = new QThread();
+    QSemaphore started;
+    connect(thread, &QThread::started, [&]() { // runs in the new thread
+        daemon = new LogDaemon();
+        ok = daemon->listen();
+        started.release();
+    });
+    thread->start();
+    started.acquire();
+    return ok;
+}
+
+void LogDaemonTest::stopDaemon() {
+
+    if (!thread)
+        return;
+
+    daemon->deleteLater(); // in its thread, once it finishes
+    thread->quit();
+    thread->wait();
+    delete thread;
+    thread = NULL;
+    daemon = NULL;
+}
+
+const LogRequest LogDaemonTest::request(const QStringList& args) const {
+// as Git::startDaemonRevList(), refs key as Git::getRefs()
+
+    LogRequest r;
+    r.workDir = repo.path();
+    r.gitDir = repo.gitDir();
+    r.cmd = Git::revListCmd(true) + args;
+
+    QByteArray head, refs;
+    repo.git(QStringList() << "rev-parse" << "--revs-only" << "HEAD", &head);
+    repo.git(QStringList() << "show-ref" << "-d", &refs);
+    r.refsKey = Git::refsFingerprint(QString(head).trimmed(), QString(refs));
+    return r;
+}
+
+const QByteArray LogDaemonTest::gitLog(const QStringList& args) const {
+
+    QStringList cmd(Git::revListCmd(true) + args);
+    cmd.removeFirst(); // "git"
+    QByteArray out;
+    repo.git(cmd, &out);
+    return out;
+}
+
+int LogDaemonTest::revCount() const {
+
+    QByteArray out;
+    repo.git(QStringList() << "rev-list" << "--all" << "--count", &out);
+    return out.trimmed().toInt();
+}
+
+qint64 LogDaemonTest::ask(const LogRequest& r, QByteArray* log) const {
+// as DataLoader::startDaemon(), -2 if the daemon is not there
+
+    log->clear();
+    QLocalSocket s;
+    s.connectToServer(LogDaemon::socketName());
+    if (!s.waitForConnected(1000) || !LogDaemon::sendRequest(&s, r))
+        return -2;
+
+    const qint64 size = LogDaemon::waitReply(&s, 5000);
+    while (log->size() < size && (s.bytesAvailable() || s.waitForReadyRead(5000)))
+        log->append(s.readAll());
+
+    return size;
+}
+
+qint64 LogDaemonTest::waitHit(const LogRequest& r, QByteArray* log) const {
+// first requests miss while the daemon runs 'git log'
+
+    QElapsedTimer t;
+    t.start();
+    qint64 size;
+    while ((size = ask(r, log)) == -1 && t.elapsed() < WAIT_LOAD)
+        QTest::qWait(50);
+
+    return size;
+}
+
+void LogDaemonTest::initTestCase()
+{
+    // socket name and settings come from HOME, so they are ours only
+    QVERIFY(repo.isValid());
+    QVERIFY(repo.importHistory(COMMITS));
+    qputenv("HOME", repo.path().toLocal8Bit());
+    qputenv("GIT_CONFIG_NOSYSTEM", "1");
+    qputenv("TZ", "UTC");
+    QVERIFY(startDaemon());
+}
+
+void LogDaemonTest::cleanupTestCase()
+{
+    stopDaemon();
+}
+
+void LogDaemonTest::hitAndMiss()
+{
+    // an unknown repository is a miss, then it is loaded for next time
+    const LogRequest r(request());
+    QByteArray log;
+    QCOMPARE(ask(r, &log), qint64(-1));
+
+    const qint64 size = waitHit(r, &log);
+    QVERIFY(size > 0);
+    QCOMPARE(log.size(), int(size));
+    QCOMPARE(log, gitLog());
+
+    // same output is sent only for the same refs
+    LogRequest stale(r);
+    stale.refsKey = "other";
+    QCOMPARE(ask(stale, &log), qint64(-1));
+
+    // a revision range is another entry
+    const LogRequest range(request(QStringList() << "master~10"));
+    QVERIFY(waitHit(range, &log) > 0);
+    QCOMPARE(log, gitLog(QStringList() << "master~10"));
+}
+
+void LogDaemonTest::refsChanged()
+{
+    // new refs are noticed, 'git log' runs again, old output is not sent
+    const LogRequest before(request());
+    QByteArray log;
+    QVERIFY(waitHit(before, &log) > 0);
+
+    QVERIFY(repo.commit("daemon.txt", "new\n", "a new commit"));
+    const LogRequest after(request());
+    QVERIFY(after.refsKey != before.refsKey);
+
+    QVERIFY(waitHit(after, &log) > 0);
+    QCOMPARE(log, gitLog());
+    QCOMPARE(ask(before, &log), qint64(-1));
+}
+
+void LogDaemonTest::badRequests()
+{
+/*
+   Only the main view command, with revisions and paths, is run and
+   only in the working directory of the repository. An option that
+   writes a file must not be run.
+*/
+    QByteArray log;
+    const QString out(repo.path() + "/written.txt");
+    LogRequest r(request(QStringList() << "--output=" + out));
+    QCOMPARE(ask(r, &log), qint64(-1));
+
+    r = request();
+    r.cmd = QStringList() << "git" << "status";
+    QCOMPARE(ask(r, &log), qint64(-1));
+
+    r = request(QStringList() << "--" << "-not-an-option.txt"); // a path
+    QVERIFY(waitHit(r, &log) >= 0);
+
+    r = request(QStringList() << "--all");
+    QVERIFY(waitHit(r, &log) > 0);
+    QCOMPARE(log, gitLog(QStringList() << "--all"));
+
+    r = request();
+    r.workDir = QDir::tempPath(); // not the working directory of gitDir
+    QCOMPARE(ask(r, &log), qint64(-1));
+
+    r = request();
+    r.workDir = "relative/path";
+    QCOMPARE(ask(r, &log), qint64(-1));
+
+    QTest::qWait(500); // daemon would be loading by now
+    QVERIFY(!QFile::exists(out));
+    QCOMPARE(ask(request(QStringList() << "--output=" + out), &log), qint64(-1));
+}
+
+void LogDaemonTest::secondDaemon()
+{
+    // a running daemon is not taken over, it still answers
+    LogDaemon other;
+    QVERIFY(!other.listen());
+
+    QByteArray log;
+    QVERIFY(ask(request(), &log) > 0);
+}
+
+void LogDaemonTest::clientFallback()
+{
+/*
+   When the daemon does not answer in time, here because it runs in
+   the thread that is waiting for it, or there is no daemon at all,
+   Git loads by itself. Refs change in between, so that the second
+   load does not share the snapshot of the first one.
+*/
+    stopDaemon();
+    LogDaemon* blocked = new LogDaemon();
+    QVERIFY(blocked->listen());
+
+    Git* git = new Git(NULL);
+    const FileHistory* fh = repo.load(git);
+    QVERIFY(fh);
+    QCOMPARE(fh->rowCount(), revCount());
+    git->stop(false);
+    delete git;
+    delete blocked;
+
+    QVERIFY(repo.commit("fallback.txt", "new\n", "no daemon"));
+    git = new Git(NULL);
+    fh = repo.load(git);
+    QVERIFY(fh);
+    QCOMPARE(fh->rowCount(), revCount());
+    git->stop(false);
+    delete git;
+}
+
+QGIT_TEST_MAIN(LogDaemonTest)
+
+#include "tst_logdaemon.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_logformat
+
+SOURCES += \
+    $$PWD/tst_logformat.cpp
@@ -0,0 +1,119 @@
+#include <QtTest>
+
+#include "git.h"
+#include "logformat.h"
+#include "testrepo.h"
+
+static const int COMMITS = 5000;
+
+Q_DECLARE_METATYPE(LogFormatId)
+
+class LogFormatTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void records_data();
+    void records();
+    void parseTime_data() { records_data(); }
+    void parseTime();
+
+private:
+    TestRepo repo;
+    RowBlock blocks[UNAPPLIED_LOG + 1];
+};
+
+static const QStringList gitArgs(const QString& cmd) {
+
+    QStringList args(cmd.split(' ', QString::SkipEmptyParts));
+    args.removeFirst(); // "git"
+    return args;
+}
+
+static const QList<Rev*> parse(const RowBlock& block, LogFormatId f, bool full) {
+// as Git::addChunk() does, 'full' indexes all the fields as the views do
+
+    QList<Rev*> revs;
+    int start = 0, next = 0;
+    while (true) {
+        Rev* r = new Rev(block, start, revs.count(), &next, f);
+        if (next < 0) {
+            delete r;
+            break;
+        }
+        if (full)
+            r->diff();
+
+        revs.append(r);
+        start = next;
+    }
+    return revs;
+}
+
+void LogFormatTest::initTestCase()
+{
+/*
+   Output of the commands of each layout, file history is asked for
+   a directory to have many records with a patch.
+*/
+    QVERIFY(repo.isValid());
+    QVERIFY2(repo.importHistory(COMMITS), "git fast-import failed");
+
+    QStringList cmd[UNAPPLIED_LOG + 1];
+    cmd[MAIN_LOG] = gitArgs(Git::revListCmd(true).join(" "));
+    cmd[FILE_LOG] = gitArgs(Git::revListCmd(false).join(" ") + " -r -m -p --full-index -- src");
+    cmd[UNAPPLIED_LOG] = gitArgs("git log " + logFormatArgs<LogFormat<UNAPPLIED_LOG> >()
+                                 + " master~1000..master");
+    for (int f = MAIN_LOG; f <= UNAPPLIED_LOG; f++) {
+        QByteArray out;
+        QVERIFY(repo.git(cmd[f], &out));
+        blocks[f].append(out).append('\0');
+    }
+}
+
+void LogFormatTest::records_data()
+{
+    QTest::addColumn<LogFormatId>("format");
+    QTest::newRow("main view") << MAIN_LOG;
+    QTest::newRow("file history") << FILE_LOG;
+    QTest::newRow("unapplied patches") << UNAPPLIED_LOG;
+}
+
+void LogFormatTest::records()
+{
+    // every record is found, with its fields in the right place
+    QFETCH(LogFormatId, format);
+    const RowBlock& block = blocks[format];
+    const QList<Rev*> revs(parse(block, format, true));
+    QVERIFY(revs.count() > 100);
+    QCOMPARE(revs.count(), block.count('\0')); // one more terminator appended
+
+    foreach (const Rev* r, revs) {
+        QVERIFY(r->authorTime() > 0);
+        QVERIFY(r->author().contains('<'));
+        QVERIFY(r->committer().startsWith("C O Mitter"));
+        QVERIFY2(r->shortLog().contains(QRegExp("^(subject|first line) ")), qPrintable(r->shortLog()));
+        QCOMPARE(r->diff().isEmpty(), format != FILE_LOG);
+    }
+    qDeleteAll(revs);
+}
+
+void LogFormatTest::parseTime()
+{
+    // loading, then indexing of the whole records
+    QFETCH(LogFormatId, format);
+    const RowBlock& block = blocks[format];
+    int cnt = 0;
+
+    QBENCHMARK {
+        const QList<Rev*> revs(parse(block, format, true));
+        cnt += revs.count();
+        qDeleteAll(revs);
+    }
+    QVERIFY(cnt > 0);
+}
+
+QTEST_GUILESS_MAIN(LogFormatTest)
+
+#include "tst_logformat.moc"
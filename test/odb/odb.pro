@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_odb
+
+SOURCES += \
+    $$PWD/tst_odb.cpp
@@ -0,0 +1,320 @@
+#include <QElapsedTimer>
+#include <QtTest>
+
+#include "git.h"
+#include "odb/commitgraph.h"
+#include "odb/commitwalker.h"
+#include "odb/objectdb.h"
+#include "odb/packbitmap.h"
+#include "testrepo.h"
+
+static const int COMMITS = 20000;
+
+class OdbTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void walkerMatchesLog();
+    void walkerMatchesLogAfterGc();
+    void badTips();
+    void loadTime();
+    void bloomFallback();
+    void bloomFilters_data();
+    void bloomFilters();
+    void bloomFilterTime();
+    void packBitmaps();
+
+private:
+    bool writeCommitGraph(bool changedPaths, const QString& version = QString());
+    const QVector<QByteArray> allCommits() const;
+    bool gitLog(QByteArray* out) const;
+    bool nativeLog(QByteArray* out) const;
+    void compareLogs();
+
+    TestRepo repo;
+};
+
+static const QList<QByteArray> records(const QByteArray& log) {
+// git separates records with '\0', walker terminates them
+
+    QList<QByteArray> res(log.split('\0'));
+    if (!res.isEmpty() && res.last().isEmpty())
+        res.removeLast();
+
+    return res;
+}
+
+bool OdbTest::gitLog(QByteArray* out) const {
+
+    QStringList args(Git::revListCmd(true));
+    args.removeFirst(); // "git"
+    return repo.git(args, out);
+}
+
+bool OdbTest::nativeLog(QByteArray* out) const {
+// same steps, and chunk sizes, of DataLoader::startNative()
+
+    CommitWalker w(repo.gitDir());
+    if (!w.start(repo.tips()))
+        return false;
+
+    while (!w.walk(4096))
+        ;
+    while (!w.atEnd())
+        w.format(out, out->size() + 64 * 1024);
+
+    return w.errorString().isEmpty();
+}
+
+void OdbTest::compareLogs()
+{
+    QByteArray log, native;
+    QVERIFY2(gitLog(&log), "git log failed");
+    QVERIFY2(nativeLog(&native), "commit walker failed");
+
+    const QList<QByteArray> expected(records(log));
+    const QList<QByteArray> actual(records(native));
+    QCOMPARE(actual.count(), expected.count());
+
+    for (int i = 0; i < expected.count(); i++)
+        if (actual.at(i) != expected.at(i))
+            QFAIL(qPrintable(QString("record %1 differs\ngit:\n%2\nwalker:\n%3")
+                             .arg(i).arg(QString::fromUtf8(expected.at(i)))
+                             .arg(QString::fromUtf8(actual.at(i)))));
+}
+
+void OdbTest::initTestCase()
+{
+    QVERIFY2(repo.isValid(), "cannot create test repository");
+    QVERIFY2(repo.importHistory(COMMITS), "git fast-import failed");
+
+    // some loose objects too, on top of the imported pack
+    QVERIFY(repo.commit("loose.txt", "first\n", "loose commit\n\nwith a body"));
+    QVERIFY(repo.commit("loose.txt", "second\n", "second loose commit"));
+}
+
+void OdbTest::walkerMatchesLog()
+{
+    compareLogs();
+}
+
+void OdbTest::walkerMatchesLogAfterGc()
+{
+    // all in a single pack, with deltas and a commit-graph
+    QVERIFY2(repo.git(QStringList() << "gc" << "--quiet"), "git gc failed");
+    compareLogs();
+}
+
+void OdbTest::badTips()
+{
+    // missing objects and tags to blobs are skipped, good tips are kept
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "hash-object" << "-w" << "--stdin", &out, "a blob\n"));
+    const QString blob(QString::fromLatin1(out).trimmed());
+    QVERIFY(repo.git(QStringList() << "tag" << "-a" << "-m" << "to a blob" << "blob-tag" << blob));
+    QVERIFY(repo.git(QStringList() << "rev-parse" << "blob-tag", &out));
+    const QString blobTag(QString::fromLatin1(out).trimmed());
+    QVERIFY(repo.git(QStringList() << "rev-parse" << "HEAD", &out));
+    const QString head(QString::fromLatin1(out).trimmed());
+
+    CommitWalker bad(repo.gitDir());
+    QVERIFY(!bad.start(QStringList() << QString(40, 'e') << blobTag << blob));
+    QVERIFY(!bad.errorString().isEmpty());
+
+    CommitWalker w(repo.gitDir());
+    QVERIFY(w.start(QStringList() << QString(40, 'e') << blobTag << head));
+    QVERIFY(!w.walk(1));
+
+    QVERIFY(repo.git(QStringList() << "tag" << "-d" << "blob-tag"));
+}
+
+void OdbTest::loadTime()
+{
+    // the whole history, as when a repository is opened
+    QElapsedTimer t;
+    QByteArray log, native;
+
+    t.start();
+    QVERIFY(gitLog(&log));
+    const qint64 gitMs = t.elapsed();
+
+    t.restart();
+    QVERIFY(nativeLog(&native));
+    const qint64 nativeMs = t.elapsed();
+
+    QCOMPARE(records(native).count(), records(log).count());
+    qDebug("%d commits loaded in %lld ms by git log, in %lld ms by the commit walker",
+           records(log).count(), gitMs, nativeMs);
+}
+
+bool OdbTest::writeCommitGraph(bool changedPaths, const QString& version) {
+// from scratch, an existing file could be reused by git
+
+    QStringList args;
+    if (!version.isEmpty())
+        args << "-c" << "commitGraph.changedPathsVersion=" + version;
+
+    args << "commit-graph" << "write" << "--reachable";
+    if (changedPaths)
+        args << "--changed-paths";
+
+    QFile::remove(repo.gitDir() + "/objects/info/commit-graph");
+    return repo.git(args);
+}
+
+const QVector<QByteArray> OdbTest::allCommits() const {
+
+    QByteArray out;
+    QVector<QByteArray> res;
+    if (repo.git(QStringList() << "rev-list" << "--all", &out))
+        foreach (const QByteArray& sha, out.split('\n'))
+            if (!sha.isEmpty())
+                res.append(ObjectDb::toRaw(sha.constData()));
+
+    return res;
+}
+
+void OdbTest::bloomFallback()
+{
+    // without changed-path chunks every query must answer "maybe"
+    QVERIFY(writeCommitGraph(false));
+
+    CommitGraph cg(repo.gitDir());
+    QVERIFY(cg.open());
+    QVERIFY(!cg.hasBloomFilters());
+
+    const CommitGraph::BloomKeys keys(CommitGraph::pathKeys("not/a/path.txt"));
+    foreach (const QByteArray& sha, allCommits())
+        QVERIFY(cg.maybeChanged(sha, keys));
+}
+
+void OdbTest::bloomFilters_data()
+{
+    // older git ignores the version and writes version 1 filters
+    QTest::addColumn<QString>("version");
+    QTest::newRow("default") << QString();
+    QTest::newRow("v1") << QString("1");
+    QTest::newRow("v2") << QString("2");
+}
+
+void OdbTest::bloomFilters()
+{
+/*
+   A filter must never exclude a path changed by the commit, also
+   the non ASCII ones, this checks both murmur3 variants. Excluding
+   almost always a path never changed checks that filters are used.
+*/
+    QFETCH(QString, version);
+    QVERIFY(writeCommitGraph(true, version));
+
+    CommitGraph cg(repo.gitDir());
+    QVERIFY(cg.open());
+    QVERIFY(cg.hasBloomFilters());
+
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "-c" << "core.quotePath=false" << "log" << "--all"
+                     << "--no-merges" << "--format=>%H" << "--name-only", &out));
+
+    QByteArray sha;
+    int paths = 0;
+    foreach (const QByteArray& line, out.split('\n')) {
+        if (line.startsWith('>'))
+            sha = ObjectDb::toRaw(line.constData() + 1);
+
+        else if (!line.isEmpty()) {
+            paths++;
+            const QString path(QString::fromUtf8(line));
+            QVERIFY2(cg.maybeChanged(sha, CommitGraph::pathKeys(path)),
+                     qPrintable("false negative for " + path + " in " + sha.toHex()));
+        }
+    }
+    QVERIFY(paths >= COMMITS);
+
+    const QVector<QByteArray> commits(allCommits());
+    const CommitGraph::BloomKeys keys(CommitGraph::pathKeys("not/a/path.txt"));
+    int maybe = 0;
+    foreach (const QByteArray& sha, commits)
+        maybe += cg.maybeChanged(sha, keys);
+
+    QVERIFY2(maybe < commits.count() / 100, qPrintable(QString("%1 false positives").arg(maybe)));
+}
+
+void OdbTest::bloomFilterTime()
+{
+/*
+   Commits a file filter has still to check in the revision
+   files, and time to find them, compared with a path limited
+   'git rev-list' that uses the same filters.
+*/
+    QVERIFY(writeCommitGraph(true));
+
+    CommitGraph cg(repo.gitDir());
+    QVERIFY(cg.open());
+
+    const QString path("src/m3/f5.txt");
+    const QVector<QByteArray> commits(allCommits());
+    const QVector<CommitGraph::BloomKeys> paths(1, CommitGraph::pathKeys(path));
+    QElapsedTimer t;
+    int maybe = 0;
+
+    t.start();
+    foreach (const QByteArray& sha, commits)
+        maybe += cg.maybeChangedAny(sha, paths);
+    const qint64 bloomUs = t.nsecsElapsed() / 1000;
+
+    QByteArray out;
+    t.restart();
+    QVERIFY(repo.git(QStringList() << "rev-list" << "--all" << "--" << path, &out));
+    const qint64 gitUs = t.nsecsElapsed() / 1000;
+
+    QVERIFY(maybe >= out.count('\n'));
+    qDebug("%s: %d of %d commits left to check in %lld us, git rev-list %lld us",
+           qPrintable(path), maybe, commits.count(), bloomUs, gitUs);
+}
+
+void OdbTest::packBitmaps()
+{
+/*
+   Bitmaps are EWAH compressed, possibly xor'ed with other ones,
+   and their bits follow the pack order. Once translated to rows
+   they must give the same commits 'git rev-list' finds.
+*/
+    QVERIFY(repo.git(QStringList() << "repack" << "-adq" << "--write-bitmap-index"));
+
+    const QVector<QByteArray> commits(allCommits());
+    QHash<QByteArray, int> rowOf;
+    for (int i = 0; i < commits.count(); i++)
+        rowOf.insert(commits.at(i), i);
+
+    PackBitmaps pb(repo.gitDir());
+    QVERIFY(pb.open());
+    pb.setRows(commits);
+
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "log" << "--no-walk" << "--all" << "--format=%H", &out));
+
+    int checked = 0;
+    foreach (const QByteArray& tip, out.split('\n')) {
+        QBitArray rows;
+        if (tip.isEmpty() || !pb.reachableRows(ObjectDb::toRaw(tip.constData()), &rows))
+            continue; // no bitmap for this one
+
+        QByteArray revs;
+        QVERIFY(repo.git(QStringList() << "rev-list" << tip, &revs));
+
+        QBitArray expected(commits.count());
+        foreach (const QByteArray& sha, revs.split('\n'))
+            if (!sha.isEmpty())
+                expected.setBit(rowOf.value(ObjectDb::toRaw(sha.constData())));
+
+        QVERIFY2(rows == expected, qPrintable("wrong reachable set for " + tip));
+        checked++;
+    }
+    QVERIFY2(checked > 0, "no tip has a bitmap");
+}
+
+QTEST_GUILESS_MAIN(OdbTest)
+
+#include "tst_odb.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_patchids
+
+SOURCES += \
+    $$PWD/tst_patchids.cpp
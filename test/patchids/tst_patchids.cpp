@@ -0,0 +1,224 @@
+#include <QtTest>
+
+#include "common.h"
+#include "git.h"
+#include "patchid.h"
+#include "task.h"
+#include "testrepo.h"
+
+static const int COMMITS = 2000;
+
+class PatchIdsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void compute();
+    void equivalents();
+    void saveLoad();
+    void manyChunks();
+    void canceled();
+    void loadedEquivalents();
+
+private:
+    const QByteArray raw(const QString& rev) const;
+    const QStringList commits() const;
+
+    TestRepo repo;
+    QByteArray fix, picked, empty1, empty2, other;
+    QHash<QByteArray, QByteArray> ids;
+};
+
+const QByteArray PatchIdsTest::raw(const QString& rev) const
+{
+    QByteArray out;
+    if (!repo.git(QStringList() << "rev-parse" << rev, &out))
+        return QByteArray();
+
+    return QByteArray::fromHex(out.trimmed());
+}
+
+const QStringList PatchIdsTest::commits() const
+{
+// the ones Git::startPatchIds() asks for, with a single parent
+
+    QStringList shas;
+    foreach (const QByteArray& sha, QList<QByteArray>() << fix << picked << empty1 << empty2 << other)
+        shas.append(QString::fromLatin1(sha.toHex()));
+
+    return shas;
+}
+
+void PatchIdsTest::initTestCase()
+{
+/*
+   A fix cherry-picked to a release branch, two empty commits
+   and an unrelated change.
+*/
+    QVERIFY(repo.isValid());
+    QVERIFY(repo.commit("a.txt", "base\n", "base"));
+    QVERIFY(repo.commit("fix.txt", "fix\n", "fix"));
+    fix = raw("HEAD");
+
+    QVERIFY(repo.git(QStringList() << "checkout" << "-q" << "-b" << "rel" << "HEAD~1"));
+    QVERIFY(repo.git(QStringList() << "cherry-pick" << QString::fromLatin1(fix.toHex())));
+    picked = raw("HEAD");
+    QVERIFY(picked != fix);
+
+    QVERIFY(repo.git(QStringList() << "commit" << "-q" << "--allow-empty" << "-m" << "empty 1"));
+    empty1 = raw("HEAD");
+    QVERIFY(repo.git(QStringList() << "commit" << "-q" << "--allow-empty" << "-m" << "empty 2"));
+    empty2 = raw("HEAD");
+    QVERIFY(repo.commit("other.txt", "other\n", "other"));
+    other = raw("HEAD");
+
+    Task t(NULL);
+    QVERIFY(PatchIds::compute(&t, repo.path(), commits(), &ids));
+}
+
+void PatchIdsTest::compute()
+{
+    // every commit gets an id, empty ones the all zero one
+    const QByteArray none(20, '\0');
+    QCOMPARE(ids.count(), 5);
+    QCOMPARE(ids.value(fix).size(), 20);
+    QCOMPARE(ids.value(fix), ids.value(picked));
+    QVERIFY(ids.value(fix) != none);
+    QVERIFY(ids.value(other) != none);
+    QVERIFY(ids.value(other) != ids.value(fix));
+    QCOMPARE(ids.value(empty1), none);
+    QCOMPARE(ids.value(empty2), none);
+}
+
+void PatchIdsTest::equivalents()
+{
+    // empty commits are known but not equivalent to each other
+    PatchIds p;
+    QHashIterator<QByteArray, QByteArray> it(ids);
+    while (it.hasNext()) {
+        it.next();
+        p.insert(it.key(), it.value());
+    }
+    QCOMPARE(p.equivalents(fix), QList<QByteArray>() << picked);
+    QCOMPARE(p.equivalents(picked), QList<QByteArray>() << fix);
+    QVERIFY(p.equivalents(other).isEmpty());
+    QVERIFY(p.contains(empty1));
+    QVERIFY(p.contains(empty2));
+    QVERIFY(p.equivalents(empty1).isEmpty());
+    QVERIFY(p.equivalents(empty2).isEmpty());
+    QVERIFY(!p.contains(QByteArray(20, '\1')));
+    QVERIFY(p.equivalents(QByteArray(20, '\1')).isEmpty());
+}
+
+void PatchIdsTest::saveLoad()
+{
+    // saved ids, the empty ones too, come back as they were
+    PatchIds p;
+    QVERIFY(p.load(repo.gitDir())); // no file yet
+    QVERIFY(!p.contains(fix));
+    QVERIFY(!p.save(repo.gitDir())); // nothing changed
+
+    QHashIterator<QByteArray, QByteArray> it(ids);
+    while (it.hasNext()) {
+        it.next();
+        p.insert(it.key(), it.value());
+    }
+    QVERIFY(p.save(repo.gitDir()));
+    QVERIFY(QFile::exists(repo.gitDir() + QGit::P_ID_FILE));
+    QVERIFY(!p.save(repo.gitDir())); // already saved
+
+    PatchIds loaded;
+    QVERIFY(loaded.load(repo.gitDir()));
+    const QStringList shas(commits());
+    FOREACH_SL (s, shas)
+        QVERIFY(loaded.contains(QByteArray::fromHex(s->toLatin1())));
+
+    QCOMPARE(loaded.equivalents(fix), QList<QByteArray>() << picked);
+    QVERIFY(loaded.equivalents(empty1).isEmpty());
+    QVERIFY(!loaded.save(repo.gitDir())); // loading does not change them
+
+    // a bad file is an error and leaves nothing behind
+    QFile f(repo.gitDir() + QGit::P_ID_FILE);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(qCompress(QByteArray("not patch ids")));
+    f.close();
+    QVERIFY(!loaded.load(repo.gitDir()));
+    QVERIFY(!loaded.contains(fix));
+}
+
+void PatchIdsTest::manyChunks()
+{
+    // more commits than a single pipe takes, each one is found
+    TestRepo big;
+    QVERIFY(big.isValid());
+    QVERIFY2(big.importHistory(COMMITS), "git fast-import failed");
+
+    QByteArray out;
+    QVERIFY(big.git(QStringList() << "rev-list" << "--no-merges" << "--min-parents=1"
+                                  << "--all", &out));
+    const QStringList shas(QString::fromLatin1(out).split('\n', QString::SkipEmptyParts));
+    QVERIFY(shas.count() > 1000);
+
+    Task t(NULL);
+    QHash<QByteArray, QByteArray> res;
+    QVERIFY(PatchIds::compute(&t, big.path(), shas, &res));
+    QCOMPARE(res.count(), shas.count());
+    FOREACH_SL (s, shas)
+        QVERIFY(res.value(QByteArray::fromHex(s->toLatin1())) != QByteArray(20, '\0'));
+}
+
+void PatchIdsTest::canceled()
+{
+    // nothing is stored, not even as empty
+    Task t(NULL);
+    t.cancel();
+    QHash<QByteArray, QByteArray> res;
+    QVERIFY(!PatchIds::compute(&t, repo.path(), commits(), &res));
+    QVERIFY(res.isEmpty());
+}
+
+void PatchIdsTest::loadedEquivalents()
+{
+/*
+   Only revisions with a loaded equivalent are marked: saved ids
+   could refer to commits rebased away, here one for 'other'.
+*/
+    PatchIds p;
+    QHashIterator<QByteArray, QByteArray> it(ids);
+    while (it.hasNext()) {
+        it.next();
+        p.insert(it.key(), it.value());
+    }
+    const QByteArray gone(20, '\7');
+    p.insert(gone, ids.value(other));
+    QVERIFY(p.save(repo.gitDir()));
+
+    qputenv("HOME", repo.path().toLocal8Bit()); // settings too
+    QGit::setFlag(QGit::PATCH_ID_F, true);
+
+    Git* git = new Git(NULL);
+    QVERIFY(repo.load(git));
+
+    const Rev* rf = git->revLookup(QString::fromLatin1(fix.toHex()));
+    const Rev* rp = git->revLookup(QString::fromLatin1(picked.toHex()));
+    const Rev* ro = git->revLookup(QString::fromLatin1(other.toHex()));
+    const Rev* re = git->revLookup(QString::fromLatin1(empty1.toHex()));
+    QVERIFY(rf && rp && ro && re);
+
+    QTRY_VERIFY(git->hasEquivalentRevs(rf->sha()));
+    QVERIFY(git->hasEquivalentRevs(rp->sha()));
+    QCOMPARE(git->getEquivalentRevs(QString::fromLatin1(fix.toHex())),
+             QStringList() << QString::fromLatin1(picked.toHex()));
+
+    QVERIFY(!git->hasEquivalentRevs(ro->sha()));
+    QVERIFY(git->getEquivalentRevs(QString::fromLatin1(other.toHex())).isEmpty());
+    QVERIFY(!git->hasEquivalentRevs(re->sha()));
+
+    QGit::setFlag(QGit::PATCH_ID_F, false);
+    delete git;
+}
+
+QGIT_TEST_MAIN(PatchIdsTest)
+
+#include "tst_patchids.moc"
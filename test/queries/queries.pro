@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_queries
+
+SOURCES += \
+    $$PWD/tst_queries.cpp
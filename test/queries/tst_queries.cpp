@@ -0,0 +1,225 @@
+#include <algorithm>
+
+#include <QtTest>
+
+#include "filehistory.h"
+#include "git.h"
+#include "testrepo.h"
+
+static const int COMMITS = 20000;
+static const int TAGS_PER_COMMIT = 5; // 100k lightweight tags
+static const int FAN_OUT = 1000;      // branches forking at the same revision
+
+class QueriesTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    QueriesTest() : git(NULL), fh(NULL) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void childs();
+    void refNames();
+    void sortShaList();
+    void queryTime_data();
+    void queryTime();
+
+private:
+    bool addFanOut();
+    bool addTags();
+    const QStringList sampleShas(int cnt) const;
+
+    TestRepo repo;
+    Git* git;
+    const FileHistory* fh;
+    QString baseSha;
+    QStringList fanShas;
+};
+
+bool QueriesTest::addFanOut() {
+// many branches with a single commit each on top of an old revision
+
+    QByteArray out;
+    if (!repo.git(QStringList() << "rev-list" << "--first-parent" << "--skip=5000"
+                  << "-n1" << "master", &out))
+        return false;
+
+    baseSha = QString::fromLatin1(out).trimmed();
+    QByteArray s;
+    for (int i = 0; i < FAN_OUT; i++) {
+        const QByteArray n(QByteArray::number(i));
+        const QByteArray msg("fan out " + n + '\n');
+        s.append("commit refs/heads/fan-" + n + '\n');
+        s.append("committer C O Mitter <committer@example.com> ");
+        s.append(QByteArray::number(2000000000 + i)).append(" +0000\n");
+        s.append("data ").append(QByteArray::number(msg.size())).append('\n').append(msg);
+        s.append("from ").append(baseSha.toLatin1()).append("\n\n");
+    }
+    return repo.git(QStringList() << "fast-import" << "--quiet", NULL, s);
+}
+
+bool QueriesTest::addTags() {
+// packed, as a repository with so many refs would have them
+
+    QByteArray out;
+    if (!repo.git(QStringList() << "rev-list" << "--all", &out))
+        return false;
+
+    QByteArray s;
+    int i = 0;
+    foreach (const QByteArray& sha, out.split('\n'))
+        if (!sha.isEmpty() && i < COMMITS) {
+            for (int k = 0; k < TAGS_PER_COMMIT; k++)
+                s.append("create refs/tags/l" + QByteArray::number(i) + '.'
+                         + QByteArray::number(k) + ' ' + sha + '\n');
+            i++;
+        }
+    return repo.git(QStringList() << "update-ref" << "--stdin", NULL, s)
+        && repo.git(QStringList() << "pack-refs" << "--all" << "--prune");
+}
+
+const QStringList QueriesTest::sampleShas(int cnt) const {
+// evenly spread over the loaded history
+
+    QStringList res;
+    const int rows = fh->rowCount();
+    for (int i = 0; i < cnt; i++)
+        res.append(fh->sha((qint64)i * rows / cnt));
+
+    return res;
+}
+
+void QueriesTest::initTestCase()
+{
+    QVERIFY(repo.isValid());
+    QVERIFY2(repo.importHistory(COMMITS), "git fast-import failed");
+    QVERIFY2(addFanOut(), "cannot create fan out branches");
+    QVERIFY2(addTags(), "cannot create tags");
+
+    for (int i = 0; i < FAN_OUT; i++)
+        fanShas.append(QString());
+
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "for-each-ref" << "--format=%(refname:short) %(objectname)"
+                     << "refs/heads/fan-*", &out));
+    foreach (const QByteArray& line, out.split('\n'))
+        if (!line.isEmpty())
+            fanShas[line.mid(4, line.indexOf(' ') - 4).toInt()] = QString::fromLatin1(line.mid(line.indexOf(' ') + 1));
+
+    git = new Git(NULL);
+    fh = repo.load(git);
+    QVERIFY2(fh, "loading did not complete");
+    QCOMPARE(fh->rowCount(), COMMITS + FAN_OUT);
+
+    // children and nearest refs are indexed a bit after loading
+    QTRY_VERIFY_WITH_TIMEOUT(!git->getChilds(baseSha).isEmpty(), 60000);
+}
+
+void QueriesTest::cleanupTestCase()
+{
+    if (git)
+        git->stop(false);
+
+    delete git;
+}
+
+void QueriesTest::childs()
+{
+    // the whole fan out, plus the revision on master, in loading order
+    const QStringList childs(git->getChilds(baseSha));
+    QVERIFY(childs.count() > FAN_OUT);
+
+    foreach (const QString& sha, fanShas)
+        QVERIFY(childs.contains(sha));
+
+    for (int i = 1; i < childs.count(); i++)
+        QVERIFY(fh->row(childs.at(i - 1)) < fh->row(childs.at(i)));
+}
+
+void QueriesTest::refNames()
+{
+    // every revision is loaded, only the order can differ
+    const QStringList loaded(git->getAllRefNames(Git::TAG | Git::BRANCH, true));
+    QStringList all(git->getAllRefNames(Git::TAG | Git::BRANCH, false));
+    QVERIFY(loaded.count() >= COMMITS * TAGS_PER_COMMIT + FAN_OUT);
+    QCOMPARE(loaded.count(), all.count());
+
+    QStringList sorted(loaded);
+    sorted.sort();
+    all.sort();
+    QCOMPARE(sorted, all);
+
+    int prev = -1;
+    foreach (const QString& name, loaded) {
+        if (!name.startsWith("fan-"))
+            continue;
+
+        const int row = fh->row(git->getRefSha(name, Git::BRANCH, false));
+        QVERIFY2(row > prev, qPrintable(name + " out of loading order"));
+        prev = row;
+    }
+}
+
+void QueriesTest::sortShaList()
+{
+    // same revisions, sorted by row, the unknown one dropped
+    QStringList shas(fanShas);
+    std::reverse(shas.begin(), shas.end());
+    shas.append(QString(40, 'f'));
+
+    const QStringList sorted(git->sortShaListByIndex(shas));
+    QCOMPARE(sorted.count(), FAN_OUT);
+    for (int i = 1; i < sorted.count(); i++)
+        QVERIFY(fh->row(sorted.at(i - 1)) < fh->row(sorted.at(i)));
+}
+
+void QueriesTest::queryTime_data()
+{
+    QTest::addColumn<int>("query");
+    QTest::newRow("getChilds") << 0;
+    QTest::newRow("getAllRefNames") << 1;
+    QTest::newRow("sortShaListByIndex") << 2;
+    QTest::newRow("getNearTags") << 3;
+    QTest::newRow("getDescendantBranches") << 4;
+}
+
+void QueriesTest::queryTime()
+{
+/*
+   Calls as the views do them, on a history with 100k refs and a
+   revision with a thousand children. Near tags and branches are
+   asked for a thousand revisions spread over the history.
+*/
+    QFETCH(int, query);
+    const QStringList sample(sampleShas(1000));
+    int cnt = 0;
+
+    QBENCHMARK {
+        switch (query) {
+        case 0:
+            cnt += git->getChilds(baseSha).count();
+            break;
+        case 1:
+            cnt += git->getAllRefNames(Git::TAG | Git::BRANCH, true).count();
+            break;
+        case 2:
+            cnt += git->sortShaListByIndex(fanShas).count();
+            break;
+        case 3:
+            foreach (const QString& sha, sample)
+                cnt += git->getNearTags(true, sha).count() + git->getNearTags(false, sha).count();
+            break;
+        case 4:
+            foreach (const QString& sha, sample)
+                cnt += git->getDescendantBranches(sha).count();
+            break;
+        }
+    }
+    QVERIFY(cnt > 0);
+}
+
+QGIT_TEST_MAIN(QueriesTest)
+
+#include "tst_queries.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_reachability
+
+SOURCES += \
+    $$PWD/tst_reachability.cpp
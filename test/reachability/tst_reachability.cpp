@@ -0,0 +1,135 @@
+#include <QtTest>
+
+#include "reachability.h"
+#include "testrepo.h"
+
+class ReachabilityTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void reachable();
+    void ranges_data();
+    void ranges();
+    void missingParents();
+
+private:
+    int row(const QString& rev) const;
+    const QBitArray revList(const QStringList& args) const;
+
+    TestRepo repo;
+    QStringList shas;
+    QHash<QString, int> rows;
+    Reachability reach;
+};
+
+int ReachabilityTest::row(const QString& rev) const {
+
+    QByteArray out;
+    if (!repo.git(QStringList() << "rev-parse" << rev + "^{commit}", &out))
+        return -1;
+
+    return rows.value(QString::fromLatin1(out).trimmed(), -1);
+}
+
+const QBitArray ReachabilityTest::revList(const QStringList& args) const {
+
+    QByteArray out;
+    QBitArray set(shas.count());
+    if (repo.git(QStringList() << "rev-list" << args, &out))
+        foreach (const QByteArray& sha, out.split('\n'))
+            if (!sha.isEmpty())
+                set.setBit(rows.value(QString::fromLatin1(sha)));
+
+    return set;
+}
+
+void ReachabilityTest::initTestCase()
+{
+    // the graph table as Git::updateReachability() builds it
+    QVERIFY(repo.isValid());
+    QVERIFY(repo.importHistory(3000));
+
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "rev-list" << "--all" << "--topo-order" << "--parents", &out));
+
+    QList<QStringList> parents;
+    foreach (const QByteArray& line, out.split('\n')) {
+        if (line.isEmpty())
+            continue;
+
+        QStringList l(QString::fromLatin1(line).split(' '));
+        rows.insert(l.first(), shas.count());
+        shas.append(l.takeFirst());
+        parents.append(l);
+    }
+    QVector<int> firstParent, parentRows;
+    for (int r = 0; r < shas.count(); r++) {
+        firstParent.append(parentRows.count());
+        foreach (const QString& p, parents.at(r))
+            parentRows.append(rows.value(p, -1));
+    }
+    firstParent.append(parentRows.count());
+    reach.setGraph(firstParent, parentRows);
+    QVERIFY(reach.isValid(shas.count()));
+}
+
+void ReachabilityTest::reachable()
+{
+    const QStringList tips(QStringList() << "master" << "topic" << "feature-4" << "v2" << "master~1000");
+
+    QVector<int> tipRows;
+    foreach (const QString& t, tips)
+        tipRows.append(row(t));
+
+    reach.compute(tipRows); // in parallel
+
+    for (int i = 0; i < tips.count(); i++) {
+        QVERIFY(reach.isKnown(tipRows.at(i)));
+        QVERIFY2(reach.reachable(tipRows.at(i)) == revList(QStringList(tips.at(i))), qPrintable(tips.at(i)));
+    }
+}
+
+void ReachabilityTest::ranges_data()
+{
+    QTest::addColumn<QString>("a");
+    QTest::addColumn<QString>("b");
+    QTest::newRow("branch") << "master" << "feature-8";
+    QTest::newRow("merged") << "master" << "topic";
+    QTest::newRow("tags") << "v1" << "v2";
+    QTest::newRow("reverse") << "master" << "master~700";
+}
+
+void ReachabilityTest::ranges()
+{
+    // the bitwise operations of Git::getRangeFilter()
+    QFETCH(QString, a);
+    QFETCH(QString, b);
+
+    const QBitArray ra(reach.reachable(row(a)));
+    const QBitArray rb(reach.reachable(row(b)));
+
+    QCOMPARE(rb & ~ra, revList(QStringList(a + ".." + b)));
+    QCOMPARE((ra | rb) & ~(ra & rb), revList(QStringList(a + "..." + b)));
+    QCOMPARE(ra & ~rb, revList(QStringList() << a << "^" + b));
+}
+
+void ReachabilityTest::missingParents()
+{
+    // boundary revisions have parents not loaded, with row -1
+    Reachability r;
+    QVector<int> firstParent, parentRows;
+    firstParent << 0 << 2 << 3 << 3;
+    parentRows << 1 << -1 << 2;
+    r.setGraph(firstParent, parentRows);
+
+    QBitArray all(3, true);
+    QCOMPARE(r.reachable(0), all);
+    QCOMPARE(r.reachable(2).count(true), 1);
+    QCOMPARE(r.reachable(5).count(true), 0);
+}
+
+QTEST_GUILESS_MAIN(ReachabilityTest)
+
+#include "tst_reachability.moc"
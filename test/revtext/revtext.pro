@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_revtext
+
+SOURCES += \
+    $$PWD/tst_revtext.cpp
@@ -0,0 +1,209 @@
+#include <QElapsedTimer>
+#include <QTextCodec>
+#include <QtConcurrentRun>
+#include <QtTest>
+
+#include "git.h"
+#include "testrepo.h"
+
+class RevTextTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void decodeMatchesUtf8();
+    void cachePerThread();
+    void codecPerHistory();
+    void decodeTime();
+    void fromUtf8Time();
+    void identities();
+    void identitiesMemory();
+
+private:
+    TestRepo repo;
+    RowBlock block;
+    QList<Rev*> revs;
+};
+
+static const QString revTexts(const QList<Rev*>& revs) {
+
+    QString s;
+    foreach (const Rev* r, revs)
+        s.append(r->author()).append(r->committer()).append(r->shortLog());
+
+    return s;
+}
+
+void RevTextTest::initTestCase()
+{
+    // revisions parsed as Git::addChunk() does, from a single block
+    QVERIFY(repo.isValid());
+    QVERIFY(repo.importHistory(20000));
+
+    QStringList args(Git::revListCmd(true));
+    args.removeFirst(); // "git"
+    QByteArray log;
+    QVERIFY(repo.git(args, &log));
+    block.append(log).append('\0');
+
+    int start = 0, next = 0;
+    while (true) {
+        Rev* r = new Rev(block, start, revs.count(), &next, MAIN_LOG);
+        if (next < 0) {
+            delete r;
+            break;
+        }
+        revs.append(r);
+        start = next;
+    }
+    QCOMPARE(revs.count(), 20000);
+}
+
+void RevTextTest::cleanupTestCase()
+{
+    qDeleteAll(revs);
+}
+
+void RevTextTest::decodeMatchesUtf8()
+{
+    // plain ASCII takes a shortcut, UTF-8 names must come out the same
+    int nonAscii = 0;
+    foreach (const Rev* r, revs) {
+        const QByteArray raw(r->rawAuthor());
+        QCOMPARE(r->author(), QString::fromUtf8(raw));
+        QCOMPARE(r->committer(), QString::fromUtf8(r->rawCommitter()));
+        nonAscii += (r->author() != QString::fromLatin1(raw));
+    }
+    QVERIFY(nonAscii > 0);
+}
+
+void RevTextTest::cachePerThread()
+{
+/*
+   Tasks read revisions text while the views repaint. Only the
+   thread owning the cache, here the test one, can fill it, the
+   others must decode on their own and get the same text.
+*/
+    RevTexts texts;
+    block.texts = &texts;
+    const QString mine(revTexts(revs)); // revisions are indexed now
+
+    QFuture<QString> f(QtConcurrent::run(revTexts, revs));
+    QCOMPARE(revTexts(revs), mine);
+    QCOMPARE(f.result(), mine);
+
+    block.texts = NULL;
+}
+
+void RevTextTest::codecPerHistory()
+{
+/*
+   Two repositories open with different encodings, a task decodes
+   revisions of the UTF-8 one while the other one changes codec.
+*/
+    RevTexts latin1;
+    latin1.setCodec(QTextCodec::codecForName("ISO-8859-1"));
+    RevTexts utf8;
+    utf8.setCodec(NULL);
+
+    block.texts = &utf8;
+    const QString mine(revTexts(revs));
+    QFuture<QString> f(QtConcurrent::run(revTexts, revs));
+    for (int i = 0; i < 100; i++)
+        latin1.setCodec(i % 2 ? QTextCodec::codecForName("ISO-8859-1") : NULL);
+
+    QCOMPARE(f.result(), mine);
+
+    block.texts = &latin1;
+    int differs = 0;
+    foreach (const Rev* r, revs) {
+        QCOMPARE(r->author(), QString::fromLatin1(r->rawAuthor()));
+        differs += (r->author() != QString::fromUtf8(r->rawAuthor()));
+    }
+    QVERIFY(differs > 0);
+
+    Identities ids;
+    const QByteArray raw("J\xc3\xbcrgen<author@example.com>");
+    const int id = ids.intern(raw, latin1.codec());
+    QCOMPARE(ids.name(id), QString::fromLatin1(raw));
+    ids.recode(NULL);
+    QCOMPARE(ids.name(id), QString::fromUtf8(raw));
+
+    block.texts = NULL;
+}
+
+void RevTextTest::decodeTime()
+{
+    // author and committer of every revision, cache not used
+    int len = 0;
+    QBENCHMARK {
+        foreach (const Rev* r, revs)
+            len += r->author().length() + r->committer().length();
+    }
+    QVERIFY(len > 0);
+}
+
+void RevTextTest::fromUtf8Time()
+{
+    // same fields with a plain QString::fromUtf8(), for comparison
+    int len = 0;
+    QBENCHMARK {
+        foreach (const Rev* r, revs)
+            len += QString::fromUtf8(r->rawAuthor()).length() + QString::fromUtf8(r->rawCommitter()).length();
+    }
+    QVERIFY(len > 0);
+}
+
+void RevTextTest::identities()
+{
+    Identities ids;
+    const int a = ids.intern("A U Thor<author@example.com>");
+    QCOMPARE(ids.intern(QByteArray("A U Thor<author@example.com>")), a);
+
+    const int b = ids.intern("J\xc3\xbcrgen \xc3\x9cnicode<author@example.com>");
+    QVERIFY(b != a);
+    QCOMPARE(ids.count(), 2);
+    QCOMPARE(ids.name(a), QString("A U Thor<author@example.com>"));
+    QCOMPARE(ids.name(b), QString::fromUtf8("J\xc3\xbcrgen \xc3\x9cnicode<author@example.com>"));
+}
+
+void RevTextTest::identitiesMemory()
+{
+/*
+   Authors of 1M revisions by 5000 people, kept as a string per
+   revision or interned. Sizes are the ones of Qt5 on 64 bit: 24
+   bytes of header for each string or byte array, about 32 bytes
+   for each hash node.
+*/
+    const int REVS = 1000000, AUTHORS = 5000;
+    QVector<QByteArray> raw;
+    for (int i = 0; i < AUTHORS; i++)
+        raw.append(QString("Author Number %1<author.%1@example.com>").arg(i).toUtf8());
+
+    Identities ids;
+    QVector<int> authorIds(REVS);
+    QElapsedTimer t;
+    t.start();
+    for (int r = 0; r < REVS; r++)
+        authorIds[r] = ids.intern(raw.at((r * 7919) % AUTHORS));
+
+    const qint64 ms = t.elapsed();
+    QCOMPARE(ids.count(), AUTHORS);
+
+    qint64 perRev = 0, interned = qint64(sizeof(int)) * REVS;
+    for (int r = 0; r < REVS; r++)
+        perRev += 24 + 2 * (ids.name(authorIds.at(r)).length() + 1);
+
+    for (int i = 0; i < ids.count(); i++)
+        interned += 24 + 2 * (ids.name(i).length() + 1) + 24 + raw.at(i).size() + 1 + 32;
+
+    QVERIFY(interned < perRev / 10);
+    qDebug("%d revisions, %d authors: %lld KB as strings, %lld KB interned, saved %lld KB, interned in %lld ms",
+           REVS, AUTHORS, perRev / 1024, interned / 1024, (perRev - interned) / 1024, ms);
+}
+
+QTEST_GUILESS_MAIN(RevTextTest)
+
+#include "tst_revtext.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_rowblocks
+
+SOURCES += \
+    $$PWD/tst_rowblocks.cpp
@@ -0,0 +1,176 @@
+#include <QElapsedTimer>
+#include <QTemporaryFile>
+#include <QtConcurrentRun>
+#include <QtTest>
+
+#include "git.h"
+#include "rowblocks.h"
+#include "testrepo.h"
+
+static const int BLOCK_SIZE = 64 * 1024; // as DataLoader READ_BLOCK_SIZE
+
+class RowBlocksTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+    void restore_data();
+    void restore();
+    void clearWhileLoading();
+    void textFromTask();
+
+private:
+    TestRepo repo;
+    QTemporaryFile* logFile;
+    QByteArray log;
+    QList<RowBlock*> blocks;
+};
+
+void RowBlocksTest::initTestCase()
+{
+    // main view 'git log' output, saved to file as DataLoader does
+    QVERIFY(repo.isValid());
+    QVERIFY(repo.importHistory(20000));
+
+    QStringList args(Git::revListCmd(true));
+    args.removeFirst(); // "git"
+    QVERIFY(repo.git(args, &log));
+
+    logFile = new QTemporaryFile(this);
+    QVERIFY(logFile->open());
+    QCOMPARE(logFile->write(log), qint64(log.size()));
+    logFile->close();
+}
+
+void RowBlocksTest::cleanup()
+{
+    // blocks are owned by FileHistory, not by RowBlocks
+    qDeleteAll(blocks);
+    blocks.clear();
+}
+
+void RowBlocksTest::restore_data()
+{
+    QTest::addColumn<bool>("fromFile");
+    QTest::newRow("dropped") << true;
+    QTest::newRow("compressed") << false;
+}
+
+void RowBlocksTest::restore()
+{
+/*
+   With a budget of 1/8 of the data, evicted blocks must come back
+   with the same content, reports memory saved and restore time.
+*/
+    QFETCH(bool, fromFile);
+
+    RowBlocks rb;
+    rb.setBudget(log.size() / 8);
+    const int id = (fromFile ? rb.reserveFile(logFile->fileName()) : -1);
+    QVERIFY(!fromFile || id != -1);
+
+    for (int ofs = 0; ofs < log.size(); ofs += BLOCK_SIZE) {
+        RowBlock* b = new RowBlock(fromFile ? ofs : -1, id);
+        b->append(log.mid(ofs, BLOCK_SIZE));
+        blocks.append(b);
+        rb.add(b);
+    }
+    qDebug("%s", qPrintable(rb.report()));
+
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < blocks.count(); i++) {
+        const RowBlock& b = *blocks.at(i);
+        b.touch();
+        QVERIFY2(b == log.mid(i * BLOCK_SIZE, BLOCK_SIZE), qPrintable(QString("block %1 differs").arg(i)));
+    }
+    qDebug("%d blocks, %d KB, touched in %lld ms",
+           blocks.count(), log.size() / 1024, t.elapsed());
+}
+
+void RowBlocksTest::clearWhileLoading()
+{
+    // loader file is only read until handed over, clear() must not delete it
+    QTemporaryFile* f = new QTemporaryFile(this);
+    QVERIFY(f->open());
+    f->write("data");
+
+    RowBlocks rb;
+    rb.setBudget(BLOCK_SIZE);
+    const int id = rb.reserveFile(f->fileName());
+    QVERIFY(id != -1);
+
+    rb.clear(); // as with a refresh during the load
+    QVERIFY(f->exists());
+    QCOMPARE(f->parent(), static_cast<QObject*>(this));
+    QVERIFY(!rb.adoptFile(id, f));
+
+    // a new load on the same history
+    const int id2 = rb.reserveFile(f->fileName());
+    QVERIFY(rb.adoptFile(id2, f));
+    QVERIFY(f->parent() == NULL);
+    const QString name(f->fileName());
+    rb.clear(); // now it is ours
+    QVERIFY(!QFile::exists(name));
+}
+
+static const QString revTexts(const QList<Rev*>& revs) {
+
+    QString s;
+    foreach (const Rev* r, revs)
+        s.append(r->author()).append(r->committer()).append(r->shortLog());
+
+    return s;
+}
+
+void RowBlocksTest::textFromTask()
+{
+/*
+   A task reads revisions text while the GUI thread, here the test
+   one, evicts and restores the same blocks. Blocks are cut at record
+   boundaries and revisions parsed as Git::addChunk() does.
+*/
+    QByteArray all(log);
+    all.append('\0');
+
+    RowBlocks rb;
+    rb.setBudget(all.size() / 8);
+    QList<Rev*> revs;
+    for (int ofs = 0; ofs < all.size(); ) {
+        int end = all.indexOf('\0', ofs + BLOCK_SIZE);
+        end = (end == -1 ? all.size() : end + 1);
+        RowBlock* b = new RowBlock();
+        b->append(all.mid(ofs, end - ofs));
+        blocks.append(b);
+        rb.add(b);
+
+        int start = 0, next = 0;
+        while (true) {
+            Rev* r = new Rev(*b, start, revs.count(), &next, MAIN_LOG);
+            if (next < 0) {
+                delete r;
+                break;
+            }
+            revs.append(r);
+            start = next;
+        }
+        ofs = end;
+    }
+    QCOMPARE(revs.count(), 20000);
+    const QString mine(revTexts(revs)); // revisions are indexed now
+
+    QFuture<QString> f(QtConcurrent::run(revTexts, revs));
+    while (!f.isFinished())
+        for (int i = blocks.count() - 1; i >= 0; i--)
+            blocks.at(i)->touch();
+
+    QCOMPARE(f.result(), mine);
+    QCOMPARE(revTexts(revs), mine);
+    qDeleteAll(revs);
+}
+
+QTEST_GUILESS_MAIN(RowBlocksTest)
+
+#include "tst_rowblocks.moc"
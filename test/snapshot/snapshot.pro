@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_snapshot
+
+SOURCES += \
+    $$PWD/tst_snapshot.cpp
@@ -0,0 +1,240 @@
+#include <QtConcurrentRun>
+#include <QtTest>
+
+#include "filehistory.h"
+#include "git.h"
+#include "snapshot.h"
+#include "testrepo.h"
+
+static const int COMMITS = 3000;
+
+class SnapshotTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    SnapshotTest() : git(NULL) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void commitTable();
+    void refs();
+    void refreshKeepsOldGeneration();
+    void readFromOtherThread();
+    void registry();
+    void fileFilter();
+    void secondWindow();
+
+private:
+    bool reload();
+
+    TestRepo repo;
+    Git* git;
+};
+
+static const QString dump(const RepoSnapshotPtr& s) {
+// everything a reader could ask for each row
+
+    QString d;
+    for (int row = 0; row < s->count(); row++) {
+        d.append(s->sha(row)).append(' ').append(s->author(row)).append(' ');
+        d.append(QString::number(s->authorTime(row)));
+        foreach (int p, s->parentRows(row))
+            d.append(' ').append(p != -1 ? s->sha(p) : "-");
+
+        d.append('\n');
+    }
+    return d;
+}
+
+bool SnapshotTest::reload() {
+// as a refresh, loading again on the same Git
+
+    git->stop(false);
+    return (repo.load(git) != NULL);
+}
+
+void SnapshotTest::initTestCase()
+{
+    QVERIFY(repo.isValid());
+    QVERIFY2(repo.importHistory(COMMITS), "git fast-import failed");
+
+    git = new Git(NULL);
+    QVERIFY2(repo.load(git), "loading did not complete");
+}
+
+void SnapshotTest::cleanupTestCase()
+{
+    if (git)
+        git->stop(false);
+
+    delete git;
+}
+
+void SnapshotTest::commitTable()
+{
+    // same revisions, parents and authors of 'git log'
+    const RepoSnapshotPtr s(git->snapshot());
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "log" << "--all" << "--format=%H %at %P", &out));
+
+    int cnt = 0;
+    foreach (const QByteArray& line, out.split('\n')) {
+        if (line.isEmpty())
+            continue;
+
+        const QStringList f(QString::fromLatin1(line).split(' ', QString::SkipEmptyParts));
+        const int row = s->row(f.at(0));
+        QVERIFY2(row != -1, qPrintable(f.at(0) + " not in snapshot"));
+        QCOMPARE(s->sha(row), f.at(0));
+        QCOMPARE(s->authorTime(row), f.at(1).toUInt());
+        QCOMPARE(s->author(row), git->revLookup(f.at(0))->author());
+
+        const QVector<int> parents(s->parentRows(row));
+        QCOMPARE(parents.count(), f.count() - 2);
+        for (int i = 0; i < parents.count(); i++)
+            QCOMPARE(s->sha(parents.at(i)), f.at(i + 2));
+
+        cnt++;
+    }
+    QCOMPARE(s->count(), cnt);
+    QCOMPARE(s->row(QString(40, 'f')), -1);
+}
+
+void SnapshotTest::refs()
+{
+    // annotated tags are found on the tagged revision
+    const RepoSnapshotPtr s(git->snapshot());
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "for-each-ref" << "refs/heads" << "refs/tags"
+                     << "--format=%(refname:short) %(objectname) %(*objectname)", &out));
+
+    int cnt = 0;
+    foreach (const QByteArray& line, out.split('\n')) {
+        if (line.isEmpty())
+            continue;
+
+        const QStringList f(QString::fromLatin1(line).split(' ', QString::SkipEmptyParts));
+        const Reference* r = s->refs(f.last());
+        QVERIFY2(r, qPrintable("no refs for " + f.first()));
+        QVERIFY(r->branches.contains(f.first()) || r->tags.contains(f.first()));
+        cnt++;
+    }
+    QVERIFY(cnt >= COMMITS / 1000 + 1);
+}
+
+void SnapshotTest::refreshKeepsOldGeneration()
+{
+    // a reader holding the old snapshot sees it unchanged
+    const RepoSnapshotPtr before(git->snapshot());
+    const QString data(dump(before));
+
+    QVERIFY(repo.commit("new.txt", "new\n", "a new commit"));
+    QVERIFY(reload());
+
+    const RepoSnapshotPtr after(git->snapshot());
+    QVERIFY(after->generation() > before->generation());
+    QCOMPARE(after->count(), before->count() + 1);
+    QCOMPARE(dump(before), data);
+}
+
+void SnapshotTest::readFromOtherThread()
+{
+/*
+   A worker goes through a snapshot while the GUI thread loads
+   again and publishes new generations, as when a refresh comes
+   while a background task is running.
+*/
+    const RepoSnapshotPtr s(git->snapshot());
+    const QString expected(dump(s));
+
+    QFuture<QString> f(QtConcurrent::run(dump, s));
+    QVERIFY(reload());
+    QVERIFY(reload());
+
+    QCOMPARE(f.result(), expected);
+    QCOMPARE(dump(git->snapshot()), expected); // nothing changed on disk
+}
+
+void SnapshotTest::registry()
+{
+    // log data is kept only when the rows are not paged out
+    const RepoSnapshotPtr s(git->snapshot());
+    if (s->logData().isEmpty())
+        QSKIP("log data not kept, the snapshot is not shared");
+
+    QCOMPARE(RepoRegistry::lookup(repo.gitDir()), s);
+    QCOMPARE(RepoRegistry::lookup(repo.path() + "/.git/"), s);
+
+    RepoRegistry::keepWarm(s, s->memorySize());
+    RepoRegistry::keepWarm(RepoSnapshotPtr(), 0); // budget is over, dropped
+    QCOMPARE(RepoRegistry::lookup(repo.gitDir()), s); // still in use here
+}
+
+void SnapshotTest::fileFilter()
+{
+/*
+   Filter by file name reads the file names of the snapshot, once
+   they are loaded. Merges are listed only if the file differs from
+   all the parents, git log shows them or not according to its own
+   simplification, so any other match must be a merge.
+*/
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "log" << "--all" << "--no-merges"
+                     << "--format=%H" << "--" << "src/m3/f5.txt", &out));
+    const QStringList expected(QString::fromLatin1(out).split('\n', QString::SkipEmptyParts));
+    QVERIFY(!expected.isEmpty());
+
+    QTRY_VERIFY_WITH_TIMEOUT(git->snapshot()->files(expected.last()), 30000);
+    const RepoSnapshotPtr s(git->snapshot());
+
+    ShaSet shaSet;
+    git->getFileFilter("*M3/F5*", shaSet);
+    FOREACH_SL (it, expected)
+        QVERIFY2(shaSet.contains(*it), qPrintable(*it + " not matched"));
+
+    FOREACH (ShaSet, it, shaSet)
+        if (!expected.contains(*it))
+            QVERIFY2(s->parentRows(s->row(*it)).count() > 1, qPrintable(*it + " matched"));
+}
+
+void SnapshotTest::secondWindow()
+{
+/*
+   Another window on the same repository parses the 'git log' output
+   read by the first one: same rows and refs, and its log data are
+   the same blocks, not a copy of a second 'git log' run.
+*/
+    const RepoSnapshotPtr s(git->snapshot());
+    if (s->logData().isEmpty())
+        QSKIP("log data not kept, the snapshot is not shared");
+
+    Git* other = new Git(NULL);
+    QVERIFY(repo.load(other));
+    const RepoSnapshotPtr o(other->snapshot());
+
+    QCOMPARE(dump(o), dump(s));
+    QCOMPARE(o->logData().count(), s->logData().count());
+    for (int i = 0; i < s->logData().count(); i++)
+        QVERIFY(o->logData().at(i).constData() == s->logData().at(i).constData());
+
+    int refsCnt = 0;
+    for (int row = 0; row < s->count(); row++) {
+        const Reference* r = s->refs(s->sha(row));
+        const Reference* ro = o->refs(s->sha(row));
+        QCOMPARE(ro != NULL, r != NULL);
+        if (r) {
+            QCOMPARE(ro->branches, r->branches);
+            QCOMPARE(ro->tags, r->tags);
+            refsCnt++;
+        }
+    }
+    QVERIFY(refsCnt > 0);
+    other->stop(false);
+    delete other;
+}
+
+QGIT_TEST_MAIN(SnapshotTest)
+
+#include "tst_snapshot.moc"
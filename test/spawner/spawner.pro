@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_spawner
+
+SOURCES += \
+    $$PWD/tst_spawner.cpp
@@ -0,0 +1,222 @@
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QtTest>
+
+#include "spawner.h"
+#include "testrepo.h"
+
+#ifdef Q_OS_LINUX
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#endif
+
+class SpawnerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void output();
+    void exitCode();
+    void waitRetriesOnSignals();
+    void closeFromSignal();
+    void killIgnoringTerm();
+    void firstByteTime_data();
+    void firstByteTime();
+
+private:
+    TestRepo repo;
+};
+
+static bool start(SpawnedProcess* p, const QStringList& args, const QString& wd) {
+
+    return p->start(args, wd);
+}
+
+static bool start(QProcess* p, const QStringList& args, const QString& wd) {
+
+    QStringList a(args);
+    p->setWorkingDirectory(wd);
+    p->start(a.takeFirst(), a);
+    return p->waitForStarted();
+}
+
+template <class P> static qint64 firstByte(P* p, const QStringList& args, const QString& wd) {
+// microseconds from start to first output in the event loop, -1 if none
+
+    QEventLoop loop;
+    QObject::connect(p, &P::readyReadStandardOutput, &loop, &QEventLoop::quit);
+    QTimer::singleShot(10000, &loop, SLOT(quit()));
+
+    QElapsedTimer t;
+    t.start();
+    if (!start(p, args, wd))
+        return -1;
+
+    loop.exec();
+    const qint64 us = t.nsecsElapsed() / 1000;
+    const bool gotData = !p->readAllStandardOutput().isEmpty();
+    p->waitForFinished(-1);
+    return (gotData ? us : -1);
+}
+
+void SpawnerTest::initTestCase()
+{
+    qRegisterMetaType<QProcess::ExitStatus>("QProcess::ExitStatus");
+    QVERIFY(repo.isValid());
+    QVERIFY(repo.importHistory(1000));
+
+    SpawnedProcess p(NULL);
+    if (!p.start(QStringList() << "true", repo.path()))
+        QSKIP("posix_spawn not available, QProcess is used");
+
+    QVERIFY(p.waitForFinished(-1));
+}
+
+void SpawnerTest::output()
+{
+    // all of it, standard output and error kept apart
+    QStringList args;
+    args << "git" << "log" << "--format=%H %s";
+
+    SpawnedProcess p(NULL);
+    QVERIFY(p.start(args, repo.path()));
+    QByteArray out;
+    connect(&p, &SpawnedProcess::readyReadStandardOutput, [&]() { out.append(p.readAllStandardOutput()); });
+    QVERIFY(p.waitForFinished(-1));
+    out.append(p.readAllStandardOutput());
+
+    QByteArray expected;
+    QVERIFY(repo.git(args.mid(1), &expected));
+    QCOMPARE(out, expected);
+
+    SpawnedProcess e(NULL);
+    QVERIFY(e.start(QStringList() << "git" << "log" << "not-a-ref", repo.path()));
+    QVERIFY(e.waitForFinished(-1));
+    QVERIFY(e.readAllStandardOutput().isEmpty());
+    QVERIFY(e.readAllStandardError().contains("not-a-ref"));
+}
+
+void SpawnerTest::exitCode()
+{
+    // reaped in the event loop, once both pipes are closed
+    SpawnedProcess p(NULL);
+    QSignalSpy spy(&p, SIGNAL(finished(int, QProcess::ExitStatus)));
+    QVERIFY(p.start(QStringList() << "sh" << "-c" << "echo out; echo err >&2; exit 3", repo.path()));
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.at(0).at(0).toInt(), 3);
+    QVERIFY(!p.isRunning());
+}
+
+#ifdef Q_OS_LINUX
+static volatile sig_atomic_t alarms;
+static void onAlarm(int) { alarms++; }
+#endif
+
+void SpawnerTest::waitRetriesOnSignals()
+{
+/*
+   A signal handler installed without SA_RESTART makes poll() fail
+   with EINTR, waitForFinished() must go on waiting.
+*/
+#ifdef Q_OS_LINUX
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onAlarm;
+    QVERIFY(sigaction(SIGALRM, &sa, &old) == 0);
+
+    struct itimerval tv, oldTv;
+    memset(&tv, 0, sizeof(tv));
+    tv.it_interval.tv_usec = tv.it_value.tv_usec = 2000;
+    QVERIFY(setitimer(ITIMER_REAL, &tv, &oldTv) == 0);
+
+    alarms = 0;
+    SpawnedProcess p(NULL);
+    const bool started = p.start(QStringList() << "sh" << "-c" << "sleep 0.3; echo done", repo.path());
+    const bool finished = started && p.waitForFinished(-1);
+
+    memset(&tv, 0, sizeof(tv));
+    setitimer(ITIMER_REAL, &tv, NULL);
+    sigaction(SIGALRM, &old, NULL);
+
+    QVERIFY(finished);
+    QVERIFY(alarms > 0);
+    QCOMPARE(p.readAllStandardOutput(), QByteArray("done\n"));
+#else
+    QSKIP("Linux only");
+#endif
+}
+
+void SpawnerTest::closeFromSignal()
+{
+    // the whole output in the event loop, pipes are closed by notifiers
+    for (int i = 0; i < 20; i++) {
+        SpawnedProcess p(NULL);
+        QSignalSpy spy(&p, SIGNAL(finished(int, QProcess::ExitStatus)));
+        QVERIFY(p.start(QStringList() << "git" << "--version", repo.path()));
+        QVERIFY(spy.wait(10000));
+        QVERIFY(p.readAllStandardOutput().startsWith("git version"));
+    }
+}
+
+void SpawnerTest::killIgnoringTerm()
+{
+    // as MyProcess::on_cancel(), a bounded wait then a kill
+    SpawnedProcess p(NULL);
+    QSignalSpy ready(&p, SIGNAL(readyReadStandardOutput()));
+    QVERIFY(p.start(QStringList() << "sh" << "-c" << "trap '' TERM; echo ready; exec sleep 60",
+                    repo.path()));
+    QVERIFY(ready.wait(10000));
+
+    QElapsedTimer t;
+    t.start();
+    p.terminate();
+    QVERIFY(!p.waitForFinished(300));
+    QVERIFY(p.isRunning());
+
+    QSignalSpy spy(&p, SIGNAL(finished(int, QProcess::ExitStatus)));
+    p.kill();
+    QVERIFY(p.waitForFinished(10000));
+    QVERIFY(!p.isRunning());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(1).value<QProcess::ExitStatus>(), QProcess::CrashExit);
+    QVERIFY(t.elapsed() < 10000);
+}
+
+void SpawnerTest::firstByteTime_data()
+{
+    // fork() of QProcess costs more when the parent is bigger
+    QTest::addColumn<int>("residentMB");
+    QTest::newRow("small") << 0;
+    QTest::newRow("512 MB resident") << 512;
+}
+
+void SpawnerTest::firstByteTime()
+{
+    QFETCH(int, residentMB);
+    QByteArray ballast(residentMB * 1024 * 1024, 'x');
+
+    const QStringList args(QStringList() << "git" << "rev-parse" << "HEAD");
+    QVector<qint64> spawned, forked;
+    for (int i = 0; i < 50; i++) {
+        SpawnedProcess sp(NULL);
+        spawned.append(firstByte(&sp, args, repo.path()));
+        QProcess qp;
+        forked.append(firstByte(&qp, args, repo.path()));
+    }
+    std::sort(spawned.begin(), spawned.end());
+    std::sort(forked.begin(), forked.end());
+    QVERIFY(spawned.first() > 0 && forked.first() > 0);
+
+    qDebug("spawn to first byte, median of %d: posix_spawn %lld us, QProcess %lld us (%d MB resident)",
+           spawned.count(), spawned.at(spawned.count() / 2), forked.at(forked.count() / 2),
+           ballast.size() / (1024 * 1024));
+}
+
+QTEST_GUILESS_MAIN(SpawnerTest)
+
+#include "tst_spawner.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_tasks
+
+SOURCES += \
+    $$PWD/tst_tasks.cpp
@@ -0,0 +1,124 @@
+#include <QTimer>
+#include <QtTest>
+
+#include "filehistory.h"
+#include "git.h"
+#include "myprocess.h"
+#include "task.h"
+#include "testrepo.h"
+
+class TasksTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    TasksTest() : git(NULL) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void followRenames();
+    void cancelRenames();
+    void badArguments();
+    void runSyncNoEvents();
+
+private:
+    TestRepo repo;
+    Git* git;
+    QString first, head;
+};
+
+void TasksTest::initTestCase()
+{
+    // a file renamed once, history of the old name ends in the new one
+    QVERIFY(repo.isValid());
+    QVERIFY(repo.commit("a.txt", "a\n", "add a"));
+    QVERIFY(repo.commit("a.txt", "a\nb\n", "change a"));
+
+    QByteArray out;
+    QVERIFY(repo.git(QStringList() << "rev-parse" << "HEAD", &out));
+    first = QString::fromLatin1(out).trimmed();
+
+    QVERIFY(repo.git(QStringList() << "mv" << "a.txt" << "b.txt"));
+    QVERIFY(repo.git(QStringList() << "commit" << "-q" << "-m" << "rename a"));
+    QVERIFY(repo.git(QStringList() << "rev-parse" << "HEAD", &out));
+    head = QString::fromLatin1(out).trimmed();
+
+    git = new Git(NULL);
+    QVERIFY(repo.load(git));
+}
+
+void TasksTest::cleanupTestCase()
+{
+    delete git;
+}
+
+void TasksTest::followRenames()
+{
+    FileHistory fh(NULL, git);
+    QObject ctx;
+    QList<const FileHistory*> loaded;
+    connect(git, &Git::loadCompleted, &ctx, [&loaded](const FileHistory* f, const QString&) { loaded.append(f); });
+
+    QVERIFY(git->startFileHistory(first, "a.txt", &fh));
+    QTRY_VERIFY(loaded.contains(&fh));
+    QCOMPARE(fh.fileNames().value(0), QString("b.txt")); // the newest name
+    QVERIFY(fh.rowCount() > 0);
+}
+
+void TasksTest::cancelRenames()
+{
+/*
+   Closing the file viewer before the rename search is done must
+   not start the history load once the search completes.
+*/
+    FileHistory fh(NULL, git);
+    QObject ctx;
+    QList<const FileHistory*> loaded;
+    connect(git, &Git::loadCompleted, &ctx, [&loaded](const FileHistory* f, const QString&) { loaded.append(f); });
+
+    QVERIFY(git->startFileHistory(first, "a.txt", &fh));
+    QVERIFY(fh.findChild<Task*>());
+    git->cancelDataLoading(&fh);
+
+    QTRY_VERIFY(!fh.findChild<Task*>()); // deleted once finished
+    QVERIFY(fh.fileNames().isEmpty());
+    QCOMPARE(fh.rowCount(), 0);
+    QVERIFY(!loaded.contains(&fh));
+
+    // also by a clear, as when the viewer is reused
+    QVERIFY(git->startFileHistory(first, "a.txt", &fh));
+    fh.clear();
+    QTRY_VERIFY(!fh.findChild<Task*>());
+    QVERIFY(fh.fileNames().isEmpty());
+}
+
+void TasksTest::badArguments()
+{
+    FileHistory fh(NULL, git);
+    QVERIFY(!git->startFileHistory(QString(40, '0'), "a.txt", &fh));
+    QVERIFY(!git->startFileHistory(head, "", &fh));
+    QVERIFY(!fh.findChild<Task*>());
+}
+
+void TasksTest::runSyncNoEvents()
+{
+    // a slot run while waiting could re-enter the caller
+    bool fired = false;
+    QTimer t;
+    t.setSingleShot(true);
+    connect(&t, &QTimer::timeout, [&fired]() { fired = true; });
+    t.start(0);
+
+    MyProcess p(NULL, git, repo.path(), false);
+    QByteArray out;
+    QVERIFY(p.runSync("git rev-parse HEAD", &out, NULL, ""));
+    QCOMPARE(QString::fromLatin1(out).trimmed(), head);
+    QVERIFY(!fired);
+
+    QTRY_VERIFY(fired); // once back in the event loop
+}
+
+QGIT_TEST_MAIN(TasksTest)
+
+#include "tst_tasks.moc"
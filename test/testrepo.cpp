@@ -0,0 +1,194 @@
+#include "testrepo.h"
+
+#include <QEventLoop>
+#include <QFile>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTimer>
+
+#include "git.h"
+
+static const uint BASE_TIME = 1500000000;
+
+static void appendData(QByteArray* s, const QByteArray& data) {
+
+    s->append("data ").append(QByteArray::number(data.size())).append('\n');
+    s->append(data).append('\n');
+}
+
+static int appendCommit(QByteArray* s, const char* ref, int mark, int from, int merge, int i) {
+/*
+   Messages, names and paths cover the cases the log parsers
+   care about: bodies with blank lines, subjects split on more
+   lines, trailing spaces and non ASCII text.
+*/
+    static const char* msgs[] = {
+        "subject %1\n",
+        "subject %1\n\nbody of %1\nsecond line\n",
+        "first line %1\ncontinued subject  \n\nbody\n",
+        "subject %1\n\n\nbody after blank lines\n"
+    };
+    const QByteArray n(QByteArray::number(i));
+    QByteArray msg(msgs[i % 4]);
+    msg.replace("%1", n);
+
+    s->append("commit ").append(ref).append('\n');
+    s->append("mark :").append(QByteArray::number(mark)).append('\n');
+    s->append("author ").append(i % 5 ? "A U Thor" : "J\xc3\xbcrgen \xc3\x9cnicode");
+    s->append(" <author@example.com> ").append(QByteArray::number(BASE_TIME + i * 60 - (i % 3) * 7));
+    s->append(" +0100\n");
+    s->append("committer C O Mitter <committer@example.com> ");
+    s->append(QByteArray::number(BASE_TIME + i * 60)).append(" +0000\n");
+    appendData(s, msg);
+    if (from)
+        s->append("from :").append(QByteArray::number(from)).append('\n');
+    if (merge)
+        s->append("merge :").append(QByteArray::number(merge)).append('\n');
+
+    QByteArray path;
+    if (merge)
+        path = "merges.txt";
+    else if (i % 9 == 0)
+        path = "doc/\xc3\xbcn\xc3\xaf" + QByteArray::number(i % 3) + ".txt";
+    else
+        path = "src/m" + QByteArray::number(i % 7) + "/f" + QByteArray::number(i % 13) + ".txt";
+
+    s->append("M 644 inline ").append(path).append('\n');
+    appendData(s, "content of " + n + '\n');
+    s->append('\n');
+    return mark;
+}
+
+TestRepo::TestRepo() : valid(false) {
+
+    valid = dir.isValid() && git(QStringList() << "init" << "-q" << ".");
+}
+
+bool TestRepo::git(const QStringList& args, QByteArray* out, const QByteArray& input) const {
+// user configuration must not change the output
+
+    QProcessEnvironment env(QProcessEnvironment::systemEnvironment());
+    env.insert("HOME", dir.path());
+    env.insert("GIT_CONFIG_NOSYSTEM", "1");
+    env.insert("LC_ALL", "C");
+    env.insert("TZ", "UTC");
+
+    QStringList a;
+    a << "-c" << "user.name=C O Mitter" << "-c" << "user.email=committer@example.com"
+      << "-c" << "gc.auto=0" << args;
+
+    QProcess p;
+    p.setProcessEnvironment(env);
+    p.setWorkingDirectory(dir.path());
+    p.start("git", a);
+    if (!p.waitForStarted())
+        return false;
+
+    if (!input.isEmpty())
+        p.write(input);
+
+    p.closeWriteChannel();
+    if (!p.waitForFinished(-1))
+        return false;
+
+    if (out)
+        *out = p.readAllStandardOutput();
+
+    return (p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0);
+}
+
+const QByteArray TestRepo::fastImportStream(int commits) {
+/*
+   Every 50 commits a topic branch of 5 commits grows interleaved
+   with master, then it is merged, one out of four is left unmerged
+   under its own ref instead. Master gets an annotated tag every
+   1000 commits.
+*/
+    QByteArray s;
+    int mark = 0, master = 0, topics = 0;
+    int i = 0;
+    while (i < commits) {
+
+        if (i % 50 != 20 || i + 11 > commits) {
+            master = appendCommit(&s, "refs/heads/master", ++mark, master, 0, i++);
+
+            if (i % 1000 == 0) {
+                s.append("tag v").append(QByteArray::number(i / 1000)).append('\n');
+                s.append("from :").append(QByteArray::number(master)).append('\n');
+                s.append("tagger C O Mitter <committer@example.com> ");
+                s.append(QByteArray::number(BASE_TIME + i * 60)).append(" +0000\n");
+                appendData(&s, "release " + QByteArray::number(i / 1000) + '\n');
+            }
+            continue;
+        }
+        int tip = master;
+        for (int k = 0; k < 5; k++) {
+            tip = appendCommit(&s, "refs/heads/topic", ++mark, tip, 0, i++);
+            master = appendCommit(&s, "refs/heads/master", ++mark, master, 0, i++);
+        }
+        if (++topics % 4 == 0) {
+            s.append("reset refs/heads/feature-").append(QByteArray::number(topics)).append('\n');
+            s.append("from :").append(QByteArray::number(tip)).append("\n\n");
+        } else
+            master = appendCommit(&s, "refs/heads/master", ++mark, master, tip, i++);
+    }
+    return s;
+}
+
+bool TestRepo::importHistory(int commits) {
+
+    return git(QStringList() << "fast-import" << "--quiet", NULL, fastImportStream(commits))
+        && git(QStringList() << "reset" << "-q" << "--hard" << "master");
+}
+
+bool TestRepo::commit(const QString& file, const QByteArray& content, const QString& msg) {
+// a loose commit on top of current branch
+
+    QFile f(dir.path() + '/' + file);
+    if (!f.open(QIODevice::WriteOnly) || f.write(content) != content.size())
+        return false;
+
+    f.close();
+    return git(QStringList() << "add" << file)
+        && git(QStringList() << "commit" << "-q" << "-m" << msg);
+}
+
+const QStringList TestRepo::tips() const {
+// all refs and HEAD, as Git::startNativeRevList() does
+
+    QByteArray out;
+    if (!git(QStringList() << "for-each-ref" << "--format=%(objectname)", &out))
+        return QStringList();
+
+    QStringList res(QString::fromLatin1(out).split('\n', QString::SkipEmptyParts));
+    if (git(QStringList() << "rev-parse" << "HEAD", &out))
+        res.append(QString::fromLatin1(out).trimmed());
+
+    return res;
+}
+
+const FileHistory* TestRepo::load(Git* git) const {
+/*
+   Main history once loading completed, or NULL. Git runs its own
+   commands, they get the same environment of the ones above.
+*/
+    qputenv("HOME", dir.path().toLocal8Bit());
+    qputenv("GIT_CONFIG_NOSYSTEM", "1");
+    qputenv("TZ", "UTC");
+
+    const FileHistory* fh = NULL;
+    QEventLoop loop;
+    const QMetaObject::Connection c(QObject::connect(git, &Git::loadCompleted,
+                                                     [&](const FileHistory* f, const QString&) {
+        if (git->isMainHistory(f)) {
+            fh = f;
+            loop.quit();
+        }
+    }));
+    QTimer::singleShot(5 * 60 * 1000, &loop, SLOT(quit()));
+    if (git->init(dir.path(), NULL, false) && !fh)
+        loop.exec();
+
+    QObject::disconnect(c);
+    return fh;
+}
@@ -0,0 +1,58 @@
+#ifndef TESTREPO_H
+#define TESTREPO_H
+
+#include <QApplication>
+#include <QByteArray>
+#include <QStringList>
+#include <QTemporaryDir>
+
+/*
+ * A throw away repository for the tests, removed on destruction.
+ *
+ * importHistory() creates with 'git fast-import' a synthetic history
+ * with merged and unmerged topic branches and annotated tags, each
+ * commit changes a file in a small directory tree. The result is
+ * always the same for the same number of commits.
+ *
+ * load() opens the repository in a Git object, as a window does, for
+ * the tests of the loaded data.
+ */
+class Git;
+class FileHistory;
+
+class TestRepo {
+public:
+    TestRepo();
+
+    bool isValid() const { return valid; }
+    const QString path() const { return dir.path(); }
+    const QString gitDir() const { return dir.path() + "/.git"; }
+
+    bool git(const QStringList& args, QByteArray* out = NULL,
+             const QByteArray& input = QByteArray()) const;
+    bool importHistory(int commits);
+    bool commit(const QString& file, const QByteArray& content, const QString& msg);
+    const QStringList tips() const;
+    const FileHistory* load(Git* git) const;
+
+    static const QByteArray fastImportStream(int commits);
+
+private:
+    QTemporaryDir dir;
+    bool valid;
+};
+
+/*
+ * As QTEST_MAIN, but the application gets no arguments because qgit
+ * passes its own ones to 'git log', see Git::getArgs().
+ */
+#define QGIT_TEST_MAIN(TestObject) \
+int main(int argc, char* argv[]) \
+{ \
+    int appArgc = 1; \
+    QApplication app(appArgc, argv); \
+    TestObject tc; \
+    return QTest::qExec(&tc, argc, argv); \
+}
+
+#endif // TESTREPO_H
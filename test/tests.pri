@@ -0,0 +1,19 @@
+# Settings shared by the unit tests, each one is a separate
+# executable built, as test_diff, against the application sources.
+# Tests needing a repository build it in a temporary directory
+# with the git found in PATH, see testrepo.h
+
+DEFINES += QGIT_TEST_BUILD=1
+
+include($$PWD/../src/src.pro)
+
+QT       += widgets testlib
+
+INCLUDEPATH += $$PWD
+CONFIG   += console testcase
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+HEADERS += $$PWD/testrepo.h
+SOURCES += $$PWD/testrepo.cpp